@@ -18,7 +18,7 @@ import numpy as np
 def parse_args():
     """Parse command line arguments"""
     parser = argparse.ArgumentParser(description='Analyze experiment results')
-    parser.add_argument('--type', choices=['timing', 'energy'], required=True,
+    parser.add_argument('--type', choices=['timing', 'energy', 'bench'], required=True,
                         help='Type of results to analyze')
     parser.add_argument('--dir', default=None,
                         help='Directory containing result files')
@@ -127,6 +127,8 @@ def analyze_energy_results(directory, output_dir):
     
     # Regular expression to extract operation rates
     rate_regex = re.compile(r'STAT: (\d+)s - Rate:\s+(\d+) ops/sec')
+    # Summary line of the worker mode (continuous_operation --threads/--work)
+    result_regex = re.compile(r'^RESULT: (.*)$')
     
     # Read all log files
     for log_file in log_files:
@@ -151,12 +153,20 @@ def analyze_energy_results(directory, output_dir):
         
         # Extract operation rates from log file
         rates = []
+        result = {}
         with open(log_file, 'r') as f:
             for line in f:
                 match = rate_regex.search(line)
                 if match:
                     seconds, rate = match.groups()
                     rates.append(int(rate))
+                match = result_regex.search(line)
+                if match:
+                    result = dict(field.split('=', 1) for field in match.group(1).split())
+        
+        # A short worker run may end before its first STAT line
+        if not rates and result:
+            rates = [float(result['ops_per_sec'])]
         
         if rates:
             # Add this experiment's average rate to results
@@ -166,7 +176,9 @@ def analyze_energy_results(directory, output_dir):
                 'avg_rate': avg_rate,
                 'min_rate': min(rates),
                 'max_rate': max(rates),
-                'rates': rates
+                'rates': rates,
+                'rate_per_core': float(result['ops_per_sec_per_core']) if result else None,
+                'ops_per_joule': float(result['ops_per_joule']) if result.get('ops_per_joule', 'NA') != 'NA' else None
             })
     
     # Calculate statistics
@@ -177,17 +189,22 @@ def analyze_energy_results(directory, output_dir):
             experiments = results[algorithm][bits]
             if experiments:
                 avg_rates = [exp['avg_rate'] for exp in experiments]
+                per_core = [exp['rate_per_core'] for exp in experiments if exp['rate_per_core'] is not None]
+                per_joule = [exp['ops_per_joule'] for exp in experiments if exp['ops_per_joule'] is not None]
                 stats[algorithm][bits] = {
                     'min_rate': min(avg_rates),
                     'max_rate': max(avg_rates),
                     'mean_rate': statistics.mean(avg_rates) if avg_rates else 0,
+                    'mean_rate_per_core': statistics.mean(per_core) if per_core else '',
+                    'mean_ops_per_joule': statistics.mean(per_joule) if per_joule else '',
                     'experiments': len(experiments)
                 }
     
     # Write summary to CSV
     summary_file = os.path.join(output_dir, 'energy_summary.csv')
     with open(summary_file, 'w', newline='') as f:
-        fieldnames = ['algorithm', 'bits', 'min_rate', 'max_rate', 'mean_rate', 'experiments']
+        fieldnames = ['algorithm', 'bits', 'min_rate', 'max_rate', 'mean_rate', 'mean_rate_per_core',
+                      'mean_ops_per_joule', 'experiments']
         writer = csv.DictWriter(f, fieldnames=fieldnames)
         writer.writeheader()
         
@@ -203,6 +220,91 @@ def analyze_energy_results(directory, output_dir):
     
     return stats
 
+def analyze_bench_results(directory, output_dir):
+    """Analyze benchmark results written by BenchResults (the Benchmark,... schema)"""
+    if not directory:
+        directory = os.path.join(os.path.dirname(os.path.dirname(os.path.dirname(os.path.abspath(__file__)))),
+                                 'results')
+    
+    # Create output directory if it doesn't exist
+    os.makedirs(output_dir, exist_ok=True)
+    
+    # Only files in the shared schema; throughput, counter and raw sample files are skipped
+    rows = []
+    for csv_file in sorted(glob.glob(os.path.join(directory, '*.csv'))):
+        with open(csv_file, 'r') as f:
+            reader = csv.DictReader(f)
+            if not reader.fieldnames or reader.fieldnames[0] != 'Benchmark' or 'P50Ms' not in reader.fieldnames:
+                continue
+            print(f"Processing {os.path.basename(csv_file)}...")
+            for row in reader:
+                if row['Runs'] == '0':
+                    continue
+                rows.append(row)
+    
+    if not rows:
+        print(f"No benchmark results found in {directory}")
+        return
+    
+    # Series are (benchmark, algorithm, variant); points are bit sizes
+    stats = {}
+    for row in rows:
+        series = ' '.join(part for part in (row['Benchmark'], row['Algorithm'], row['Variant']) if part)
+        stats.setdefault(series, {})[int(row['BitSize'])] = {
+            'p50': float(row['P50Ms']),
+            'ci_low': float(row['CiLowMs']),
+            'ci_high': float(row['CiHighMs']),
+            'p99': float(row['P99Ms']),
+            'runs': int(row['Runs']),
+            'converged': row['Converged'] == '1'
+        }
+    
+    # Write summary to CSV
+    summary_file = os.path.join(output_dir, 'bench_summary.csv')
+    with open(summary_file, 'w', newline='') as f:
+        fieldnames = ['series', 'bits', 'p50', 'ci_low', 'ci_high', 'p99', 'runs', 'converged']
+        writer = csv.DictWriter(f, fieldnames=fieldnames)
+        writer.writeheader()
+        
+        for series in sorted(stats.keys()):
+            for bits in sorted(stats[series].keys()):
+                writer.writerow({'series': series, 'bits': bits, **stats[series][bits]})
+    
+    unconverged = sum(1 for series in stats for bits in stats[series] if not stats[series][bits]['converged'])
+    if unconverged:
+        print(f"Warning: {unconverged} results did not reach their confidence interval target")
+    
+    print(f"Benchmark summary written to {summary_file}")
+    
+    return stats
+
+def generate_bench_plots(stats, output_dir):
+    """Generate plots for benchmark results: median with its confidence interval"""
+    if not stats:
+        return
+    
+    plt.figure(figsize=(12, 8))
+    
+    for series in sorted(stats.keys()):
+        x = sorted(stats[series].keys())
+        y = [stats[series][bits]['p50'] for bits in x]
+        low = [stats[series][bits]['p50'] - stats[series][bits]['ci_low'] for bits in x]
+        high = [stats[series][bits]['ci_high'] - stats[series][bits]['p50'] for bits in x]
+        
+        plt.errorbar(x, y, yerr=[low, high], marker='o', capsize=3, label=series)
+    
+    plt.title('Median Time by Bit Size (with confidence interval)')
+    plt.xlabel('Bit Size')
+    plt.ylabel('Time (ms)')
+    plt.xscale('log', base=2)
+    plt.yscale('log', base=10)
+    plt.grid(True, which='both', linestyle='--', alpha=0.5)
+    plt.legend()
+    
+    plot_file = os.path.join(output_dir, 'bench_plot.png')
+    plt.savefig(plot_file)
+    print(f"Benchmark plot saved to {plot_file}")
+
 def generate_timing_plots(stats, output_dir):
     """Generate plots for timing results"""
     if not stats:
@@ -267,6 +369,10 @@ def main():
         stats = analyze_timing_results(args.dir, args.output)
         if args.plot:
             generate_timing_plots(stats, args.output)
+    elif args.type == 'bench':
+        stats = analyze_bench_results(args.dir, args.output)
+        if args.plot:
+            generate_bench_plots(stats, args.output)
     else:  # energy
         stats = analyze_energy_results(args.dir, args.output)
         if args.plot:
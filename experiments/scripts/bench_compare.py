@@ -0,0 +1,164 @@
+#!/usr/bin/env python3
+
+"""
+Compare benchmark timings against a stored baseline
+
+Reads the raw timings that BenchResults writes next to every latency result
+file (*_samples.csv) from a baseline and a current results directory. Every
+result present in both is compared with a one-sided Mann-Whitney U test on
+the raw runs, so a change is only reported when the whole distribution has
+shifted and not because of a few outliers. A result regresses when the test
+is significant and its median grew by more than the threshold and by more
+than the noise floor (operations of a few tens of nanoseconds are only a
+few dozen timer ticks, where one tick is already several percent).
+
+Exits with 1 if any result regressed or a baseline result is missing from
+the current run, so it can gate an upgrade. Needs only the standard library.
+"""
+
+import os
+import sys
+import csv
+import glob
+import math
+import argparse
+import statistics
+
+def parse_args():
+    """Parse command line arguments"""
+    parser = argparse.ArgumentParser(description='Compare benchmark results with a baseline')
+    parser.add_argument('baseline',
+                        help='Baseline results directory (or a single *_samples.csv file)')
+    parser.add_argument('current', nargs='?', default='results',
+                        help='Current results directory (or a single *_samples.csv file)')
+    parser.add_argument('--threshold', type=float, default=0.05,
+                        help='Relative median increase that counts as a regression (default: 0.05)')
+    parser.add_argument('--alpha', type=float, default=0.01,
+                        help='Significance level of the Mann-Whitney test (default: 0.01)')
+    parser.add_argument('--noise-floor-ms', type=float, default=1e-5,
+                        help='Median changes smaller than this are timer noise (default: 1e-5, 10 ns)')
+    parser.add_argument('--all', action='store_true',
+                        help='List unchanged results too, not only changes')
+    return parser.parse_args()
+
+def load_samples(path):
+    """Load raw timings keyed by (benchmark, algorithm, bits, variant)"""
+    files = [path] if os.path.isfile(path) else sorted(glob.glob(os.path.join(path, '*_samples.csv')))
+    samples = {}
+    for sample_file in files:
+        with open(sample_file, 'r') as f:
+            for row in csv.DictReader(f):
+                key = (row['Benchmark'], row['Algorithm'], int(row['BitSize']), row['Variant'])
+                samples[key] = [float(v) for v in row['SamplesMs'].split()]
+    return samples
+
+def normal_sf(z):
+    """Upper tail probability of the standard normal distribution"""
+    return 0.5 * math.erfc(z / math.sqrt(2))
+
+def mann_whitney_greater(current, baseline):
+    """
+    One-sided Mann-Whitney U test that current tends to be larger than baseline
+
+    Uses the normal approximation with tie and continuity corrections, which
+    is adequate for the ten or more runs the harness always takes.
+    Returns the p-value.
+    """
+    n1, n2 = len(current), len(baseline)
+    values = sorted([(v, 0) for v in current] + [(v, 1) for v in baseline])
+
+    # Average ranks over ties
+    rank_sum = 0.0
+    tie_term = 0.0
+    i = 0
+    while i < len(values):
+        j = i
+        while j + 1 < len(values) and values[j + 1][0] == values[i][0]:
+            j += 1
+        rank = (i + j) / 2.0 + 1
+        rank_sum += rank * sum(1 for k in range(i, j + 1) if values[k][1] == 0)
+        t = j - i + 1
+        tie_term += t ** 3 - t
+        i = j + 1
+
+    u = rank_sum - n1 * (n1 + 1) / 2.0
+    mean = n1 * n2 / 2.0
+    n = n1 + n2
+    variance = n1 * n2 / 12.0 * ((n + 1) - tie_term / (n * (n - 1)))
+    if variance <= 0:
+        return 1.0
+    z = (u - mean - 0.5) / math.sqrt(variance)
+    return normal_sf(z)
+
+def compare(baseline, current, threshold, alpha, noise_floor):
+    """Compare every baseline result with the current one; returns table rows"""
+    rows = []
+    for key in sorted(baseline.keys()):
+        base = baseline[key]
+        if key not in current:
+            rows.append((key, statistics.median(base), None, None, None, 'MISSING'))
+            continue
+        cur = current[key]
+        base_median = statistics.median(base)
+        cur_median = statistics.median(cur)
+        change = cur_median / base_median - 1 if base_median > 0 else 0.0
+        visible = abs(cur_median - base_median) > noise_floor
+
+        p_slower = mann_whitney_greater(cur, base)
+        p_faster = mann_whitney_greater(base, cur)
+        if visible and p_slower < alpha and change > threshold:
+            status, p = 'REGRESSED', p_slower
+        elif visible and p_faster < alpha and change < -threshold:
+            status, p = 'IMPROVED', p_faster
+        else:
+            status, p = 'same', min(p_slower, p_faster)
+        rows.append((key, base_median, cur_median, change, p, status))
+
+    for key in sorted(set(current.keys()) - set(baseline.keys())):
+        rows.append((key, None, statistics.median(current[key]), None, None, 'NEW'))
+    return rows
+
+def print_table(rows, show_all):
+    """Print the comparison as a fixed-width table"""
+    header = ('Benchmark', 'Algorithm', 'Bits', 'Variant', 'BaseP50Ms', 'CurP50Ms', 'Change', 'p', 'Status')
+    lines = []
+    for key, base, cur, change, p, status in rows:
+        if status == 'same' and not show_all:
+            continue
+        lines.append((key[0], key[1], str(key[2]), key[3],
+                      '-' if base is None else f'{base:.6g}',
+                      '-' if cur is None else f'{cur:.6g}',
+                      '-' if change is None else f'{change * 100:+.1f}%',
+                      '-' if p is None else f'{p:.2g}',
+                      status))
+    if not lines:
+        return
+    widths = [max(len(line[i]) for line in [header] + lines) for i in range(len(header))]
+    for line in [header] + lines:
+        print('  '.join(field.ljust(width) for field, width in zip(line, widths)).rstrip())
+
+def main():
+    args = parse_args()
+
+    baseline = load_samples(args.baseline)
+    if not baseline:
+        print(f"No baseline samples found in {args.baseline}")
+        return 2
+    current = load_samples(args.current)
+    if not current:
+        print(f"No current samples found in {args.current}")
+        return 2
+
+    rows = compare(baseline, current, args.threshold, args.alpha, args.noise_floor_ms)
+    print_table(rows, args.all)
+
+    counts = {}
+    for row in rows:
+        counts[row[5]] = counts.get(row[5], 0) + 1
+    print(f"{len(rows)} results: " + ', '.join(f"{counts[s]} {s.lower()}" for s in sorted(counts)))
+    print(f"(regression: median +{args.threshold * 100:.0f}% and Mann-Whitney p < {args.alpha})")
+
+    return 1 if counts.get('REGRESSED') or counts.get('MISSING') else 0
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -26,6 +26,9 @@ function print_help() {
     echo "  -d, --duration SECONDS   Duration in seconds (default: $DEFAULT_DURATION)"
     echo "  -c, --config FILE        Config file to use (default: default_config.json)"
     echo "  -o, --output DIR         Output directory (default: $DEFAULT_OUTPUT_DIR)"
+    echo "      --threads N          Run N pinned workers on fresh candidates (0 for one per core)"
+    echo "      --work N             Stop after N numbers or primes (the duration becomes a time limit)"
+    echo "      --no-meter           Do not prompt for a USB power meter (use the RAPL/hwmon counters)"
     echo "  -h, --help               Show this help message"
     exit 0
 }
@@ -36,6 +39,9 @@ BITS="all"
 DURATION=$DEFAULT_DURATION
 CONFIG_FILE=$DEFAULT_CONFIG
 OUTPUT_DIR=$DEFAULT_OUTPUT_DIR
+THREADS=""
+WORK=""
+NO_METER=0
 
 while (( "$#" )); do
     case "$1" in
@@ -84,6 +90,28 @@ while (( "$#" )); do
                 exit 1
             fi
             ;;
+        --threads)
+            if [ -n "$2" ] && [ ${2:0:1} != "-" ]; then
+                THREADS=$2
+                shift 2
+            else
+                echo "Error: Argument for $1 is missing" >&2
+                exit 1
+            fi
+            ;;
+        --work)
+            if [ -n "$2" ] && [ ${2:0:1} != "-" ]; then
+                WORK=$2
+                shift 2
+            else
+                echo "Error: Argument for $1 is missing" >&2
+                exit 1
+            fi
+            ;;
+        --no-meter)
+            NO_METER=1
+            shift
+            ;;
         -h|--help)
             print_help
             ;;
@@ -115,6 +143,15 @@ else
     exit 1
 fi
 
+# Worker mode options for continuous_operation
+WORKER_ARGS=()
+if [ -n "$THREADS" ]; then
+    WORKER_ARGS+=("--threads=$THREADS")
+fi
+if [ -n "$WORK" ]; then
+    WORKER_ARGS+=("--work=$WORK")
+fi
+
 # Get timestamp for this experiment run
 TIMESTAMP=$(date +"%Y%m%d_%H%M%S")
 
@@ -128,6 +165,9 @@ for algo in "${ALGOS[@]}"; do
         echo "Algorithm: $algo" >> "$log_file"
         echo "Bit size: $bits" >> "$log_file"
         echo "Duration: $DURATION seconds" >> "$log_file"
+        if [ ${#WORKER_ARGS[@]} -gt 0 ]; then
+            echo "Workers: ${WORKER_ARGS[*]}" >> "$log_file"
+        fi
         echo "------------------------------" >> "$log_file"
         
         # Display instructions for the user
@@ -135,18 +175,20 @@ for algo in "${ALGOS[@]}"; do
         echo "========================================================================================="
         echo "ENERGY MEASUREMENT FOR: $algo with $bits bits"
         echo "========================================================================================="
-        echo "Start capturing energy consumption with your USB power meter NOW."
-        echo "This test will run for $DURATION seconds."
-        echo "Press Ctrl+C to stop the test early (not recommended)."
-        echo ""
-        echo "Test will start in 5 seconds..."
-        sleep 5
+        if [ "$NO_METER" -eq 0 ]; then
+            echo "Start capturing energy consumption with your USB power meter NOW."
+            echo "This test will run for $DURATION seconds."
+            echo "Press Ctrl+C to stop the test early (not recommended)."
+            echo ""
+            echo "Test will start in 5 seconds..."
+            sleep 5
+        fi
         
         # Run the continuous operation program
         start_time=$(date +%s)
         end_time=$((start_time + DURATION))
         
-        "$REPO_ROOT/experiments/bin/continuous_operation" "$algo" "$bits" "$DURATION" | tee -a "$log_file"
+        "$REPO_ROOT/experiments/bin/continuous_operation" "$algo" "$bits" "$DURATION" "${WORKER_ARGS[@]}" | tee -a "$log_file"
         
         echo "" >> "$log_file"
         echo "Experiment completed at $(date)" >> "$log_file"
@@ -155,12 +197,14 @@ for algo in "${ALGOS[@]}"; do
         echo "========================================================================================="
         echo "ENERGY MEASUREMENT COMPLETE"
         echo "========================================================================================="
-        echo "Stop capturing energy consumption with your USB power meter NOW."
+        if [ "$NO_METER" -eq 0 ]; then
+            echo "Stop capturing energy consumption with your USB power meter NOW."
+        fi
         echo "Results logged to: $log_file"
         echo ""
         
         # If not the last experiment, wait for user to prepare for the next one
-        if [ "$algo" != "${ALGOS[-1]}" ] || [ "$bits" != "${BIT_SIZES[-1]}" ]; then
+        if [ "$NO_METER" -eq 0 ] && { [ "$algo" != "${ALGOS[-1]}" ] || [ "$bits" != "${BIT_SIZES[-1]}" ]; }; then
             echo "Press Enter when ready to continue to the next experiment..."
             read
         fi
@@ -30,11 +30,15 @@ function print_help() {
     echo "  -i, --iterations COUNT    Number of iterations for timing tests (default: $DEFAULT_ITERATIONS)"
     echo "  -c, --config FILE         Config file to use (default: $DEFAULT_CONFIG)"
     echo "  -o, --output DIR          Output directory (default based on experiment type)"
+    echo "      --threads N           Energy: run N pinned workers on fresh candidates (0 for one per core)"
+    echo "      --work N              Energy: stop after N numbers or primes"
+    echo "      --no-meter            Energy: do not prompt for a USB power meter"
     echo "  -h, --help                Show this help message"
     echo ""
     echo "Examples:"
     echo "  $0 --timing --algorithm lcg --bits 1024 --iterations 100"
     echo "  $0 --energy --algorithm all --duration 1800"
+    echo "  $0 --energy --algorithm miller_rabin --bits 2048 --threads 0 --work 10000 --no-meter"
     exit 0
 }
 
@@ -46,6 +50,9 @@ DURATION=$DEFAULT_DURATION
 ITERATIONS=$DEFAULT_ITERATIONS
 CONFIG_FILE="$CONFIG_DIR/$DEFAULT_CONFIG"
 OUTPUT_DIR=""
+THREADS=""
+WORK=""
+NO_METER=0
 
 while (( "$#" )); do
     case "$1" in
@@ -111,6 +118,28 @@ while (( "$#" )); do
                 exit 1
             fi
             ;;
+        --threads)
+            if [ -n "$2" ] && [ ${2:0:1} != "-" ]; then
+                THREADS=$2
+                shift 2
+            else
+                echo "Error: Argument for $1 is missing" >&2
+                exit 1
+            fi
+            ;;
+        --work)
+            if [ -n "$2" ] && [ ${2:0:1} != "-" ]; then
+                WORK=$2
+                shift 2
+            else
+                echo "Error: Argument for $1 is missing" >&2
+                exit 1
+            fi
+            ;;
+        --no-meter)
+            NO_METER=1
+            shift
+            ;;
         -h|--help)
             print_help
             ;;
@@ -155,13 +184,26 @@ else
     echo "- Duration: $DURATION seconds"
     echo "- Output: $OUTPUT_DIR"
     
+    # Worker mode options
+    ENERGY_ARGS=()
+    if [ -n "$THREADS" ]; then
+        ENERGY_ARGS+=(--threads "$THREADS")
+    fi
+    if [ -n "$WORK" ]; then
+        ENERGY_ARGS+=(--work "$WORK")
+    fi
+    if [ "$NO_METER" -eq 1 ]; then
+        ENERGY_ARGS+=(--no-meter)
+    fi
+    
     # Call the energy experiment script
     "$SCRIPT_DIR/energy_experiment.sh" \
         --algorithm "$ALGORITHM" \
         --bits "$BITS" \
         --duration "$DURATION" \
         --config "$CONFIG_FILE" \
-        --output "$OUTPUT_DIR"
+        --output "$OUTPUT_DIR" \
+        "${ENERGY_ARGS[@]}"
 fi
 
 echo "Experiments completed successfully!" 
\ No newline at end of file
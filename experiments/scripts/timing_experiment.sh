@@ -11,6 +11,9 @@ EXPERIMENTS_DIR="$REPO_ROOT/experiments"
 CONFIG_DIR="$EXPERIMENTS_DIR/configs"
 RESULTS_DIR="$EXPERIMENTS_DIR/results/timing"
 
+# Primes under test come from the shared cache, wherever the script is run from
+export PRIME_CACHE="${PRIME_CACHE:-$EXPERIMENTS_DIR/cache/primes.bin}"
+
 # Default values
 DEFAULT_CONFIG="$CONFIG_DIR/default_config.json"
 DEFAULT_ITERATIONS=10
@@ -145,6 +148,11 @@ for algo in "${PRNG_ALGOS[@]}"; do
 done
 
 # Run primality testing timing experiments
+if [ ${#PRIMALITY_ALGOS[@]} -gt 0 ]; then
+    # Generate any missing primes once, before the timed runs
+    "$REPO_ROOT/experiments/bin/measure_primality_time" --build-cache "${BIT_SIZES[@]}"
+fi
+
 for algo in "${PRIMALITY_ALGOS[@]}"; do
     echo "Running timing experiments for $algo primality test..."
     output_file="$OUTPUT_DIR/${algo}_timing_${TIMESTAMP}.csv"
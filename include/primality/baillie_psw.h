@@ -4,15 +4,23 @@
 #include <gmp.h>
 #include <stdexcept>
 #include <cmath>
+#include <algorithm>
+#include "screening.h"
+#include "mod_context.h"
+#include "workspace.h"
 
 /**
  * @brief Baillie-PSW primality test implementation
  * 
  * The Baillie-PSW test is a combination of:
- * 1. Trial division by small primes
+ * 1. Trial division by small primes (a gcd against their product)
  * 2. A base-2 Miller-Rabin test
  * 3. A strong Lucas probable prime test
  * 
+ * Steps 1 and 2 are the shared screening pipeline in screening.h. Step 3
+ * runs a V-only Lucas ladder in Montgomery form (ModContext), about three
+ * modular multiplications per bit of n.
+ * 
  * No composite number is known to pass the Baillie-PSW test, making it
  * very reliable for practical purposes.
  * 
@@ -20,19 +28,10 @@
  * - Baillie, R., & Wagstaff Jr, S. S. (1980). Lucas pseudoprimes. Mathematics of Computation, 35(152), 1391-1417.
  * - Pomerance, C., Selfridge, J. L., & Wagstaff Jr, S. S. (1980). The pseudoprimes to 25·10⁹.
  * - Crandall, R., & Pomerance, C. (2005). Prime Numbers: A Computational Perspective. Springer.
+ * - Joye, M., & Quisquater, J.-J. (1996). Efficient computation of full Lucas sequences.
+ *   Electronics Letters, 32(6), 537-538.
  */
 namespace BailliePSW {
-    // Small primes list for trial division
-    const int small_primes[] = {
-        2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53, 59, 61, 67, 71, 
-        73, 79, 83, 89, 97, 101, 103, 107, 109, 113, 127, 131, 137, 139, 149, 151, 
-        157, 163, 167, 173, 179, 181, 191, 193, 197, 199, 211, 223, 227, 229, 233, 
-        239, 241, 251, 257, 263, 269, 271, 277, 281, 283, 293, 307, 311, 313, 317, 
-        331, 337, 347, 349, 353, 359, 367, 373, 379, 383, 389, 397, 401, 409, 419, 
-        421, 431, 433, 439, 443, 449, 457, 461, 463, 467, 479, 487, 491, 499, 503, 509
-    };
-    constexpr int num_small_primes = sizeof(small_primes) / sizeof(small_primes[0]);
-    
     /**
      * @brief Calculate the Jacobi symbol (a/n)
      * 
@@ -48,406 +47,306 @@ namespace BailliePSW {
     }
     
     /**
-     * @brief Calculate Lucas V sequence values
+     * @brief Choose the Lucas parameters by Selfridge's method A
      * 
-     * Computes the Lucas V sequence value V_k(P,Q) mod n for given parameters.
+     * D is the first of 5, -7, 9, -11, ... with Jacobi(D/n) = -1; then P = 1
+     * and Q = (1 - D) / 4.
      * 
-     * @param v_k Output parameter for V_k
-     * @param P Lucas sequence parameter P
-     * @param Q Lucas sequence parameter Q
-     * @param k Index to compute
-     * @param n Modulus
+     * @param n Odd number greater than 1, not a perfect square
+     * @param ws Workspace providing the temporaries
+     * @param D Output parameter for D
+     * @param Q Output parameter for Q
+     * @return int 1 if parameters were found, 0 if n is composite (a small
+     *         factor showed up, or no D was found), -1 if n = |D| for the D
+     *         that was reached, in which case gcd tells nothing
      */
-    void lucas_v_mod(mpz_t v_k, const mpz_t P, const mpz_t Q, const mpz_t k, const mpz_t n) {
-        mpz_t v0, v1, k_copy, q_power;
-        mpz_init_set_ui(v0, 2);           // V_0 = 2
-        mpz_init(v1);                     // V_1 = P
-        mpz_set(v1, P);                   
-        mpz_init(k_copy);
-        mpz_init(q_power);
-        mpz_set(k_copy, k);
-        
-        // If k = 0, return V_0 = 2
-        if (mpz_sgn(k_copy) == 0) {
-            mpz_set(v_k, v0);
-            mpz_clear(v0);
-            mpz_clear(v1);
-            mpz_clear(k_copy);
-            mpz_clear(q_power);
-            return;
-        }
-        
-        // If k = 1, return V_1 = P
-        if (mpz_cmp_ui(k_copy, 1) == 0) {
-            mpz_set(v_k, v1);
-            mpz_clear(v0);
-            mpz_clear(v1);
-            mpz_clear(k_copy);
-            mpz_clear(q_power);
-            return;
-        }
-        
-        // Double-and-add algorithm for computing V_k efficiently
-        mpz_t d, t1, t2, t3;
-        mpz_init(d);
-        mpz_init(t1);
-        mpz_init(t2);
-        mpz_init(t3);
+    int selfridge_parameters(const mpz_t n, PrimalityWorkspace& ws, long& D, long& Q) {
+        mpz_ptr D_value = ws.lucas_D, abs_D = ws.lucas_abs_D, gcd = ws.lucas_gcd;
         
-        // Start from k-1 (index 0 in binary), doubling each time
-        mpz_sub_ui(k_copy, k_copy, 1);
-        
-        mpz_set(d, v1);  // d = V_1 initially
-        
-        // Process each bit of k_copy from second-lowest to highest (already handled bit 0)
-        while (mpz_cmp_ui(k_copy, 1) > 0) {
-            // t1 = d^2
-            mpz_mul(t1, d, d);
-            mpz_mod(t1, t1, n);
-            
-            // t2 = P*d
-            mpz_mul(t2, P, d);
-            mpz_mod(t2, t2, n);
-            
-            // t3 = Q^(j-1) * V_2
-            mpz_mul(t3, Q, v0);
-            mpz_mod(t3, t3, n);
+        for (long magnitude = 5; magnitude <= 1000; magnitude += 2) {
+            D = ((magnitude / 2) % 2 == 0) ? magnitude : -magnitude;  // 5, -7, 9, -11, ...
+            mpz_set_si(D_value, D);
             
-            // v0 = d^2 - 2Q^j-1
-            mpz_sub(v0, t1, t3);
-            mpz_mod(v0, v0, n);
-            
-            // v1 = P*d - Q^j-1 * V_1
-            mpz_mul(t3, Q, v1);
-            mpz_mod(t3, t3, n);
-            mpz_sub(v1, t2, t3);
-            mpz_mod(v1, v1, n);
-            
-            // Halve k_copy
-            mpz_tdiv_q_2exp(k_copy, k_copy, 1);
+            int jacobi = jacobi_symbol(D_value, n);
+            if (jacobi == -1) {
+                Q = (1 - D) / 4;
+                return 1;
+            }
+            if (jacobi == 0) {
+                // gcd(|D|, n) > 1: n has a proper factor unless n = |D|
+                mpz_abs(abs_D, D_value);
+                mpz_gcd(gcd, abs_D, n);
+                return (mpz_cmp(gcd, n) == 0) ? -1 : 0;
+            }
         }
         
-        mpz_set(v_k, d);
-        
-        mpz_clear(v0);
-        mpz_clear(v1);
-        mpz_clear(k_copy);
-        mpz_clear(q_power);
-        mpz_clear(d);
-        mpz_clear(t1);
-        mpz_clear(t2);
-        mpz_clear(t3);
+        // Safety limit (only perfect squares get here, and those are rejected earlier)
+        return 0;
     }
     
     /**
-     * @brief Calculate Lucas U and V sequence values
-     * 
-     * Computes both the Lucas U and V sequence values U_k(P,Q) and V_k(P,Q) mod n
+     * @brief Convert a small signed integer to a Montgomery residue
      * 
-     * @param u_k Output parameter for U_k
-     * @param v_k Output parameter for V_k
-     * @param P Lucas sequence parameter P
-     * @param Q Lucas sequence parameter Q
-     * @param k Index to compute
-     * @param n Modulus
+     * @param mod Montgomery context for n
+     * @param r Output residue
+     * @param value Integer with |value| < n
      */
-    void lucas_sequence_mod(mpz_t u_k, mpz_t v_k, const mpz_t P, const mpz_t Q, const mpz_t k, const mpz_t n) {
-        mpz_t u0, u1, v0, v1, k_copy, q_k;
-        mpz_init_set_ui(u0, 0);    // U_0 = 0
-        mpz_init_set_ui(u1, 1);    // U_1 = 1
-        mpz_init_set_ui(v0, 2);    // V_0 = 2
-        mpz_init(v1);              // V_1 = P
-        mpz_set(v1, P);
-        mpz_init(k_copy);
-        mpz_init(q_k);
-        mpz_set(k_copy, k);
-        
-        // If k = 0, return U_0 = 0, V_0 = 2
-        if (mpz_sgn(k_copy) == 0) {
-            mpz_set(u_k, u0);
-            mpz_set(v_k, v0);
-            mpz_clear(u0); mpz_clear(u1); mpz_clear(v0); mpz_clear(v1);
-            mpz_clear(k_copy); mpz_clear(q_k);
-            return;
+    void to_mont_si(ModContext& mod, mp_limb_t* r, long value) {
+        mod.to_mont_ui(r, static_cast<mp_limb_t>(value < 0 ? -value : value));
+        if (value < 0) {
+            mod.neg(r, r);
         }
-        
-        // Binary method for computing Lucas sequences
-        // Reference: Algorithm 3.6.7 in Cohen's "A Course in Computational Algebraic Number Theory"
-        mpz_t t1, t2, t3, t4;
-        mpz_init(t1); mpz_init(t2); mpz_init(t3); mpz_init(t4);
-        
-        // Get binary representation of k
-        size_t bit_length = mpz_sizeinbase(k_copy, 2);
-        
-        for (size_t i = bit_length - 1; i > 0; --i) {
-            // t1 = U_m * U_m
-            mpz_mul(t1, u0, u0);
-            mpz_mod(t1, t1, n);
-            
-            // t2 = V_m * V_m
-            mpz_mul(t2, v0, v0);
-            mpz_mod(t2, t2, n);
-            
-            // t3 = U_m * V_m
-            mpz_mul(t3, u0, v0);
-            mpz_mod(t3, t3, n);
-            
-            // U_{2m} = U_m * V_m
-            mpz_set(u0, t3);
-            
-            // V_{2m} = V_m^2 - 2Q^m
-            mpz_set_ui(t4, 2);
-            mpz_neg(t4, t4); // t4 = -2
-            mpz_submul(t2, t4, Q); // t2 = V_m^2 - 2Q^m
-            mpz_mod(t2, t2, n);
-            mpz_set(v0, t2);
-            
-            // If the i-th bit of k is 1, update for U_{2m+1} and V_{2m+1}
-            if (mpz_tstbit(k_copy, i - 1)) {
-                // t1 = U_{2m} * P
-                mpz_mul(t1, u0, P);
-                mpz_mod(t1, t1, n);
-                
-                // t2 = V_{2m}
-                mpz_set(t2, v0);
-                
-                // U_{2m+1} = (P*U_{2m} + V_{2m}) / 2
-                mpz_add(u0, t1, t2);
-                if (mpz_odd_p(u0)) {
-                    mpz_add(u0, u0, n);
-                }
-                mpz_tdiv_q_2exp(u0, u0, 1);
-                mpz_mod(u0, u0, n);
-                
-                // V_{2m+1} = (P*V_{2m} + U_{2m}*D) / 2
-                mpz_mul(t1, t2, P);
-                mpz_mod(t1, t1, n);
-                
-                mpz_mul(t2, u0, Q);
-                mpz_mod(t2, t2, n);
-                
-                mpz_sub(v0, t1, t2);
-                mpz_mod(v0, v0, n);
-            }
+    }
+    
+    /**
+     * @brief Multiply a residue by a small signed integer
+     * 
+     * @param mod Montgomery context for n
+     * @param r Output residue (may alias a)
+     * @param a Residue
+     * @param c Multiplier
+     */
+    void mul_si(ModContext& mod, mp_limb_t* r, const mp_limb_t* a, long c) {
+        mod.mul_ui(r, a, static_cast<mp_limb_t>(c < 0 ? -c : c));
+        if (c < 0) {
+            mod.neg(r, r);
         }
-        
-        mpz_set(u_k, u0);
-        mpz_set(v_k, v0);
-        
-        mpz_clear(u0); mpz_clear(u1); mpz_clear(v0); mpz_clear(v1);
-        mpz_clear(k_copy); mpz_clear(q_k); mpz_clear(t1); mpz_clear(t2);
-        mpz_clear(t3); mpz_clear(t4);
     }
     
     /**
-     * @brief Perform the strong Lucas primality test
+     * @brief Evaluate V_k, V_{k+1} and Q^k for the Lucas sequences with P = 1
      * 
-     * @param n Number to test for primality
-     * @return bool True if the number passes the test, false otherwise
+     * Montgomery ladder over the bits of k, keeping the pair (V_j, V_{j+1})
+     * and Q^j, using
+     *   V_{2j}   = V_j^2 - 2 Q^j
+     *   V_{2j+1} = V_j V_{j+1} - P Q^j
+     *   V_{2j+2} = V_{j+1}^2 - 2 Q^{j+1}
+     * Each bit costs two multiplications for the V pair and one squaring for
+     * Q^j, plus multiplications by the small Q, which are linear-time.
+     * U_k is never formed: D U_k = 2 V_{k+1} - P V_k, so the caller can test
+     * U_k = 0 on the V pair.
+     * 
+     * @param mod Montgomery context for n
+     * @param v Output residue V_k
+     * @param v_next Output residue V_{k+1}
+     * @param q_k Output residue Q^k
+     * @param Q Lucas parameter Q
+     * @param k Positive index
+     * @param t Scratch residue
      */
-    bool strong_lucas_test(const mpz_t n) {
-        // Find the first D in the sequence 5, -7, 9, -11, ... such that Jacobi(D/n) = -1
-        mpz_t D, abs_D, P, Q, gcd, U, V, n_plus_1, d, V_term, two;
-        mpz_init(D);
-        mpz_init(abs_D);
-        mpz_init_set_ui(P, 1);       // We'll use P = 1 for simplicity
-        mpz_init(Q);
-        mpz_init(gcd);
-        mpz_init(U);
-        mpz_init(V);
-        mpz_init(n_plus_1);
-        mpz_init(d);
-        mpz_init(V_term);
-        mpz_init_set_ui(two, 2);
-        
-        int D_val = 5;
-        int sign = 1;
-        bool found_D = false;
-        
-        // Find D such that Jacobi(D/n) = -1
-        while (!found_D) {
-            mpz_set_si(D, D_val * sign);
-            
-            // Compute Jacobi(D/n)
-            int jacobi = mpz_jacobi(D, n);
+    void lucas_chain(ModContext& mod, mp_limb_t* v, mp_limb_t* v_next, mp_limb_t* q_k,
+                     long Q, const mpz_t k, mp_limb_t* t) {
+        size_t size = mod.limbs();
+        
+        // j = 1: V_1 = P = 1, V_2 = P^2 - 2Q = 1 - 2Q, Q^1 = Q
+        std::copy(mod.one(), mod.one() + size, v);
+        to_mont_si(mod, q_k, Q);
+        mod.add(t, q_k, q_k);
+        mod.sub(v_next, v, t);
+        
+        for (mp_bitcnt_t i = mpz_sizeinbase(k, 2) - 1; i > 0; --i) {
+            // t = P Q^j = Q^j
+            std::copy(q_k, q_k + size, t);
             
-            if (jacobi == 0) {
-                // If Jacobi symbol is 0, gcd(|D|, n) > 1
-                mpz_abs(abs_D, D);
-                mpz_gcd(gcd, abs_D, n);
+            if (mpz_tstbit(k, i - 1)) {
+                // j -> 2j + 1: V_{2j+1} = V_j V_{j+1} - Q^j, V_{2j+2} = V_{j+1}^2 - 2 Q^{j+1}
+                mod.mul(v, v, v_next);
+                mod.sub(v, v, t);
+                mul_si(mod, t, q_k, 2 * Q);
+                mod.sqr(v_next, v_next);
+                mod.sub(v_next, v_next, t);
                 
-                // If gcd(|D|, n) = n, then n = |D| (unlikely)
-                if (mpz_cmp(gcd, n) == 0) {
-                    mpz_clear(D); mpz_clear(abs_D); mpz_clear(P); mpz_clear(Q);
-                    mpz_clear(gcd); mpz_clear(U); mpz_clear(V); mpz_clear(n_plus_1);
-                    mpz_clear(d); mpz_clear(V_term); mpz_clear(two);
-                    return mpz_probab_prime_p(n, 5) > 0;  // Extra check
-                }
+                // Q^{2j+1} = (Q^j)^2 Q
+                mod.sqr(q_k, q_k);
+                mul_si(mod, q_k, q_k, Q);
+            } else {
+                // j -> 2j: V_{2j+1} = V_j V_{j+1} - Q^j, V_{2j} = V_j^2 - 2 Q^j
+                mod.mul(v_next, v, v_next);
+                mod.sub(v_next, v_next, t);
+                mod.add(t, t, t);
+                mod.sqr(v, v);
+                mod.sub(v, v, t);
                 
-                // Otherwise, n has a proper factor
-                mpz_clear(D); mpz_clear(abs_D); mpz_clear(P); mpz_clear(Q);
-                mpz_clear(gcd); mpz_clear(U); mpz_clear(V); mpz_clear(n_plus_1);
-                mpz_clear(d); mpz_clear(V_term); mpz_clear(two);
-                return false;
-            }
-            
-            if (jacobi == -1) {
-                found_D = true;
-                break;
-            }
-            
-            // Try next D in sequence
-            sign *= -1;
-            if (sign == 1) {
-                D_val += 2;
+                // Q^{2j} = (Q^j)^2
+                mod.sqr(q_k, q_k);
             }
-            
-            // Safety limit (should never be reached in practice)
-            if (D_val > 1000) {
-                mpz_clear(D); mpz_clear(abs_D); mpz_clear(P); mpz_clear(Q);
-                mpz_clear(gcd); mpz_clear(U); mpz_clear(V); mpz_clear(n_plus_1);
-                mpz_clear(d); mpz_clear(V_term); mpz_clear(two);
-                return false;
-            }
-        }
-        
-        // Calculate Q = (1 - D) / 4
-        mpz_sub_ui(Q, P, 1);  // Q = P - 1 = 0
-        mpz_sub(Q, Q, D);     // Q = (P - 1) - D = -D
-        mpz_tdiv_q_ui(Q, Q, 4); // Q = -D/4
-        
-        // Calculate n + 1 = d * 2^s where d is odd
-        mpz_add_ui(n_plus_1, n, 1);
-        mpz_set(d, n_plus_1);
-        unsigned long s = 0;
-        
-        while (mpz_even_p(d)) {
-            mpz_tdiv_q_2exp(d, d, 1);  // d = d / 2
-            s++;
         }
-        
-        // Compute U_d and V_d
-        lucas_sequence_mod(U, V, P, Q, d, n);
-        
-        // Check if U_d = 0 (mod n)
-        if (mpz_sgn(U) == 0) {
-            mpz_clear(D); mpz_clear(abs_D); mpz_clear(P); mpz_clear(Q);
-            mpz_clear(gcd); mpz_clear(U); mpz_clear(V); mpz_clear(n_plus_1);
-            mpz_clear(d); mpz_clear(V_term); mpz_clear(two);
+    }
+    
+    /**
+     * @brief Run the strong Lucas conditions for known parameters
+     * 
+     * @param mod Montgomery context for n
+     * @param Q Lucas parameter Q (P = 1)
+     * @param d Odd part of n + 1
+     * @param s Exponent of 2 in n + 1
+     * @param ws Workspace providing the residues
+     * @return bool True if U_d = 0 or V_{d*2^r} = 0 for some 0 <= r < s (mod n)
+     */
+    bool strong_lucas_conditions(ModContext& mod, long Q, const mpz_t d, unsigned long s,
+                                 PrimalityWorkspace& ws) {
+        size_t size = mod.limbs();
+        ws.lucas_residues.resize(std::max(ws.lucas_residues.size(), 4 * size));
+        mp_limb_t* v = &ws.lucas_residues[0];
+        mp_limb_t* v_next = &ws.lucas_residues[size];
+        mp_limb_t* q_k = &ws.lucas_residues[2 * size];
+        mp_limb_t* t = &ws.lucas_residues[3 * size];
+        
+        lucas_chain(mod, v, v_next, q_k, Q, d, t);
+        
+        // U_d = 0 exactly when 2 V_{d+1} = P V_d, since D is invertible mod n
+        mod.add(t, v_next, v_next);
+        if (mod.equal(t, v)) {
             return true;
         }
         
-        // Check if V_d = 0 (mod n) or V_{d*2^r} = 0 (mod n) for some 0 ≤ r < s
-        mpz_set(V_term, V);
-        
+        // V_{d*2^r} = 0 for some 0 <= r < s, using V_{2k} = V_k^2 - 2 Q^k
         for (unsigned long r = 0; r < s; ++r) {
-            if (mpz_sgn(V_term) == 0) {
-                mpz_clear(D); mpz_clear(abs_D); mpz_clear(P); mpz_clear(Q);
-                mpz_clear(gcd); mpz_clear(U); mpz_clear(V); mpz_clear(n_plus_1);
-                mpz_clear(d); mpz_clear(V_term); mpz_clear(two);
+            if (mod.is_zero(v)) {
                 return true;
             }
-            
-            if (r < s - 1) {
-                // Calculate V_{2k} from V_k: V_{2k} = V_k^2 - 2*Q^k
-                mpz_mul(V_term, V_term, V_term);  // V_term = V_term^2
-                mpz_mod(V_term, V_term, n);
-                
-                mpz_set_ui(Q, 2);
-                mpz_neg(Q, Q);  // Q = -2
-                mpz_add(V_term, V_term, Q);  // V_term = V_term^2 - 2
-                mpz_mod(V_term, V_term, n);
+            if (r + 1 < s) {
+                mod.add(t, q_k, q_k);
+                mod.sqr(v, v);
+                mod.sub(v, v, t);
+                mod.sqr(q_k, q_k);
             }
         }
         
         // If no condition is met, the test fails
-        mpz_clear(D); mpz_clear(abs_D); mpz_clear(P); mpz_clear(Q);
-        mpz_clear(gcd); mpz_clear(U); mpz_clear(V); mpz_clear(n_plus_1);
-        mpz_clear(d); mpz_clear(V_term); mpz_clear(two);
         return false;
     }
     
+    /**
+     * @brief Perform the strong Lucas probable prime test
+     * 
+     * With n + 1 = d * 2^s, d odd, n passes if U_d = 0 or V_{d*2^r} = 0 for
+     * some 0 <= r < s (mod n). Parameters are chosen by Selfridge's method A.
+     * 
+     * @param n Odd number greater than 1, not a perfect square
+     * @param ws Workspace providing the temporaries
+     * @return bool True if the number passes the test, false otherwise
+     */
+    bool strong_lucas_test(const mpz_t n, PrimalityWorkspace& ws) {
+        PRIME_TIME(T_LUCAS);
+        long D = 0, Q = 0;
+        int found = selfridge_parameters(n, ws, D, Q);
+        if (found == 0) {
+            return false;
+        }
+        if (found < 0) {
+            return mpz_probab_prime_p(n, 5) > 0;  // n = |D| is tiny
+        }
+        
+        // n + 1 = d * 2^s where d is odd
+        mpz_ptr d = ws.lucas_d;
+        mpz_add_ui(d, n, 1);
+        unsigned long s = mpz_scan1(d, 0);
+        mpz_tdiv_q_2exp(d, d, s);
+        
+        ws.mod.set_modulus(n);
+        return strong_lucas_conditions(ws.mod, Q, d, s, ws);
+    }
+    
+    /**
+     * @brief Fill in the Lucas fields of a prepared number, once
+     * 
+     * @param pm Prepared odd number greater than 3, not a perfect square
+     * @param ws Workspace providing the temporaries of the parameter search
+     */
+    void prepare_lucas(PreparedModulus& pm, PrimalityWorkspace& ws) {
+        if (pm.lucas_ready) return;
+        pm.lucas_found = selfridge_parameters(pm.n, ws, pm.lucas_D, pm.lucas_Q);
+        mpz_add_ui(pm.lucas_d, pm.n, 1);
+        pm.lucas_s = mpz_scan1(pm.lucas_d, 0);
+        mpz_tdiv_q_2exp(pm.lucas_d, pm.lucas_d, pm.lucas_s);
+        pm.lucas_ready = true;
+    }
+    
+    /**
+     * @brief Perform the strong Lucas probable prime test on a prepared number
+     * 
+     * @param pm Prepared odd number greater than 3, not a perfect square
+     * @param ws Workspace providing the temporaries
+     * @return bool True if the number passes the test, false otherwise
+     */
+    bool strong_lucas_test(PreparedModulus& pm, PrimalityWorkspace& ws) {
+        PRIME_TIME(T_LUCAS);
+        prepare_lucas(pm, ws);
+        if (pm.lucas_found == 0) {
+            return false;
+        }
+        if (pm.lucas_found < 0) {
+            return mpz_probab_prime_p(pm.n, 5) > 0;  // n = |D| is tiny
+        }
+        return strong_lucas_conditions(pm.mod, pm.lucas_Q, pm.lucas_d, pm.lucas_s, ws);
+    }
+    
     /**
      * @brief Perform the Baillie-PSW primality test
      * 
      * @param n Number to test for primality
+     * @param gmp_randstate GMP random state (unused; the test is deterministic)
+     * @param workspace Scratch values to reuse, or nullptr to use temporary ones
      * @return bool True if the number is probably prime, false if definitely composite
      */
-    bool test(const mpz_t n, gmp_randstate_t gmp_randstate) {
+    bool test(const mpz_t n, gmp_randstate_t gmp_randstate, PrimalityWorkspace* workspace = nullptr) {
         // Handle small cases
         if (mpz_cmp_ui(n, 2) < 0) return false;  // n < 2
         if (mpz_cmp_ui(n, 2) == 0) return true;  // n = 2
         if (mpz_even_p(n)) return false;         // n is even and > 2
         
-        // 1. Trial division by small primes
-        for (int i = 0; i < num_small_primes; ++i) {
-            // Skip checking division by 2 (already checked even numbers)
-            if (small_primes[i] == 2) continue;
-            
-            // Check if n is a small prime
-            if (mpz_cmp_ui(n, small_primes[i]) == 0) return true;
-            
-            // Check if n is divisible by a small prime
-            if (mpz_divisible_ui_p(n, small_primes[i])) return false;
+        if (workspace == nullptr) {
+            PrimalityWorkspace local;
+            return test(n, gmp_randstate, &local);
         }
+        PrimalityWorkspace& ws = *workspace;
         
-        // 2. Check if n is a perfect square
+        // 1. Perfect squares never have Jacobi(D/n) = -1, so reject them up front
         if (mpz_perfect_square_p(n)) return false;
         
-        // 3. Miller-Rabin base 2
-        mpz_t base2;
-        mpz_init_set_ui(base2, 2);
-        
-        // Need temporary variables for MR test base 2
-        mpz_t n_minus_1, d_mr, x, two;
-        mpz_init(n_minus_1);
-        mpz_init(d_mr);
-        mpz_init(x);
-        mpz_init_set_ui(two, 2);
-        
-        // n_minus_1 = n - 1
-        mpz_sub_ui(n_minus_1, n, 1);
-        
-        // Find d and s such that n - 1 = 2^s * d
-        mpz_set(d_mr, n_minus_1);
+        // 2. Trial division gcd and Miller-Rabin base 2 (shared screening pipeline)
         unsigned long s = 0;
-        while (mpz_even_p(d_mr)) {
-            mpz_fdiv_q_2exp(d_mr, d_mr, 1);
-            s++;
+        Screening::Verdict verdict = Screening::screen(n, ws, s);
+        if (verdict != Screening::PROBABLE) {
+            return verdict == Screening::PRIME; // Small prime, or composite
         }
-        // Calculate x = 2^d mod n
-        mpz_powm(x, base2, d_mr, n);
         
-        bool mr_base2_passed = false;
-        if (mpz_cmp_ui(x, 1) == 0 || mpz_cmp(x, n_minus_1) == 0) {
-            mr_base2_passed = true;
-        } else {
-            for (unsigned long r = 1; r < s; ++r) {
-                mpz_powm(x, x, two, n); // Square x mod n
-                if (mpz_cmp(x, n_minus_1) == 0) {
-                    mr_base2_passed = true;
-                    break;
-                }
-                if (mpz_cmp_ui(x, 1) == 0) { // Non-trivial sqrt of 1
-                    mr_base2_passed = false;
-                    break;
-                }
-            }
+        // 3. Strong Lucas Primality Test
+        bool passed = strong_lucas_test(n, ws);
+        Screening::count(passed ? Screening::stats().accepted : Screening::stats().lucas_rejects);
+        if (passed) PRIME_COUNT(ACCEPTED); else PRIME_COUNT(LUCAS_REJECTS);
+        return passed;
+    }
+    
+    /**
+     * @brief Perform the Baillie-PSW primality test on a prepared number
+     * 
+     * Same stages and counters as test(n, ...); the perfect-square check,
+     * n - 1 and n + 1, the Selfridge parameters and the Montgomery constants
+     * come from the preparation.
+     * 
+     * @param pm Prepared number to test
+     * @param gmp_randstate GMP random state (unused; the test is deterministic)
+     * @param ws Workspace holding the scratch values
+     * @return bool True if the number is probably prime, false if definitely composite
+     */
+    bool test(PreparedModulus& pm, gmp_randstate_t gmp_randstate, PrimalityWorkspace& ws) {
+        if (!pm.odd) {
+            return test(pm.n, gmp_randstate, &ws);  // Even, or at most 3
         }
+        if (pm.square) return false;
         
-        mpz_clear(base2);
-        mpz_clear(n_minus_1);
-        mpz_clear(d_mr);
-        mpz_clear(x);
-        mpz_clear(two);
-        
-        if (!mr_base2_passed) {
-            return false; // Failed MR base 2 => composite
+        Screening::Verdict verdict = Screening::screen(pm, ws);
+        if (verdict != Screening::PROBABLE) {
+            return verdict == Screening::PRIME;
         }
         
-        // 4. Strong Lucas Primality Test
-        return strong_lucas_test(n);
+        bool passed = strong_lucas_test(pm, ws);
+        Screening::count(passed ? Screening::stats().accepted : Screening::stats().lucas_rejects);
+        if (passed) PRIME_COUNT(ACCEPTED); else PRIME_COUNT(LUCAS_REJECTS);
+        return passed;
     }
 };
 
-#endif // BAILLIE_PSW_H 
\ No newline at end of file
+#endif // BAILLIE_PSW_H
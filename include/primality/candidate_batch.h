@@ -0,0 +1,207 @@
+#ifndef CANDIDATE_BATCH_H
+#define CANDIDATE_BATCH_H
+
+#include <gmp.h>
+#include <algorithm>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "screening.h"
+#include "baillie_psw.h"
+#include "u64_primality.h"
+#include "workspace.h"
+
+/**
+ * @brief Stage-major primality testing over a batch of candidates
+ *
+ * Instead of running the whole pipeline on one number before moving to the
+ * next, the batch runs each stage over every candidate that is still
+ * undecided: trial division, then the base-2 strong round, then the remaining
+ * Miller-Rabin rounds (round by round) or the strong Lucas test. Composites
+ * drop out of the active list as soon as a stage rejects them.
+ *
+ * The candidates and their per-modulus data (n - 1, the odd part d and the
+ * exponent s) are copied into structure-of-arrays buffers: one contiguous
+ * limb array per quantity with a fixed stride, plus read-only mpz views
+ * (mpz_roinit_n) into them. The buffers are reused across batches.
+ */
+class CandidateBatch {
+public:
+    /**
+     * @brief Test every number in a batch
+     *
+     * @param ns Numbers to test
+     * @param count Number of entries in ns and out
+     * @param out Output: out[i] is true if ns[i] is (probably) prime
+     * @param use_bpsw True for Baillie-PSW, false for Miller-Rabin
+     * @param k Number of Miller-Rabin rounds (including the base-2 round)
+     * @param rand_state GMP random state for the Miller-Rabin witnesses
+     * @param ws Workspace for the scratch values
+     */
+    void run(const mpz_t* ns, size_t count, bool* out, bool use_bpsw, int k,
+             gmp_randstate_t rand_state, PrimalityWorkspace& ws) {
+        load(ns, count, out, use_bpsw);
+
+        // Stage 1: trial division over the whole batch
+        compact([&](size_t i) {
+            Screening::Verdict verdict = Screening::trial_stage(n(i), ws);
+            if (verdict == Screening::PROBABLE) return true;
+            out[index[i]] = (verdict == Screening::PRIME);
+            return false;
+        });
+
+        // Per-modulus data for the survivors: n - 1 = 2^s * d
+        prepare(ws);
+
+        // Stage 2: base-2 strong round
+        compact([&](size_t i) {
+            if (Screening::base2_stage(n(i), n_minus_1(i), d(i), s[i], ws)) return true;
+            out[index[i]] = false;
+            return false;
+        });
+
+        if (use_bpsw) {
+            // Stage 3: strong Lucas test
+            compact([&](size_t i) {
+                bool passed = BailliePSW::strong_lucas_test(n(i), ws);
+                Screening::count(passed ? Screening::stats().accepted : Screening::stats().lucas_rejects);
+                if (passed) PRIME_COUNT(ACCEPTED); else PRIME_COUNT(LUCAS_REJECTS);
+                out[index[i]] = passed;
+                return false;
+            });
+            return;
+        }
+
+        // Stage 3: the remaining Miller-Rabin rounds, one round over the whole batch at a time
+        for (int round = 1; round < k && !active.empty(); ++round) {
+            compact([&](size_t i) {
+                mpz_sub_ui(ws.n_minus_3, n(i), 3);
+                mpz_urandomm(ws.a, rand_state, ws.n_minus_3);  // a = random in [0, n-4]
+                mpz_add_ui(ws.a, ws.a, 2);                     // a = random in [2, n-2]
+                if (Screening::strong_round(ws.x, ws.a, d(i), s[i], n(i), n_minus_1(i))) return true;
+                Screening::count(Screening::stats().round_rejects);
+                PRIME_COUNT(ROUND_REJECTS);
+                out[index[i]] = false;
+                return false;
+            });
+        }
+
+        for (size_t slot : active) {
+            Screening::count(Screening::stats().accepted);
+            PRIME_COUNT(ACCEPTED);
+            out[index[slot]] = true;
+        }
+        active.clear();
+    }
+
+private:
+    size_t stride = 0;                    // Limbs per candidate in every buffer
+    std::vector<mp_limb_t> n_limbs;       // Candidate i at [i * stride]
+    std::vector<mp_limb_t> n_minus_1_limbs;
+    std::vector<mp_limb_t> d_limbs;
+    std::vector<unsigned long> s;         // Exponent of 2 in n - 1
+    std::vector<size_t> index;            // Position of each slot in the caller's arrays
+    std::vector<size_t> active;           // Slots still undecided
+    std::vector<__mpz_struct> n_views;    // Read-only views into the limb buffers
+    std::vector<__mpz_struct> n_minus_1_views;
+    std::vector<__mpz_struct> d_views;
+
+    mpz_srcptr n(size_t slot) const { return &n_views[slot]; }
+    mpz_srcptr n_minus_1(size_t slot) const { return &n_minus_1_views[slot]; }
+    mpz_srcptr d(size_t slot) const { return &d_views[slot]; }
+
+    /**
+     * @brief Settle trivial inputs and copy the rest into the limb buffers
+     */
+    void load(const mpz_t* ns, size_t count, bool* out, bool use_bpsw) {
+        index.clear();
+        active.clear();
+
+        stride = 1;
+        for (size_t i = 0; i < count; ++i) {
+            stride = std::max(stride, mpz_size(ns[i]));
+        }
+
+        n_limbs.assign(count * stride, 0);
+        n_views.resize(count);
+
+        for (size_t i = 0; i < count; ++i) {
+            const mpz_srcptr value = ns[i];
+
+            // Inputs that need no pipeline: small, even, one-word or square
+            if (mpz_cmp_ui(value, 3) <= 0) {
+                out[i] = (mpz_cmp_ui(value, 2) >= 0);
+                continue;
+            }
+            if (mpz_even_p(value)) {
+                out[i] = false;
+                continue;
+            }
+            if (U64Primality::available() && U64Primality::fits(value)) {
+                out[i] = U64Primality::is_prime(U64Primality::to_u64(value));
+                continue;
+            }
+            if (use_bpsw && mpz_perfect_square_p(value)) {
+                out[i] = false;
+                continue;
+            }
+
+            size_t slot = index.size();
+            size_t limbs = mpz_size(value);
+            const mp_limb_t* src = mpz_limbs_read(value);
+            std::copy(src, src + limbs, n_limbs.begin() + slot * stride);
+            mpz_roinit_n(&n_views[slot], &n_limbs[slot * stride], limbs);
+
+            index.push_back(i);
+            active.push_back(slot);
+        }
+    }
+
+    /**
+     * @brief Compute n - 1, d and s for every active slot
+     */
+    void prepare(PrimalityWorkspace& ws) {
+        size_t slots = index.size();
+        n_minus_1_limbs.assign(slots * stride, 0);
+        d_limbs.assign(slots * stride, 0);
+        s.assign(slots, 0);
+        n_minus_1_views.resize(slots);
+        d_views.resize(slots);
+
+        for (size_t slot : active) {
+            mpz_sub_ui(ws.n_minus_1, n(slot), 1);
+            s[slot] = Screening::decompose(ws.d, ws.n_minus_1);
+
+            store(ws.n_minus_1, n_minus_1_limbs, n_minus_1_views, slot);
+            store(ws.d, d_limbs, d_views, slot);
+        }
+    }
+
+    /**
+     * @brief Copy a non-negative value into a limb buffer and point a view at it
+     */
+    void store(const mpz_t value, std::vector<mp_limb_t>& limbs, std::vector<__mpz_struct>& views, size_t slot) {
+        size_t size = mpz_size(value);
+        const mp_limb_t* src = mpz_limbs_read(value);
+        std::copy(src, src + size, limbs.begin() + slot * stride);
+        mpz_roinit_n(&views[slot], &limbs[slot * stride], size);
+    }
+
+    /**
+     * @brief Run a stage over the active slots, keeping those it passes
+     *
+     * @param stage Function taking a slot and returning true if it stays undecided
+     */
+    template <typename Stage>
+    void compact(Stage stage) {
+        size_t kept = 0;
+        for (size_t i = 0; i < active.size(); ++i) {
+            if (stage(active[i])) {
+                active[kept++] = active[i];
+            }
+        }
+        active.resize(kept);
+    }
+};
+
+#endif // CANDIDATE_BATCH_H
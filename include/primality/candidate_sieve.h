@@ -0,0 +1,182 @@
+#ifndef CANDIDATE_SIEVE_H
+#define CANDIDATE_SIEVE_H
+
+#include <gmp.h>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include "prime_sieve.h"
+
+/**
+ * @brief Incremental sieve over a window of odd prime candidates
+ *
+ * A prime search picks one random odd start s and walks the candidates
+ * s, s+2, s+4, ... The sieve keeps s mod p for each of the first few thousand
+ * odd primes p and uses those residues to strike out every candidate in the
+ * current window that has a small factor. Only the survivors need to go
+ * through a probabilistic test. When the window is exhausted, the residues are
+ * advanced by the window width with plain machine arithmetic, so the big
+ * number is only reduced once per search.
+ *
+ * References:
+ * - Menezes, A. J., et al. (1996). Handbook of Applied Cryptography, Note 4.45.
+ * - Crandall, R., & Pomerance, C. (2005). Prime Numbers: A Computational Perspective, Section 3.2.
+ */
+class CandidateSieve {
+public:
+    // Largest number of odd primes used for sieving
+    enum { DEFAULT_NUM_PRIMES = 4096 };
+
+    // Largest number of candidates (odd offsets) per window
+    enum { DEFAULT_WINDOW = 4096 };
+
+    /**
+     * @brief Get the table of the first DEFAULT_NUM_PRIMES odd primes
+     *
+     * The table is built once, on first use, with PrimeSieve.
+     *
+     * @return const std::vector<uint32_t>& Odd primes 3, 5, 7, ...
+     */
+    static const std::vector<uint32_t>& odd_primes() {
+        static const std::vector<uint32_t> table = build_odd_primes(DEFAULT_NUM_PRIMES);
+        return table;
+    }
+
+    /**
+     * @brief Get the first count odd primes
+     *
+     * @param count Number of odd primes to return
+     * @return std::vector<uint32_t> The primes in increasing order
+     */
+    static std::vector<uint32_t> build_odd_primes(size_t count) {
+        return PrimeSieve::first_odd_primes(count);
+    }
+
+    /**
+     * @brief Construct a sieve for candidates of the given bit length
+     *
+     * Primes that are not smaller than 2^(bits-1) are dropped from the table,
+     * so a candidate can never be struck out for being equal to a sieving prime.
+     * By default both the window and the prime count scale with the bit length
+     * (2*bits primes, bits offsets): small candidates are cheap to test and do
+     * not repay a large sieve, while 2048/4096-bit candidates use the full table.
+     *
+     * @param bits Bit length of the candidates (at least 2)
+     * @param window Number of odd candidates per window, or 0 to scale with bits
+     * @param num_primes Number of odd primes to sieve with, or 0 to scale with bits
+     */
+    CandidateSieve(unsigned int bits, size_t window = 0, size_t num_primes = 0)
+        : bits(bits), window(window), position(0), sieved(0) {
+        if (this->window == 0) {
+            this->window = std::min<size_t>(std::max<size_t>(bits, 64), DEFAULT_WINDOW);
+        }
+        if (num_primes == 0) {
+            num_primes = std::min<size_t>(std::max<size_t>(2 * bits, 32), DEFAULT_NUM_PRIMES);
+        }
+        
+        const std::vector<uint32_t>& table = odd_primes();
+        for (size_t i = 0; i < num_primes && i < table.size(); ++i) {
+            if (bits <= 32 && table[i] >= (1UL << (bits - 1))) break;
+            primes.push_back(table[i]);
+        }
+        residues.resize(primes.size());
+        marks.resize(this->window);
+        mpz_init(base);
+    }
+
+    /**
+     * @brief Destructor
+     */
+    ~CandidateSieve() {
+        mpz_clear(base);
+    }
+
+    CandidateSieve(const CandidateSieve&) = delete;
+    CandidateSieve& operator=(const CandidateSieve&) = delete;
+
+    /**
+     * @brief Start a new search from the given odd number
+     *
+     * @param start First candidate (must be odd)
+     */
+    void reset(const mpz_t start) {
+        mpz_set(base, start);
+        for (size_t i = 0; i < primes.size(); ++i) {
+            residues[i] = static_cast<uint32_t>(mpz_fdiv_ui(base, primes[i]));
+        }
+        sieve_window();
+    }
+
+    /**
+     * @brief Get the next candidate that survived the sieve
+     *
+     * @param candidate Output parameter for the candidate
+     * @return bool False once the candidates would exceed the bit length;
+     *         the caller should then reset() with a fresh start
+     */
+    bool next(mpz_t candidate) {
+        while (true) {
+            while (position < window) {
+                size_t offset = position++;
+                if (marks[offset]) {
+                    sieved++;
+                    continue;
+                }
+
+                mpz_add_ui(candidate, base, 2 * offset);
+                return mpz_sizeinbase(candidate, 2) <= bits;
+            }
+            advance_window();
+        }
+    }
+
+    /**
+     * @brief Get the number of struck-out candidates skipped by next() so far
+     *
+     * @return uint64_t Number of sieved-out candidates
+     */
+    uint64_t sieved_out() const {
+        return sieved;
+    }
+
+private:
+    unsigned int bits;
+    size_t window;
+    size_t position;               // Next offset to hand out in the current window
+    uint64_t sieved;               // Candidates rejected by the sieve
+    mpz_t base;                    // Candidate at offset 0 of the current window
+    std::vector<uint32_t> primes;  // Odd sieving primes
+    std::vector<uint32_t> residues;// base mod primes[i]
+    std::vector<uint8_t> marks;    // marks[i] != 0 if base + 2i has a small factor
+
+    /**
+     * @brief Mark every offset in the window whose candidate a sieving prime divides
+     */
+    void sieve_window() {
+        std::fill(marks.begin(), marks.end(), 0);
+        for (size_t i = 0; i < primes.size(); ++i) {
+            uint64_t p = primes[i];
+            // base + 2j = 0 (mod p)  <=>  j = (p - r) * 2^-1 (mod p), with 2^-1 = (p + 1) / 2
+            uint64_t first = ((p - residues[i]) % p) * ((p + 1) / 2) % p;
+            for (uint64_t j = first; j < window; j += p) {
+                marks[j] = 1;
+            }
+        }
+        position = 0;
+    }
+
+    /**
+     * @brief Move to the next window, updating the residues incrementally
+     */
+    void advance_window() {
+        uint64_t step = 2 * static_cast<uint64_t>(window);
+        mpz_add_ui(base, base, step);
+        for (size_t i = 0; i < primes.size(); ++i) {
+            residues[i] = static_cast<uint32_t>((residues[i] + step) % primes[i]);
+        }
+        sieve_window();
+    }
+};
+
+#endif // CANDIDATE_SIEVE_H
@@ -3,6 +3,7 @@
 
 #include <gmp.h>
 #include <stdexcept>
+#include "screening.h"
 
 /**
  * @brief Miller-Rabin primality test implementation
@@ -17,112 +18,108 @@
  * - Wikipedia: Miller–Rabin primality test
  */
 namespace MillerRabin {
+    /**
+     * @brief Run random-base strong rounds on a number that passed screening
+     * 
+     * @param n Odd number greater than 3
+     * @param n_minus_1 The value n - 1
+     * @param n_minus_3 The value n - 3, bound for the witnesses
+     * @param d Odd part of n - 1
+     * @param s Exponent of 2 in n - 1
+     * @param rounds Number of rounds
+     * @param gmp_randstate GMP random state to use
+     * @param ws Workspace holding the scratch values
+     * @return bool True if n passed every round
+     */
+    bool random_rounds(const mpz_t n, const mpz_t n_minus_1, const mpz_t n_minus_3,
+                       const mpz_t d, unsigned long s, int rounds,
+                       gmp_randstate_t gmp_randstate, PrimalityWorkspace& ws) {
+        PRIME_TIME(T_ROUNDS);
+        for (int i = 0; i < rounds; ++i) {
+            // Choose random witness 'a' in range [2, n-2]
+            mpz_urandomm(ws.a, gmp_randstate, n_minus_3);  // a = random in [0, n-4]
+            mpz_add_ui(ws.a, ws.a, 2);                     // a = random in [2, n-2]
+            
+            if (!Screening::strong_round(ws.x, ws.a, d, s, n, n_minus_1)) {
+                Screening::count(Screening::stats().round_rejects);
+                PRIME_COUNT(ROUND_REJECTS);
+                return false;  // Composite
+            }
+        }
+        
+        // If all rounds passed, n is probably prime
+        Screening::count(Screening::stats().accepted);
+        PRIME_COUNT(ACCEPTED);
+        return true;
+    }
+    
     /**
      * @brief Perform the Miller-Rabin primality test
      * 
+     * The candidate first goes through the shared screening pipeline (trial
+     * division gcd, then a base-2 strong round, which counts as the first of
+     * the k rounds). Only survivors run the remaining k-1 random-base rounds.
+     * 
      * @param n Number to test for primality
      * @param k Number of rounds/iterations (higher = more accurate)
      * @param gmp_randstate GMP random state to use
+     * @param workspace Scratch values to reuse, or nullptr to use temporary ones
      * @return bool True if the number is probably prime, false if composite
      */
-    bool test(const mpz_t n, int k, gmp_randstate_t gmp_randstate) {
+    bool test(const mpz_t n, int k, gmp_randstate_t gmp_randstate, PrimalityWorkspace* workspace = nullptr) {
         // Handle base cases
         if (mpz_cmp_ui(n, 2) < 0) return false;  // n < 2
         if (mpz_cmp_ui(n, 2) == 0) return true;  // n = 2
         if (mpz_cmp_ui(n, 3) == 0) return true;  // n = 3
         if (mpz_even_p(n)) return false;         // n is even and > 2
         
-        // Initialize temporary variables
-        mpz_t n_minus_1, d, a, x, two;
-        mpz_init(n_minus_1);
-        mpz_init(d);
-        mpz_init(a);
-        mpz_init(x);
-        mpz_init_set_ui(two, 2);
-        
-        // Calculate n_minus_1 = n - 1
-        mpz_sub_ui(n_minus_1, n, 1);
+        if (workspace == nullptr) {
+            PrimalityWorkspace local;
+            return test(n, k, gmp_randstate, &local);
+        }
+        PrimalityWorkspace& ws = *workspace;
         
-        // Find d and s such that n - 1 = 2^s * d, where d is odd
-        mpz_set(d, n_minus_1);
+        int remaining = (k > 1) ? k - 1 : 0;
         unsigned long s = 0;
         
-        // While d is even (lowest bit is 0)
-        while (mpz_even_p(d)) {
-            mpz_fdiv_q_2exp(d, d, 1); // d = d / 2
-            s++;
+        // Trial division and base-2 round; on success n - 1 = 2^s * d
+        Screening::Verdict verdict = Screening::screen(n, ws, s);
+        if (verdict != Screening::PROBABLE) {
+            return verdict == Screening::PRIME;
         }
-        // Now d is odd, s is the exponent of 2
         
-        // Perform k rounds of testing
-        for (int i = 0; i < k; ++i) {
-            // Choose random witness 'a' in range [2, n-2]
-            // Need n-3 for upper bound of mpz_urandomm
-            mpz_t n_minus_3;
-            mpz_init(n_minus_3);
-
-            if (mpz_cmp_ui(n, 4) <= 0) {
-                // Handle small n cases
-                mpz_set_ui(n_minus_3, 1);
-            } else {
-                mpz_sub_ui(n_minus_3, n, 3);  // n_minus_3 = n - 3
-            }
-            
-            mpz_urandomm(a, gmp_randstate, n_minus_3);  // a = random in [0, n-4]
-            mpz_add_ui(a, a, 2);                      // a = random in [2, n-2]
-            mpz_clear(n_minus_3);
-            
-            // Calculate x = a^d mod n
-            mpz_powm(x, a, d, n);
-            
-            // If x == 1 or x == n-1, this iteration passes
-            if (mpz_cmp_ui(x, 1) == 0 || mpz_cmp(x, n_minus_1) == 0) {
-                continue;
-            }
-            
-            // Check remaining iterations of squaring
-            bool maybe_prime = false;
-            for (unsigned long r = 1; r < s; ++r) {
-                mpz_powm(x, x, two, n);  // x = x^2 mod n
-                
-                // If x == 1, we found a non-trivial sqrt of 1 => composite
-                if (mpz_cmp_ui(x, 1) == 0) {
-                    mpz_clear(n_minus_1);
-                    mpz_clear(d);
-                    mpz_clear(a);
-                    mpz_clear(x);
-                    mpz_clear(two);
-                    return false;  // Composite
-                }
-                
-                // If x == n-1, this iteration passes
-                if (mpz_cmp(x, n_minus_1) == 0) {
-                    maybe_prime = true;
-                    break;
-                }
-            }
-            
-            // If we didn't find x == n-1 in the loop, then n is composite
-            if (!maybe_prime) {
-                mpz_clear(n_minus_1);
-                mpz_clear(d);
-                mpz_clear(a);
-                mpz_clear(x);
-                mpz_clear(two);
-                return false;  // Composite
-            }
+        // Need n-3 for upper bound of mpz_urandomm
+        mpz_sub_ui(ws.n_minus_3, n, 3);
+        
+        // Perform the remaining rounds with random witnesses
+        return random_rounds(n, ws.n_minus_1, ws.n_minus_3, ws.d, s, remaining, gmp_randstate, ws);
+    }
+    
+    /**
+     * @brief Perform the Miller-Rabin primality test on a prepared number
+     * 
+     * Same rounds and counters as test(n, ...), with the per-n values taken
+     * from the preparation instead of being recomputed.
+     * 
+     * @param pm Prepared number to test
+     * @param k Number of rounds/iterations, including the base-2 round
+     * @param gmp_randstate GMP random state to use
+     * @param ws Workspace holding the scratch values
+     * @return bool True if the number is probably prime, false if composite
+     */
+    bool test(PreparedModulus& pm, int k, gmp_randstate_t gmp_randstate, PrimalityWorkspace& ws) {
+        if (!pm.odd) {
+            return test(pm.n, k, gmp_randstate, &ws);  // Even, or at most 3
         }
         
-        // Clean up resources
-        mpz_clear(n_minus_1);
-        mpz_clear(d);
-        mpz_clear(a);
-        mpz_clear(x);
-        mpz_clear(two);
+        Screening::Verdict verdict = Screening::screen(pm, ws);
+        if (verdict != Screening::PROBABLE) {
+            return verdict == Screening::PRIME;
+        }
         
-        // If all k rounds passed, n is probably prime
-        return true;
+        int remaining = (k > 1) ? k - 1 : 0;
+        return random_rounds(pm.n, pm.n_minus_1, pm.n_minus_3, pm.d, pm.s, remaining, gmp_randstate, ws);
     }
 };
 
-#endif // MILLER_RABIN_H 
\ No newline at end of file
+#endif // MILLER_RABIN_H
@@ -0,0 +1,291 @@
+#ifndef MOD_CONTEXT_H
+#define MOD_CONTEXT_H
+
+#include <gmp.h>
+#include <vector>
+#include <cstddef>
+#include <algorithm>
+#include "../utils/instrument.h"
+
+/**
+ * @brief Montgomery arithmetic modulo a fixed odd n, over raw limbs
+ *
+ * A ModContext does the setup for n once (n^-1 mod B, R mod n and R^2 mod n,
+ * with R = B^limbs()) and then provides mul, sqr, add and sub on residues
+ * stored as limbs() limbs in Montgomery form (a * R mod n). Chains of
+ * multiplications (the base-2 exponentiation, the Lucas sequences) then cost
+ * one mpn product and one reduction per step, with no division and no
+ * per-call setup.
+ *
+ * General exponentiation is left to mpz_powm: its internal reduction kernels
+ * (mpn_redc_2, mpn_redc_n) are not exported, and a fixed-window pow built on
+ * the public mpn functions measured 3-20% slower than it for 512-4096 bits.
+ *
+ * Residues handled by the context are always fully reduced, so two residues
+ * are equal exactly when their limbs are, and one() and minus_one() can be
+ * compared against directly without leaving Montgomery form.
+ *
+ * The buffers only grow, so reusing a context for moduli of the same size
+ * does not allocate. A context must not be shared between threads.
+ *
+ * References:
+ * - Montgomery, P. L. (1985). Modular multiplication without trial division.
+ *   Mathematics of Computation, 44(170), 519-521.
+ * - Menezes, A. J., et al. (1996). Handbook of Applied Cryptography, Chapter 14.
+ */
+class ModContext {
+public:
+    /**
+     * @brief Construct an empty context; call set_modulus before use
+     */
+    ModContext() : size(0), inv(0) {}
+
+    /**
+     * @brief Construct a context for the modulus n
+     *
+     * @param n Odd modulus greater than 1
+     */
+    explicit ModContext(const mpz_t n) : ModContext() {
+        set_modulus(n);
+    }
+
+    /**
+     * @brief Do the per-modulus precomputation
+     *
+     * @param n Odd modulus greater than 1
+     */
+    void set_modulus(const mpz_t n) {
+        size = mpz_size(n);
+        const mp_limb_t* n_limbs = mpz_limbs_read(n);
+        modulus.assign(n_limbs, n_limbs + size);
+
+        // Newton iteration for n^-1 mod B: each step doubles the number of correct low bits
+        mp_limb_t x = modulus[0];  // Correct to 3 bits for odd n
+        for (int bits = 3; bits < GMP_NUMB_BITS; bits *= 2) {
+            x *= 2 - modulus[0] * x;
+        }
+        inv = -x;
+
+        product.resize(2 * size + 1);
+        operand.resize(size);
+        quotient.resize(size + 2);
+        r_mod_n.resize(size);
+        r2_mod_n.resize(size);
+        neg_one.resize(size);
+
+        // R mod n and R^2 mod n by dividing B^size and B^(2 * size)
+        std::fill(product.begin(), product.end(), 0);
+        product[size] = 1;
+        mpn_tdiv_qr(quotient.data(), r_mod_n.data(), 0, product.data(), size + 1, modulus.data(), size);
+
+        std::fill(product.begin(), product.end(), 0);
+        product[2 * size] = 1;
+        mpn_tdiv_qr(quotient.data(), r2_mod_n.data(), 0, product.data(), 2 * size + 1, modulus.data(), size);
+
+        // -1 in Montgomery form is n - (R mod n)
+        mpn_sub_n(neg_one.data(), modulus.data(), r_mod_n.data(), size);
+    }
+
+    /**
+     * @brief Get the residue length
+     *
+     * @return size_t Number of limbs in every residue
+     */
+    size_t limbs() const {
+        return size;
+    }
+
+    /**
+     * @brief Get 1 in Montgomery form
+     */
+    const mp_limb_t* one() const {
+        return r_mod_n.data();
+    }
+
+    /**
+     * @brief Get n - 1 in Montgomery form
+     */
+    const mp_limb_t* minus_one() const {
+        return neg_one.data();
+    }
+
+    /**
+     * @brief Compare two residues
+     *
+     * @return bool True if a and b are the same residue
+     */
+    bool equal(const mp_limb_t* a, const mp_limb_t* b) const {
+        return mpn_cmp(a, b, size) == 0;
+    }
+
+    /**
+     * @brief Check whether a residue is zero
+     */
+    bool is_zero(const mp_limb_t* a) const {
+        return mpn_zero_p(a, size) != 0;
+    }
+
+    /**
+     * @brief Convert an integer to Montgomery form
+     *
+     * @param r Output residue
+     * @param a Integer in [0, n)
+     */
+    void to_mont(mp_limb_t* r, const mpz_t a) {
+        size_t a_size = mpz_size(a);
+        const mp_limb_t* a_limbs = mpz_limbs_read(a);
+        std::copy(a_limbs, a_limbs + a_size, operand.begin());
+        std::fill(operand.begin() + a_size, operand.end(), 0);
+        mul(r, operand.data(), r2_mod_n.data());
+    }
+
+    /**
+     * @brief Convert a small integer to Montgomery form
+     *
+     * @param r Output residue
+     * @param a Integer smaller than n
+     */
+    void to_mont_ui(mp_limb_t* r, mp_limb_t a) {
+        std::fill(operand.begin(), operand.end(), 0);
+        operand[0] = a;
+        mul(r, operand.data(), r2_mod_n.data());
+    }
+
+    /**
+     * @brief Convert a residue back to an ordinary integer
+     *
+     * @param r Output integer in [0, n)
+     * @param a Residue
+     */
+    void from_mont(mpz_t r, const mp_limb_t* a) {
+        std::copy(a, a + size, product.begin());
+        std::fill(product.begin() + size, product.begin() + 2 * size, 0);
+        reduce(mpz_limbs_write(r, size), product.data());
+        mpz_limbs_finish(r, size);
+    }
+
+    /**
+     * @brief Montgomery multiplication: r = a * b / R mod n
+     *
+     * r may alias a or b.
+     */
+    void mul(mp_limb_t* r, const mp_limb_t* a, const mp_limb_t* b) {
+        PRIME_COUNT(MONT_MULS);
+        PRIME_COUNT_N(LIMB_MULS, 2 * size * size);
+        if (a == b) {
+            mpn_sqr(product.data(), a, size);
+        } else {
+            mpn_mul_n(product.data(), a, b, size);
+        }
+        reduce(r, product.data());
+    }
+
+    /**
+     * @brief Montgomery squaring: r = a^2 / R mod n
+     *
+     * r may alias a.
+     */
+    void sqr(mp_limb_t* r, const mp_limb_t* a) {
+        PRIME_COUNT(MONT_MULS);
+        PRIME_COUNT_N(LIMB_MULS, 2 * size * size);
+        mpn_sqr(product.data(), a, size);
+        reduce(r, product.data());
+    }
+
+    /**
+     * @brief Modular addition: r = a + b mod n
+     */
+    void add(mp_limb_t* r, const mp_limb_t* a, const mp_limb_t* b) {
+        mp_limb_t carry = mpn_add_n(r, a, b, size);
+        if (carry || mpn_cmp(r, modulus.data(), size) >= 0) {
+            mpn_sub_n(r, r, modulus.data(), size);
+        }
+    }
+
+    /**
+     * @brief Modular subtraction: r = a - b mod n
+     */
+    void sub(mp_limb_t* r, const mp_limb_t* a, const mp_limb_t* b) {
+        if (mpn_sub_n(r, a, b, size)) {
+            mpn_add_n(r, r, modulus.data(), size);
+        }
+    }
+
+    /**
+     * @brief Modular negation: r = -a mod n
+     */
+    void neg(mp_limb_t* r, const mp_limb_t* a) {
+        if (is_zero(a)) {
+            std::copy(a, a + size, r);
+        } else {
+            mpn_sub_n(r, modulus.data(), a, size);
+        }
+    }
+
+    /**
+     * @brief Multiplication by a small integer: r = a * c mod n
+     *
+     * Scaling commutes with the Montgomery factor, so a residue times an
+     * ordinary integer is again a residue. Costs one single-limb product and
+     * one short division instead of a full multiplication.
+     *
+     * r may alias a.
+     */
+    void mul_ui(mp_limb_t* r, const mp_limb_t* a, mp_limb_t c) {
+        product[size] = mpn_mul_1(product.data(), a, size, c);
+        mpn_tdiv_qr(quotient.data(), r, 0, product.data(), size + 1, modulus.data(), size);
+    }
+
+    /**
+     * @brief Modular exponentiation of the base 2: r = 2^e
+     *
+     * Multiplying by 2 is a modular doubling, so this costs one squaring per
+     * exponent bit and no table.
+     *
+     * @param r Output residue
+     * @param e Positive exponent
+     */
+    void pow_base2(mp_limb_t* r, const mpz_t e) {
+        mp_bitcnt_t bits = mpz_sizeinbase(e, 2);
+        add(r, one(), one());
+        for (mp_bitcnt_t i = bits - 1; i > 0; --i) {
+            sqr(r, r);
+            if (mpz_tstbit(e, i - 1)) {
+                add(r, r, r);
+            }
+        }
+    }
+
+private:
+    size_t size;                         // Limbs in n
+    mp_limb_t inv;                       // -n^-1 mod B
+    std::vector<mp_limb_t> modulus;      // n
+    std::vector<mp_limb_t> r_mod_n;      // R mod n (1 in Montgomery form)
+    std::vector<mp_limb_t> r2_mod_n;     // R^2 mod n, for conversion into Montgomery form
+    std::vector<mp_limb_t> neg_one;      // n - 1 in Montgomery form
+    std::vector<mp_limb_t> product;      // Double-length product
+    std::vector<mp_limb_t> operand;      // Zero-padded conversion input
+    std::vector<mp_limb_t> quotient;     // Discarded quotient of the setup divisions
+
+    /**
+     * @brief Montgomery reduction: r = t / R mod n, for t < n * R
+     *
+     * Same scheme as GMP's mpn_redc_1: the carry of each row is parked in
+     * the limb that row cleared and added back in one pass at the end.
+     *
+     * @param r Output residue
+     * @param t Double-length input, destroyed
+     */
+    void reduce(mp_limb_t* r, mp_limb_t* t) const {
+        for (size_t i = 0; i < size; ++i) {
+            mp_limb_t m = t[i] * inv;
+            t[i] = mpn_addmul_1(t + i, modulus.data(), size, m);
+        }
+        mp_limb_t carry = mpn_add_n(r, t + size, t, size);
+        if (carry || mpn_cmp(r, modulus.data(), size) >= 0) {
+            mpn_sub_n(r, r, modulus.data(), size);
+        }
+    }
+};
+
+#endif // MOD_CONTEXT_H
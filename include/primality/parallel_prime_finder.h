@@ -0,0 +1,167 @@
+#ifndef PARALLEL_PRIME_FINDER_H
+#define PARALLEL_PRIME_FINDER_H
+
+#include <gmp.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include "primality_tester.h"
+
+/**
+ * @brief Multi-threaded prime search with first-winner cancellation
+ *
+ * Runs N worker threads, each with its own PrimalityTester and therefore its
+ * own independently seeded GMP random state. Every worker draws its own random
+ * starting points, so the workers walk disjoint candidate streams. The first
+ * worker to find a prime publishes it and raises a shared stop flag, which the
+ * other workers check before every candidate.
+ */
+class ParallelPrimeFinder {
+private:
+    std::vector<std::unique_ptr<PrimalityTester>> testers;  // One per worker
+
+    /**
+     * @brief SplitMix64 step, used to derive well-separated per-worker seeds
+     *
+     * @param x Input value
+     * @return uint64_t Mixed value
+     */
+    static uint64_t splitmix64(uint64_t x) {
+        x += 0x9E3779B97F4A7C15ULL;
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+        return x ^ (x >> 31);
+    }
+
+public:
+    /**
+     * @brief Construct a new ParallelPrimeFinder
+     *
+     * @param num_threads Number of worker threads, or 0 to use all hardware threads
+     * @param seed Base seed for the workers, or 0 for automatic seeding
+     */
+    explicit ParallelPrimeFinder(unsigned int num_threads = 0, uint64_t seed = 0) {
+        if (num_threads == 0) {
+            num_threads = std::thread::hardware_concurrency();
+            if (num_threads == 0) num_threads = 1;
+        }
+        if (seed == 0) {
+            // Use system clock as seed if none provided
+            seed = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+        }
+
+        for (unsigned int i = 0; i < num_threads; ++i) {
+            testers.emplace_back(new PrimalityTester(static_cast<unsigned long>(splitmix64(seed + i))));
+        }
+    }
+
+    /**
+     * @brief Get the number of worker threads
+     *
+     * @return unsigned int Number of workers
+     */
+    unsigned int thread_count() const {
+        return static_cast<unsigned int>(testers.size());
+    }
+
+    /**
+     * @brief Set the policy every worker uses for its candidates
+     *
+     * @param policy The policy (see PrimalityTester::set_search_policy)
+     */
+    void set_search_policy(const RoundPolicy& policy) {
+        for (auto& tester : testers) {
+            tester->set_search_policy(policy);
+        }
+    }
+
+    /**
+     * @brief Find a prime of the specified bit size using all workers
+     *
+     * @param result Output parameter for the prime number
+     * @param bits The bit length of the prime number
+     * @param type The type of primality test to use
+     * @param method The candidate search strategy to use
+     * @return bool Always returns true (the search is never cancelled from outside)
+     */
+    bool find_prime(mpz_t result, unsigned int bits,
+                    PrimalityTester::TestType type = PrimalityTester::MILLER_RABIN,
+                    PrimalityTester::SearchMethod method = PrimalityTester::SIEVE_SEARCH) {
+        if (testers.size() == 1 || bits < 8) {
+            return testers[0]->find_prime(result, bits, type, method);
+        }
+        return first_found(result, [&](PrimalityTester* tester, mpz_t candidate, const std::atomic<bool>* stop) {
+            return tester->find_prime(candidate, bits, type, method, stop);
+        });
+    }
+
+    /**
+     * @brief Find a safe prime p = 2q + 1 of the specified bit size using all workers
+     *
+     * @param result Output parameter for the safe prime
+     * @param bits The bit length of the safe prime (at least 3)
+     * @param type The type of primality test to use for q
+     * @return bool Always returns true (the search is never cancelled from outside)
+     * @throws std::invalid_argument If bits is below 3
+     */
+    bool find_safe_prime(mpz_t result, unsigned int bits,
+                         PrimalityTester::TestType type = PrimalityTester::MILLER_RABIN) {
+        if (testers.size() == 1 || bits < 8) {
+            return testers[0]->generate_safe_prime(result, bits, type);
+        }
+        return first_found(result, [&](PrimalityTester* tester, mpz_t candidate, const std::atomic<bool>* stop) {
+            return tester->generate_safe_prime(candidate, bits, type, stop);
+        });
+    }
+
+private:
+    /**
+     * @brief Run a search on every worker and keep the first result
+     *
+     * @param result Output parameter for the first number found
+     * @param search Called as search(tester, candidate, stop); returns false if cancelled
+     * @return bool Always returns true
+     */
+    template <typename Search>
+    bool first_found(mpz_t result, Search search) {
+        std::atomic<bool> stop(false);
+        std::mutex result_mutex;
+        bool published = false;
+
+        auto worker = [&](PrimalityTester* tester) {
+            mpz_t candidate;
+            mpz_init(candidate);
+
+            if (search(tester, candidate, &stop)) {
+                std::lock_guard<std::mutex> lock(result_mutex);
+                if (!published) {
+                    mpz_set(result, candidate);
+                    published = true;
+                }
+                stop.store(true, std::memory_order_relaxed);
+            }
+
+            mpz_clear(candidate);
+        };
+
+        std::vector<std::thread> threads;
+        threads.reserve(testers.size() - 1);
+        for (size_t i = 1; i < testers.size(); ++i) {
+            threads.emplace_back(worker, testers[i].get());
+        }
+        // The calling thread acts as worker 0
+        worker(testers[0].get());
+
+        for (auto& t : threads) {
+            t.join();
+        }
+
+        return true;
+    }
+};
+
+#endif // PARALLEL_PRIME_FINDER_H
@@ -0,0 +1,98 @@
+#ifndef PREPARED_MODULUS_H
+#define PREPARED_MODULUS_H
+
+#include <gmp.h>
+#include "mod_context.h"
+
+/**
+ * @brief Per-modulus values for testing the same number over and over
+ *
+ * A primality test spends a few operations on n itself before any
+ * exponentiation: n - 1 = 2^s * d, the bound n - 3 for random witnesses, the
+ * perfect-square check, the Montgomery constants and, for Baillie-PSW, the
+ * Selfridge parameters and n + 1 = 2^s' * d'. A caller that tests one
+ * number many times (a verifier checking the same public moduli, the
+ * benchmark loops) prepares it once and passes the PreparedModulus to
+ * PrimalityTester::is_prime, which then pays only for trial division and
+ * the exponentiations.
+ *
+ * The Miller-Rabin values and the Montgomery context are set up by the
+ * constructor. The Lucas parameters are filled in by BailliePSW on first use,
+ * so a modulus that is only ever tested with Miller-Rabin never searches
+ * for D.
+ *
+ * A PreparedModulus must not be shared between threads: the Montgomery
+ * context has scratch space and the Lucas fields are filled in lazily.
+ */
+struct PreparedModulus {
+    mpz_t n;                    // The number under test
+    bool odd;                   // n is odd and greater than 3, so the fields below are set
+
+    // Miller-Rabin and screening
+    mpz_t n_minus_1;            // n - 1
+    mpz_t n_minus_3;            // n - 3, bound for random witnesses
+    mpz_t d;                    // Odd part of n - 1
+    unsigned long s;            // Exponent of 2 in n - 1
+    bool square;                // n is a perfect square
+
+    // Montgomery arithmetic modulo n
+    ModContext mod;
+
+    // Strong Lucas test, filled in by BailliePSW::prepare_lucas
+    bool lucas_ready;           // The fields below are set
+    int lucas_found;            // Result of BailliePSW::selfridge_parameters
+    long lucas_D, lucas_Q;      // Selfridge parameters (P = 1)
+    mpz_t lucas_d;              // Odd part of n + 1
+    unsigned long lucas_s;      // Exponent of 2 in n + 1
+
+    /**
+     * @brief Prepare n for repeated testing
+     *
+     * @param value The number to test later
+     */
+    explicit PreparedModulus(const mpz_t value)
+        : odd(false), s(0), square(false), lucas_ready(false), lucas_found(0),
+          lucas_D(0), lucas_Q(0), lucas_s(0) {
+        mpz_init_set(n, value);
+        mpz_init(n_minus_1);
+        mpz_init(n_minus_3);
+        mpz_init(d);
+        mpz_init(lucas_d);
+
+        odd = mpz_odd_p(n) && mpz_cmp_ui(n, 3) > 0;
+        if (!odd) return;
+
+        mpz_sub_ui(n_minus_1, n, 1);
+        mpz_sub_ui(n_minus_3, n, 3);
+        s = mpz_scan1(n_minus_1, 0);
+        mpz_tdiv_q_2exp(d, n_minus_1, s);
+        square = mpz_perfect_square_p(n) != 0;
+        mod.set_modulus(n);
+    }
+
+    /**
+     * @brief Destructor
+     */
+    ~PreparedModulus() {
+        mpz_clear(n);
+        mpz_clear(n_minus_1);
+        mpz_clear(n_minus_3);
+        mpz_clear(d);
+        mpz_clear(lucas_d);
+    }
+
+    PreparedModulus(const PreparedModulus&) = delete;
+    PreparedModulus& operator=(const PreparedModulus&) = delete;
+
+    /**
+     * @brief Check whether this is the preparation of a given number
+     *
+     * @param value Number to compare with
+     * @return bool True if value equals n
+     */
+    bool prepares(const mpz_t value) const {
+        return mpz_cmp(n, value) == 0;
+    }
+};
+
+#endif // PREPARED_MODULUS_H
@@ -2,12 +2,22 @@
 #define PRIMALITY_TESTER_H
 
 #include <gmp.h>
-#include <array>
 #include <vector>
+#include <atomic>
+#include <memory>
 #include "../utils/mpz_utils.h"
 #include "miller_rabin.h"
 #include "baillie_psw.h"
+#include "candidate_sieve.h"
+#include "candidate_batch.h"
+#include "safe_prime_sieve.h"
+#include "u64_primality.h"
+#include "small_primes.h"
+#include "workspace.h"
+#include "prepared_modulus.h"
+#include "round_policy.h"
 #include <iostream>
+#include <stdexcept>
 
 /**
  * @brief Class for performing primality tests
@@ -15,6 +25,10 @@
 class PrimalityTester {
 private:
     gmp_randstate_t rand_state;
+    PrimalityWorkspace workspace;  // Scratch values reused by every test
+    CandidateBatch batch;          // Limb buffers reused by is_prime_batch
+    RoundPolicy search_policy;     // Rounds for the candidates of a prime search
+    std::atomic<uint64_t> tried;   // Candidates tested by the searches so far
     
 public:
     /**
@@ -25,15 +39,85 @@ public:
         BAILLIE_PSW
     };
     
+    /**
+     * @brief Candidate search strategy enum
+     * 
+     * SIEVE_SEARCH walks up from one random start and only tests candidates
+     * that survive the small-prime sieve. RANDOM_RESTART draws a fresh random
+     * odd number after every failure and is kept as a baseline for benchmarks.
+     */
+    enum SearchMethod {
+        SIEVE_SEARCH,
+        RANDOM_RESTART
+    };
+    
+    /**
+     * @brief Position of a sieved search, kept between calls
+     * 
+     * A search cut short by max_candidates normally loses its sieve; given a
+     * Walk, the next call goes on from the candidate after the last one
+     * tested instead of sieving a fresh random start. A Walk serves one
+     * search at a time, but any tester may continue it.
+     */
+    class Walk {
+    public:
+        /**
+         * @brief Construct a walk that has not started yet
+         * 
+         * @param bits Bit length of the primes searched for (at least 3 for a safe prime)
+         * @param safe True for a safe prime search (generate_safe_prime)
+         */
+        Walk(unsigned int bits, bool safe) : bits(bits), started(false), counted(0) {
+            if (safe) {
+                safe_sieve.reset(new SafePrimeSieve(bits));
+            } else {
+                sieve.reset(new CandidateSieve(bits));
+            }
+        }
+        
+    private:
+        friend class PrimalityTester;
+        unsigned int bits;
+        std::unique_ptr<CandidateSieve> sieve;       // Plain search
+        std::unique_ptr<SafePrimeSieve> safe_sieve;  // Safe prime search
+        bool started;                                // The sieve has a start; false once it ran past bits
+        uint64_t counted;                            // Sieve rejects already added to the counters
+        
+        /**
+         * @brief Get the sieve rejects since the last call
+         */
+        uint64_t new_rejects() {
+            uint64_t total = sieve ? sieve->sieved_out() : safe_sieve->sieved_out();
+            uint64_t fresh = total - counted;
+            counted = total;
+            return fresh;
+        }
+    };
+    
     /**
      * @brief Construct a new PrimalityTester object
      * 
      * Initializes the GMP random state
      */
-    PrimalityTester() {
+    PrimalityTester() : search_policy(RoundPolicy::DEFAULT_ERROR_BITS, RoundPolicy::RANDOM_CANDIDATE), tried(0) {
         MPZUtils::init_gmp_random(rand_state);
     }
     
+    /**
+     * @brief Construct a new PrimalityTester object with an explicit seed
+     * 
+     * Used to give every worker thread its own independently seeded random state.
+     * 
+     * @param seed Seed for the GMP random state
+     */
+    explicit PrimalityTester(unsigned long seed)
+        : search_policy(RoundPolicy::DEFAULT_ERROR_BITS, RoundPolicy::RANDOM_CANDIDATE), tried(0) {
+        MPZUtils::init_gmp_random(rand_state, seed);
+    }
+    
+    PrimalityTester(const PrimalityTester&) = delete;
+    PrimalityTester& operator=(const PrimalityTester&) = delete;
+    
     /**
      * @brief Destructor
      * 
@@ -43,82 +127,486 @@ public:
         MPZUtils::clear_gmp_random(rand_state);
     }
     
+    /**
+     * @brief Check whether is_prime gives a proven answer for n
+     * 
+     * Numbers below 2^64 take the deterministic native path, whatever test type
+     * is requested.
+     * 
+     * @param n The number to test
+     * @return true if is_prime(n) is a proof rather than a probable answer
+     */
+    static bool is_proven(const mpz_t n) {
+        return U64Primality::available() && U64Primality::fits(n);
+    }
+    
     /**
      * @brief Test if a number is prime using the chosen primality test
      * 
+     * Numbers that fit in 64 bits are tested deterministically with native
+     * arithmetic (see U64Primality); larger numbers use the chosen test.
+     * 
      * @param n The number to test
      * @param type The type of primality test to use
      * @param k Number of iterations for Miller-Rabin test (higher means more accurate but slower)
      * @return true if n is probably prime, false if n is definitely composite
      */
     bool is_prime(const mpz_t n, TestType type = MILLER_RABIN, unsigned int k = 40) {
+        PRIME_TIME(T_IS_PRIME);
+        if (is_proven(n)) {
+            return U64Primality::is_prime(U64Primality::to_u64(n));
+        }
+        
+        workspace.reserve(mpz_sizeinbase(n, 2));
+        
         switch (type) {
             case MILLER_RABIN:
-                return MillerRabin::test(n, k, rand_state);
+                return MillerRabin::test(n, k, rand_state, &workspace);
             
             case BAILLIE_PSW:
-                return BailliePSW::test(n, rand_state);
+                return BailliePSW::test(n, rand_state, &workspace);
                 
             default:
-                return MillerRabin::test(n, k, rand_state);
+                return MillerRabin::test(n, k, rand_state, &workspace);
+        }
+    }
+    
+    /**
+     * @brief Test a prepared number with the chosen primality test
+     * 
+     * Gives the same answers as is_prime(pm.n, type, k), without redoing the
+     * per-n setup (see PreparedModulus). Prepare a number once and call this
+     * when the same number is tested many times.
+     * 
+     * @param pm The prepared number
+     * @param type The type of primality test to use
+     * @param k Number of iterations for Miller-Rabin test
+     * @return true if n is probably prime, false if n is definitely composite
+     */
+    bool is_prime(PreparedModulus& pm, TestType type = MILLER_RABIN, unsigned int k = 40) {
+        PRIME_TIME(T_IS_PRIME);
+        if (is_proven(pm.n)) {
+            return U64Primality::is_prime(U64Primality::to_u64(pm.n));
+        }
+        
+        workspace.reserve(mpz_sizeinbase(pm.n, 2));
+        
+        if (type == BAILLIE_PSW) {
+            return BailliePSW::test(pm, rand_state, workspace);
         }
+        return MillerRabin::test(pm, k, rand_state, workspace);
+    }
+    
+    /**
+     * @brief Test if a number is prime with the test and rounds a policy chooses
+     * 
+     * @param n The number to test
+     * @param policy Error target and origin of n
+     * @return true if n is probably prime, false if n is definitely composite
+     */
+    bool is_prime(const mpz_t n, const RoundPolicy& policy) {
+        RoundPolicy::Choice choice = policy.choose(mpz_sizeinbase(n, 2));
+        return is_prime(n, choice.bpsw ? BAILLIE_PSW : MILLER_RABIN, choice.rounds);
+    }
+    
+    /**
+     * @brief Set the policy for the candidates of generate_prime and find_prime
+     * 
+     * The default accepts a composite with probability at most 2^-128,
+     * counting on the candidates being random (see RoundPolicy).
+     * 
+     * @param policy The policy
+     */
+    void set_search_policy(const RoundPolicy& policy) {
+        search_policy = policy;
+    }
+    
+    /**
+     * @brief Get the policy for the candidates of generate_prime and find_prime
+     */
+    const RoundPolicy& get_search_policy() const {
+        return search_policy;
+    }
+    
+    /**
+     * @brief Get the number of candidates the prime searches have tested so far
+     * 
+     * Counts the candidates of generate_prime, find_prime and
+     * generate_safe_prime over the tester's lifetime. The searching thread
+     * updates the count as it goes, so another thread may read it to follow
+     * the progress of a search.
+     * 
+     * @return uint64_t Candidates tested
+     */
+    uint64_t candidates_tried() const {
+        return tried.load(std::memory_order_relaxed);
+    }
+    
+    /**
+     * @brief Test a batch of numbers, one pipeline stage at a time
+     * 
+     * Gives the same answers as calling is_prime on every number, but runs
+     * trial division over the whole batch, then the base-2 round over the
+     * survivors, then the remaining rounds (or the Lucas test), so each stage
+     * works through contiguous data. See CandidateBatch.
+     * 
+     * @param ns The numbers to test
+     * @param count Number of numbers
+     * @param out Output: out[i] is true if ns[i] is probably prime
+     * @param type The type of primality test to use
+     * @param k Number of iterations for Miller-Rabin test
+     */
+    void is_prime_batch(const mpz_t* ns, size_t count, bool* out,
+                        TestType type = MILLER_RABIN, unsigned int k = 40) {
+        size_t max_bits = 0;
+        for (size_t i = 0; i < count; ++i) {
+            max_bits = std::max(max_bits, mpz_sizeinbase(ns[i], 2));
+        }
+        workspace.reserve(max_bits);
+        
+        batch.run(ns, count, out, type == BAILLIE_PSW, static_cast<int>(k), rand_state, workspace);
     }
     
     /**
      * @brief Generate a random prime number with the specified number of bits
      * 
+     * Candidates are tested with the test and rounds the search policy
+     * chooses for the bit size.
+     * 
+     * @param result Output parameter for the prime number
+     * @param bits The bit length of the prime number
+     * @param method The candidate search strategy to use
+     * @param stop Optional cancellation flag, checked before every candidate
+     * @return bool True if a prime was found, false if the search was cancelled
+     */
+    bool generate_prime(mpz_t result, unsigned int bits, SearchMethod method = SIEVE_SEARCH,
+                        const std::atomic<bool>* stop = nullptr) {
+        RoundPolicy::Choice choice = search_policy.choose(bits);
+        return search(result, bits, choice.bpsw ? BAILLIE_PSW : MILLER_RABIN, choice.rounds, method, stop, 0);
+    }
+    
+    /**
+     * @brief Find a prime number of the specified bit size using the specified primality test
+     * 
+     * Miller-Rabin runs as many rounds as the search policy asks for at this
+     * bit size; Baillie-PSW needs no round count.
+     * 
+     * @param result Output parameter for the prime number
+     * @param bits The bit length of the prime number
+     * @param type The type of primality test to use
+     * @param method The candidate search strategy to use
+     * @param stop Optional cancellation flag, checked before every candidate
+     * @param max_candidates Give up after testing this many candidates, 0 for no limit
+     * @return bool True if a prime was found, false if the search was cancelled or gave up
+     */
+    bool find_prime(mpz_t result, unsigned int bits, TestType type, SearchMethod method = SIEVE_SEARCH,
+                    const std::atomic<bool>* stop = nullptr, uint64_t max_candidates = 0) {
+        return search(result, bits, type, search_policy.rounds(bits), method, stop, max_candidates);
+    }
+    
+    /**
+     * @brief Continue a sieved prime search, for example one chunk of a long search
+     * 
+     * Like find_prime with SIEVE_SEARCH, but the search goes on from where
+     * the walk's last call stopped.
+     * 
+     * @param result Output parameter for the prime number
+     * @param type The type of primality test to use
+     * @param walk The search position (constructed with safe false)
+     * @param stop Optional cancellation flag, checked before every candidate
+     * @param max_candidates Give up after testing this many candidates, 0 for no limit
+     * @return bool True if a prime was found, false if the search was cancelled or gave up
+     */
+    bool find_prime(mpz_t result, TestType type, Walk& walk,
+                    const std::atomic<bool>* stop = nullptr, uint64_t max_candidates = 0) {
+        if (walk.bits < 8) {
+            return search(result, walk.bits, type, search_policy.rounds(walk.bits), SIEVE_SEARCH, stop, max_candidates);
+        }
+        PRIME_TIME(T_SEARCH);
+        return walk_sieved(result, type, search_policy.rounds(walk.bits), walk, stop, max_candidates);
+    }
+    
+    /**
+     * @brief Generate a random safe prime p = 2q + 1 (q prime) with the specified number of bits
+     * 
+     * Candidates q come from SafePrimeSieve, which strikes out every q for
+     * which q or 2q + 1 has a small factor. A survivor then runs the base-2
+     * round on q and on p, so most pairs are rejected after one
+     * exponentiation each; only a pair that passes both gets the remaining
+     * rounds on q, as many as the search policy asks for. p needs no more:
+     * p - 1 = 2q with q prime and above sqrt(p), and 3 does not divide p, so
+     * by Pocklington's criterion 2^(p-1) = 1 (mod p) proves p prime.
+     * 
+     * @param result Output parameter for the safe prime
+     * @param bits The bit length of the safe prime (at least 3)
+     * @param type The type of primality test to use for q
+     * @param stop Optional cancellation flag, checked before every candidate
+     * @param max_candidates Give up after testing this many candidates q, 0 for no limit
+     * @return bool True if a safe prime was found, false if the search was cancelled or gave up
+     * @throws std::invalid_argument If bits is below 3
+     */
+    bool generate_safe_prime(mpz_t result, unsigned int bits, TestType type = MILLER_RABIN,
+                             const std::atomic<bool>* stop = nullptr, uint64_t max_candidates = 0) {
+        if (bits < 3) {
+            throw std::invalid_argument("Safe primes have at least 3 bits");
+        }
+        Walk walk(bits, true);
+        return generate_safe_prime(result, type, walk, stop, max_candidates);
+    }
+    
+    /**
+     * @brief Continue a safe prime search, for example one chunk of a long search
+     * 
+     * Like generate_safe_prime, but the search goes on from where the walk's
+     * last call stopped.
+     * 
+     * @param result Output parameter for the safe prime
+     * @param type The type of primality test to use for q
+     * @param walk The search position (constructed with safe true)
+     * @param stop Optional cancellation flag, checked before every candidate
+     * @param max_candidates Give up after testing this many candidates q, 0 for no limit
+     * @return bool True if a safe prime was found, false if the search was cancelled or gave up
+     */
+    bool generate_safe_prime(mpz_t result, TestType type, Walk& walk,
+                             const std::atomic<bool>* stop = nullptr, uint64_t max_candidates = 0) {
+        PRIME_TIME(T_SEARCH);
+        unsigned int bits = walk.bits;
+        unsigned int k = search_policy.rounds(bits - 1);
+        SafePrimeSieve& sieve = *walk.safe_sieve;
+        mpz_t q;
+        mpz_init(q);
+        bool found = false;
+        uint64_t tested = 0;
+        
+        while (!found && !stopped(stop) && !exhausted(tested, max_candidates)) {
+            if (!walk.started) {
+                MPZUtils::random_odd(q, bits - 1, rand_state);
+                sieve.reset(q);
+                walk.started = true;
+            }
+            
+            while (true) {
+                if (!sieve.next(q)) {
+                    walk.started = false;  // Past the bit length: restart from a new random q
+                    break;
+                }
+                PRIME_COUNT(CANDIDATES);
+                tried.fetch_add(1, std::memory_order_relaxed);
+                mpz_mul_2exp(result, q, 1);
+                mpz_add_ui(result, result, 1);
+                
+                if (safe_pair(q, result, type, k)) {
+                    found = true;
+                    break;
+                }
+                if (stopped(stop) || exhausted(++tested, max_candidates)) {
+                    break;
+                }
+            }
+        }
+        
+        mpz_clear(q);
+        uint64_t rejects = walk.new_rejects();
+        Screening::count(Screening::stats().sieve_rejects, rejects);
+        PRIME_COUNT_N(SIEVE_REJECTS, rejects);
+        return found;
+    }
+    
+private:
+    /**
+     * @brief Test a safe prime candidate p = 2q + 1, cheap stages first
+     * 
+     * q and then p go through screening (trial division and the base-2
+     * round); only if both pass does q get the rest of its test: the k - 1
+     * random-base rounds, or the strong Lucas test for Baillie-PSW. The
+     * base-2 round on q counts as its first round, so it is not repeated.
+     * 
+     * @param q Odd candidate q
+     * @param p The value 2q + 1
+     * @param type The type of primality test to use for q
+     * @param k Number of iterations for Miller-Rabin test on q
+     * @return bool True if q is probably prime and p passed the base-2 round
+     */
+    bool safe_pair(const mpz_t q, const mpz_t p, TestType type, unsigned int k) {
+        if (is_proven(p)) {
+            return is_prime(q, type, k) && is_prime(p, MILLER_RABIN, 1);
+        }
+        
+        // p is above 2^64, so q is well above the trial division primes and
+        // screening answers only COMPOSITE or PROBABLE
+        workspace.reserve(mpz_sizeinbase(p, 2));
+        unsigned long s = 0;
+        if (Screening::screen(q, workspace, s) != Screening::PROBABLE ||
+            Screening::screen(p, workspace, s) != Screening::PROBABLE) {
+            return false;
+        }
+        
+        if (type == BAILLIE_PSW) {
+            if (mpz_perfect_square_p(q)) return false;
+            bool passed = BailliePSW::strong_lucas_test(q, workspace);
+            Screening::count(passed ? Screening::stats().accepted : Screening::stats().lucas_rejects);
+            if (passed) PRIME_COUNT(ACCEPTED); else PRIME_COUNT(LUCAS_REJECTS);
+            return passed;
+        }
+        
+        // Screening p replaced q's n - 1 = 2^s * d in the workspace
+        mpz_sub_ui(workspace.n_minus_1, q, 1);
+        s = Screening::decompose(workspace.d, workspace.n_minus_1);
+        mpz_sub_ui(workspace.n_minus_3, q, 3);
+        int remaining = (k > 1) ? static_cast<int>(k) - 1 : 0;
+        return MillerRabin::random_rounds(q, workspace.n_minus_1, workspace.n_minus_3, workspace.d, s,
+                                          remaining, rand_state, workspace);
+    }
+    
+    /**
+     * @brief Search for a prime, testing the candidates with the given test
+     * 
+     * @param result Output parameter for the prime number
      * @param bits The bit length of the prime number
-     * @return mpz_t A prime number with the specified bit length
+     * @param type The type of primality test to use
+     * @param k Number of iterations for Miller-Rabin test
+     * @param method The candidate search strategy to use
+     * @param stop Optional cancellation flag
+     * @param max_candidates Candidate limit, 0 for none
+     * @return bool True if a prime was found, false if cancelled or out of candidates
      */
-    void generate_prime(mpz_t result, unsigned int bits) {
+    bool search(mpz_t result, unsigned int bits, TestType type, unsigned int k, SearchMethod method,
+                const std::atomic<bool>* stop, uint64_t max_candidates) {
+        PRIME_TIME(T_SEARCH);
         if (bits <= 1) {
             mpz_set_ui(result, 2);
-            return;
+            return true;
         }
         
-        // Small primes for bits <= 64
-        static const std::array<unsigned long, 15> small_primes = {
-            2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47
-        };
-        
-        // For very small values, return a small prime
+        // For very small values, return the first prime of that length
+        static constexpr SmallPrimes::Table<15> small_primes = SmallPrimes::first<15>();
         if (bits < 8) {
-            for (size_t i = 0; i < small_primes.size(); i++) {
-                mpz_t temp;
-                mpz_init(temp);
-                mpz_set_ui(temp, small_primes[i]);
-                if (mpz_sizeinbase(temp, 2) == static_cast<size_t>(bits)) {
-                    mpz_set(result, temp);
-                    mpz_clear(temp);
-                    return;
+            for (uint32_t p : small_primes) {
+                if (p >> (bits - 1) == 1) {
+                    mpz_set_ui(result, p);
+                    return true;
                 }
-                mpz_clear(temp);
             }
         }
         
+        if (method == RANDOM_RESTART) {
+            return generate_prime_random_restart(result, bits, type, k, stop, max_candidates);
+        }
+        return generate_prime_sieved(result, bits, type, k, stop, max_candidates);
+    }
+    
+    /**
+     * @brief Search by drawing a new random odd number after every failure
+     * 
+     * @param result Output parameter for the prime number
+     * @param bits The bit length of the prime number
+     * @param type The type of primality test to use
+     * @param k Number of iterations for Miller-Rabin test
+     * @param stop Optional cancellation flag
+     * @param max_candidates Candidate limit, 0 for none
+     * @return bool True if a prime was found, false if cancelled or out of candidates
+     */
+    bool generate_prime_random_restart(mpz_t result, unsigned int bits, TestType type, unsigned int k,
+                                       const std::atomic<bool>* stop, uint64_t max_candidates) {
         // Generate random odd numbers and test them until we find a prime
-        while (true) {
+        for (uint64_t tested = 0; !stopped(stop) && !exhausted(tested, max_candidates); ++tested) {
             MPZUtils::random_odd(result, bits, rand_state);
+            PRIME_COUNT(CANDIDATES);
+            tried.fetch_add(1, std::memory_order_relaxed);
             
-            if (is_prime(result)) {
-                return;
+            if (is_prime(result, type, k)) {
+                return true;
             }
         }
+        return false;
     }
     
     /**
-     * @brief Find a prime number of the specified bit size using the specified primality test
+     * @brief Search upwards from a random start, testing only sieve survivors
+     * 
+     * If the walk runs past the bit length before a prime is found, the
+     * search restarts from a new random odd number.
      * 
      * @param result Output parameter for the prime number
      * @param bits The bit length of the prime number
      * @param type The type of primality test to use
-     * @return bool Always returns true (for compatibility with benchmark)
+     * @param k Number of iterations for Miller-Rabin test
+     * @param stop Optional cancellation flag
+     * @param max_candidates Candidate limit, 0 for none
+     * @return bool True if a prime was found, false if cancelled or out of candidates
+     */
+    bool generate_prime_sieved(mpz_t result, unsigned int bits, TestType type, unsigned int k,
+                               const std::atomic<bool>* stop, uint64_t max_candidates) {
+        Walk walk(bits, false);
+        return walk_sieved(result, type, k, walk, stop, max_candidates);
+    }
+    
+    /**
+     * @brief Continue a sieved search from the walk's position
+     * 
+     * @param result Output parameter for the prime number
+     * @param type The type of primality test to use
+     * @param k Number of iterations for Miller-Rabin test
+     * @param walk The search position (bits of at least 8)
+     * @param stop Optional cancellation flag
+     * @param max_candidates Candidate limit, 0 for none
+     * @return bool True if a prime was found, false if cancelled or out of candidates
+     */
+    bool walk_sieved(mpz_t result, TestType type, unsigned int k, Walk& walk,
+                     const std::atomic<bool>* stop, uint64_t max_candidates) {
+        CandidateSieve& sieve = *walk.sieve;
+        bool found = false;
+        uint64_t tested = 0;
+        
+        while (!found && !stopped(stop) && !exhausted(tested, max_candidates)) {
+            if (!walk.started) {
+                MPZUtils::random_odd(result, walk.bits, rand_state);
+                sieve.reset(result);
+                walk.started = true;
+            }
+            
+            while (true) {
+                if (!sieve.next(result)) {
+                    walk.started = false;  // Past the bit length: restart from a new random odd number
+                    break;
+                }
+                PRIME_COUNT(CANDIDATES);
+                tried.fetch_add(1, std::memory_order_relaxed);
+                if (is_prime(result, type, k)) {
+                    found = true;
+                    break;
+                }
+                if (stopped(stop) || exhausted(++tested, max_candidates)) {
+                    break;
+                }
+            }
+        }
+        
+        uint64_t rejects = walk.new_rejects();
+        Screening::count(Screening::stats().sieve_rejects, rejects);
+        PRIME_COUNT_N(SIEVE_REJECTS, rejects);
+        return found;
+    }
+    
+    /**
+     * @brief Check an optional cancellation flag
+     * 
+     * @param stop Cancellation flag, or nullptr
+     * @return bool True if the search should stop
+     */
+    static bool stopped(const std::atomic<bool>* stop) {
+        return stop != nullptr && stop->load(std::memory_order_relaxed);
+    }
+    
+    /**
+     * @brief Check a candidate limit
+     * 
+     * @param tested Candidates tested so far
+     * @param max_candidates The limit, 0 for none
+     * @return bool True if the search should give up
      */
-    bool find_prime(mpz_t result, unsigned int bits, TestType type) {
-        // Currently, we only have one implementation that uses Miller-Rabin
-        // So we ignore the test type parameter and just use generate_prime
-        generate_prime(result, bits);
-        return true;
+    static bool exhausted(uint64_t tested, uint64_t max_candidates) {
+        return max_candidates != 0 && tested >= max_candidates;
     }
 };
 
@@ -0,0 +1,384 @@
+#ifndef PRIME_CACHE_H
+#define PRIME_CACHE_H
+
+#include <gmp.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "primality_tester.h"
+
+/**
+ * @brief Read-only, memory-mapped store of primes by bit size
+ *
+ * File layout (all fields little-endian):
+ * - Header: magic "PRMCACHE", version, limb size in bits (64), number of
+ *   bit sizes, reserved word
+ * - Index: one entry per bit size with the bit size, the number of primes,
+ *   the limbs per prime and the byte offset of the first prime
+ * - Data: the primes of each size back to back, each as a fixed number of
+ *   64-bit limbs, least significant limb first
+ *
+ * open() maps the file and checks the header; after that, view() points a
+ * read-only mpz_t straight at the mapped limbs (mpz_roinit_n) and load()
+ * copies an entry out with mpz_import. Nothing is parsed, so a tool can
+ * start and get its primes in well under a millisecond.
+ *
+ * Files are written by PrimeCacheBuilder, or by ensure(), which adds any
+ * missing primes to an existing cache.
+ */
+class PrimeCache {
+public:
+    static const uint32_t VERSION = 1;
+
+    /**
+     * @brief Construct a closed cache
+     */
+    PrimeCache() : data(nullptr), length(0) {}
+
+    /**
+     * @brief Unmap the file
+     */
+    ~PrimeCache() {
+        close();
+    }
+
+    PrimeCache(const PrimeCache&) = delete;
+    PrimeCache& operator=(const PrimeCache&) = delete;
+
+    /**
+     * @brief Get the cache location used by the tools
+     *
+     * @return std::string $PRIME_CACHE if set, otherwise experiments/cache/primes.bin
+     */
+    static std::string default_path() {
+        const char* env = std::getenv("PRIME_CACHE");
+        return (env != nullptr && *env != '\0') ? env : "experiments/cache/primes.bin";
+    }
+
+    /**
+     * @brief Map a cache file
+     *
+     * @param path File to open
+     * @return bool False if the file is missing, truncated or not a cache
+     */
+    bool open(const std::string& path) {
+        close();
+
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(Header))) {
+            ::close(fd);
+            return false;
+        }
+
+        void* mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) return false;
+
+        data = static_cast<const unsigned char*>(mapped);
+        length = static_cast<size_t>(st.st_size);
+        if (!validate()) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Unmap the file; views handed out before become invalid
+     */
+    void close() {
+        if (data != nullptr) {
+            munmap(const_cast<unsigned char*>(data), length);
+        }
+        data = nullptr;
+        length = 0;
+        entries.clear();
+    }
+
+    /**
+     * @brief Check whether a file is mapped
+     */
+    bool is_open() const {
+        return data != nullptr;
+    }
+
+    /**
+     * @brief Get the number of primes stored for a bit size
+     *
+     * @param bits Bit length
+     * @return size_t Number of primes (0 if the size is not stored)
+     */
+    size_t count(unsigned int bits) const {
+        const IndexEntry* entry = find(bits);
+        return entry ? entry->count : 0;
+    }
+
+    /**
+     * @brief Get the stored bit sizes
+     *
+     * @return std::vector<unsigned int> Bit sizes in file order
+     */
+    std::vector<unsigned int> bit_sizes() const {
+        std::vector<unsigned int> sizes;
+        for (const IndexEntry& entry : entries) {
+            sizes.push_back(entry.bits);
+        }
+        return sizes;
+    }
+
+    /**
+     * @brief Point a read-only mpz_t at a stored prime, without copying
+     *
+     * The view must not be modified or cleared, and is valid until the cache
+     * is closed.
+     *
+     * @param view Output: read-only view of the prime
+     * @param bits Bit length
+     * @param index Entry number, below count(bits)
+     * @return bool False if there is no such entry
+     */
+    bool view(mpz_t view, unsigned int bits, size_t index) const {
+        const mp_limb_t* limbs = entry_limbs(bits, index);
+        if (limbs == nullptr) return false;
+        mpz_roinit_n(view, limbs, static_cast<mp_size_t>(find(bits)->limbs));
+        return true;
+    }
+
+    /**
+     * @brief Copy a stored prime into an mpz_t
+     *
+     * @param result Output parameter for the prime
+     * @param bits Bit length
+     * @param index Entry number, below count(bits)
+     * @return bool False if there is no such entry
+     */
+    bool load(mpz_t result, unsigned int bits, size_t index) const {
+        const mp_limb_t* limbs = entry_limbs(bits, index);
+        if (limbs == nullptr) return false;
+        mpz_import(result, find(bits)->limbs, -1, sizeof(uint64_t), -1, 0, limbs);
+        return true;
+    }
+
+    /**
+     * @brief Make sure a cache holds at least count primes of each size
+     *
+     * Missing primes are generated with tester and written, together with
+     * everything the file already holds, to a new file that replaces the old
+     * one. The directory is created if needed.
+     *
+     * @param path Cache file
+     * @param bit_sizes Bit sizes required (sizes below 2 are skipped)
+     * @param count Primes required per size
+     * @param tester Tester used to generate missing primes
+     * @return bool False if the file could not be written
+     */
+    static bool ensure(const std::string& path, const std::vector<unsigned int>& bit_sizes,
+                       size_t count, PrimalityTester& tester);
+
+private:
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t limb_bits;
+        uint32_t sizes;
+        uint32_t reserved;
+    };
+
+    struct IndexEntry {
+        uint32_t bits;
+        uint32_t count;
+        uint32_t limbs;     // Limbs per prime
+        uint32_t reserved;
+        uint64_t offset;    // Byte offset of the first prime
+    };
+
+    friend class PrimeCacheBuilder;
+
+    const unsigned char* data;
+    size_t length;
+    std::vector<IndexEntry> entries;
+
+    /**
+     * @brief Check the header and index against the file size
+     */
+    bool validate() {
+        static_assert(GMP_NUMB_BITS == 64, "PrimeCache stores 64-bit limbs without nails");
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+        return false;  // The mapped limbs are used in place
+#endif
+        Header header;
+        std::memcpy(&header, data, sizeof(header));
+        if (std::memcmp(header.magic, "PRMCACHE", 8) != 0 || header.version != VERSION ||
+            header.limb_bits != 64) {
+            return false;
+        }
+        if (length < sizeof(Header) + static_cast<size_t>(header.sizes) * sizeof(IndexEntry)) {
+            return false;
+        }
+
+        entries.resize(header.sizes);
+        std::memcpy(entries.data(), data + sizeof(Header), header.sizes * sizeof(IndexEntry));
+        for (const IndexEntry& entry : entries) {
+            uint64_t bytes = static_cast<uint64_t>(entry.count) * entry.limbs * sizeof(uint64_t);
+            if (entry.offset % sizeof(uint64_t) != 0 || entry.offset + bytes > length ||
+                entry.limbs != (entry.bits + 63) / 64) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    const IndexEntry* find(unsigned int bits) const {
+        for (const IndexEntry& entry : entries) {
+            if (entry.bits == bits) return &entry;
+        }
+        return nullptr;
+    }
+
+    const mp_limb_t* entry_limbs(unsigned int bits, size_t index) const {
+        const IndexEntry* entry = find(bits);
+        if (entry == nullptr || index >= entry->count) return nullptr;
+        return reinterpret_cast<const mp_limb_t*>(data + entry->offset) + index * entry->limbs;
+    }
+};
+
+/**
+ * @brief Collects primes and writes them as a PrimeCache file
+ */
+class PrimeCacheBuilder {
+public:
+    /**
+     * @brief Add a prime under its bit length
+     *
+     * @param p The prime
+     */
+    void add(const mpz_t p) {
+        unsigned int bits = static_cast<unsigned int>(mpz_sizeinbase(p, 2));
+        size_t limbs = (bits + 63) / 64;
+        std::vector<uint64_t>& store = primes[bits];
+        size_t first = store.size();
+        store.resize(first + limbs, 0);
+        mpz_export(&store[first], nullptr, -1, sizeof(uint64_t), -1, 0, p);
+    }
+
+    /**
+     * @brief Add every prime of an open cache
+     *
+     * @param cache The cache
+     */
+    void add_all(const PrimeCache& cache) {
+        mpz_t view;
+        for (unsigned int bits : cache.bit_sizes()) {
+            for (size_t i = 0; i < cache.count(bits); ++i) {
+                cache.view(view, bits, i);
+                add(view);
+            }
+        }
+    }
+
+    /**
+     * @brief Get the number of primes collected for a bit size
+     */
+    size_t count(unsigned int bits) const {
+        auto it = primes.find(bits);
+        return it == primes.end() ? 0 : it->second.size() / ((bits + 63) / 64);
+    }
+
+    /**
+     * @brief Write the collected primes
+     *
+     * The file is written next to path and renamed over it, so readers never
+     * see a partial cache. The parent directory is created if it is missing.
+     *
+     * @param path Cache file
+     * @return bool False on an I/O error
+     */
+    bool write(const std::string& path) const {
+        size_t slash = path.rfind('/');
+        if (slash != std::string::npos && slash > 0) {
+            mkdir(path.substr(0, slash).c_str(), 0755);
+        }
+
+        PrimeCache::Header header;
+        std::memcpy(header.magic, "PRMCACHE", 8);
+        header.version = PrimeCache::VERSION;
+        header.limb_bits = 64;
+        header.sizes = static_cast<uint32_t>(primes.size());
+        header.reserved = 0;
+
+        std::vector<PrimeCache::IndexEntry> index;
+        uint64_t offset = sizeof(header) + primes.size() * sizeof(PrimeCache::IndexEntry);
+        for (const auto& size : primes) {
+            PrimeCache::IndexEntry entry;
+            entry.bits = size.first;
+            entry.limbs = (size.first + 63) / 64;
+            entry.count = static_cast<uint32_t>(size.second.size() / entry.limbs);
+            entry.reserved = 0;
+            entry.offset = offset;
+            offset += size.second.size() * sizeof(uint64_t);
+            index.push_back(entry);
+        }
+
+        std::string temp = path + ".tmp";
+        FILE* out = std::fopen(temp.c_str(), "wb");
+        if (out == nullptr) return false;
+
+        bool ok = std::fwrite(&header, sizeof(header), 1, out) == 1;
+        if (ok && !index.empty()) {
+            ok = std::fwrite(index.data(), sizeof(PrimeCache::IndexEntry), index.size(), out) == index.size();
+        }
+        for (const auto& size : primes) {
+            if (!ok) break;
+            ok = std::fwrite(size.second.data(), sizeof(uint64_t), size.second.size(), out) == size.second.size();
+        }
+        ok = (std::fclose(out) == 0) && ok;
+
+        if (!ok || std::rename(temp.c_str(), path.c_str()) != 0) {
+            std::remove(temp.c_str());
+            return false;
+        }
+        return true;
+    }
+
+private:
+    std::map<unsigned int, std::vector<uint64_t>> primes;  // Limbs of every prime, by bit size
+};
+
+bool PrimeCache::ensure(const std::string& path, const std::vector<unsigned int>& bit_sizes,
+                        size_t count, PrimalityTester& tester) {
+    PrimeCacheBuilder builder;
+    {
+        PrimeCache existing;
+        if (existing.open(path)) {
+            builder.add_all(existing);
+        }
+    }
+
+    bool changed = false;
+    mpz_t prime;
+    mpz_init(prime);
+    for (unsigned int bits : bit_sizes) {
+        if (bits < 2) continue;  // No prime has fewer than 2 bits
+        while (builder.count(bits) < count) {
+            tester.generate_prime(prime, bits);
+            builder.add(prime);
+            changed = true;
+        }
+    }
+    mpz_clear(prime);
+
+    return !changed || builder.write(path);
+}
+
+#endif // PRIME_CACHE_H
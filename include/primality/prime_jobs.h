@@ -0,0 +1,871 @@
+#ifndef PRIME_JOBS_H
+#define PRIME_JOBS_H
+
+#include <gmp.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <algorithm>
+#include "../prng/xoshiro.h"
+#include "../utils/work_stealing.h"
+#include "primality_tester.h"
+
+/**
+ * @brief Asynchronous prime generation on a pool of worker threads
+ *
+ * submit_generate() queues a search and returns at once with a Handle, so a
+ * caller such as an event-loop thread never blocks on a search of random,
+ * unbounded length. Through the Handle the caller can poll or wait for the
+ * result, cancel the job or read how many candidates it has tried; a job can
+ * also carry a deadline and callbacks for progress and completion.
+ *
+ * Each worker thread owns a PrimalityTester (and so its own random state
+ * and workspace) and a deque of tasks (WorkStealingDeques). Submitted jobs
+ * wait in a shared queue; a worker moves one large job, or its share of the
+ * small jobs (up to BATCH_MAX_BITS bits, at most MAX_BATCH), into its own
+ * deque in one go and works through it on its warm tester. A small job runs
+ * to the end on one worker. A large job runs in chunks of CHUNK_CANDIDATES
+ * candidates; before each chunk the worker puts the job back into its deque,
+ * where an idle worker can steal it and search alongside. A chunk continues
+ * a sieve walk (PrimalityTester::Walk) that an earlier chunk of the job left
+ * off, so chunking does not restart the search; a thief running at the same
+ * time starts a walk of its own. With one worker nothing can steal, and
+ * large jobs run to the end like small ones. A lone 4096-bit search thus spreads over every idle core, and
+ * gives them back at the next chunk boundary when new jobs are submitted.
+ * Stolen chunks run on the thief's own tester, so the workers share no
+ * state but the job's stop flag and result.
+ *
+ * submit_test() queues a test job instead: a set of numbers that one worker
+ * tests with PrimalityTester::is_prime_batch, sorted into batches with the
+ * searches by the same size rule but never split. is_prime_batch() here
+ * spreads a large array over the pool as test jobs of TEST_CHUNK numbers
+ * each, so tests and searches share one scheduler.
+ *
+ * A monitor thread enforces the deadlines and calls the progress callbacks
+ * every PROGRESS_INTERVAL_MS while jobs are running. Cancellation and
+ * deadlines take effect before the next candidate is tested, so a running
+ * job stops within one primality test.
+ */
+class PrimeJobs {
+public:
+    /**
+     * @brief State of a job
+     */
+    enum Status {
+        PENDING,     // Queued, not started
+        RUNNING,     // A worker is searching
+        FOUND,       // Finished with a prime
+        TESTED,      // A test job finished; Handle::is_prime() has the answers
+        CANCELLED,   // Cancelled through the handle, or by the destructor
+        EXPIRED      // The deadline passed before a prime was found
+    };
+
+    /**
+     * @brief Per-job settings
+     */
+    struct Options {
+        PrimalityTester::TestType type;     // Test for the candidates (rounds from the search policy)
+        unsigned int rounds;                // Miller-Rabin rounds of a test job
+        bool safe;                          // Search for a safe prime p = 2q + 1
+        std::chrono::milliseconds timeout;  // Give up after this long (counted from submission), 0 for never
+
+        // Called on the monitor thread with the candidates tried so far, while the job runs
+        std::function<void(uint64_t candidates)> on_progress;
+
+        // Called once, on the thread that finishes the job, with its final status
+        std::function<void(Status status)> on_done;
+
+        Options() : type(PrimalityTester::MILLER_RABIN), rounds(40), safe(false), timeout(0) {}
+    };
+
+private:
+    /**
+     * @brief A submitted job, shared by the queue, the worker and the handles
+     */
+    struct Job {
+        unsigned int bits;                  // Prime size, or the largest number of a test job
+        Options options;
+        std::chrono::steady_clock::time_point deadline;  // time_point::max() if none
+        mpz_t prime;
+        size_t count;                       // Numbers of a test job, 0 for a search
+        std::unique_ptr<mpz_t[]> numbers;   // The numbers of a test job
+        std::unique_ptr<bool[]> results;    // results[i] is true if numbers[i] is probably prime
+        std::vector<std::unique_ptr<PrimalityTester::Walk>> walks;  // Idle search positions; guarded by mutex
+        std::atomic<bool> stop;             // Raised by cancel(), the deadline or the destructor
+        std::atomic<bool> expired;          // The deadline raised stop
+        std::atomic<uint64_t> candidates;   // Candidates tried by finished chunks
+        std::atomic<uint64_t> progress;     // Candidates tried so far, as last seen by the monitor
+        mutable std::mutex mutex;
+        mutable std::condition_variable finished;
+        Status status;                      // Guarded by mutex
+        bool finalized;                     // on_done has returned; guarded by mutex
+
+        Job(unsigned int bits, const Options& options)
+            : bits(bits), options(options), deadline(std::chrono::steady_clock::time_point::max()),
+              count(0), stop(false), expired(false), candidates(0), progress(0), status(PENDING),
+              finalized(false) {
+            mpz_init2(prime, bits);
+            if (options.timeout.count() > 0) {
+                deadline = std::chrono::steady_clock::now() + options.timeout;
+            }
+        }
+
+        /**
+         * @brief Construct a test job holding copies of the numbers
+         */
+        Job(const mpz_t* ns, size_t count, const Options& options)
+            : Job(0, options) {
+            this->count = count;
+            numbers.reset(new mpz_t[count]);
+            results.reset(new bool[count]());
+            for (size_t i = 0; i < count; ++i) {
+                mpz_init_set(numbers[i], ns[i]);
+                bits = std::max(bits, static_cast<unsigned int>(mpz_sizeinbase(ns[i], 2)));
+            }
+        }
+
+        ~Job() {
+            for (size_t i = 0; i < count; ++i) {
+                mpz_clear(numbers[i]);
+            }
+            mpz_clear(prime);
+        }
+
+        /**
+         * @brief Move from PENDING to RUNNING, if not done already
+         *
+         * @return bool False if the job has finished (found, cancelled or expired)
+         */
+        bool activate() {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (status == PENDING) status = RUNNING;
+            return status == RUNNING;
+        }
+
+        /**
+         * @brief Raise the stop flag because the deadline has passed
+         */
+        void expire() {
+            expired.store(true, std::memory_order_relaxed);
+            stop.store(true, std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief Finish as FOUND with the given prime, unless already finished
+         *
+         * The stop flag is raised so the job's other chunks give up.
+         *
+         * @param found The prime
+         */
+        void complete(const mpz_t found) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (status != PENDING && status != RUNNING) return;
+                mpz_set(prime, found);
+                status = FOUND;
+            }
+            stop.store(true, std::memory_order_relaxed);
+            if (options.on_done) {
+                options.on_done(FOUND);
+            }
+            finalize();
+        }
+
+        /**
+         * @brief Finish a test job as TESTED, unless already finished
+         */
+        void complete_test() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (status != PENDING && status != RUNNING) return;
+                status = TESTED;
+            }
+            if (options.on_done) {
+                options.on_done(TESTED);
+            }
+            finalize();
+        }
+
+        /**
+         * @brief Finish a job that was stopped, as EXPIRED or CANCELLED
+         */
+        void finish_stopped() {
+            finish(expired.load(std::memory_order_relaxed) ? EXPIRED : CANCELLED);
+        }
+
+        /**
+         * @brief Record the final status, call on_done and wake the waiters
+         *
+         * Only the first call has an effect. The job counts as done only
+         * once on_done has returned, so wait() returns after the callback and
+         * a waiter sees its effects.
+         *
+         * @param final_status CANCELLED or EXPIRED
+         */
+        void finish(Status final_status) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (status != PENDING && status != RUNNING) return;
+                status = final_status;
+            }
+            if (options.on_done) {
+                options.on_done(final_status);
+            }
+            finalize();
+        }
+
+        /**
+         * @brief Mark the job done after on_done has returned and wake the waiters
+         */
+        void finalize() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                finalized = true;
+            }
+            finished.notify_all();
+        }
+
+        /**
+         * @brief Check whether the job has finished and its on_done has returned
+         */
+        bool done_locked() const {
+            return finalized;
+        }
+    };
+
+public:
+    /**
+     * @brief Caller's view of a submitted job
+     *
+     * Handles are cheap to copy; all copies refer to the same job, which
+     * lives as long as any handle or the pool still needs it.
+     */
+    class Handle {
+    public:
+        /**
+         * @brief Construct an empty handle that refers to no job
+         */
+        Handle() {}
+
+        /**
+         * @brief Check whether the handle refers to a job
+         */
+        bool valid() const {
+            return job != nullptr;
+        }
+
+        /**
+         * @brief Cancel the job
+         *
+         * A pending job is finished as CANCELLED at once; a running one
+         * stops before its next candidate. Cancelling a finished job has no
+         * effect.
+         */
+        void cancel() {
+            job->stop.store(true, std::memory_order_relaxed);
+            bool pending;
+            {
+                std::lock_guard<std::mutex> lock(job->mutex);
+                pending = job->status == PENDING;
+            }
+            if (pending) {
+                job->finish(CANCELLED);
+            }
+        }
+
+        /**
+         * @brief Get the current status without waiting
+         *
+         * A finishing job reports RUNNING until its on_done has returned, so
+         * a final status here means wait() and get() will not block.
+         */
+        Status status() const {
+            std::lock_guard<std::mutex> lock(job->mutex);
+            if (job->status == PENDING || job->done_locked()) return job->status;
+            return RUNNING;
+        }
+
+        /**
+         * @brief Check whether the job has finished (found, cancelled or expired)
+         */
+        bool done() const {
+            std::lock_guard<std::mutex> lock(job->mutex);
+            return job->done_locked();
+        }
+
+        /**
+         * @brief Wait until the job has finished
+         *
+         * @return Status FOUND, TESTED, CANCELLED or EXPIRED
+         */
+        Status wait() const {
+            std::unique_lock<std::mutex> lock(job->mutex);
+            job->finished.wait(lock, [this]() { return job->done_locked(); });
+            return job->status;
+        }
+
+        /**
+         * @brief Wait until the job has finished or the timeout has passed
+         *
+         * Only the wait is bounded; the job itself keeps running.
+         *
+         * @param timeout Longest time to wait
+         * @return bool True if the job has finished
+         */
+        template <typename Rep, typename Period>
+        bool wait_for(const std::chrono::duration<Rep, Period>& timeout) const {
+            std::unique_lock<std::mutex> lock(job->mutex);
+            return job->finished.wait_for(lock, timeout, [this]() { return job->done_locked(); });
+        }
+
+        /**
+         * @brief Wait for the job and copy out its prime
+         *
+         * @param result Output parameter for the prime (unchanged unless FOUND)
+         * @return bool True if the job found a prime
+         */
+        bool get(mpz_t result) const {
+            if (wait() != FOUND) return false;
+            mpz_set(result, job->prime);
+            return true;
+        }
+
+        /**
+         * @brief Get the number of candidates the job has tried so far
+         *
+         * Exact once the job has finished; while it runs, as of the last
+         * chunk or monitor update.
+         */
+        uint64_t candidates() const {
+            return std::max(job->candidates.load(std::memory_order_relaxed),
+                            job->progress.load(std::memory_order_relaxed));
+        }
+
+        /**
+         * @brief Wait for a test job and get one of its answers
+         *
+         * @param i Index of the number, in submission order
+         * @return bool True if the number is probably prime (false if the job was cancelled or expired)
+         */
+        bool is_prime(size_t i) const {
+            return wait() == TESTED && job->results[i];
+        }
+
+        /**
+         * @brief Get the bit length the job searches for, or of the largest number of a test job
+         */
+        unsigned int bits() const {
+            return job->bits;
+        }
+
+    private:
+        friend class PrimeJobs;
+        std::shared_ptr<Job> job;
+
+        explicit Handle(std::shared_ptr<Job> job) : job(std::move(job)) {}
+    };
+
+    // Jobs of at most this many bits are small and are taken in batches
+    static const unsigned int BATCH_MAX_BITS = 512;
+
+    // Largest number of small jobs a worker takes at once
+    enum { MAX_BATCH = 64 };
+
+    // Candidates per chunk of a large job
+    static const uint64_t CHUNK_CANDIDATES = 16;
+
+    // Numbers per test job of is_prime_batch
+    enum { TEST_CHUNK = 64 };
+
+    // How often the monitor checks deadlines and calls the progress callbacks
+    enum { PROGRESS_INTERVAL_MS = 10 };
+
+    /**
+     * @brief Construct a pool and start its threads
+     *
+     * @param num_threads Number of worker threads, or 0 to use all hardware threads
+     * @param seed Base seed for the workers, or 0 for automatic seeding
+     */
+    explicit PrimeJobs(unsigned int num_threads = 0, uint64_t seed = 0)
+        : deques(resolve_threads(num_threads)), stopping(false), splitting(true) {
+        num_threads = resolve_threads(num_threads);
+
+        // One non-overlapping generator stream per worker seeds its tester
+        std::vector<Xoshiro256pp> streams = Xoshiro256pp(seed).split(num_threads);
+        for (unsigned int i = 0; i < num_threads; ++i) {
+            testers.emplace_back(new PrimalityTester(static_cast<unsigned long>(streams[i].next_u64())));
+        }
+        for (unsigned int i = 0; i < num_threads; ++i) {
+            workers.emplace_back(&PrimeJobs::worker_loop, this, static_cast<size_t>(i));
+        }
+        monitor = std::thread(&PrimeJobs::monitor_loop, this);
+    }
+
+    /**
+     * @brief Cancel every pending and running job and stop the threads
+     */
+    ~PrimeJobs() {
+        std::deque<std::shared_ptr<Job>> abandoned;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+            abandoned.swap(queue);
+            for (const Running& entry : running) {
+                entry.job->stop.store(true, std::memory_order_relaxed);
+            }
+        }
+        work.notify_all();
+        tick.notify_all();
+        for (auto& t : workers) {
+            t.join();
+        }
+        monitor.join();
+
+        // Jobs still queued or waiting in a deque never ran to the end
+        for (const auto& job : deques.drain()) {
+            abandoned.push_back(job);
+        }
+        for (const auto& job : abandoned) {
+            job->stop.store(true, std::memory_order_relaxed);
+            job->finish(CANCELLED);
+        }
+    }
+
+    PrimeJobs(const PrimeJobs&) = delete;
+    PrimeJobs& operator=(const PrimeJobs&) = delete;
+
+    /**
+     * @brief Queue a prime search
+     *
+     * @param bits Bit length of the prime (at least 3 for a safe prime)
+     * @param options Test, safe prime, timeout and callbacks
+     * @return Handle The job
+     * @throws std::invalid_argument If a safe prime of fewer than 3 bits is requested
+     */
+    Handle submit_generate(unsigned int bits, const Options& options = Options()) {
+        if (options.safe && bits < 3) {
+            throw std::invalid_argument("Safe primes have at least 3 bits");
+        }
+        return enqueue(std::make_shared<Job>(bits, options));
+    }
+
+    /**
+     * @brief Queue a test of a set of numbers
+     *
+     * The numbers are copied; one worker tests them all with
+     * PrimalityTester::is_prime_batch, options.type and options.rounds.
+     * A test job is never split, and stops only between jobs: cancelling or
+     * expiring it takes effect if no worker has started it yet.
+     *
+     * @param ns The numbers to test (odd or even, any size)
+     * @param count Number of numbers, at least 1
+     * @param options Test, rounds, timeout and on_done (safe and on_progress are ignored)
+     * @return Handle The job; Handle::is_prime(i) has the answer for ns[i]
+     * @throws std::invalid_argument If count is 0
+     */
+    Handle submit_test(const mpz_t* ns, size_t count, const Options& options = Options()) {
+        if (count == 0) {
+            throw std::invalid_argument("A test job needs at least one number");
+        }
+        return enqueue(std::make_shared<Job>(ns, count, options));
+    }
+
+    /**
+     * @brief Test a batch of numbers on the pool and wait for the answers
+     *
+     * Gives the same answers as PrimalityTester::is_prime_batch, with the
+     * batch split into test jobs of TEST_CHUNK numbers that the workers take
+     * alongside any searches.
+     *
+     * @param ns The numbers to test
+     * @param count Number of numbers
+     * @param out Output: out[i] is true if ns[i] is probably prime
+     * @param type The type of primality test to use
+     * @param k Number of iterations for Miller-Rabin test
+     */
+    void is_prime_batch(const mpz_t* ns, size_t count, bool* out,
+                        PrimalityTester::TestType type = PrimalityTester::MILLER_RABIN, unsigned int k = 40) {
+        Options options;
+        options.type = type;
+        options.rounds = k;
+        std::vector<Handle> handles;
+        for (size_t first = 0; first < count; first += TEST_CHUNK) {
+            handles.push_back(submit_test(ns + first, std::min<size_t>(TEST_CHUNK, count - first), options));
+        }
+        for (size_t chunk = 0; chunk < handles.size(); ++chunk) {
+            const Handle& handle = handles[chunk];
+            handle.wait();
+            for (size_t i = 0; i < handle.job->count; ++i) {
+                out[chunk * TEST_CHUNK + i] = handle.job->results[i];
+            }
+        }
+    }
+
+    /**
+     * @brief Get the number of worker threads
+     */
+    unsigned int thread_count() const {
+        return static_cast<unsigned int>(workers.size());
+    }
+
+    /**
+     * @brief Get the number of jobs no worker has taken yet
+     */
+    size_t pending() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return queue.size();
+    }
+
+    /**
+     * @brief Choose whether large jobs are split into stealable chunks
+     *
+     * Splitting is on by default, though a pool of one worker never splits.
+     * Turned off, every job runs to the end on the worker that took it,
+     * which the benchmarks use as the static baseline. Call before
+     * submitting jobs.
+     *
+     * @param split True to split large jobs
+     */
+    void set_splitting(bool split) {
+        splitting = split;
+    }
+
+    /**
+     * @brief Set the policy every worker uses for its candidates
+     *
+     * Call before submitting jobs.
+     *
+     * @param policy The policy (see PrimalityTester::set_search_policy)
+     */
+    void set_search_policy(const RoundPolicy& policy) {
+        for (auto& tester : testers) {
+            tester->set_search_policy(policy);
+        }
+    }
+
+private:
+    /**
+     * @brief A job a worker is running, with the tester's count when it started
+     */
+    struct Running {
+        std::shared_ptr<Job> job;
+        const PrimalityTester* tester;
+        uint64_t start;
+    };
+
+    std::vector<std::unique_ptr<PrimalityTester>> testers;  // One per worker
+    std::vector<std::thread> workers;
+    std::thread monitor;
+    WorkStealingDeques<std::shared_ptr<Job>> deques;        // One per worker
+    mutable std::mutex mutex;                // Guards queue, running, watched and stopping
+    std::condition_variable work;            // Signalled when a job is queued or a task is pushed
+    std::condition_variable tick;            // Wakes the monitor
+    std::deque<std::shared_ptr<Job>> queue;  // Submitted jobs no worker has taken yet
+    std::vector<Running> running;
+    std::vector<std::shared_ptr<Job>> watched;  // Unfinished jobs with a deadline
+    bool stopping;
+    bool splitting;
+
+    /**
+     * @brief Get the worker count for a requested thread count
+     */
+    static unsigned int resolve_threads(unsigned int num_threads) {
+        if (num_threads == 0) {
+            num_threads = std::thread::hardware_concurrency();
+            if (num_threads == 0) num_threads = 1;
+        }
+        return num_threads;
+    }
+
+    /**
+     * @brief Put a new job on the shared queue and wake a worker
+     */
+    Handle enqueue(const std::shared_ptr<Job>& job) {
+        const Options& options = job->options;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.push_back(job);
+            if (options.timeout.count() > 0) {
+                watched.push_back(job);
+            }
+        }
+        work.notify_one();
+        if (options.timeout.count() > 0) {
+            tick.notify_one();
+        }
+        return Handle(job);
+    }
+
+    /**
+     * @brief Take the next jobs off the shared queue (call with the lock held)
+     *
+     * A large job is taken alone. Small jobs are taken in a run from the
+     * front of the queue, at most MAX_BATCH and at most this worker's share
+     * of them, so the other workers still get some.
+     *
+     * @param batch Output: the jobs to run
+     */
+    void take_batch(std::vector<std::shared_ptr<Job>>& batch) {
+        batch.clear();
+        if (queue.front()->bits > BATCH_MAX_BITS) {
+            batch.push_back(queue.front());
+            queue.pop_front();
+            return;
+        }
+
+        size_t small = 0;
+        while (small < queue.size() && queue[small]->bits <= BATCH_MAX_BITS) {
+            small++;
+        }
+        size_t share = std::min<size_t>(MAX_BATCH, (small + testers.size() - 1) / testers.size());
+        for (size_t i = 0; i < share; ++i) {
+            batch.push_back(queue.front());
+            queue.pop_front();
+        }
+    }
+
+    /**
+     * @brief Wake sleeping workers after tasks were pushed
+     *
+     * Taking the lock orders the push before a sleeper's next check, so no
+     * wake-up is lost.
+     *
+     * @param all True to wake every sleeper, false for one
+     */
+    void wake(bool all) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+        }
+        if (all) {
+            work.notify_all();
+        } else {
+            work.notify_one();
+        }
+    }
+
+    /**
+     * @brief Body of a worker thread
+     *
+     * New jobs come first, so a large job gives its workers back at the next
+     * chunk boundary; then the worker's own deque, newest first; then the
+     * oldest task of another worker.
+     *
+     * @param index The worker's index (its tester and deque)
+     */
+    void worker_loop(size_t index) {
+        std::vector<std::shared_ptr<Job>> batch;
+        std::shared_ptr<Job> job;
+        mpz_t candidate;
+        mpz_init(candidate);
+
+        while (true) {
+            bool more_queued;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                work.wait(lock, [this]() { return stopping || !queue.empty() || deques.size() > 0; });
+                if (stopping) break;
+                batch.clear();
+                if (!queue.empty()) {
+                    take_batch(batch);
+                }
+                more_queued = !queue.empty();
+            }
+
+            // Newest first, so this worker pops the batch in submission order
+            for (auto it = batch.rbegin(); it != batch.rend(); ++it) {
+                deques.push(index, *it);
+            }
+            if (batch.size() > 1 || more_queued) {
+                wake(true);
+            }
+
+            while (deques.pop(index, job) || deques.steal(index, job)) {
+                run(job, index, candidate);
+                job.reset();
+                if (!queue_empty()) break;
+            }
+        }
+
+        mpz_clear(candidate);
+    }
+
+    /**
+     * @brief Check whether the shared queue is empty (or the pool is stopping)
+     */
+    bool queue_empty() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return queue.empty() && !stopping;
+    }
+
+    /**
+     * @brief Run a small search or a test job to the end, or one chunk of a large search
+     *
+     * @param job The job
+     * @param index The worker's index
+     * @param candidate The worker's scratch value for the search result
+     */
+    void run(const std::shared_ptr<Job>& job, size_t index, mpz_t candidate) {
+        if (std::chrono::steady_clock::now() >= job->deadline) {
+            job->expire();
+        }
+        if (!job->activate()) {
+            return;  // Finished while it waited, or a leftover chunk of a finished job
+        }
+        if (job->stop.load(std::memory_order_relaxed)) {
+            job->finish_stopped();
+            return;
+        }
+
+        if (job->count > 0) {
+            testers[index]->is_prime_batch(job->numbers.get(), job->count, job->results.get(),
+                                           job->options.type, job->options.rounds);
+            job->complete_test();
+            return;
+        }
+
+        // The job goes back into the deque before the chunk runs: an idle
+        // worker can steal it and search alongside, and this worker continues
+        // from it when the chunk is done
+        bool chunked = splitting && job->bits > BATCH_MAX_BITS && testers.size() > 1;
+        if (chunked) {
+            deques.push(index, job);
+            wake(false);
+        }
+
+        PrimalityTester* tester = testers[index].get();
+        uint64_t start = tester->candidates_tried();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping) {
+                job->stop.store(true, std::memory_order_relaxed);
+            }
+            running.push_back(Running{job, tester, start});
+        }
+        tick.notify_one();
+
+        bool found;
+        if (chunked) {
+            // Continue a walk that no other chunk is using, or start one
+            std::unique_ptr<PrimalityTester::Walk> walk;
+            {
+                std::lock_guard<std::mutex> lock(job->mutex);
+                if (!job->walks.empty()) {
+                    walk = std::move(job->walks.back());
+                    job->walks.pop_back();
+                }
+            }
+            if (!walk) {
+                walk.reset(new PrimalityTester::Walk(job->bits, job->options.safe));
+            }
+            found = job->options.safe
+                ? tester->generate_safe_prime(candidate, job->options.type, *walk, &job->stop, CHUNK_CANDIDATES)
+                : tester->find_prime(candidate, job->options.type, *walk, &job->stop, CHUNK_CANDIDATES);
+            std::lock_guard<std::mutex> lock(job->mutex);
+            job->walks.push_back(std::move(walk));
+        } else {
+            found = job->options.safe
+                ? tester->generate_safe_prime(candidate, job->bits, job->options.type, &job->stop)
+                : tester->find_prime(candidate, job->bits, job->options.type,
+                                     PrimalityTester::SIEVE_SEARCH, &job->stop);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running.erase(std::find_if(running.begin(), running.end(),
+                                       [tester](const Running& entry) { return entry.tester == tester; }));
+        }
+        job->candidates.fetch_add(tester->candidates_tried() - start, std::memory_order_relaxed);
+
+        if (found) {
+            job->complete(candidate);
+        } else if (job->stop.load(std::memory_order_relaxed)) {
+            job->finish_stopped();
+        }
+    }
+
+    /**
+     * @brief Body of the monitor thread
+     *
+     * Every PROGRESS_INTERVAL_MS while there is anything to watch: expire
+     * jobs whose deadline has passed and report the progress of running
+     * ones. Callbacks are called without the pool lock held, so they may
+     * submit or cancel jobs.
+     */
+    void monitor_loop() {
+        std::vector<std::pair<std::shared_ptr<Job>, uint64_t>> progress;
+        std::vector<std::shared_ptr<Job>> expired;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                if (stopping) return;
+                if (running.empty() && watched.empty()) {
+                    tick.wait(lock);
+                } else {
+                    tick.wait_for(lock, std::chrono::milliseconds(PROGRESS_INTERVAL_MS));
+                }
+                if (stopping) return;
+
+                // Candidates of finished chunks plus those of the chunks running now
+                progress.clear();
+                for (const Running& entry : running) {
+                    uint64_t live = entry.tester->candidates_tried() - entry.start;
+                    auto it = std::find_if(progress.begin(), progress.end(),
+                                           [&entry](const std::pair<std::shared_ptr<Job>, uint64_t>& p) {
+                                               return p.first == entry.job;
+                                           });
+                    if (it == progress.end()) {
+                        progress.emplace_back(entry.job, entry.job->candidates.load(std::memory_order_relaxed));
+                        it = progress.end() - 1;
+                    }
+                    it->second += live;
+                }
+
+                auto now = std::chrono::steady_clock::now();
+                expired.clear();
+                for (auto it = watched.begin(); it != watched.end();) {
+                    const std::shared_ptr<Job>& job = *it;
+                    bool done;
+                    {
+                        std::lock_guard<std::mutex> job_lock(job->mutex);
+                        done = job->done_locked();
+                    }
+                    if (!done && now >= job->deadline) {
+                        job->expire();
+                        expired.push_back(job);
+                        done = true;
+                    }
+                    it = done ? watched.erase(it) : it + 1;
+                }
+            }
+
+            // A job that is still pending finishes now; a running one stops before its next candidate
+            for (const auto& job : expired) {
+                bool pending;
+                {
+                    std::lock_guard<std::mutex> job_lock(job->mutex);
+                    pending = job->status == PENDING;
+                }
+                if (pending) {
+                    job->finish(EXPIRED);
+                }
+            }
+            for (const auto& entry : progress) {
+                entry.first->progress.store(entry.second, std::memory_order_relaxed);
+                if (entry.first->options.on_progress) {
+                    entry.first->options.on_progress(entry.second);
+                }
+            }
+        }
+    }
+};
+
+#endif // PRIME_JOBS_H
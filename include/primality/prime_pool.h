@@ -0,0 +1,330 @@
+#ifndef PRIME_POOL_H
+#define PRIME_POOL_H
+
+#include <gmp.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include "../prng/xoshiro.h"
+#include "../utils/mpmc_ring.h"
+#include "primality_tester.h"
+
+/**
+ * @brief Pool of ready-made random primes, refilled in the background
+ *
+ * The pool keeps a bounded shelf of primes for each configured bit size.
+ * Refill threads, each with its own PrimalityTester, run generate_prime
+ * whenever a shelf has an empty slot, so callers take a prime that already
+ * exists instead of paying the (heavy-tailed) search latency themselves.
+ *
+ * Every shelf preallocates its primes and passes slot indices through two
+ * lock-free rings (MpmcRing): one of slots holding a prime, one of empty slots
+ * waiting for a refill. try_acquire pops a full slot, copies the prime out and
+ * hands the slot back to the refill threads; it never takes a lock and never
+ * waits for a search.
+ *
+ * acquire() searches on the caller's thread after a miss, with a tester
+ * taken from the pool's spare testers, which are seeded from the same
+ * generator as the refill threads and use the same policy.
+ *
+ * A prime is handed out at most once. The counters in stats() record hits,
+ * misses and how fast the refill threads produce primes.
+ */
+class PrimePool {
+public:
+    /**
+     * @brief Pool counters, shared by all threads
+     */
+    struct Stats {
+        std::atomic<uint64_t> hits;       // Acquires served from a shelf
+        std::atomic<uint64_t> misses;     // Acquires that found the shelf empty (or no shelf)
+        std::atomic<uint64_t> refills;    // Primes produced by the refill threads
+        std::atomic<uint64_t> refill_ns;  // Search time spent on those primes
+
+        Stats() : hits(0), misses(0), refills(0), refill_ns(0) {}
+
+        /**
+         * @brief Print the counters in a human-readable form
+         *
+         * @param out Output stream
+         */
+        void print(std::ostream& out) const {
+            uint64_t produced = refills.load();
+            out << "  Pool: hits=" << hits.load()
+                << " misses=" << misses.load()
+                << " refills=" << produced
+                << " mean_refill_ms="
+                << (produced ? refill_ns.load() / 1e6 / produced : 0.0) << std::endl;
+        }
+    };
+
+    /**
+     * @brief Construct a pool and start the refill threads
+     *
+     * @param bit_sizes Bit sizes to keep primes for
+     * @param capacity Primes kept per bit size
+     * @param num_threads Number of refill threads, or 0 to use all hardware threads
+     * @param seed Base seed for the refill threads, or 0 for automatic seeding
+     * @param policy Rounds for the candidates of every search (see PrimalityTester::set_search_policy)
+     */
+    PrimePool(const std::vector<unsigned int>& bit_sizes, size_t capacity = 16,
+              unsigned int num_threads = 1, uint64_t seed = 0,
+              const RoundPolicy& policy = RoundPolicy(RoundPolicy::DEFAULT_ERROR_BITS, RoundPolicy::RANDOM_CANDIDATE))
+        : policy(policy), stopping(false), started(std::chrono::steady_clock::now()) {
+        for (unsigned int bits : bit_sizes) {
+            shelves.emplace_back(new Shelf(bits, capacity));
+        }
+
+        if (num_threads == 0) {
+            num_threads = std::thread::hardware_concurrency();
+            if (num_threads == 0) num_threads = 1;
+        }
+
+        // One non-overlapping generator stream per refill thread seeds its tester;
+        // the stream after them seeds the testers of acquire()
+        std::vector<Xoshiro256pp> streams = Xoshiro256pp(seed).split(num_threads + 1);
+        for (unsigned int i = 0; i < num_threads; ++i) {
+            testers.emplace_back(new PrimalityTester(static_cast<unsigned long>(streams[i].next_u64())));
+            testers.back()->set_search_policy(policy);
+        }
+        spare_seeds.reset(new Xoshiro256pp(streams[num_threads]));
+        for (unsigned int i = 0; i < num_threads; ++i) {
+            refillers.emplace_back(&PrimePool::refill_loop, this, testers[i].get());
+        }
+    }
+
+    /**
+     * @brief Stop the refill threads and release the primes
+     *
+     * Searches in progress are cancelled.
+     */
+    ~PrimePool() {
+        stopping.store(true);
+        {
+            std::lock_guard<std::mutex> lock(wake_mutex);
+        }
+        wake.notify_all();
+        for (auto& t : refillers) {
+            t.join();
+        }
+    }
+
+    PrimePool(const PrimePool&) = delete;
+    PrimePool& operator=(const PrimePool&) = delete;
+
+    /**
+     * @brief Take a prime from the pool if one is ready
+     *
+     * @param result Output parameter for the prime
+     * @param bits Bit length of the prime
+     * @return bool True on a hit; false if no prime of that size was ready
+     */
+    bool try_acquire(mpz_t result, unsigned int bits) {
+        Shelf* shelf = find(bits);
+        size_t slot;
+        if (shelf == nullptr || !shelf->ready.pop(slot)) {
+            counters.misses.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        mpz_set(result, shelf->primes[slot]);
+        shelf->available.fetch_sub(1, std::memory_order_relaxed);
+        shelf->empty.push(slot);
+        wake.notify_one();
+
+        counters.hits.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    /**
+     * @brief Take a prime from the pool, or search for one on a miss
+     *
+     * A miss runs the search on the calling thread, with the same latency as
+     * PrimalityTester::generate_prime. Concurrent misses each get their own
+     * tester; testers are kept for later misses.
+     *
+     * @param result Output parameter for the prime
+     * @param bits Bit length of the prime
+     * @return bool True if the prime came from the pool
+     */
+    bool acquire(mpz_t result, unsigned int bits) {
+        if (try_acquire(result, bits)) {
+            return true;
+        }
+        std::unique_ptr<PrimalityTester> tester;
+        {
+            std::lock_guard<std::mutex> lock(spare_mutex);
+            if (spare.empty()) {
+                tester.reset(new PrimalityTester(static_cast<unsigned long>(spare_seeds->next_u64())));
+                tester->set_search_policy(policy);
+            } else {
+                tester = std::move(spare.back());
+                spare.pop_back();
+            }
+        }
+        tester->generate_prime(result, bits);
+        std::lock_guard<std::mutex> lock(spare_mutex);
+        spare.push_back(std::move(tester));
+        return false;
+    }
+
+    /**
+     * @brief Get the number of primes ready for a bit size
+     *
+     * @param bits Bit length
+     * @return size_t Primes on the shelf (0 if the size is not pooled)
+     */
+    size_t available(unsigned int bits) const {
+        const Shelf* shelf = find(bits);
+        return shelf ? shelf->available.load(std::memory_order_relaxed) : 0;
+    }
+
+    /**
+     * @brief Get the number of primes kept per bit size
+     *
+     * @return size_t Shelf capacity
+     */
+    size_t capacity() const {
+        return shelves.empty() ? 0 : shelves[0]->capacity;
+    }
+
+    /**
+     * @brief Check whether every shelf is full
+     */
+    bool full() const {
+        for (const auto& shelf : shelves) {
+            if (shelf->available.load(std::memory_order_relaxed) < shelf->capacity) return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Get the pool counters
+     */
+    const Stats& stats() const {
+        return counters;
+    }
+
+    /**
+     * @brief Get the refill rate since the pool was created
+     *
+     * @return double Primes produced per second
+     */
+    double refill_rate() const {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - started;
+        return elapsed.count() > 0 ? counters.refills.load() / elapsed.count() : 0.0;
+    }
+
+private:
+    /**
+     * @brief Primes of one bit size and the rings of full and empty slots
+     */
+    struct Shelf {
+        unsigned int bits;
+        size_t capacity;
+        std::unique_ptr<mpz_t[]> primes;
+        MpmcRing<size_t> ready;          // Slots holding a prime
+        MpmcRing<size_t> empty;          // Slots waiting for a refill
+        std::atomic<size_t> available;   // Number of slots in ready
+
+        Shelf(unsigned int bits, size_t capacity)
+            : bits(bits), capacity(capacity), primes(new mpz_t[capacity]),
+              ready(capacity), empty(capacity), available(0) {
+            for (size_t i = 0; i < capacity; ++i) {
+                mpz_init2(primes[i], bits);
+                empty.push(i);
+            }
+        }
+
+        ~Shelf() {
+            for (size_t i = 0; i < capacity; ++i) {
+                mpz_clear(primes[i]);
+            }
+        }
+    };
+
+    std::vector<std::unique_ptr<Shelf>> shelves;
+    RoundPolicy policy;
+    std::vector<std::unique_ptr<PrimalityTester>> testers;  // One per refill thread
+    std::mutex spare_mutex;                                 // Guards spare and spare_seeds
+    std::vector<std::unique_ptr<PrimalityTester>> spare;    // Idle testers for acquire()
+    std::unique_ptr<Xoshiro256pp> spare_seeds;              // Seeds the testers for acquire()
+    std::vector<std::thread> refillers;
+    std::atomic<bool> stopping;
+    std::mutex wake_mutex;               // Only used to sleep on wake
+    std::condition_variable wake;        // Signalled when a slot is emptied
+    Stats counters;
+    std::chrono::steady_clock::time_point started;
+
+    // Longest an idle refill thread sleeps before looking at the shelves again
+    enum { IDLE_POLL_MS = 50 };
+
+    Shelf* find(unsigned int bits) const {
+        for (const auto& shelf : shelves) {
+            if (shelf->bits == bits) return shelf.get();
+        }
+        return nullptr;
+    }
+
+    /**
+     * @brief Body of a refill thread
+     *
+     * Refills the emptiest shelf first. When every shelf is full the thread
+     * sleeps until an acquire empties a slot; the wait is bounded by
+     * IDLE_POLL_MS because acquire signals without taking the mutex.
+     *
+     * @param tester The thread's own primality tester
+     */
+    void refill_loop(PrimalityTester* tester) {
+        std::vector<Shelf*> order;
+        for (const auto& shelf : shelves) {
+            order.push_back(shelf.get());
+        }
+
+        while (!stopping.load()) {
+            std::sort(order.begin(), order.end(), [](const Shelf* a, const Shelf* b) {
+                return a->available.load(std::memory_order_relaxed) < b->available.load(std::memory_order_relaxed);
+            });
+
+            Shelf* target = nullptr;
+            size_t slot = 0;
+            for (Shelf* shelf : order) {
+                if (shelf->empty.pop(slot)) {
+                    target = shelf;
+                    break;
+                }
+            }
+
+            if (target == nullptr) {
+                std::unique_lock<std::mutex> lock(wake_mutex);
+                if (!stopping.load()) {
+                    wake.wait_for(lock, std::chrono::milliseconds(IDLE_POLL_MS));
+                }
+                continue;
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            if (!tester->generate_prime(target->primes[slot], target->bits,
+                                        PrimalityTester::SIEVE_SEARCH, &stopping)) {
+                target->empty.push(slot);  // Cancelled by the destructor
+                break;
+            }
+            auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start);
+
+            target->ready.push(slot);
+            target->available.fetch_add(1, std::memory_order_relaxed);
+            counters.refills.fetch_add(1, std::memory_order_relaxed);
+            counters.refill_ns.fetch_add(elapsed.count(), std::memory_order_relaxed);
+        }
+    }
+};
+
+#endif // PRIME_POOL_H
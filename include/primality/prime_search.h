@@ -0,0 +1,179 @@
+#ifndef PRIME_SEARCH_H
+#define PRIME_SEARCH_H
+
+#include <gmp.h>
+#include <stdint.h>
+#include "../prng/random_bits.h"
+#include "../utils/mpz_utils.h"
+#include "miller_rabin.h"
+#include "baillie_psw.h"
+#include "candidate_sieve.h"
+#include "u64_primality.h"
+#include "workspace.h"
+#include "round_policy.h"
+
+/**
+ * @brief Miller-Rabin as a PrimeSearch test policy
+ *
+ * @tparam Rounds Number of rounds, including the base-2 round
+ */
+template <int Rounds = 40>
+struct MillerRabinTest {
+    static bool test(const mpz_t n, gmp_randstate_t rand_state, PrimalityWorkspace& ws) {
+        return MillerRabin::test(n, Rounds, rand_state, &ws);
+    }
+
+    static bool test(PreparedModulus& pm, gmp_randstate_t rand_state, PrimalityWorkspace& ws) {
+        return MillerRabin::test(pm, Rounds, rand_state, ws);
+    }
+};
+
+/**
+ * @brief Miller-Rabin with as many rounds as an error target needs for random candidates
+ *
+ * The rounds come from RoundPolicy for random candidates, the same default
+ * as PrimalityTester::generate_prime; they are recomputed only when the bit
+ * size changes.
+ *
+ * @tparam ErrorBits Accept a composite with probability at most 2^-ErrorBits
+ */
+template <unsigned int ErrorBits = RoundPolicy::DEFAULT_ERROR_BITS>
+struct AdaptiveMillerRabinTest {
+    static bool test(const mpz_t n, gmp_randstate_t rand_state, PrimalityWorkspace& ws) {
+        return MillerRabin::test(n, rounds(n), rand_state, &ws);
+    }
+
+    static bool test(PreparedModulus& pm, gmp_randstate_t rand_state, PrimalityWorkspace& ws) {
+        return MillerRabin::test(pm, rounds(pm.n), rand_state, ws);
+    }
+
+    static int rounds(const mpz_t n) {
+        static thread_local size_t cached_bits = 0;
+        static thread_local unsigned int cached_rounds = 0;
+        size_t bits = mpz_sizeinbase(n, 2);
+        if (bits != cached_bits) {
+            cached_rounds = RoundPolicy(ErrorBits, RoundPolicy::RANDOM_CANDIDATE).rounds(bits);
+            cached_bits = bits;
+        }
+        return static_cast<int>(cached_rounds);
+    }
+};
+
+/**
+ * @brief Baillie-PSW as a PrimeSearch test policy
+ */
+struct BailliePSWTest {
+    static bool test(const mpz_t n, gmp_randstate_t rand_state, PrimalityWorkspace& ws) {
+        return BailliePSW::test(n, rand_state, &ws);
+    }
+
+    static bool test(PreparedModulus& pm, gmp_randstate_t rand_state, PrimalityWorkspace& ws) {
+        return BailliePSW::test(pm, rand_state, ws);
+    }
+};
+
+/**
+ * @brief Random prime search with the generator and the test bound at compile time
+ *
+ * The same sieved walk as PrimalityTester::generate_prime (a random odd
+ * start, then only the candidates that survive CandidateSieve), but the
+ * start comes from RandomBits<Gen> and every candidate goes to Test::test,
+ * so neither the generator nor the test is reached through a virtual call
+ * or a switch. Numbers below 2^64 take the deterministic native path.
+ *
+ * The Miller-Rabin witnesses are drawn from a GMP random state seeded from
+ * the generator, so a search is reproducible from the generator's seed.
+ *
+ * @tparam Gen Generator type (anything with a uint64_t next_u64())
+ * @tparam Test Test policy with static test(n, rand_state, workspace) and
+ *              test(prepared, rand_state, workspace)
+ */
+template <typename Gen, typename Test>
+class PrimeSearch {
+public:
+    /**
+     * @brief Bind a generator
+     *
+     * @param gen The generator; must outlive this object
+     */
+    explicit PrimeSearch(Gen& gen) : random(gen) {
+        MPZUtils::init_gmp_random(rand_state, static_cast<unsigned long>(gen.next_u64()));
+    }
+
+    PrimeSearch(const PrimeSearch&) = delete;
+    PrimeSearch& operator=(const PrimeSearch&) = delete;
+
+    /**
+     * @brief Destructor
+     */
+    ~PrimeSearch() {
+        MPZUtils::clear_gmp_random(rand_state);
+    }
+
+    /**
+     * @brief Test a number with the bound test
+     *
+     * @param n The number to test
+     * @return bool True if n is (probably) prime
+     */
+    bool is_prime(const mpz_t n) {
+        if (U64Primality::available() && U64Primality::fits(n)) {
+            return U64Primality::is_prime(U64Primality::to_u64(n));
+        }
+        workspace.reserve(mpz_sizeinbase(n, 2));
+        return Test::test(n, rand_state, workspace);
+    }
+
+    /**
+     * @brief Test a prepared number with the bound test
+     *
+     * Gives the same answers as is_prime(pm.n), without redoing the per-n
+     * setup (see PreparedModulus).
+     *
+     * @param pm The prepared number
+     * @return bool True if n is (probably) prime
+     */
+    bool is_prime(PreparedModulus& pm) {
+        if (U64Primality::available() && U64Primality::fits(pm.n)) {
+            return U64Primality::is_prime(U64Primality::to_u64(pm.n));
+        }
+        workspace.reserve(mpz_sizeinbase(pm.n, 2));
+        return Test::test(pm, rand_state, workspace);
+    }
+
+    /**
+     * @brief Find a random prime with exactly the given number of bits
+     *
+     * @param result Output parameter for the prime
+     * @param bits Bit length of the prime
+     */
+    void find(mpz_t result, unsigned int bits) {
+        if (bits <= 1) {
+            mpz_set_ui(result, 2);
+            return;
+        }
+
+        CandidateSieve sieve(bits);
+        while (true) {
+            random(result, static_cast<int>(bits));
+            mpz_setbit(result, 0);
+            sieve.reset(result);
+
+            while (sieve.next(result)) {
+                PRIME_COUNT(CANDIDATES);
+                if (is_prime(result)) {
+                    Screening::count(Screening::stats().sieve_rejects, sieve.sieved_out());
+                    PRIME_COUNT_N(SIEVE_REJECTS, sieve.sieved_out());
+                    return;
+                }
+            }
+        }
+    }
+
+private:
+    RandomBits<Gen> random;
+    gmp_randstate_t rand_state;
+    PrimalityWorkspace workspace;
+};
+
+#endif // PRIME_SEARCH_H
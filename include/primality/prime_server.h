@@ -0,0 +1,425 @@
+#ifndef PRIME_SERVER_H
+#define PRIME_SERVER_H
+
+#include <gmp.h>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "candidate_sieve.h"
+#include "primality_tester.h"
+#include "prime_pool.h"
+#include "round_policy.h"
+#include "safe_prime_sieve.h"
+
+/**
+ * @brief Long-running request loop that keeps the primality state warm
+ *
+ * A fresh `main test` or `main generate` process pays for process start,
+ * the sieve tables, the tester's workspace and RNG before doing any work,
+ * which for small inputs is nearly all of its run time. PrimeServer sets all
+ * of that up once and then answers newline-delimited requests:
+ *
+ *     test <number>              ok prime | ok probable-prime | ok composite
+ *     generate <bits> [safe]     ok <prime in decimal>
+ *     ping                       ok pong
+ *     stats                      ok requests=<n> pool_hits=<n> pool_misses=<n>
+ *     quit                       ok bye, then the connection is closed
+ *
+ * Any other line gets `error <message>`, as does a test or generate above
+ * MAX_BITS bits or a safe generate above MAX_SAFE_BITS; empty lines get no
+ * answer. Numbers in requests are decimal, or hex with 0x. Answers come in
+ * request order, one line each.
+ *
+ * Requests are pipelined: every read takes whatever the client has sent (up
+ * to READ_SIZE bytes), answers all complete lines in it and sends the
+ * answers with one write, so a client that streams many requests without
+ * waiting pays one system call pair per batch rather than per request.
+ *
+ * serve_fd() runs the loop on a pair of file descriptors (stdin/stdout) until
+ * end of input. serve_socket() listens on a Unix socket and serves any number
+ * of clients from one thread with poll(); a client that stops reading its
+ * answers is not read from until it catches up. Requests run on the serving
+ * thread, so a long generate delays the other clients; pool() moves prime
+ * searches for the pooled sizes to background threads.
+ */
+class PrimeServer {
+public:
+    // Bytes taken from a client per read
+    enum { READ_SIZE = 1 << 16 };
+
+    // Longest request line; a longer one is answered with an error and dropped
+    enum { MAX_LINE = 1 << 20 };
+
+    // Pending answer bytes above which a client is not read from
+    enum { MAX_PENDING = 1 << 20 };
+
+    /**
+     * @brief Set up the warm state
+     *
+     * @param type Test for test requests and prime searches
+     * @param auto_algo Let the policies choose the test per bit size instead
+     * @param search_policy Rounds for the candidates of generate
+     * @param test_policy Rounds for numbers given to test
+     */
+    PrimeServer(PrimalityTester::TestType type, bool auto_algo,
+                const RoundPolicy& search_policy, const RoundPolicy& test_policy)
+        : type(type), auto_algo(auto_algo), test_policy(test_policy), requests(0) {
+        tester.set_search_policy(search_policy);
+        mpz_init(number);
+
+        // Build the static sieve tables now rather than on the first request
+        CandidateSieve::odd_primes();
+        SafePrimeSieve::odd_primes();
+    }
+
+    /**
+     * @brief Destructor
+     */
+    ~PrimeServer() {
+        mpz_clear(number);
+    }
+
+    PrimeServer(const PrimeServer&) = delete;
+    PrimeServer& operator=(const PrimeServer&) = delete;
+
+    /**
+     * @brief Keep ready-made primes for some bit sizes
+     *
+     * generate requests for these sizes (not safe primes) take a prime from a
+     * PrimePool refilled by background threads and only search on a miss.
+     * Pooled primes are searched with the server's search policy.
+     *
+     * @param bit_sizes Bit sizes to pool
+     * @param capacity Primes kept per bit size
+     * @param threads Refill threads, or 0 for all hardware threads
+     */
+    void pool(const std::vector<unsigned int>& bit_sizes, size_t capacity, unsigned int threads) {
+        primes.reset(new PrimePool(bit_sizes, capacity, threads, 0, tester.get_search_policy()));
+    }
+
+    /**
+     * @brief Answer one request line
+     *
+     * @param line The request, without the newline
+     * @param out Output buffer; the answer and a newline are appended
+     * @return bool False if the client asked to quit
+     */
+    bool handle(const std::string& line, std::string& out) {
+        split(line, words);
+        if (words.empty()) return true;
+        requests++;
+
+        const std::string& command = words[0];
+        if (command == "test" && words.size() == 2) {
+            if (mpz_set_str(number, words[1].c_str(), 0) != 0) {
+                out += "error invalid number\n";
+                return true;
+            }
+            if (mpz_sizeinbase(number, 2) > MAX_BITS) {
+                out += "error number too large\n";
+                return true;
+            }
+            RoundPolicy::Choice choice = test_policy.choose(mpz_sizeinbase(number, 2));
+            PrimalityTester::TestType test_type =
+                auto_algo ? (choice.bpsw ? PrimalityTester::BAILLIE_PSW : PrimalityTester::MILLER_RABIN) : type;
+            if (!tester.is_prime(number, test_type, choice.rounds)) {
+                out += "ok composite\n";
+            } else if (PrimalityTester::is_proven(number)) {
+                out += "ok prime\n";
+            } else {
+                out += "ok probable-prime\n";
+            }
+        } else if (command == "generate" && (words.size() == 2 || (words.size() == 3 && words[2] == "safe"))) {
+            unsigned long bits = std::strtoul(words[1].c_str(), nullptr, 10);
+            bool safe = words.size() == 3;
+            if (bits < (safe ? 3u : 2u) || bits > (safe ? MAX_SAFE_BITS : MAX_BITS)) {
+                out += "error invalid bit size\n";
+                return true;
+            }
+            generate(static_cast<unsigned int>(bits), safe);
+            out += "ok ";
+            append_decimal(number, out);
+            out += '\n';
+        } else if (command == "ping" && words.size() == 1) {
+            out += "ok pong\n";
+        } else if (command == "stats" && words.size() == 1) {
+            out += "ok requests=" + std::to_string(requests);
+            if (primes) {
+                out += " pool_hits=" + std::to_string(primes->stats().hits.load()) +
+                       " pool_misses=" + std::to_string(primes->stats().misses.load());
+            }
+            out += '\n';
+        } else if (command == "quit" && words.size() == 1) {
+            out += "ok bye\n";
+            return false;
+        } else {
+            out += "error unknown request\n";
+        }
+        return true;
+    }
+
+    /**
+     * @brief Serve requests from one file descriptor until end of input
+     *
+     * @param in Descriptor to read requests from
+     * @param out Descriptor to write answers to
+     * @return bool False if reading or writing failed
+     */
+    bool serve_fd(int in, int out) {
+        Client client(in);
+        std::vector<char> chunk(READ_SIZE);
+        while (true) {
+            ssize_t got = ::read(in, chunk.data(), chunk.size());
+            if (got < 0 && errno == EINTR) continue;
+            if (got < 0) return false;
+
+            bool open = got > 0 && consume(client, chunk.data(), static_cast<size_t>(got));
+            if (got == 0 && !client.input.empty()) {
+                handle(client.input, client.output);  // Last line without a newline
+                client.input.clear();
+            }
+            if (!write_all(out, client.output)) return false;
+            client.output.clear();
+            if (!open) return true;
+        }
+    }
+
+    /**
+     * @brief Listen on a Unix socket and serve clients until stop is set
+     *
+     * A stale socket file at path is replaced; the socket file is removed
+     * again on return. stop is checked at least every POLL_MS milliseconds.
+     *
+     * @param path Filesystem path of the socket
+     * @param stop Flag that ends the loop
+     * @return bool False if the socket could not be set up
+     */
+    bool serve_socket(const std::string& path, const std::atomic<bool>& stop) {
+        sockaddr_un address;
+        std::memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+            errno = ENAMETOOLONG;
+            return false;
+        }
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+        struct stat existing;
+        if (::stat(path.c_str(), &existing) == 0 && S_ISSOCK(existing.st_mode)) {
+            ::unlink(path.c_str());
+        }
+
+        int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listener < 0) return false;
+        if (::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+            ::listen(listener, SOMAXCONN) != 0) {
+            int error = errno;
+            ::close(listener);
+            errno = error;
+            return false;
+        }
+
+        std::vector<std::unique_ptr<Client>> clients;
+        std::vector<pollfd> fds;
+        std::vector<char> chunk(READ_SIZE);
+        while (!stop.load()) {
+            fds.clear();
+            fds.push_back(pollfd{listener, POLLIN, 0});
+            for (const auto& client : clients) {
+                short events = 0;
+                if (client->open && client->output.size() < MAX_PENDING) events |= POLLIN;
+                if (!client->output.empty()) events |= POLLOUT;
+                fds.push_back(pollfd{client->fd, events, 0});
+            }
+
+            if (::poll(fds.data(), fds.size(), POLL_MS) <= 0) continue;
+
+            if (fds[0].revents & POLLIN) {
+                int fd = ::accept(listener, nullptr, nullptr);
+                if (fd >= 0) {
+                    ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+                    clients.emplace_back(new Client(fd));
+                }
+            }
+
+            for (size_t i = 0; i < clients.size(); ++i) {
+                Client& client = *clients[i];
+                short revents = fds[i + 1].revents;
+                if (revents & (POLLIN | POLLHUP | POLLERR)) {
+                    ssize_t got = ::read(client.fd, chunk.data(), chunk.size());
+                    if (got > 0) {
+                        client.open = consume(client, chunk.data(), static_cast<size_t>(got));
+                    } else if (got == 0 || (errno != EAGAIN && errno != EINTR)) {
+                        client.open = false;
+                        client.failed = got < 0;
+                    }
+                }
+                if (!client.output.empty() && !client.failed) {
+                    ssize_t sent = ::send(client.fd, client.output.data(), client.output.size(), MSG_NOSIGNAL);
+                    if (sent > 0) {
+                        client.output.erase(0, static_cast<size_t>(sent));
+                    } else if (sent < 0 && errno != EAGAIN && errno != EINTR) {
+                        client.failed = true;
+                    }
+                }
+            }
+
+            // Drop clients that are done and have nothing left to send
+            size_t kept = 0;
+            for (size_t i = 0; i < clients.size(); ++i) {
+                if (clients[i]->failed || (!clients[i]->open && clients[i]->output.empty())) {
+                    ::close(clients[i]->fd);
+                } else {
+                    clients[kept++] = std::move(clients[i]);
+                }
+            }
+            clients.resize(kept);
+        }
+
+        for (const auto& client : clients) {
+            ::close(client->fd);
+        }
+        ::close(listener);
+        ::unlink(path.c_str());
+        return true;
+    }
+
+private:
+    /**
+     * @brief Input and pending answers of one connection
+     */
+    struct Client {
+        int fd;
+        std::string input;   // Start of a request line that has not ended yet
+        std::string output;  // Answers not yet sent
+        bool open;           // Still reading requests
+        bool failed;         // The connection broke; pending answers are dropped
+
+        explicit Client(int fd) : fd(fd), open(true), failed(false) {}
+    };
+
+    // Largest bit size for generate and for numbers given to test. Requests run
+    // on the serving thread, so the caps keep each one to about a second or two
+    // here (64 adversarial rounds at 4096 bits, or a 1536-bit safe prime search)
+    enum { MAX_BITS = 4096, MAX_SAFE_BITS = 1536 };
+
+    // Longest poll() wait, so that serve_socket notices stop
+    enum { POLL_MS = 200 };
+
+    PrimalityTester tester;           // Workspace, RNG and search policy reused by every request
+    PrimalityTester::TestType type;
+    bool auto_algo;
+    RoundPolicy test_policy;
+    std::unique_ptr<PrimePool> primes;  // Ready-made primes, if pool() was called
+    mpz_t number;                     // Operand and result of the current request
+    std::string line;                 // Current request line
+    std::vector<std::string> words;   // Words of the current request
+    uint64_t requests;
+
+    /**
+     * @brief Answer every complete line in a chunk of input
+     *
+     * @param client The connection the chunk came from
+     * @param data The chunk
+     * @param size Bytes in the chunk
+     * @return bool False if a request asked to quit; the rest of the chunk is ignored
+     */
+    bool consume(Client& client, const char* data, size_t size) {
+        const char* end = data + size;
+        while (data < end) {
+            const char* newline = static_cast<const char*>(std::memchr(data, '\n', end - data));
+            if (newline == nullptr) {
+                client.input.append(data, end);
+                if (client.input.size() > MAX_LINE) {
+                    client.output += "error request too long\n";
+                    return false;
+                }
+                return true;
+            }
+
+            const std::string* request;
+            if (client.input.empty()) {
+                line.assign(data, newline);
+                request = &line;
+            } else {
+                client.input.append(data, newline);
+                request = &client.input;
+            }
+            bool more = handle(*request, client.output);
+            client.input.clear();
+            data = newline + 1;
+            if (!more) return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Find a prime for a generate request into number
+     *
+     * @param bits Bit length
+     * @param safe True for a safe prime
+     */
+    void generate(unsigned int bits, bool safe) {
+        RoundPolicy::Choice choice = tester.get_search_policy().choose(safe ? bits - 1 : bits);
+        PrimalityTester::TestType search_type =
+            auto_algo ? (choice.bpsw ? PrimalityTester::BAILLIE_PSW : PrimalityTester::MILLER_RABIN) : type;
+        if (safe) {
+            tester.generate_safe_prime(number, bits, search_type);
+        } else if (!primes || !primes->try_acquire(number, bits)) {
+            tester.find_prime(number, bits, search_type);
+        }
+    }
+
+    /**
+     * @brief Split a line into words at spaces and tabs (a trailing CR is dropped)
+     */
+    static void split(const std::string& text, std::vector<std::string>& words) {
+        words.clear();
+        size_t i = 0;
+        size_t end = text.size();
+        if (end > 0 && text[end - 1] == '\r') end--;
+        while (i < end) {
+            while (i < end && (text[i] == ' ' || text[i] == '\t')) i++;
+            size_t start = i;
+            while (i < end && text[i] != ' ' && text[i] != '\t') i++;
+            if (i > start) words.emplace_back(text, start, i - start);
+        }
+    }
+
+    /**
+     * @brief Append n in decimal to a string
+     */
+    static void append_decimal(const mpz_t n, std::string& out) {
+        size_t offset = out.size();
+        out.resize(offset + mpz_sizeinbase(n, 10) + 2);
+        mpz_get_str(&out[offset], 10, n);
+        out.resize(offset + std::strlen(&out[offset]));
+    }
+
+    /**
+     * @brief Write a whole buffer to a descriptor
+     */
+    static bool write_all(int fd, const std::string& data) {
+        size_t done = 0;
+        while (done < data.size()) {
+            ssize_t wrote = ::write(fd, data.data() + done, data.size() - done);
+            if (wrote < 0 && errno == EINTR) continue;
+            if (wrote <= 0) return false;
+            done += static_cast<size_t>(wrote);
+        }
+        return true;
+    }
+};
+
+#endif // PRIME_SERVER_H
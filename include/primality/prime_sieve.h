@@ -0,0 +1,506 @@
+#ifndef PRIME_SIEVE_H
+#define PRIME_SIEVE_H
+
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "u64_primality.h"
+
+/**
+ * @brief Segmented sieve of Eratosthenes over 64-bit intervals
+ *
+ * Only odd numbers are stored, one bit each: bit g stands for 2g + 1. The
+ * interval is sieved one segment at a time, sized to stay in the L1 cache
+ * (or in L2 when the sieving primes are larger than an L1 segment, so that
+ * each of them still hits most segments). Each segment starts as a copy of
+ * a precomputed wheel pattern with the multiples of 3, 5, 7, 11 and 13
+ * already removed, so only the primes from 17 up are crossed off: about
+ * four fifths of the odd numbers never need to be touched.
+ *
+ * Sieving primes go up to sqrt(hi), but no further than MAX_SIEVING_PRIME.
+ * Above MAX_SIEVING_PRIME^2 (2^48) a survivor then has no factor below
+ * 2^24, which removes all but a few percent of the composites, and is
+ * confirmed with the deterministic U64Primality test. That keeps the
+ * sieving primes at 1.1 million (8.6 MB of offsets per thread) even for
+ * intervals just below 2^64.
+ *
+ * Ranges can be split over threads: the interval is cut into chunks of
+ * SEGMENTS_PER_CHUNK segments, which the threads claim in turn, and
+ * enumerated primes are handed to the caller in increasing order.
+ *
+ * References:
+ * - Crandall, R., & Pomerance, C. (2005). Prime Numbers: A Computational Perspective, Section 3.2.
+ * - Walisch, K. primesieve: https://github.com/kimwalisch/primesieve (segment sizing and pre-sieving)
+ */
+namespace PrimeSieve {
+    // Segment sizes in bytes of sieve bits (16 odd numbers per byte)
+    const size_t L1_SEGMENT_BYTES = 32 * 1024;
+    const size_t L2_SEGMENT_BYTES = 256 * 1024;
+
+    // Largest sieving prime; beyond MAX_SIEVING_PRIME^2 survivors are confirmed individually
+    const uint64_t MAX_SIEVING_PRIME = 1ULL << 24;
+
+    // Segments per unit of work handed to a thread
+    const size_t SEGMENTS_PER_CHUNK = 16;
+
+    // Primes removed by the wheel pattern; the pattern repeats every 3*5*7*11*13 odd numbers
+    const uint32_t WHEEL_PRIMES[] = {3, 5, 7, 11, 13};
+    const uint64_t WHEEL_PERIOD = 3 * 5 * 7 * 11 * 13;
+
+    // First prime the segments are sieved with
+    const uint32_t FIRST_SIEVING_PRIME = 17;
+
+    /**
+     * @brief Get the wheel pattern: bit g is set if 2g + 1 has no factor among WHEEL_PRIMES
+     *
+     * WHEEL_PERIOD is odd, so the pattern repeats every WHEEL_PERIOD 64-bit
+     * words and word w of any segment is word w mod WHEEL_PERIOD of it.
+     *
+     * @return const std::vector<uint64_t>& WHEEL_PERIOD words, built on first use
+     */
+    const std::vector<uint64_t>& wheel_pattern() {
+        struct Pattern {
+            std::vector<uint64_t> words;
+            Pattern() : words(WHEEL_PERIOD, ~0ULL) {
+                // 2g + 1 = 0 (mod p)  <=>  g = (p - 1)/2 (mod p)
+                for (uint32_t p : WHEEL_PRIMES) {
+                    for (uint64_t g = (p - 1) / 2; g < 64 * WHEEL_PERIOD; g += p) {
+                        words[g >> 6] &= ~(1ULL << (g & 63));
+                    }
+                }
+            }
+        };
+        static const Pattern pattern;
+        return pattern.words;
+    }
+
+    /**
+     * @brief Integer square root
+     *
+     * @param n Any 64-bit number
+     * @return uint64_t floor(sqrt(n))
+     */
+    uint64_t isqrt(uint64_t n) {
+        uint64_t r = static_cast<uint64_t>(std::sqrt(static_cast<double>(n)));
+        if (r > 0xFFFFFFFFULL) r = 0xFFFFFFFFULL;
+        while (r > 0 && r * r > n) --r;
+        while (r < 0xFFFFFFFFULL && (r + 1) * (r + 1) <= n) ++r;
+        return r;
+    }
+
+    /**
+     * @brief Plain sieve of Eratosthenes for the sieving primes of the sieving primes
+     *
+     * @param limit Upper bound (at most 2^16)
+     * @return std::vector<uint32_t> The primes in [FIRST_SIEVING_PRIME, limit]
+     */
+    std::vector<uint32_t> base_primes(uint32_t limit) {
+        std::vector<uint32_t> primes;
+        std::vector<uint8_t> composite(limit + 1, 0);
+        for (uint32_t i = 3; i <= limit; i += 2) {
+            if (composite[i]) continue;
+            if (i >= FIRST_SIEVING_PRIME) primes.push_back(i);
+            for (uint32_t j = i * i; j <= limit; j += 2 * i) {
+                composite[j] = 1;
+            }
+        }
+        return primes;
+    }
+
+    /**
+     * @brief One thread's walk over consecutive segments
+     *
+     * Keeps, for every sieving prime, the bit index of its next odd multiple,
+     * so moving to the next segment costs no division.
+     */
+    class SegmentWalker {
+    public:
+        /**
+         * @brief Start a walk
+         *
+         * @param primes Sieving primes, all at least FIRST_SIEVING_PRIME
+         * @param start Bit index of the first segment (a multiple of 64)
+         * @param words 64-bit words per segment
+         */
+        SegmentWalker(const std::vector<uint32_t>& primes, uint64_t start, size_t words)
+            : primes(primes), start(start), bits(words), next(primes.size()) {
+            for (size_t i = 0; i < primes.size(); ++i) {
+                uint64_t p = primes[i];
+                // 2g + 1 = 0 (mod p)  <=>  g = (p - 1)/2 (mod p); p^2 is the first multiple to strike
+                uint64_t target = (p - 1) / 2;
+                uint64_t g = start + (target + p - start % p) % p;
+                next[i] = std::max(g, (p * p - 1) / 2);
+            }
+        }
+
+        /**
+         * @brief Sieve the next segment
+         *
+         * @return uint64_t Bit index of bit 0 of the segment
+         */
+        uint64_t sieve() {
+            const std::vector<uint64_t>& pattern = wheel_pattern();
+            size_t index = static_cast<size_t>((start / 64) % WHEEL_PERIOD);
+            for (size_t w = 0; w < bits.size(); ++w) {
+                bits[w] = pattern[index];
+                if (++index == WHEEL_PERIOD) index = 0;
+            }
+
+            uint64_t length = 64 * static_cast<uint64_t>(bits.size());
+            uint64_t* data = bits.data();
+            for (size_t i = 0; i < primes.size(); ++i) {
+                uint64_t j = next[i] - start;
+                if (j >= length) continue;
+                uint64_t p = primes[i];
+                for (; j < length; j += p) {
+                    data[j >> 6] &= ~(1ULL << (j & 63));
+                }
+                next[i] = start + j;
+            }
+
+            uint64_t first = start;
+            start += length;
+            return first;
+        }
+
+        /**
+         * @brief Get the bits of the last sieved segment
+         */
+        const std::vector<uint64_t>& segment() const {
+            return bits;
+        }
+
+    private:
+        const std::vector<uint32_t>& primes;
+        uint64_t start;                 // Bit index of the next segment
+        std::vector<uint64_t> bits;     // Bit g - start is set if 2g + 1 survived
+        std::vector<uint64_t> next;     // Bit index of the next odd multiple of primes[i]
+    };
+
+    /**
+     * @brief Everything needed to sieve one interval
+     */
+    struct Plan {
+        bool empty;                     // No odd number above 13 in the interval
+        uint64_t low_bit;               // First bit inside the interval
+        uint64_t high_bit;              // Last bit inside the interval
+        uint64_t first_bit;             // Bit 0 of the first segment (low_bit rounded down to 64)
+        size_t words;                   // 64-bit words per segment
+        uint64_t segments;              // Number of segments
+        bool confirm;                   // Survivors above confirm_above need U64Primality
+        uint64_t confirm_above;
+        std::vector<uint32_t> primes;   // Sieving primes
+
+        uint64_t chunks() const {
+            return (segments + SEGMENTS_PER_CHUNK - 1) / SEGMENTS_PER_CHUNK;
+        }
+    };
+
+    template <typename F>
+    void for_each_prime(uint64_t lo, uint64_t hi, F f, unsigned int threads = 1);
+
+    /**
+     * @brief Work out the sieving primes and segment layout for [lo, hi]
+     *
+     * @param lo Lower bound (inclusive)
+     * @param hi Upper bound (inclusive)
+     * @return Plan The plan; odd numbers up to 13 are left to the caller
+     */
+    Plan make_plan(uint64_t lo, uint64_t hi) {
+        Plan plan;
+        lo = std::max<uint64_t>(lo, FIRST_SIEVING_PRIME);
+        uint64_t odd_lo = lo | 1;
+        uint64_t odd_hi = (hi % 2 == 1) ? hi : hi - 1;
+        plan.empty = hi < FIRST_SIEVING_PRIME || odd_lo < lo || odd_lo > odd_hi;
+        plan.low_bit = (odd_lo - 1) / 2;
+        plan.high_bit = plan.empty ? 0 : (odd_hi - 1) / 2;
+        plan.first_bit = plan.low_bit / 64 * 64;
+
+        uint64_t root = isqrt(hi);
+        uint64_t limit = std::min(root, MAX_SIEVING_PRIME);
+        plan.confirm = root > MAX_SIEVING_PRIME;
+        plan.confirm_above = MAX_SIEVING_PRIME * MAX_SIEVING_PRIME;
+        if (!plan.empty && limit >= FIRST_SIEVING_PRIME) {
+            if (limit <= 65536) {
+                plan.primes = base_primes(static_cast<uint32_t>(limit));
+            } else {
+                for_each_prime(FIRST_SIEVING_PRIME, limit, [&](uint64_t p) {
+                    plan.primes.push_back(static_cast<uint32_t>(p));
+                });
+            }
+        }
+
+        // An L1 segment holds 2^18 bits (2^19 numbers); larger primes would skip most of them
+        uint64_t largest = plan.primes.empty() ? 0 : plan.primes.back();
+        plan.words = ((largest > 8 * L1_SEGMENT_BYTES) ? L2_SEGMENT_BYTES : L1_SEGMENT_BYTES) / 8;
+
+        uint64_t span = plan.empty ? 0 : plan.high_bit - plan.first_bit + 1;
+        uint64_t length = 64 * static_cast<uint64_t>(plan.words);
+        if (span <= length) {
+            // A short interval needs no more than one segment, rounded up to whole words
+            plan.words = static_cast<size_t>((span + 63) / 64);
+            plan.segments = plan.empty ? 0 : 1;
+        } else {
+            plan.segments = (span + length - 1) / length;
+        }
+        return plan;
+    }
+
+    /**
+     * @brief Clear the bits of a segment word that lie outside the interval
+     *
+     * @param plan The interval
+     * @param word The word
+     * @param base Bit index of bit 0 of the word
+     * @return uint64_t The word with only the bits inside [low_bit, high_bit] left
+     */
+    uint64_t clip_word(const Plan& plan, uint64_t word, uint64_t base) {
+        if (base + 63 < plan.low_bit || base > plan.high_bit) return 0;
+        if (base < plan.low_bit) word &= ~0ULL << (plan.low_bit - base);
+        if (plan.high_bit - base < 63) word &= ~0ULL >> (63 - (plan.high_bit - base));
+        return word;
+    }
+
+    /**
+     * @brief Call f(n) for every prime n of a sieved segment inside the interval
+     *
+     * @param plan The interval
+     * @param bits The segment
+     * @param first Bit index of bit 0 of the segment
+     * @param f Called with each prime, in increasing order
+     */
+    template <typename F>
+    void scan_segment(const Plan& plan, const std::vector<uint64_t>& bits, uint64_t first, F& f) {
+        for (size_t w = 0; w < bits.size(); ++w) {
+            uint64_t base = first + 64 * w;
+            if (base > plan.high_bit) break;
+            uint64_t word = clip_word(plan, bits[w], base);
+
+            while (word) {
+                uint64_t n = 2 * (base + __builtin_ctzll(word)) + 1;
+                word &= word - 1;
+                if (plan.confirm && n > plan.confirm_above && !U64Primality::is_prime(n)) continue;
+                f(n);
+            }
+        }
+    }
+
+    /**
+     * @brief Count the primes of a sieved segment inside the interval
+     *
+     * Without survivors to confirm this is one popcount per word.
+     *
+     * @param plan The interval
+     * @param bits The segment
+     * @param first Bit index of bit 0 of the segment
+     * @return uint64_t Number of primes
+     */
+    uint64_t count_segment(const Plan& plan, const std::vector<uint64_t>& bits, uint64_t first) {
+        uint64_t count = 0;
+        if (plan.confirm) {
+            auto tally = [&](uint64_t) { count++; };
+            scan_segment(plan, bits, first, tally);
+            return count;
+        }
+        for (size_t w = 0; w < bits.size(); ++w) {
+            count += __builtin_popcountll(clip_word(plan, bits[w], first + 64 * w));
+        }
+        return count;
+    }
+
+    /**
+     * @brief Sieve one chunk of the interval
+     *
+     * @param plan The interval
+     * @param chunk Chunk number
+     * @param visit Called as visit(bits, first) for each sieved segment of the chunk
+     */
+    template <typename F>
+    void sieve_chunk(const Plan& plan, uint64_t chunk, F visit) {
+        uint64_t length = 64 * static_cast<uint64_t>(plan.words);
+        uint64_t first = chunk * SEGMENTS_PER_CHUNK;
+        uint64_t last = std::min<uint64_t>(plan.segments, first + SEGMENTS_PER_CHUNK);
+        SegmentWalker walker(plan.primes, plan.first_bit + first * length, plan.words);
+        for (uint64_t s = first; s < last; ++s) {
+            uint64_t start = walker.sieve();
+            visit(walker.segment(), start);
+        }
+    }
+
+    /**
+     * @brief Resolve a thread count of 0 to the number of hardware threads
+     */
+    unsigned int thread_count(unsigned int threads) {
+        if (threads == 0) threads = std::thread::hardware_concurrency();
+        return threads == 0 ? 1 : threads;
+    }
+
+    /**
+     * @brief Call f(p) for every prime p in [lo, hi], in increasing order
+     *
+     * With more than one thread the chunks are sieved concurrently, at most
+     * a few per thread ahead of the caller, and f still runs on the calling
+     * thread in order.
+     *
+     * @param lo Lower bound (inclusive)
+     * @param hi Upper bound (inclusive, up to 2^64 - 1)
+     * @param f Called with each prime as a uint64_t
+     * @param threads Sieving threads (0 for one per hardware thread)
+     */
+    template <typename F>
+    void for_each_prime(uint64_t lo, uint64_t hi, F f, unsigned int threads) {
+        if (lo > hi) return;
+        if (lo <= 2 && hi >= 2) f(static_cast<uint64_t>(2));
+        for (uint32_t p : WHEEL_PRIMES) {
+            if (lo <= p && p <= hi) f(static_cast<uint64_t>(p));
+        }
+
+        Plan plan = make_plan(lo, hi);
+        if (plan.empty) return;
+        uint64_t chunks = plan.chunks();
+        threads = thread_count(threads);
+
+        if (threads == 1 || chunks == 1) {
+            SegmentWalker walker(plan.primes, plan.first_bit, plan.words);
+            for (uint64_t s = 0; s < plan.segments; ++s) {
+                uint64_t start = walker.sieve();
+                scan_segment(plan, walker.segment(), start, f);
+            }
+            return;
+        }
+
+        // Workers sieve chunks into buffers; the caller hands them to f in order
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::map<uint64_t, std::vector<uint64_t>> done;
+        uint64_t claimed = 0, delivered = 0;
+        const uint64_t ahead = 2 * static_cast<uint64_t>(threads);
+
+        auto worker = [&]() {
+            while (true) {
+                uint64_t chunk;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    changed.wait(lock, [&]() { return claimed >= chunks || claimed < delivered + ahead; });
+                    if (claimed >= chunks) return;
+                    chunk = claimed++;
+                }
+                std::vector<uint64_t> found;
+                auto collect = [&](uint64_t p) { found.push_back(p); };
+                sieve_chunk(plan, chunk, [&](const std::vector<uint64_t>& bits, uint64_t first) {
+                    scan_segment(plan, bits, first, collect);
+                });
+
+                std::lock_guard<std::mutex> lock(mutex);
+                done[chunk].swap(found);
+                changed.notify_all();
+            }
+        };
+
+        std::vector<std::thread> pool;
+        for (unsigned int t = 0; t < threads; ++t) {
+            pool.emplace_back(worker);
+        }
+        for (uint64_t chunk = 0; chunk < chunks; ++chunk) {
+            std::vector<uint64_t> found;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&]() { return done.count(chunk) > 0; });
+                found.swap(done[chunk]);
+                done.erase(chunk);
+                delivered = chunk + 1;
+                changed.notify_all();
+            }
+            for (uint64_t p : found) {
+                f(p);
+            }
+        }
+        for (std::thread& thread : pool) {
+            thread.join();
+        }
+    }
+
+    /**
+     * @brief Count the primes in [lo, hi]
+     *
+     * @param lo Lower bound (inclusive)
+     * @param hi Upper bound (inclusive, up to 2^64 - 1)
+     * @param threads Sieving threads (0 for one per hardware thread)
+     * @return uint64_t Number of primes
+     */
+    uint64_t count_primes(uint64_t lo, uint64_t hi, unsigned int threads = 1) {
+        if (lo > hi) return 0;
+        uint64_t small = (lo <= 2 && hi >= 2) ? 1 : 0;
+        for (uint32_t p : WHEEL_PRIMES) {
+            if (lo <= p && p <= hi) small++;
+        }
+
+        Plan plan = make_plan(lo, hi);
+        if (plan.empty) return small;
+        uint64_t chunks = plan.chunks();
+        threads = static_cast<unsigned int>(std::min<uint64_t>(thread_count(threads), chunks));
+
+        std::atomic<uint64_t> next(0);
+        std::atomic<uint64_t> total(small);
+        auto worker = [&]() {
+            uint64_t count = 0;
+            for (uint64_t chunk = next++; chunk < chunks; chunk = next++) {
+                sieve_chunk(plan, chunk, [&](const std::vector<uint64_t>& bits, uint64_t first) {
+                    count += count_segment(plan, bits, first);
+                });
+            }
+            total += count;
+        };
+
+        std::vector<std::thread> pool;
+        for (unsigned int t = 1; t < threads; ++t) {
+            pool.emplace_back(worker);
+        }
+        worker();
+        for (std::thread& thread : pool) {
+            thread.join();
+        }
+        return total;
+    }
+
+    /**
+     * @brief Get every prime below a bound
+     *
+     * @param limit Exclusive upper bound
+     * @return std::vector<uint32_t> The primes, starting with 2
+     */
+    std::vector<uint32_t> primes_below(uint32_t limit) {
+        std::vector<uint32_t> primes;
+        if (limit <= 2) return primes;
+        for_each_prime(0, limit - 1, [&](uint64_t p) { primes.push_back(static_cast<uint32_t>(p)); });
+        return primes;
+    }
+
+    /**
+     * @brief Get the first count odd primes
+     *
+     * @param count Number of primes
+     * @return std::vector<uint32_t> Odd primes 3, 5, 7, ...
+     */
+    std::vector<uint32_t> first_odd_primes(size_t count) {
+        // The n-th prime is below n*(ln n + ln ln n) for n >= 6
+        double n = static_cast<double>(count + 1 < 6 ? 6 : count + 1);
+        uint64_t limit = static_cast<uint64_t>(n * (std::log(n) + std::log(std::log(n)))) + 1;
+
+        std::vector<uint32_t> primes;
+        primes.reserve(count);
+        for_each_prime(3, limit, [&](uint64_t p) {
+            if (primes.size() < count) primes.push_back(static_cast<uint32_t>(p));
+        });
+        return primes;
+    }
+};
+
+#endif // PRIME_SIEVE_H
@@ -0,0 +1,186 @@
+#ifndef ROUND_POLICY_H
+#define ROUND_POLICY_H
+
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+
+/**
+ * @brief Choice of primality test and Miller-Rabin round count for an error target
+ *
+ * How many rounds are needed depends on where the number comes from:
+ *
+ * - ADVERSARIAL (a number supplied from outside): only the worst-case bound
+ *   holds, a composite passes a random-base round with probability at most
+ *   1/4, so an error of 2^-e needs ceil(e/2) rounds. choose() uses
+ *   Baillie-PSW instead, which has no known counterexample and costs about
+ *   three rounds.
+ * - RANDOM_CANDIDATE (a random odd number from a prime search): the
+ *   Damgard-Landrock-Pomerance bounds on p(k,t), the probability that a
+ *   random odd k-bit number passing t rounds is composite, fall steeply
+ *   with k. These are the bounds behind FIPS 186-5 Appendix B.3 and
+ *   HAC Table 4.4: 2^-80 takes 27 rounds at 100 bits, 3 at 1024 bits and 2
+ *   at 2048 bits. The sieved search walks up from a random start instead of
+ *   drawing every candidate afresh, for which Brandt and Damgard give bounds
+ *   of the same order.
+ *
+ * The bounds assume random bases. The first round of MillerRabin::test
+ * always uses base 2, so that round is added on top of the bound. The
+ * result is never more than the worst-case count.
+ */
+class RoundPolicy {
+public:
+    /**
+     * @brief Where the numbers to test come from
+     */
+    enum Origin {
+        RANDOM_CANDIDATE,   // Random odd numbers drawn by a prime search
+        ADVERSARIAL         // Anything else, possibly chosen to fool the test
+    };
+
+    /**
+     * @brief The test to run
+     */
+    struct Choice {
+        bool bpsw;              // Baillie-PSW rather than Miller-Rabin
+        unsigned int rounds;    // Miller-Rabin rounds, including the base-2 round
+    };
+
+    // Default error target: a composite is accepted with probability at most 2^-128
+    static const unsigned int DEFAULT_ERROR_BITS = 128;
+
+    /**
+     * @brief Construct a policy
+     *
+     * @param error_bits Accept a composite with probability at most 2^-error_bits
+     * @param origin Where the numbers come from
+     */
+    explicit RoundPolicy(unsigned int error_bits = DEFAULT_ERROR_BITS, Origin origin = ADVERSARIAL)
+        : error_bits(error_bits), origin(origin), fixed(0) {}
+
+    /**
+     * @brief Policy that always runs the same number of Miller-Rabin rounds
+     *
+     * @param rounds Rounds, including the base-2 round
+     * @return RoundPolicy The policy
+     */
+    static RoundPolicy fixed_rounds(unsigned int rounds) {
+        RoundPolicy policy(0, ADVERSARIAL);
+        policy.fixed = std::max(rounds, 1u);
+        return policy;
+    }
+
+    /**
+     * @brief Get the Miller-Rabin rounds that meet the error target for bits-bit numbers
+     *
+     * @param bits Bit length of the numbers
+     * @return unsigned int Rounds, including the base-2 round
+     */
+    unsigned int rounds(size_t bits) const {
+        if (fixed > 0) return fixed;
+        unsigned int worst = worst_case_rounds(error_bits);
+        if (origin == ADVERSARIAL) return worst;
+        return std::min(worst, random_candidate_rounds(bits, error_bits) + 1);
+    }
+
+    /**
+     * @brief Choose the cheaper test that meets the error target
+     *
+     * Random candidates use Miller-Rabin with rounds(bits). Adversarial
+     * numbers use Baillie-PSW when Miller-Rabin would need more rounds than
+     * it costs; a fixed-round policy always uses Miller-Rabin.
+     *
+     * @param bits Bit length of the numbers
+     * @return Choice The test
+     */
+    Choice choose(size_t bits) const {
+        Choice choice;
+        choice.rounds = rounds(bits);
+        choice.bpsw = fixed == 0 && origin == ADVERSARIAL && choice.rounds > BPSW_COST_ROUNDS;
+        return choice;
+    }
+
+    /**
+     * @brief Get the error target
+     *
+     * @return unsigned int e for an error of at most 2^-e (0 for a fixed-round policy)
+     */
+    unsigned int error_target() const {
+        return fixed > 0 ? 0 : error_bits;
+    }
+
+    /**
+     * @brief Get the origin the policy assumes
+     */
+    Origin assumed_origin() const {
+        return origin;
+    }
+
+    /**
+     * @brief Rounds for an error of 2^-error_bits on any input (1/4 per round)
+     */
+    static unsigned int worst_case_rounds(unsigned int error_bits) {
+        return std::max(1u, (error_bits + 1) / 2);
+    }
+
+    /**
+     * @brief Random-base rounds for an error of 2^-error_bits on random odd bits-bit numbers
+     *
+     * The smallest t for which one of the Damgard-Landrock-Pomerance bounds
+     * on p(k,t) is at most 2^-error_bits.
+     *
+     * @param bits Bit length k of the numbers
+     * @param error_bits Error target
+     * @return unsigned int Rounds (the worst-case count where no bound applies)
+     */
+    static unsigned int random_candidate_rounds(size_t bits, unsigned int error_bits) {
+        unsigned int worst = worst_case_rounds(error_bits);
+        for (unsigned int t = 1; t < worst; ++t) {
+            if (log2_dlp_bound(static_cast<double>(bits), t) <= -static_cast<double>(error_bits)) {
+                return t;
+            }
+        }
+        return worst;
+    }
+
+private:
+    // Baillie-PSW (a base-2 round and a strong Lucas test) costs about this many rounds
+    static const unsigned int BPSW_COST_ROUNDS = 3;
+
+    unsigned int error_bits;
+    Origin origin;
+    unsigned int fixed;     // Rounds of a fixed-round policy, 0 otherwise
+
+    /**
+     * @brief log2 of the best Damgard-Landrock-Pomerance bound on p(k,t) (0 if none applies)
+     */
+    static double log2_dlp_bound(double k, unsigned int t) {
+        double best = 0.0;
+        double lk = std::log2(k);
+        if (t == 1 && k >= 2) {
+            // p(k,1) < k^2 4^(2 - sqrt(k))
+            best = std::min(best, 2 * lk + 2 * (2 - std::sqrt(k)));
+        }
+        if (k < 21) return best;
+        if ((t == 2 && k >= 88) || (t >= 3 && t <= k / 9)) {
+            // p(k,t) < k^(3/2) 2^t t^(-1/2) 4^(2 - sqrt(tk))
+            best = std::min(best, 1.5 * lk + t - 0.5 * std::log2(static_cast<double>(t)) +
+                                  2 * (2 - std::sqrt(t * k)));
+        }
+        if (t >= k / 9 && t <= k / 4) {
+            // p(k,t) < 7/20 k 2^(-5t) + 1/7 k^(15/4) 2^(-k/2-2t) + 12 k 2^(-k/4-3t)
+            double a = std::log2(0.35 * k) - 5.0 * t;
+            double b = 3.75 * lk - std::log2(7.0) - k / 2 - 2.0 * t;
+            double c = std::log2(12 * k) - k / 4 - 3.0 * t;
+            double m = std::max(a, std::max(b, c));
+            best = std::min(best, m + std::log2(std::exp2(a - m) + std::exp2(b - m) + std::exp2(c - m)));
+        }
+        if (t >= k / 4) {
+            // p(k,t) < 1/7 k^(15/4) 2^(-k/2-2t)
+            best = std::min(best, 3.75 * lk - std::log2(7.0) - k / 2 - 2.0 * t);
+        }
+        return best;
+    }
+};
+
+#endif // ROUND_POLICY_H
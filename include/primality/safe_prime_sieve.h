@@ -0,0 +1,177 @@
+#ifndef SAFE_PRIME_SIEVE_H
+#define SAFE_PRIME_SIEVE_H
+
+#include <gmp.h>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include "candidate_sieve.h"
+
+/**
+ * @brief Combined sieve over candidates q for safe primes p = 2q + 1
+ *
+ * Works like CandidateSieve, walking q, q+2, q+4, ... from a random odd
+ * start, but one pass over the residues q mod r strikes out every q for
+ * which either q or 2q + 1 has the small factor r: q = 0 (mod r) or
+ * q = (r - 1)/2 (mod r). Both numbers have to be prime, so a survivor of
+ * both sieves is far rarer than a plain prime candidate and the sieve uses
+ * many more primes and a wider window than CandidateSieve: about 0.5% of
+ * the odd q survive 2^16 sieving primes, against about 8% of the
+ * candidates of a prime search with the same table.
+ *
+ * References:
+ * - Wiener, M. J. (2003). Safe Prime Generation with a Combined Sieve. IACR ePrint 2003/186.
+ */
+class SafePrimeSieve {
+public:
+    // Largest number of odd primes used for sieving
+    enum { DEFAULT_NUM_PRIMES = 65536 };
+
+    // Largest number of candidates (odd offsets) per window
+    enum { DEFAULT_WINDOW = 65536 };
+
+    /**
+     * @brief Get the table of the first DEFAULT_NUM_PRIMES odd primes
+     *
+     * @return const std::vector<uint32_t>& Odd primes 3, 5, 7, ...
+     */
+    static const std::vector<uint32_t>& odd_primes() {
+        static const std::vector<uint32_t> table = CandidateSieve::build_odd_primes(DEFAULT_NUM_PRIMES);
+        return table;
+    }
+
+    /**
+     * @brief Construct a sieve for safe primes of the given bit length
+     *
+     * The candidates q have bits - 1 bits. Primes that are not smaller than
+     * 2^(bits-2) are dropped from the table, so neither q nor 2q + 1 can be
+     * struck out for being equal to a sieving prime. By default the prime
+     * count scales with the bit length (16*bits primes) and the window with
+     * the prime count.
+     *
+     * @param bits Bit length of the safe primes (at least 3)
+     * @param window Number of odd candidates per window, or 0 to scale with bits
+     * @param num_primes Number of odd primes to sieve with, or 0 to scale with bits
+     */
+    SafePrimeSieve(unsigned int bits, size_t window = 0, size_t num_primes = 0)
+        : bits(bits), window(window), position(0), sieved(0) {
+        if (num_primes == 0) {
+            num_primes = std::min<size_t>(std::max<size_t>(16 * bits, 64), DEFAULT_NUM_PRIMES);
+        }
+        if (this->window == 0) {
+            this->window = std::min<size_t>(std::max<size_t>(num_primes, 256), DEFAULT_WINDOW);
+        }
+
+        const std::vector<uint32_t>& table = odd_primes();
+        for (size_t i = 0; i < num_primes && i < table.size(); ++i) {
+            if (bits <= 34 && table[i] >= (1UL << (bits - 2))) break;
+            primes.push_back(table[i]);
+        }
+        residues.resize(primes.size());
+        marks.resize(this->window);
+        mpz_init(base);
+    }
+
+    /**
+     * @brief Destructor
+     */
+    ~SafePrimeSieve() {
+        mpz_clear(base);
+    }
+
+    SafePrimeSieve(const SafePrimeSieve&) = delete;
+    SafePrimeSieve& operator=(const SafePrimeSieve&) = delete;
+
+    /**
+     * @brief Start a new search from the given odd q
+     *
+     * @param start First candidate q (must be odd, with bits - 1 bits)
+     */
+    void reset(const mpz_t start) {
+        mpz_set(base, start);
+        for (size_t i = 0; i < primes.size(); ++i) {
+            residues[i] = static_cast<uint32_t>(mpz_fdiv_ui(base, primes[i]));
+        }
+        sieve_window();
+    }
+
+    /**
+     * @brief Get the next q for which neither q nor 2q + 1 has a small factor
+     *
+     * @param q Output parameter for the candidate
+     * @return bool False once q would exceed bits - 1 bits; the caller
+     *         should then reset() with a fresh start
+     */
+    bool next(mpz_t q) {
+        while (true) {
+            while (position < window) {
+                size_t offset = position++;
+                if (marks[offset]) {
+                    sieved++;
+                    continue;
+                }
+
+                mpz_add_ui(q, base, 2 * offset);
+                return mpz_sizeinbase(q, 2) < bits;
+            }
+            advance_window();
+        }
+    }
+
+    /**
+     * @brief Get the number of struck-out candidates skipped by next() so far
+     *
+     * @return uint64_t Number of sieved-out candidates
+     */
+    uint64_t sieved_out() const {
+        return sieved;
+    }
+
+private:
+    unsigned int bits;
+    size_t window;
+    size_t position;               // Next offset to hand out in the current window
+    uint64_t sieved;               // Candidates rejected by the sieve
+    mpz_t base;                    // Candidate q at offset 0 of the current window
+    std::vector<uint32_t> primes;  // Odd sieving primes
+    std::vector<uint32_t> residues;// base mod primes[i]
+    std::vector<uint8_t> marks;    // marks[i] != 0 if base + 2i or 2(base + 2i) + 1 has a small factor
+
+    /**
+     * @brief Mark every offset whose q or 2q + 1 a sieving prime divides
+     */
+    void sieve_window() {
+        std::fill(marks.begin(), marks.end(), 0);
+        for (size_t i = 0; i < primes.size(); ++i) {
+            uint64_t p = primes[i];
+            uint64_t half = (p + 1) / 2;  // 2^-1 (mod p)
+            uint64_t r = residues[i];
+            // q = base + 2j = 0 (mod p)  <=>  j = -r * 2^-1 (mod p)
+            uint64_t first = (p - r) % p * half % p;
+            // 2q + 1 = 0 (mod p)  <=>  q = (p - 1)/2 (mod p)  <=>  j = ((p - 1)/2 - r) * 2^-1 (mod p)
+            uint64_t second = ((p - 1) / 2 + p - r) % p * half % p;
+            for (uint64_t j = first; j < window; j += p) {
+                marks[j] = 1;
+            }
+            for (uint64_t j = second; j < window; j += p) {
+                marks[j] = 1;
+            }
+        }
+        position = 0;
+    }
+
+    /**
+     * @brief Move to the next window, updating the residues incrementally
+     */
+    void advance_window() {
+        uint64_t step = 2 * static_cast<uint64_t>(window);
+        mpz_add_ui(base, base, step);
+        for (size_t i = 0; i < primes.size(); ++i) {
+            residues[i] = static_cast<uint32_t>((residues[i] + step) % primes[i]);
+        }
+        sieve_window();
+    }
+};
+
+#endif // SAFE_PRIME_SIEVE_H
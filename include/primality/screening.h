@@ -0,0 +1,395 @@
+#ifndef SCREENING_H
+#define SCREENING_H
+
+#include <gmp.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "candidate_sieve.h"
+#include "workspace.h"
+#include "prepared_modulus.h"
+#include "../utils/instrument.h"
+
+/**
+ * @brief Shared early-abort screening pipeline for the primality tests
+ *
+ * Both Miller-Rabin and Baillie-PSW run the same cheap stages before their
+ * expensive part:
+ * 1. Trial division, done as a single gcd against the product of the odd
+ *    primes below TRIAL_DIVISION_LIMIT
+ * 2. A base-2 strong probable prime test
+ *
+ * Only candidates that survive both stages go on to the remaining random
+ * Miller-Rabin rounds or to the strong Lucas test. Every stage updates the
+ * process-wide counters in stats(), so the benchmarks can show where
+ * composites are filtered out and how much modular exponentiation was avoided.
+ */
+namespace Screening {
+    // Trial division covers all odd primes below this bound
+    const unsigned long TRIAL_DIVISION_LIMIT = 1024;
+
+    // Moduli of at least this many limbs run the base-2 round in Montgomery form
+    const size_t MONTGOMERY_BASE2_LIMBS = 12;
+
+    /**
+     * @brief Outcome of a screening stage
+     */
+    enum Verdict {
+        COMPOSITE,   // Definitely composite
+        PRIME,       // Definitely prime (n is one of the trial division primes)
+        PROBABLE     // Passed the stage, needs further testing
+    };
+
+    /**
+     * @brief Per-stage counters, shared by all threads
+     */
+    struct Stats {
+        std::atomic<uint64_t> candidates;        // Numbers that entered the pipeline
+        std::atomic<uint64_t> sieve_rejects;     // Candidates struck out by the search sieve
+        std::atomic<uint64_t> trial_rejects;     // Rejected by the trial division gcd
+        std::atomic<uint64_t> base2_rejects;     // Rejected by the base-2 strong test
+        std::atomic<uint64_t> round_rejects;     // Rejected by a further Miller-Rabin round
+        std::atomic<uint64_t> lucas_rejects;     // Rejected by the strong Lucas test
+        std::atomic<uint64_t> accepted;          // Declared (probably) prime
+        std::atomic<uint64_t> modexps;           // Modular exponentiations performed
+        std::atomic<uint64_t> modexps_avoided;   // Exponentiations skipped thanks to trial division
+
+        Stats() {
+            reset();
+        }
+
+        /**
+         * @brief Zero all counters
+         */
+        void reset() {
+            candidates = 0;
+            sieve_rejects = 0;
+            trial_rejects = 0;
+            base2_rejects = 0;
+            round_rejects = 0;
+            lucas_rejects = 0;
+            accepted = 0;
+            modexps = 0;
+            modexps_avoided = 0;
+        }
+
+        /**
+         * @brief Print the counters in a human-readable form
+         *
+         * @param out Output stream
+         */
+        void print(std::ostream& out) const {
+            out << "  Screening: candidates=" << candidates.load()
+                << " sieve=" << sieve_rejects.load()
+                << " trial=" << trial_rejects.load()
+                << " base2=" << base2_rejects.load()
+                << " rounds=" << round_rejects.load()
+                << " lucas=" << lucas_rejects.load()
+                << " accepted=" << accepted.load()
+                << " modexps=" << modexps.load()
+                << " avoided=" << modexps_avoided.load() << std::endl;
+        }
+
+        /**
+         * @brief Get the CSV column names matching csv_row()
+         *
+         * @return const char* Comma-separated column names
+         */
+        static const char* csv_header() {
+            return "Candidates,SieveRejects,TrialRejects,Base2Rejects,RoundRejects,"
+                   "LucasRejects,Accepted,ModExps,ModExpsAvoided";
+        }
+
+        /**
+         * @brief Format the counters as a CSV row
+         *
+         * @return std::string Comma-separated counter values
+         */
+        std::string csv_row() const {
+            std::ostringstream row;
+            row << candidates.load() << "," << sieve_rejects.load() << ","
+                << trial_rejects.load() << "," << base2_rejects.load() << ","
+                << round_rejects.load() << "," << lucas_rejects.load() << ","
+                << accepted.load() << "," << modexps.load() << ","
+                << modexps_avoided.load();
+            return row.str();
+        }
+    };
+
+    /**
+     * @brief Get the process-wide screening counters
+     *
+     * @return Stats& The counters
+     */
+    Stats& stats() {
+        static Stats instance;
+        return instance;
+    }
+
+    /**
+     * @brief Add to a counter without ordering constraints
+     *
+     * @param counter The counter
+     * @param amount Amount to add
+     */
+    inline void count(std::atomic<uint64_t>& counter, uint64_t amount = 1) {
+        counter.fetch_add(amount, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Get the product of the odd primes below TRIAL_DIVISION_LIMIT
+     *
+     * @return const mpz_t& The primorial, computed on first use
+     */
+    const mpz_t& trial_primorial() {
+        struct Primorial {
+            mpz_t value;
+            Primorial() {
+                mpz_init_set_ui(value, 1);
+                for (uint32_t p : CandidateSieve::odd_primes()) {
+                    if (p >= TRIAL_DIVISION_LIMIT) break;
+                    mpz_mul_ui(value, value, p);
+                }
+            }
+            ~Primorial() {
+                mpz_clear(value);
+            }
+        };
+        static Primorial primorial;
+        return primorial.value;
+    }
+
+    /**
+     * @brief Trial division stage: one gcd against the primorial
+     *
+     * @param n Odd number greater than 2
+     * @param g Scratch value for the gcd
+     * @return Verdict COMPOSITE if n has a small odd factor, PRIME if n is
+     *         itself a small prime, PROBABLE otherwise
+     */
+    Verdict trial_division(const mpz_t n, mpz_t g) {
+        mpz_gcd(g, n, trial_primorial());
+
+        if (mpz_cmp_ui(g, 1) == 0) {
+            return PROBABLE;
+        }
+
+        // n shares a factor with the primorial; it is prime only if it is one of the primes
+        if (mpz_cmp_ui(n, TRIAL_DIVISION_LIMIT) < 0) {
+            const std::vector<uint32_t>& primes = CandidateSieve::odd_primes();
+            if (std::binary_search(primes.begin(), primes.end(), static_cast<uint32_t>(mpz_get_ui(n)))) {
+                return PRIME;
+            }
+        }
+        return COMPOSITE;
+    }
+
+    /**
+     * @brief Write n - 1 = 2^s * d with d odd
+     *
+     * @param d Output parameter for the odd part
+     * @param n_minus_1 The value n - 1
+     * @return unsigned long The exponent s
+     */
+    unsigned long decompose(mpz_t d, const mpz_t n_minus_1) {
+        // s is the index of the lowest set bit; one shift removes all of them
+        unsigned long s = mpz_scan1(n_minus_1, 0);
+        mpz_tdiv_q_2exp(d, n_minus_1, s);
+        return s;
+    }
+
+    /**
+     * @brief One strong probable prime round for the witness a
+     *
+     * @param x Scratch value (holds a^(d*2^r) mod n on return)
+     * @param a Witness in [2, n-2]
+     * @param d Odd part of n - 1
+     * @param s Exponent of 2 in n - 1
+     * @param n Odd modulus
+     * @param n_minus_1 The value n - 1
+     * @return bool True if n is a strong probable prime to base a
+     */
+    bool strong_round(mpz_t x, const mpz_t a, const mpz_t d, unsigned long s,
+                      const mpz_t n, const mpz_t n_minus_1) {
+        count(stats().modexps);
+        PRIME_COUNT(POWM_CALLS);
+        PRIME_COUNT_N(POWM_EXP_BITS, mpz_sizeinbase(d, 2));
+
+        // Calculate x = a^d mod n
+        mpz_powm(x, a, d, n);
+
+        // If x == 1 or x == n-1, this round passes
+        if (mpz_cmp_ui(x, 1) == 0 || mpz_cmp(x, n_minus_1) == 0) {
+            return true;
+        }
+
+        // Check remaining iterations of squaring (one product and one reduction each, not an exponentiation)
+        for (unsigned long r = 1; r < s; ++r) {
+            mpz_mul(x, x, x);
+            mpz_mod(x, x, n);
+            PRIME_COUNT(MOD_SQRS);
+
+            // If x == 1, we found a non-trivial sqrt of 1 => composite
+            if (mpz_cmp_ui(x, 1) == 0) {
+                return false;
+            }
+
+            // If x == n-1, this round passes
+            if (mpz_cmp(x, n_minus_1) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @brief Strong probable prime round for the witness 2, in Montgomery form
+     *
+     * Multiplying by 2 is a modular doubling, so the exponentiation is one
+     * Montgomery squaring per bit of d (see ModContext::pow_base2).
+     *
+     * @param mod Montgomery context for n
+     * @param x Scratch residue of mod.limbs() limbs
+     * @param d Odd part of n - 1
+     * @param s Exponent of 2 in n - 1
+     * @return bool True if n is a strong probable prime to base 2
+     */
+    bool strong_round_base2(ModContext& mod, mp_limb_t* x, const mpz_t d, unsigned long s) {
+        count(stats().modexps);
+
+        mod.pow_base2(x, d);
+
+        if (mod.equal(x, mod.one()) || mod.equal(x, mod.minus_one())) {
+            return true;
+        }
+        for (unsigned long r = 1; r < s; ++r) {
+            mod.sqr(x, x);
+            if (mod.equal(x, mod.one())) return false;
+            if (mod.equal(x, mod.minus_one())) return true;
+        }
+        return false;
+    }
+
+    /**
+     * @brief Pipeline stage 1: trial division, with counters
+     *
+     * @param n Odd number greater than 3
+     * @param ws Workspace holding the scratch values
+     * @return Verdict The trial division outcome
+     */
+    Verdict trial_stage(const mpz_t n, PrimalityWorkspace& ws) {
+        PRIME_TIME(T_TRIAL);
+        Stats& st = stats();
+        count(st.candidates);
+        PRIME_COUNT(TESTED);
+
+        Verdict verdict = trial_division(n, ws.g);
+        if (verdict == COMPOSITE) {
+            count(st.trial_rejects);
+            count(st.modexps_avoided);  // The base-2 exponentiation is never run
+            PRIME_COUNT(TRIAL_REJECTS);
+        } else if (verdict == PRIME) {
+            count(st.accepted);
+            PRIME_COUNT(ACCEPTED);
+        }
+        return verdict;
+    }
+
+    /**
+     * @brief Pipeline stage 2 on a Montgomery context that is already set up for n
+     *
+     * @param n Odd number greater than 3
+     * @param n_minus_1 The value n - 1
+     * @param d Odd part of n - 1
+     * @param s Exponent of 2 in n - 1
+     * @param mod Montgomery context for n (only used from MONTGOMERY_BASE2_LIMBS limbs up)
+     * @param ws Workspace holding the scratch values
+     * @return bool True if n is a strong probable prime to base 2
+     */
+    bool base2_stage(const mpz_t n, const mpz_t n_minus_1, const mpz_t d, unsigned long s,
+                     ModContext& mod, PrimalityWorkspace& ws) {
+        PRIME_TIME(T_BASE2);
+        bool passed;
+        if (mpz_size(n) >= MONTGOMERY_BASE2_LIMBS) {
+            ws.mont_x.resize(std::max(ws.mont_x.size(), mod.limbs()));
+            passed = strong_round_base2(mod, ws.mont_x.data(), d, s);
+        } else {
+            mpz_set_ui(ws.base, 2);
+            passed = strong_round(ws.x, ws.base, d, s, n, n_minus_1);
+        }
+
+        if (!passed) {
+            count(stats().base2_rejects);
+            PRIME_COUNT(BASE2_REJECTS);
+        }
+        return passed;
+    }
+
+    /**
+     * @brief Pipeline stage 2: base-2 strong round, with counters
+     *
+     * From MONTGOMERY_BASE2_LIMBS limbs up, the round runs on ws.mod, which
+     * is set up for n here; below that, mpz_powm is faster.
+     *
+     * @param n Odd number greater than 3
+     * @param n_minus_1 The value n - 1
+     * @param d Odd part of n - 1
+     * @param s Exponent of 2 in n - 1
+     * @param ws Workspace holding the scratch values
+     * @return bool True if n is a strong probable prime to base 2
+     */
+    bool base2_stage(const mpz_t n, const mpz_t n_minus_1, const mpz_t d, unsigned long s,
+                     PrimalityWorkspace& ws) {
+        if (mpz_size(n) >= MONTGOMERY_BASE2_LIMBS) {
+            ws.mod.set_modulus(n);
+        }
+        return base2_stage(n, n_minus_1, d, s, ws.mod, ws);
+    }
+
+    /**
+     * @brief Run trial division and the base-2 strong test on n
+     *
+     * On a PROBABLE verdict, ws.n_minus_1, ws.d and the returned s
+     * describe n so the caller can run further rounds without recomputing them.
+     *
+     * @param n Odd number greater than 3
+     * @param ws Workspace holding the scratch values
+     * @param s Output parameter for the exponent of 2 in n - 1
+     * @return Verdict The screening outcome
+     */
+    Verdict screen(const mpz_t n, PrimalityWorkspace& ws, unsigned long& s) {
+        Verdict verdict = trial_stage(n, ws);
+        if (verdict != PROBABLE) {
+            return verdict;
+        }
+
+        mpz_sub_ui(ws.n_minus_1, n, 1);
+        s = decompose(ws.d, ws.n_minus_1);
+
+        return base2_stage(n, ws.n_minus_1, ws.d, s, ws) ? PROBABLE : COMPOSITE;
+    }
+
+    /**
+     * @brief Run trial division and the base-2 strong test on a prepared n
+     *
+     * Same stages and counters as screen(n, ws, s), but n - 1 = 2^s * d and
+     * the Montgomery context come from the preparation.
+     *
+     * @param pm Prepared odd number greater than 3
+     * @param ws Workspace holding the scratch values
+     * @return Verdict The screening outcome
+     */
+    Verdict screen(PreparedModulus& pm, PrimalityWorkspace& ws) {
+        Verdict verdict = trial_stage(pm.n, ws);
+        if (verdict != PROBABLE) {
+            return verdict;
+        }
+        return base2_stage(pm.n, pm.n_minus_1, pm.d, pm.s, pm.mod, ws) ? PROBABLE : COMPOSITE;
+    }
+};
+
+#endif // SCREENING_H
@@ -0,0 +1,84 @@
+#ifndef SMALL_PRIMES_H
+#define SMALL_PRIMES_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Tables of the first primes, built by the compiler
+ *
+ * SmallPrimes::first<N>() is a constexpr function, so a table declared
+ * constexpr is computed at compile time and lives in read-only data: no
+ * hand-typed arrays and no start-up cost. It uses trial division by the
+ * primes already found, which is plenty for the few hundred primes a
+ * compile-time table holds; larger tables come from PrimeSieve at run time.
+ */
+namespace SmallPrimes {
+    /**
+     * @brief The first N primes, in increasing order
+     *
+     * @tparam N Number of primes
+     */
+    template <size_t N>
+    struct Table {
+        uint32_t values[N];
+
+        constexpr uint32_t operator[](size_t i) const { return values[i]; }
+        constexpr size_t size() const { return N; }
+        constexpr const uint32_t* begin() const { return values; }
+        constexpr const uint32_t* end() const { return values + N; }
+
+        /**
+         * @brief Check whether n is one of the primes in the table
+         *
+         * @param n Number to look up
+         * @return bool True if n is in the table (binary search)
+         */
+        constexpr bool contains(uint64_t n) const {
+            size_t low = 0, high = N;
+            while (low < high) {
+                size_t mid = low + (high - low) / 2;
+                if (values[mid] == n) return true;
+                if (values[mid] < n) {
+                    low = mid + 1;
+                } else {
+                    high = mid;
+                }
+            }
+            return false;
+        }
+    };
+
+    /**
+     * @brief Build the table of the first N primes
+     *
+     * @tparam N Number of primes
+     * @tparam Odd True to start at 3 instead of 2
+     * @return Table<N> The primes
+     */
+    template <size_t N, bool Odd = false>
+    constexpr Table<N> first() {
+        Table<N> table{};
+        size_t count = 0;
+        if (!Odd && N > 0) {
+            table.values[count++] = 2;
+        }
+        for (uint32_t n = 3; count < N; n += 2) {
+            bool prime = true;
+            for (size_t i = Odd ? 0 : 1; i < count; ++i) {
+                uint32_t p = table.values[i];
+                if (p * p > n) break;
+                if (n % p == 0) {
+                    prime = false;
+                    break;
+                }
+            }
+            if (prime) {
+                table.values[count++] = n;
+            }
+        }
+        return table;
+    }
+};
+
+#endif // SMALL_PRIMES_H
@@ -0,0 +1,195 @@
+#ifndef U64_PRIMALITY_H
+#define U64_PRIMALITY_H
+
+#include <gmp.h>
+#include <stdint.h>
+#include "small_primes.h"
+
+/**
+ * @brief Deterministic primality test for numbers below 2^64
+ *
+ * Numbers that fit in one machine word are tested with native 64-bit
+ * arithmetic: Montgomery multiplication over unsigned __int128 and a strong
+ * probable prime test to each of the seven bases found by Jim Sinclair, which
+ * has no pseudoprimes below 2^64. The answer is therefore proven, and no GMP
+ * temporaries are allocated.
+ *
+ * The fast path needs a 128-bit integer type; on targets without one
+ * (e.g. 32-bit RISC-V) available() returns false and callers fall back to GMP.
+ *
+ * References:
+ * - Montgomery, P. L. (1985). Modular multiplication without trial division.
+ *   Mathematics of Computation, 44(170), 519-521.
+ * - Forisek, M., & Jancina, J. (2015). Fast Primality Testing for Integers That Fit into a Machine Word.
+ * - Deterministic bases for n < 2^64: https://miller-rabin.appspot.com/
+ */
+namespace U64Primality {
+#ifdef __SIZEOF_INT128__
+    typedef unsigned __int128 uint128_t;
+
+    /**
+     * @brief Montgomery arithmetic modulo an odd 64-bit n, with R = 2^64
+     */
+    struct Montgomery {
+        uint64_t n;      // Odd modulus
+        uint64_t n_inv;  // n^-1 mod 2^64
+        uint64_t r2;     // R^2 mod n
+
+        explicit Montgomery(uint64_t modulus) : n(modulus) {
+            // Newton iteration: each step doubles the number of correct low bits
+            uint64_t inv = n;  // Correct to 3 bits for odd n
+            for (int i = 0; i < 5; ++i) {
+                inv *= 2 - n * inv;
+            }
+            n_inv = inv;
+
+            uint128_t r = (static_cast<uint128_t>(1) << 64) % n;
+            r2 = static_cast<uint64_t>((r * r) % n);
+        }
+
+        /**
+         * @brief Montgomery reduction: t * R^-1 mod n, for t < n * R
+         */
+        uint64_t reduce(uint128_t t) const {
+            uint64_t m = static_cast<uint64_t>(t) * n_inv;
+            uint64_t t_hi = static_cast<uint64_t>(t >> 64);
+            uint64_t mn_hi = static_cast<uint64_t>((static_cast<uint128_t>(m) * n) >> 64);
+            // t - m*n is divisible by R, and its high word is t_hi - mn_hi
+            return (t_hi >= mn_hi) ? t_hi - mn_hi : t_hi - mn_hi + n;
+        }
+
+        uint64_t mul(uint64_t a, uint64_t b) const {
+            return reduce(static_cast<uint128_t>(a) * b);
+        }
+
+        uint64_t to_mont(uint64_t a) const {
+            return mul(a % n, r2);
+        }
+
+        uint64_t one() const {
+            return to_mont(1);
+        }
+    };
+
+    /**
+     * @brief Strong probable prime test to base a, in Montgomery form
+     *
+     * @param mont Montgomery context for n
+     * @param a Witness (reduced mod n, non-zero)
+     * @param d Odd part of n - 1
+     * @param s Exponent of 2 in n - 1
+     * @param one Montgomery form of 1
+     * @param minus_one Montgomery form of n - 1
+     * @return bool True if n is a strong probable prime to base a
+     */
+    bool strong_round(const Montgomery& mont, uint64_t a, uint64_t d, unsigned int s,
+                      uint64_t one, uint64_t minus_one) {
+        uint64_t base = mont.to_mont(a);
+        uint64_t x = one;
+
+        // x = a^d by left-to-right binary exponentiation
+        for (int bit = 63 - __builtin_clzll(d); bit >= 0; --bit) {
+            x = mont.mul(x, x);
+            if ((d >> bit) & 1) {
+                x = mont.mul(x, base);
+            }
+        }
+
+        if (x == one || x == minus_one) {
+            return true;
+        }
+        for (unsigned int r = 1; r < s; ++r) {
+            x = mont.mul(x, x);
+            if (x == minus_one) return true;
+            if (x == one) return false;
+        }
+        return false;
+    }
+
+    /**
+     * @brief Check whether the native path is compiled in
+     *
+     * @return bool True if 64-bit inputs can be tested without GMP
+     */
+    bool available() {
+        return true;
+    }
+
+    /**
+     * @brief Deterministically test a 64-bit number for primality
+     *
+     * @param n Number to test
+     * @return bool True if n is prime (proven), false otherwise
+     */
+    bool is_prime(uint64_t n) {
+        if (n < 2) return false;
+
+        // Trial division by the primes below 64 settles all n < 64^2
+        static constexpr SmallPrimes::Table<18> small_primes = SmallPrimes::first<18>();
+        static_assert(small_primes[17] == 61, "the table must hold the primes below 64");
+        for (uint32_t p : small_primes) {
+            if (n == p) return true;
+            if (n % p == 0) return false;
+        }
+        if (n < 64 * 64) return true;
+
+        uint64_t d = n - 1;
+        unsigned int s = __builtin_ctzll(d);
+        d >>= s;
+
+        Montgomery mont(n);
+        uint64_t one = mont.one();
+        uint64_t minus_one = n - one;  // Montgomery form of n - 1 is n - R mod n
+
+        static const uint64_t bases[] = {2, 325, 9375, 28178, 450775, 9780504, 1795265022};
+        for (uint64_t base : bases) {
+            uint64_t a = base % n;
+            if (a == 0) continue;  // Base is a multiple of n; this base says nothing
+            if (!strong_round(mont, a, d, s, one, minus_one)) {
+                return false;
+            }
+        }
+        return true;
+    }
+#else
+    bool available() {
+        return false;
+    }
+
+    bool is_prime(uint64_t n) {
+        mpz_t value;
+        mpz_init(value);
+        mpz_import(value, 1, -1, sizeof(n), 0, 0, &n);
+        bool result = mpz_probab_prime_p(value, 40) > 0;
+        mpz_clear(value);
+        return result;
+    }
+#endif
+
+    /**
+     * @brief Check whether n is non-negative and fits in 64 bits
+     *
+     * @param n The GMP integer
+     * @return bool True if the native path can handle n
+     */
+    bool fits(const mpz_t n) {
+        return mpz_sgn(n) >= 0 && mpz_sizeinbase(n, 2) <= 64;
+    }
+
+    /**
+     * @brief Convert a GMP integer that fits in 64 bits to uint64_t
+     *
+     * @param n The GMP integer (must satisfy fits())
+     * @return uint64_t The value of n
+     */
+    uint64_t to_u64(const mpz_t n) {
+        if (sizeof(unsigned long) >= sizeof(uint64_t)) {
+            return mpz_get_ui(n);
+        }
+        uint64_t value = 0;
+        mpz_export(&value, NULL, -1, sizeof(value), 0, 0, n);
+        return value;
+    }
+};
+
+#endif // U64_PRIMALITY_H
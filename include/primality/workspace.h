@@ -0,0 +1,114 @@
+#ifndef PRIMALITY_WORKSPACE_H
+#define PRIMALITY_WORKSPACE_H
+
+#include <gmp.h>
+#include <cstddef>
+#include <vector>
+#include "mod_context.h"
+
+/**
+ * @brief Reusable scratch values for the primality tests
+ *
+ * Every temporary used by MillerRabin::test, the screening pipeline and the
+ * Baillie-PSW Lucas test lives here, along with the Montgomery context for
+ * the number under test, so a caller that tests many numbers
+ * (PrimalityTester, the continuous-operation loop) initializes them once
+ * instead of running mpz_init/mpz_clear on every call. reserve() sizes the
+ * values for products of two residues, so in the steady state GMP never has
+ * to grow them.
+ *
+ * A workspace must not be shared between threads.
+ */
+struct PrimalityWorkspace {
+    // Miller-Rabin and screening
+    mpz_t n_minus_1;   // n - 1
+    mpz_t n_minus_3;   // n - 3, bound for random witnesses
+    mpz_t d;           // Odd part of n - 1
+    mpz_t a;           // Witness
+    mpz_t x;           // Running power
+    mpz_t g;           // Trial division gcd
+    mpz_t base;        // Fixed witness (2)
+
+    // Montgomery arithmetic for the current modulus
+    ModContext mod;
+    std::vector<mp_limb_t> mont_x;  // Running power of the base-2 round, in Montgomery form
+    std::vector<mp_limb_t> lucas_residues;  // V_k, V_{k+1}, Q^k and a scratch residue
+
+    // Strong Lucas test
+    mpz_t lucas_D, lucas_abs_D, lucas_gcd;  // Selfridge parameter search
+    mpz_t lucas_d;                          // Odd part of n + 1
+
+    /**
+     * @brief Construct a workspace
+     *
+     * @param bits Modulus size to preallocate for, or 0 to allocate on first use
+     */
+    explicit PrimalityWorkspace(size_t bits = 0) : reserved_bits(0) {
+        for_each([](mpz_ptr value) { mpz_init(value); });
+        reserve(bits);
+    }
+
+    /**
+     * @brief Destructor
+     */
+    ~PrimalityWorkspace() {
+        for_each([](mpz_ptr value) { mpz_clear(value); });
+    }
+
+    PrimalityWorkspace(const PrimalityWorkspace&) = delete;
+    PrimalityWorkspace& operator=(const PrimalityWorkspace&) = delete;
+
+    /**
+     * @brief Make every value large enough for moduli of the given size
+     *
+     * Values are only ever grown, so alternating between sizes does not
+     * reallocate. The contents of the values are not preserved.
+     *
+     * @param bits Bit length of the modulus
+     */
+    void reserve(size_t bits) {
+        if (bits <= reserved_bits) return;
+
+        // Room for the product of two residues plus a carry limb
+        mp_bitcnt_t capacity = 2 * bits + GMP_NUMB_BITS;
+        for_each([capacity](mpz_ptr value) {
+            if (static_cast<mp_bitcnt_t>(value->_mp_alloc) * GMP_NUMB_BITS < capacity) {
+                mpz_realloc2(value, capacity);
+            }
+        });
+        size_t limbs = (bits + GMP_NUMB_BITS - 1) / GMP_NUMB_BITS;
+        mont_x.resize(limbs);
+        lucas_residues.resize(4 * limbs);
+        reserved_bits = bits;
+    }
+
+    /**
+     * @brief Get the modulus size the workspace is sized for
+     *
+     * @return size_t Reserved bit length
+     */
+    size_t capacity_bits() const {
+        return reserved_bits;
+    }
+
+private:
+    size_t reserved_bits;
+
+    /**
+     * @brief Apply a function to every scratch value
+     *
+     * @param f Function taking an mpz_ptr
+     */
+    template <typename F>
+    void for_each(F f) {
+        mpz_ptr all[] = {
+            n_minus_1, n_minus_3, d, a, x, g, base,
+            lucas_D, lucas_abs_D, lucas_gcd, lucas_d
+        };
+        for (mpz_ptr value : all) {
+            f(value);
+        }
+    }
+};
+
+#endif // PRIMALITY_WORKSPACE_H
@@ -2,9 +2,9 @@
 #define LCG_H
 
 #include "prng_interface.h"
-#include <cmath>
 #include <chrono>
 #include <stdexcept>
+#include <vector>
 
 /**
  * @brief Linear Congruential Generator implementation
@@ -18,7 +18,7 @@
  * 
  * Reference: Knuth, D. E. (1997). The Art of Computer Programming, Vol 2.
  */
-class LCG : public PRNGInterface {
+class LCG final : public PRNGInterface {
 private:
     uint64_t state;  // Current state of the generator
     
@@ -51,6 +51,57 @@ public:
         return state;
     }
     
+    /**
+     * @brief Advance the generator by n steps in O(log n)
+     * 
+     * Same result as n calls to next_u64(). n steps of x -> a*x + c form the
+     * affine map x -> A*x + C; (A, C) is built by repeated squaring of
+     * (a, c), composing the squares that correspond to the bits of n.
+     * 
+     * Reference: Brown, F. B. (1994). Random Number Generation with
+     * Arbitrary Strides. Transactions of the American Nuclear Society, 71.
+     * 
+     * @param n Number of steps to skip
+     */
+    void discard(uint64_t n) {
+        uint64_t acc_a = 1, acc_c = 0;        // Map for the bits of n done so far
+        uint64_t cur_a = LCG_A, cur_c = LCG_C; // Map for 2^i steps
+        while (n > 0) {
+            if (n & 1) {
+                acc_a = acc_a * cur_a;
+                acc_c = acc_c * cur_a + cur_c;
+            }
+            cur_c = (cur_a + 1) * cur_c;
+            cur_a = cur_a * cur_a;
+            n >>= 1;
+        }
+        state = acc_a * state + acc_c;
+    }
+    
+    /**
+     * @brief Create k generators with non-overlapping streams
+     * 
+     * The 2^64-long period is cut into k equal blocks: generator i starts
+     * where this one would be after i * ((2^64 - 1) / k) steps, so generator
+     * 0 is a copy of this one. This generator is not changed; use either it
+     * or generator 0, not both.
+     * 
+     * @param k Number of generators
+     * @return std::vector<LCG> The generators, one per worker
+     */
+    std::vector<LCG> split(size_t k) const {
+        std::vector<LCG> streams;
+        if (k == 0) return streams;
+        streams.reserve(k);
+        uint64_t stride = UINT64_MAX / k;
+        LCG next = *this;
+        for (size_t i = 0; i < k; ++i) {
+            streams.push_back(next);
+            next.discard(stride);
+        }
+        return streams;
+    }
+    
     /**
      * @brief Generate a k-bit random number
      * 
@@ -58,32 +109,23 @@ public:
      * @param k Number of bits
      */
     void randbits(mpz_t result, int k) override {
-        if (k <= 0) {
-            mpz_set_ui(result, 0);
-            return;
-        }
-
-        int bits_per_output = 64;
-        int num_outputs = std::ceil(static_cast<double>(k) / bits_per_output);
-
-        mpz_set_ui(result, 0); // Initialize GMP integer to 0
-
-        for (int i = 0; i < num_outputs; ++i) {
-            uint64_t rand_val = next_u64();
-            mpz_mul_2exp(result, result, bits_per_output); // Left shift by 64 bits
-            mpz_add_ui(result, result, rand_val); // Add the new 64 bits
-        }
-
-        // Trim excess bits if necessary
-        int bits_generated = num_outputs * bits_per_output;
-        if (bits_generated > k) {
-            mpz_fdiv_q_2exp(result, result, bits_generated - k); // Right shift
-        }
-
-        // Ensure the number has exactly k bits (set MSB to 1)
-        if (k > 0) {
-            mpz_setbit(result, k - 1);
+        fill_bits(result, k);
+    }
+    
+protected:
+    /**
+     * @brief Generate n consecutive values with the state kept in a register
+     * 
+     * @param buf Output buffer
+     * @param n Number of values
+     */
+    void fill_block(uint64_t* buf, size_t n) override {
+        uint64_t x = state;
+        for (size_t i = 0; i < n; ++i) {
+            x = LCG_A * x + LCG_C;
+            buf[i] = x;
         }
+        state = x;
     }
 };
 
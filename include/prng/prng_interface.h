@@ -3,11 +3,18 @@
 
 #include <gmp.h>
 #include <stdint.h>
+#include <stddef.h>
 
 /**
  * @brief Interface for Pseudo-Random Number Generators
  * 
  * This class defines the common interface that all PRNGs should implement.
+ * 
+ * Bulk output goes through the non-virtual fill(), which makes one virtual
+ * call per buffer; generators override fill_block() with a loop that keeps
+ * their state in registers instead of paying a virtual next_u64() per word.
+ * fill_bits() builds a k-bit number from fill() directly in the limbs of an
+ * mpz_t, for use by the randbits() implementations.
  */
 class PRNGInterface {
 public:
@@ -30,6 +37,73 @@ public:
      * @param k Number of bits
      */
     virtual void randbits(mpz_t result, int k) = 0;
+    
+    /**
+     * @brief Fill a buffer with the next n 64-bit values in the sequence
+     * 
+     * Produces the same values as n calls to next_u64().
+     * 
+     * @param buf Output buffer
+     * @param n Number of values
+     */
+    void fill(uint64_t* buf, size_t n) {
+        fill_block(buf, n);
+    }
+    
+protected:
+    /**
+     * @brief Generate a k-bit number from the next ceil(k/64) values, in place
+     * 
+     * The first value drawn is the most significant word, the low 64*n - k
+     * bits of the last word are dropped and bit k-1 is set. The words are
+     * generated straight into the limbs of result (mpz_limbs_write), so the
+     * cost is one fill() and one shift, with no intermediate integers.
+     * 
+     * @param result GMP integer to store the result
+     * @param k Number of bits
+     */
+    void fill_bits(mpz_t result, int k) {
+        static_assert(GMP_NUMB_BITS == 64 && sizeof(mp_limb_t) == sizeof(uint64_t),
+                      "fill_bits expects 64-bit limbs without nails");
+        if (k <= 0) {
+            mpz_set_ui(result, 0);
+            return;
+        }
+        
+        size_t num_outputs = (static_cast<size_t>(k) + 63) / 64;
+        mp_limb_t* limbs = mpz_limbs_write(result, num_outputs);
+        uint64_t* words = reinterpret_cast<uint64_t*>(limbs);
+        fill(words, num_outputs);
+        
+        // Limbs are least significant first, the sequence is most significant first
+        for (size_t i = 0, j = num_outputs - 1; i < j; ++i, --j) {
+            uint64_t t = words[i];
+            words[i] = words[j];
+            words[j] = t;
+        }
+        
+        // Drop the excess low bits and set the MSB
+        unsigned excess = static_cast<unsigned>(num_outputs * 64 - k);
+        if (excess > 0) {
+            mpn_rshift(limbs, limbs, num_outputs, excess);
+        }
+        limbs[num_outputs - 1] |= mp_limb_t(1) << ((k - 1) % 64);
+        mpz_limbs_finish(result, num_outputs);
+    }
+    
+    /**
+     * @brief Generate n consecutive values into buf
+     * 
+     * The default calls next_u64() for every value.
+     * 
+     * @param buf Output buffer
+     * @param n Number of values
+     */
+    virtual void fill_block(uint64_t* buf, size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            buf[i] = next_u64();
+        }
+    }
 };
 
 #endif // PRNG_INTERFACE_H 
\ No newline at end of file
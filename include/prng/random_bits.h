@@ -0,0 +1,121 @@
+#ifndef RANDOM_BITS_H
+#define RANDOM_BITS_H
+
+#include <gmp.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "prng_interface.h"
+
+/**
+ * @brief k-bit random numbers from a generator bound at compile time
+ *
+ * RandomBits<Gen> calls Gen::next_u64() directly, so for a concrete (final)
+ * generator every word is an inlined call instead of a trip through the
+ * PRNGInterface vtable. Gen can be any type with a uint64_t next_u64();
+ * it does not have to derive from PRNGInterface.
+ *
+ * The output is the same as Gen::randbits(): the first value drawn is the
+ * most significant word, the excess low bits of the last word are dropped
+ * and bit k-1 is set.
+ *
+ * @tparam Gen Generator type
+ */
+template <typename Gen>
+class RandomBits {
+public:
+    /**
+     * @brief Bind a generator
+     *
+     * @param gen The generator; must outlive this object
+     */
+    explicit RandomBits(Gen& gen) : gen(gen) {}
+
+    /**
+     * @brief Generate a k-bit random number
+     *
+     * @param result GMP integer to store the result
+     * @param k Number of bits
+     */
+    void operator()(mpz_t result, int k) {
+        static_assert(GMP_NUMB_BITS == 64, "RandomBits expects 64-bit limbs without nails");
+        if (k <= 0) {
+            mpz_set_ui(result, 0);
+            return;
+        }
+
+        size_t num_outputs = (static_cast<size_t>(k) + 63) / 64;
+        mp_limb_t* limbs = mpz_limbs_write(result, num_outputs);
+
+        // Most significant word first
+        for (size_t i = num_outputs; i-- > 0;) {
+            limbs[i] = gen.next_u64();
+        }
+
+        // Drop the excess low bits and set the MSB
+        unsigned excess = static_cast<unsigned>(num_outputs * 64 - k);
+        if (excess > 0) {
+            mpn_rshift(limbs, limbs, num_outputs, excess);
+        }
+        limbs[num_outputs - 1] |= mp_limb_t(1) << ((k - 1) % 64);
+        mpz_limbs_finish(result, num_outputs);
+    }
+
+    /**
+     * @brief Fill a buffer with the next n values of the generator
+     *
+     * @param buf Output buffer
+     * @param n Number of values
+     */
+    void fill(uint64_t* buf, size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            buf[i] = gen.next_u64();
+        }
+    }
+
+    /**
+     * @brief Get the bound generator
+     *
+     * @return Gen& The generator
+     */
+    Gen& generator() {
+        return gen;
+    }
+
+private:
+    Gen& gen;
+};
+
+/**
+ * @brief RandomBits-shaped adapter over a PRNGInterface
+ *
+ * Lets code templated on the bit source also run through the virtual
+ * interface, so both dispatch paths can be measured side by side.
+ */
+class InterfaceBits {
+public:
+    /**
+     * @brief Bind a generator
+     *
+     * @param prng The generator; must outlive this object
+     */
+    explicit InterfaceBits(PRNGInterface& prng) : prng(prng) {}
+
+    /**
+     * @brief Generate a k-bit random number through PRNGInterface::randbits
+     */
+    void operator()(mpz_t result, int k) {
+        prng.randbits(result, k);
+    }
+
+    /**
+     * @brief Fill a buffer through PRNGInterface::fill
+     */
+    void fill(uint64_t* buf, size_t n) {
+        prng.fill(buf, n);
+    }
+
+private:
+    PRNGInterface& prng;
+};
+
+#endif // RANDOM_BITS_H
@@ -2,10 +2,10 @@
 #define XOSHIRO_H
 
 #include "prng_interface.h"
-#include <cmath>
 #include <chrono>
 #include <random>
 #include <stdexcept>
+#include <vector>
 
 /**
  * @brief Helper function for 64-bit left rotation
@@ -28,7 +28,7 @@ static inline uint64_t rotl(const uint64_t x, int k) {
  * 
  * Official implementation: https://prng.di.unimi.it/
  */
-class Xoshiro256pp : public PRNGInterface {
+class Xoshiro256pp final : public PRNGInterface {
 private:
     uint64_t s[4]; // 256 bits of state
     
@@ -56,6 +56,34 @@ private:
              s[0] = 1; // Set a non-zero state
          }
     }
+    
+    /**
+     * @brief Advance the state by the jump polynomial poly
+     * 
+     * The new state is the XOR of the states x^i for every bit i set in
+     * poly, which is the characteristic-polynomial method of the reference
+     * implementation.
+     * 
+     * @param poly Jump polynomial, least significant word first
+     */
+    void apply_jump(const uint64_t poly[4]) {
+        uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+        for (int i = 0; i < 4; i++) {
+            for (int b = 0; b < 64; b++) {
+                if (poly[i] & (UINT64_C(1) << b)) {
+                    s0 ^= s[0];
+                    s1 ^= s[1];
+                    s2 ^= s[2];
+                    s3 ^= s[3];
+                }
+                next_u64();
+            }
+        }
+        s[0] = s0;
+        s[1] = s1;
+        s[2] = s2;
+        s[3] = s3;
+    }
 
 public:
     /**
@@ -94,6 +122,64 @@ public:
         return result;
     }
     
+    /**
+     * @brief Advance the generator by 2^128 steps
+     * 
+     * Equivalent to 2^128 calls to next_u64(); used to give parallel streams
+     * non-overlapping subsequences.
+     */
+    void jump() {
+        static const uint64_t JUMP[] = {
+            0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL, 0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL
+        };
+        apply_jump(JUMP);
+    }
+    
+    /**
+     * @brief Advance the generator by 2^192 steps
+     * 
+     * Equivalent to 2^64 calls to jump(). Streams started from successive
+     * long jumps can each be split with jump() into 2^64 further streams.
+     */
+    void long_jump() {
+        static const uint64_t LONG_JUMP[] = {
+            0x76e15d3efefdcbbfULL, 0xc5004e441c522fb3ULL, 0x77710069854ee241ULL, 0x39109bb02acbe635ULL
+        };
+        apply_jump(LONG_JUMP);
+    }
+    
+    /**
+     * @brief Create k generators with non-overlapping streams
+     * 
+     * Generator i starts where this one would be after i jumps (i * 2^128
+     * steps), so generator 0 is a copy of this one. This generator is not
+     * changed; use either it or generator 0, not both.
+     * 
+     * @param k Number of generators
+     * @return std::vector<Xoshiro256pp> The generators, one per worker
+     */
+    std::vector<Xoshiro256pp> split(size_t k) const {
+        std::vector<Xoshiro256pp> streams;
+        streams.reserve(k);
+        Xoshiro256pp next = *this;
+        for (size_t i = 0; i < k; ++i) {
+            streams.push_back(next);
+            next.jump();
+        }
+        return streams;
+    }
+    
+    /**
+     * @brief Copy out the 256-bit state
+     * 
+     * @param out Array receiving the four state words
+     */
+    void get_state(uint64_t out[4]) const {
+        for (int i = 0; i < 4; ++i) {
+            out[i] = s[i];
+        }
+    }
+    
     /**
      * @brief Generate a k-bit random number
      * 
@@ -101,32 +187,33 @@ public:
      * @param k Number of bits
      */
     void randbits(mpz_t result, int k) override {
-        if (k <= 0) {
-            mpz_set_ui(result, 0);
-            return;
-        }
-
-        int bits_per_output = 64;
-        int num_outputs = std::ceil(static_cast<double>(k) / bits_per_output);
-
-        mpz_set_ui(result, 0); // Initialize GMP integer to 0
-
-        for (int i = 0; i < num_outputs; ++i) {
-            uint64_t rand_val = next_u64();
-            mpz_mul_2exp(result, result, bits_per_output); // Left shift by 64 bits
-            mpz_add_ui(result, result, rand_val); // Add the new 64 bits
-        }
-
-        // Trim excess bits if necessary
-        int bits_generated = num_outputs * bits_per_output;
-        if (bits_generated > k) {
-            mpz_fdiv_q_2exp(result, result, bits_generated - k); // Right shift
-        }
-
-        // Ensure the number has exactly k bits (set MSB to 1)
-        if (k > 0) {
-            mpz_setbit(result, k - 1);
+        fill_bits(result, k);
+    }
+    
+protected:
+    /**
+     * @brief Generate n consecutive values with the state kept in registers
+     * 
+     * @param buf Output buffer
+     * @param n Number of values
+     */
+    void fill_block(uint64_t* buf, size_t n) override {
+        uint64_t s0 = s[0], s1 = s[1], s2 = s[2], s3 = s[3];
+        for (size_t i = 0; i < n; ++i) {
+            buf[i] = rotl(s0 + s3, 23) + s0;
+            
+            const uint64_t t = s1 << 17;
+            s2 ^= s0;
+            s3 ^= s1;
+            s1 ^= s2;
+            s0 ^= s3;
+            s2 ^= t;
+            s3 = rotl(s3, 45);
         }
+        s[0] = s0;
+        s[1] = s1;
+        s[2] = s2;
+        s[3] = s3;
     }
 };
 
@@ -0,0 +1,372 @@
+#ifndef XOSHIRO_SIMD_H
+#define XOSHIRO_SIMD_H
+
+#include "prng_interface.h"
+#include "xoshiro.h"
+#include <cstring>
+#include <vector>
+
+// On x86-64 the AVX2 and AVX-512 kernels are compiled with target attributes
+// and picked at run time, so they exist whatever -march the build used
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define XOSHIRO_SIMD_X86 1
+#define XOSHIRO_SIMD_TARGET(isa) __attribute__((target(isa)))
+#endif
+#if defined(__riscv_vector) && defined(__riscv_v_intrinsic) && __riscv_v_intrinsic >= 12000
+#include <riscv_vector.h>
+#define XOSHIRO_SIMD_RVV 1
+#endif
+
+// GCC 12 reports its own _mm512_undefined_epi32() placeholders as uninitialized
+#if defined(XOSHIRO_SIMD_X86) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+/**
+ * @brief Multi-stream Xoshiro256++ for bulk generation
+ *
+ * Runs LANES independent Xoshiro256++ generators side by side, one per
+ * vector lane. Lane i starts from the seed state advanced by i jumps of
+ * 2^128 steps, so the streams never overlap. Each step of the generator
+ * produces one value per lane, and the output interleaves them: value
+ * b * LANES + i of the sequence is the b-th output of lane i.
+ *
+ * The lane update is written once per instruction set: AVX-512 (one
+ * register per state word), AVX2 (two registers of four lanes), RVV
+ * (whatever vector length the hardware offers), and a plain lane loop that
+ * the compiler can vectorize for anything else. All of them produce the same
+ * sequence. On x86-64 every kernel is built into the binary and the fastest
+ * one the CPU supports is picked when the generator is constructed, so one
+ * binary runs the AVX-512 code where it can and the generic loop elsewhere.
+ * GCC 12 has no target attribute for RISC-V, so the RVV kernel is only built
+ * when the whole program is compiled for V (e.g. -march=rv64gcv).
+ *
+ * Reference: Blackman, D., & Vigna, S. (2019). Scrambled Linear Pseudorandom
+ * Number Generators. arXiv preprint arXiv:1805.01407v5.
+ */
+class Xoshiro256ppSimd final : public PRNGInterface {
+public:
+    // Number of interleaved streams (one 512-bit register of 64-bit lanes)
+    static const size_t LANES = 8;
+
+    // Lane update kernels
+    enum Isa { GENERIC, AVX2, AVX512, RVV };
+
+    /**
+     * @brief Construct a new multi-stream generator
+     *
+     * @param seed Initial seed value, or 0 for automatic seeding
+     * @param requested Lane update to use; one the CPU does not support
+     *        falls back to best_isa()
+     */
+    Xoshiro256ppSimd(uint64_t seed = 0, Isa requested = best_isa())
+        : kernel(supported(requested) ? requested : best_isa()), buffered(0), position(0) {
+        std::vector<Xoshiro256pp> streams = Xoshiro256pp(seed).split(LANES);
+        for (size_t lane = 0; lane < LANES; ++lane) {
+            uint64_t state[4];
+            streams[lane].get_state(state);
+            for (int w = 0; w < 4; ++w) {
+                s[w][lane] = state[w];
+            }
+        }
+    }
+
+    /**
+     * @brief Check whether a kernel is built in and the CPU can run it
+     *
+     * @param isa The kernel
+     * @return bool True if a generator can use it on this host
+     */
+    static bool supported(Isa isa) {
+        switch (isa) {
+        case GENERIC:
+            return true;
+#if defined(XOSHIRO_SIMD_X86)
+        case AVX2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2");
+        case AVX512:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx512f");
+#endif
+#if defined(XOSHIRO_SIMD_RVV)
+        case RVV:
+            return true;
+#endif
+        default:
+            return false;
+        }
+    }
+
+    /**
+     * @brief Get the fastest kernel this host supports (detected once)
+     *
+     * @return Isa AVX512, AVX2 or RVV where available, GENERIC otherwise
+     */
+    static Isa best_isa() {
+        static const Isa best = supported(AVX512) ? AVX512
+                              : supported(AVX2) ? AVX2
+                              : supported(RVV) ? RVV
+                              : GENERIC;
+        return best;
+    }
+
+    /**
+     * @brief Get the name of a kernel
+     *
+     * @param isa The kernel
+     * @return const char* "avx512", "avx2", "rvv" or "generic"
+     */
+    static const char* isa_name(Isa isa) {
+        switch (isa) {
+        case AVX512: return "avx512";
+        case AVX2: return "avx2";
+        case RVV: return "rvv";
+        default: return "generic";
+        }
+    }
+
+    /**
+     * @brief Get the name of the kernel a default-constructed generator uses
+     *
+     * @return const char* "avx512", "avx2", "rvv" or "generic"
+     */
+    static const char* isa() {
+        return isa_name(best_isa());
+    }
+
+    /**
+     * @brief Get the kernel this generator uses
+     *
+     * @return Isa The kernel
+     */
+    Isa isa_used() const {
+        return kernel;
+    }
+
+    /**
+     * @brief Generate the next 64-bit pseudo-random value
+     *
+     * @return uint64_t The next random value
+     */
+    uint64_t next_u64() override {
+        if (position == buffered) {
+            generate(pending, 1);
+            buffered = LANES;
+            position = 0;
+        }
+        return pending[position++];
+    }
+
+    /**
+     * @brief Generate a k-bit random number
+     *
+     * Same layout as Xoshiro256pp::randbits: the first value drawn is the
+     * most significant word.
+     *
+     * @param result GMP integer to store the result
+     * @param k Number of bits
+     */
+    void randbits(mpz_t result, int k) override {
+        fill_bits(result, k);
+    }
+
+protected:
+    /**
+     * @brief Generate n consecutive values
+     *
+     * Whole blocks of LANES values go straight into buf; a partial block at
+     * either end passes through the small output buffer.
+     *
+     * @param buf Output buffer
+     * @param n Number of values
+     */
+    void fill_block(uint64_t* buf, size_t n) override {
+        // Values left over from an earlier call come first
+        while (n > 0 && position < buffered) {
+            *buf++ = pending[position++];
+            --n;
+        }
+
+        size_t blocks = n / LANES;
+        generate(buf, blocks);
+        buf += blocks * LANES;
+        n -= blocks * LANES;
+
+        if (n > 0) {
+            generate(pending, 1);
+            buffered = LANES;
+            position = 0;
+            while (n > 0) {
+                *buf++ = pending[position++];
+                --n;
+            }
+        }
+    }
+
+private:
+    alignas(64) uint64_t s[4][LANES];  // s[w][lane]: state word w of each stream
+    alignas(64) uint64_t pending[LANES];  // Output of the last partial block
+    Isa kernel;                        // Lane update in use
+    size_t buffered;                   // Values in pending
+    size_t position;                   // Next unread value in pending
+
+    /**
+     * @brief Advance every lane by blocks steps, writing LANES values per step
+     *
+     * @param out Output, blocks * LANES values
+     * @param blocks Number of steps
+     */
+    void generate(uint64_t* out, size_t blocks) {
+        switch (kernel) {
+#if defined(XOSHIRO_SIMD_X86)
+        case AVX512:
+            generate_avx512(out, blocks);
+            return;
+        case AVX2:
+            generate_avx2(out, blocks);
+            return;
+#endif
+#if defined(XOSHIRO_SIMD_RVV)
+        case RVV:
+            generate_rvv(out, blocks);
+            return;
+#endif
+        default:
+            generate_generic(out, blocks);
+            return;
+        }
+    }
+
+#if defined(XOSHIRO_SIMD_X86)
+    /**
+     * @brief Lane update with one AVX-512 register per state word
+     */
+    XOSHIRO_SIMD_TARGET("avx512f")
+    void generate_avx512(uint64_t* out, size_t blocks) {
+        __m512i s0 = _mm512_load_si512(s[0]);
+        __m512i s1 = _mm512_load_si512(s[1]);
+        __m512i s2 = _mm512_load_si512(s[2]);
+        __m512i s3 = _mm512_load_si512(s[3]);
+        for (size_t b = 0; b < blocks; ++b) {
+            __m512i result = _mm512_add_epi64(_mm512_rol_epi64(_mm512_add_epi64(s0, s3), 23), s0);
+            _mm512_storeu_si512(out + b * LANES, result);
+
+            __m512i t = _mm512_slli_epi64(s1, 17);
+            s2 = _mm512_xor_si512(s2, s0);
+            s3 = _mm512_xor_si512(s3, s1);
+            s1 = _mm512_xor_si512(s1, s2);
+            s0 = _mm512_xor_si512(s0, s3);
+            s2 = _mm512_xor_si512(s2, t);
+            s3 = _mm512_rol_epi64(s3, 45);
+        }
+        _mm512_store_si512(s[0], s0);
+        _mm512_store_si512(s[1], s1);
+        _mm512_store_si512(s[2], s2);
+        _mm512_store_si512(s[3], s3);
+    }
+
+    /**
+     * @brief Lane update with two AVX2 registers of four lanes per state word
+     */
+    XOSHIRO_SIMD_TARGET("avx2")
+    void generate_avx2(uint64_t* out, size_t blocks) {
+        for (size_t half = 0; half < LANES; half += 4) {
+            __m256i s0 = _mm256_load_si256(reinterpret_cast<const __m256i*>(&s[0][half]));
+            __m256i s1 = _mm256_load_si256(reinterpret_cast<const __m256i*>(&s[1][half]));
+            __m256i s2 = _mm256_load_si256(reinterpret_cast<const __m256i*>(&s[2][half]));
+            __m256i s3 = _mm256_load_si256(reinterpret_cast<const __m256i*>(&s[3][half]));
+            for (size_t b = 0; b < blocks; ++b) {
+                __m256i sum = _mm256_add_epi64(s0, s3);
+                __m256i rotated = _mm256_or_si256(_mm256_slli_epi64(sum, 23), _mm256_srli_epi64(sum, 41));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + b * LANES + half),
+                                    _mm256_add_epi64(rotated, s0));
+
+                __m256i t = _mm256_slli_epi64(s1, 17);
+                s2 = _mm256_xor_si256(s2, s0);
+                s3 = _mm256_xor_si256(s3, s1);
+                s1 = _mm256_xor_si256(s1, s2);
+                s0 = _mm256_xor_si256(s0, s3);
+                s2 = _mm256_xor_si256(s2, t);
+                s3 = _mm256_or_si256(_mm256_slli_epi64(s3, 45), _mm256_srli_epi64(s3, 19));
+            }
+            _mm256_store_si256(reinterpret_cast<__m256i*>(&s[0][half]), s0);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(&s[1][half]), s1);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(&s[2][half]), s2);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(&s[3][half]), s3);
+        }
+    }
+#endif
+
+#if defined(XOSHIRO_SIMD_RVV)
+    /**
+     * @brief Lane update with as many lanes per pass as the vector length allows
+     */
+    void generate_rvv(uint64_t* out, size_t blocks) {
+        for (size_t first = 0; first < LANES;) {
+            size_t vl = __riscv_vsetvl_e64m4(LANES - first);
+            vuint64m4_t s0 = __riscv_vle64_v_u64m4(&s[0][first], vl);
+            vuint64m4_t s1 = __riscv_vle64_v_u64m4(&s[1][first], vl);
+            vuint64m4_t s2 = __riscv_vle64_v_u64m4(&s[2][first], vl);
+            vuint64m4_t s3 = __riscv_vle64_v_u64m4(&s[3][first], vl);
+            for (size_t b = 0; b < blocks; ++b) {
+                vuint64m4_t sum = __riscv_vadd_vv_u64m4(s0, s3, vl);
+                vuint64m4_t rotated = __riscv_vor_vv_u64m4(__riscv_vsll_vx_u64m4(sum, 23, vl),
+                                                           __riscv_vsrl_vx_u64m4(sum, 41, vl), vl);
+                __riscv_vse64_v_u64m4(out + b * LANES + first, __riscv_vadd_vv_u64m4(rotated, s0, vl), vl);
+
+                vuint64m4_t t = __riscv_vsll_vx_u64m4(s1, 17, vl);
+                s2 = __riscv_vxor_vv_u64m4(s2, s0, vl);
+                s3 = __riscv_vxor_vv_u64m4(s3, s1, vl);
+                s1 = __riscv_vxor_vv_u64m4(s1, s2, vl);
+                s0 = __riscv_vxor_vv_u64m4(s0, s3, vl);
+                s2 = __riscv_vxor_vv_u64m4(s2, t, vl);
+                s3 = __riscv_vor_vv_u64m4(__riscv_vsll_vx_u64m4(s3, 45, vl),
+                                          __riscv_vsrl_vx_u64m4(s3, 19, vl), vl);
+            }
+            __riscv_vse64_v_u64m4(&s[0][first], s0, vl);
+            __riscv_vse64_v_u64m4(&s[1][first], s1, vl);
+            __riscv_vse64_v_u64m4(&s[2][first], s2, vl);
+            __riscv_vse64_v_u64m4(&s[3][first], s3, vl);
+            first += vl;
+        }
+    }
+#endif
+
+    /**
+     * @brief Lane update as a plain loop over the lanes
+     */
+    void generate_generic(uint64_t* out, size_t blocks) {
+        uint64_t s0[LANES], s1[LANES], s2[LANES], s3[LANES];
+        std::memcpy(s0, s[0], sizeof(s0));
+        std::memcpy(s1, s[1], sizeof(s1));
+        std::memcpy(s2, s[2], sizeof(s2));
+        std::memcpy(s3, s[3], sizeof(s3));
+        for (size_t b = 0; b < blocks; ++b) {
+            uint64_t* row = out + b * LANES;
+            for (size_t i = 0; i < LANES; ++i) {
+                row[i] = rotl(s0[i] + s3[i], 23) + s0[i];
+
+                const uint64_t t = s1[i] << 17;
+                s2[i] ^= s0[i];
+                s3[i] ^= s1[i];
+                s1[i] ^= s2[i];
+                s0[i] ^= s3[i];
+                s2[i] ^= t;
+                s3[i] = rotl(s3[i], 45);
+            }
+        }
+        std::memcpy(s[0], s0, sizeof(s0));
+        std::memcpy(s[1], s1, sizeof(s1));
+        std::memcpy(s[2], s2, sizeof(s2));
+        std::memcpy(s[3], s3, sizeof(s3));
+    }
+};
+
+#if defined(XOSHIRO_SIMD_X86) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif // XOSHIRO_SIMD_H
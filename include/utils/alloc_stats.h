@@ -0,0 +1,160 @@
+#ifndef ALLOC_STATS_H
+#define ALLOC_STATS_H
+
+#include <gmp.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Counting hook for GMP's memory allocation
+ *
+ * install() routes GMP's allocate/reallocate/free through counting wrappers
+ * (via mp_set_memory_functions) that forward to the functions GMP was using
+ * before. Counting starts from the moment of installation, so it should be
+ * called at the start of main(), before any mpz_t is initialized.
+ *
+ * Reading the counters before and after a loop shows how many heap
+ * operations GMP performed per iteration; with a warmed-up PrimalityWorkspace
+ * the steady state of a primality test loop should need none. The hook also
+ * tracks the bytes GMP holds (GMP passes the block size to free and
+ * reallocate) and their high-water mark, which reset_peak() lowers to the
+ * current level for measuring one stretch of work.
+ */
+namespace AllocStats {
+    /**
+     * @brief Counter snapshot
+     */
+    struct Counts {
+        uint64_t allocs;    // Calls to the allocate function
+        uint64_t reallocs;  // Calls to the reallocate function
+        uint64_t frees;     // Calls to the free function
+        uint64_t bytes;     // Bytes requested by allocate and reallocate (new size)
+
+        /**
+         * @brief Total number of heap operations
+         *
+         * @return uint64_t allocs + reallocs + frees
+         */
+        uint64_t total() const {
+            return allocs + reallocs + frees;
+        }
+    };
+
+    namespace detail {
+        std::atomic<uint64_t> allocs(0);
+        std::atomic<uint64_t> reallocs(0);
+        std::atomic<uint64_t> frees(0);
+        std::atomic<uint64_t> bytes(0);
+        std::atomic<int64_t> live(0);    // Negative if blocks from before install() are freed
+        std::atomic<int64_t> peak(0);
+
+        void* (*base_alloc)(size_t) = nullptr;
+        void* (*base_realloc)(void*, size_t, size_t) = nullptr;
+        void (*base_free)(void*, size_t) = nullptr;
+
+        void grow(int64_t delta) {
+            int64_t now = live.fetch_add(delta, std::memory_order_relaxed) + delta;
+            int64_t high = peak.load(std::memory_order_relaxed);
+            while (now > high && !peak.compare_exchange_weak(high, now, std::memory_order_relaxed)) {
+            }
+        }
+
+        void* counting_alloc(size_t size) {
+            allocs.fetch_add(1, std::memory_order_relaxed);
+            bytes.fetch_add(size, std::memory_order_relaxed);
+            grow(static_cast<int64_t>(size));
+            return base_alloc(size);
+        }
+
+        void* counting_realloc(void* ptr, size_t old_size, size_t new_size) {
+            reallocs.fetch_add(1, std::memory_order_relaxed);
+            bytes.fetch_add(new_size, std::memory_order_relaxed);
+            grow(static_cast<int64_t>(new_size) - static_cast<int64_t>(old_size));
+            return base_realloc(ptr, old_size, new_size);
+        }
+
+        void counting_free(void* ptr, size_t size) {
+            frees.fetch_add(1, std::memory_order_relaxed);
+            live.fetch_sub(static_cast<int64_t>(size), std::memory_order_relaxed);
+            base_free(ptr, size);
+        }
+    };
+
+    /**
+     * @brief Install the counting hook (idempotent)
+     */
+    void install() {
+        if (detail::base_alloc != nullptr) return;
+        mp_get_memory_functions(&detail::base_alloc, &detail::base_realloc, &detail::base_free);
+        mp_set_memory_functions(detail::counting_alloc, detail::counting_realloc, detail::counting_free);
+    }
+
+    /**
+     * @brief Check whether the hook is installed
+     *
+     * @return bool True after install()
+     */
+    bool installed() {
+        return detail::base_alloc != nullptr;
+    }
+
+    /**
+     * @brief Read the current counters
+     *
+     * @return Counts Snapshot of the counters
+     */
+    Counts snapshot() {
+        Counts counts;
+        counts.allocs = detail::allocs.load(std::memory_order_relaxed);
+        counts.reallocs = detail::reallocs.load(std::memory_order_relaxed);
+        counts.frees = detail::frees.load(std::memory_order_relaxed);
+        counts.bytes = detail::bytes.load(std::memory_order_relaxed);
+        return counts;
+    }
+
+    /**
+     * @brief Get the bytes GMP holds now
+     *
+     * @return uint64_t Live bytes allocated since install()
+     */
+    uint64_t live_bytes() {
+        int64_t live = detail::live.load(std::memory_order_relaxed);
+        return live > 0 ? static_cast<uint64_t>(live) : 0;
+    }
+
+    /**
+     * @brief Get the most bytes GMP held at once since install() or reset_peak()
+     *
+     * @return uint64_t Peak live bytes
+     */
+    uint64_t peak_bytes() {
+        int64_t peak = detail::peak.load(std::memory_order_relaxed);
+        return peak > 0 ? static_cast<uint64_t>(peak) : 0;
+    }
+
+    /**
+     * @brief Lower the peak to the current live bytes
+     */
+    void reset_peak() {
+        detail::peak.store(detail::live.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Difference between two snapshots
+     *
+     * @param later Later snapshot
+     * @param earlier Earlier snapshot
+     * @return Counts Operations performed in between
+     */
+    Counts since(const Counts& later, const Counts& earlier) {
+        Counts diff;
+        diff.allocs = later.allocs - earlier.allocs;
+        diff.reallocs = later.reallocs - earlier.reallocs;
+        diff.frees = later.frees - earlier.frees;
+        diff.bytes = later.bytes - earlier.bytes;
+        return diff;
+    }
+};
+
+#endif // ALLOC_STATS_H
@@ -0,0 +1,551 @@
+#ifndef BENCH_HARNESS_H
+#define BENCH_HARNESS_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <mutex>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <numeric>
+#include <pthread.h>
+#include <sched.h>
+#include "perf_counters.h"
+
+/**
+ * @brief Shared measurement loop for the latency benchmarks
+ *
+ * A measurement has three phases:
+ * 1. Warm-up: run until the median of the last WARMUP_WINDOW timings is
+ *    within warmup_tolerance of the window before it (caches, branch
+ *    predictors, GMP's allocations and the CPU clock have settled), bounded
+ *    by warmup_max runs and a fifth of the time budget.
+ * 2. Measurement: at least min_runs timed runs, then more until the
+ *    bootstrap confidence interval of the median is narrower than
+ *    target_rel_ci of the median, or max_runs or max_seconds is reached.
+ * 3. Summary: mean, standard deviation, min/max, p50/p90/p99, the bootstrap
+ *    confidence interval of the median and the number of Tukey outliers
+ *    (outside 1.5 IQR). Outliers are counted, not removed; the percentiles
+ *    are what the benchmarks report.
+ *
+ * Every run is timed with CycleTimer, so sub-microsecond operations are
+ * measured without a clock call or an indirect call in the timed region.
+ */
+class BenchHarness {
+public:
+    /**
+     * @brief Measurement parameters
+     */
+    struct Config {
+        int min_runs;               // Timed runs before the stopping rule is checked
+        int max_runs;               // Upper bound on timed runs
+        double max_seconds;         // Time budget for warm-up and measurement together
+        double target_rel_ci;       // Stop when the CI width is below this fraction of the median
+        double confidence;          // Confidence level of the interval
+        int warmup_min;             // Warm-up runs always performed
+        int warmup_max;             // Upper bound on warm-up runs
+        double warmup_tolerance;    // Relative change of the window median that counts as stable
+        int bootstrap_resamples;    // Resamples for the reported interval
+
+        Config()
+            : min_runs(10), max_runs(1000), max_seconds(5.0), target_rel_ci(0.05), confidence(0.95),
+              warmup_min(2), warmup_max(50), warmup_tolerance(0.05), bootstrap_resamples(1000) {}
+    };
+
+    /**
+     * @brief Statistics of one measurement, in milliseconds
+     */
+    struct Summary {
+        size_t runs;
+        size_t warmup_runs;
+        size_t outliers;
+        double mean, stddev, min, p50, p90, p99, max;
+        double ci_low, ci_high;     // Bootstrap interval of the median
+        bool converged;             // True if the interval met target_rel_ci
+        std::vector<double> samples;    // Timed runs in run order, for comparisons between builds
+
+        Summary()
+            : runs(0), warmup_runs(0), outliers(0), mean(0), stddev(0), min(0), p50(0), p90(0),
+              p99(0), max(0), ci_low(0), ci_high(0), converged(false) {}
+    };
+
+    /**
+     * @brief Construct a harness
+     *
+     * @param config Measurement parameters
+     */
+    explicit BenchHarness(const Config& config = Config()) : config(config) {}
+
+    /**
+     * @brief Measure an operation
+     *
+     * @param op Callable run once per sample
+     * @return Summary Statistics of the timed runs
+     */
+    template <typename F>
+    Summary run(F&& op) {
+        return measure([&]() {
+            uint64_t start = CycleTimer::start();
+            op();
+            uint64_t end = CycleTimer::stop();
+            return CycleTimer::to_ms(CycleTimer::elapsed(start, end));
+        });
+    }
+
+    /**
+     * @brief Measure with caller-provided timings
+     *
+     * For operations that need untimed setup per run: sample() does the
+     * setup, times the operation itself and returns its duration.
+     *
+     * @param sample Callable returning one timing in milliseconds
+     * @return Summary Statistics of the timed runs
+     */
+    template <typename F>
+    Summary measure(F&& sample) {
+        using clock = std::chrono::steady_clock;
+        auto begin = clock::now();
+        auto elapsed = [&]() { return std::chrono::duration<double>(clock::now() - begin).count(); };
+
+        // Warm-up until two consecutive windows agree
+        std::vector<double> warmup;
+        while (static_cast<int>(warmup.size()) < config.warmup_max) {
+            warmup.push_back(sample());
+            int n = static_cast<int>(warmup.size());
+            if (n < config.warmup_min) continue;
+            if (elapsed() > config.max_seconds / 5) break;
+            if (n >= 2 * WARMUP_WINDOW) {
+                double current = median_of(warmup.end() - WARMUP_WINDOW, warmup.end());
+                double previous = median_of(warmup.end() - 2 * WARMUP_WINDOW, warmup.end() - WARMUP_WINDOW);
+                if (std::fabs(current - previous) <= config.warmup_tolerance * previous) break;
+            }
+        }
+
+        // Timed runs until the interval is tight enough or the budget runs out
+        times.clear();
+        bool converged = false;
+        size_t next_check = config.min_runs;
+        while (static_cast<int>(times.size()) < config.max_runs) {
+            times.push_back(sample());
+            if (times.size() < next_check) {
+                if (elapsed() > config.max_seconds && static_cast<int>(times.size()) >= config.min_runs) break;
+                continue;
+            }
+            // Checks get rarer as the sample grows, so the bootstraps stay a small part of the run time
+            next_check = times.size() + std::max<size_t>(CHECK_EVERY, times.size() / 4);
+
+            double low, high;
+            bootstrap_median_ci(times, STOPPING_RESAMPLES, config.confidence, low, high);
+            double center = percentile(sorted(times), 0.5);
+            if (center > 0 && (high - low) <= config.target_rel_ci * center) {
+                converged = true;
+                break;
+            }
+            if (elapsed() > config.max_seconds) break;
+        }
+
+        Summary summary = summarize(times, config.bootstrap_resamples, config.confidence);
+        summary.warmup_runs = warmup.size();
+        summary.converged = converged;
+        return summary;
+    }
+
+    /**
+     * @brief Get the timings of the last measurement, in run order
+     */
+    const std::vector<double>& samples() const {
+        return times;
+    }
+
+    /**
+     * @brief Compute the statistics of a set of timings
+     *
+     * @param values Timings in milliseconds
+     * @param resamples Bootstrap resamples for the interval of the median
+     * @param confidence Confidence level of the interval
+     * @return Summary The statistics (converged and warmup_runs are left unset)
+     */
+    static Summary summarize(const std::vector<double>& values, int resamples = 1000, double confidence = 0.95) {
+        Summary summary;
+        if (values.empty()) return summary;
+        summary.samples = values;
+
+        std::vector<double> s = sorted(values);
+        summary.runs = s.size();
+        summary.mean = std::accumulate(s.begin(), s.end(), 0.0) / s.size();
+        double variance = 0.0;
+        for (double v : s) variance += (v - summary.mean) * (v - summary.mean);
+        summary.stddev = s.size() > 1 ? std::sqrt(variance / (s.size() - 1)) : 0.0;
+        summary.min = s.front();
+        summary.max = s.back();
+        summary.p50 = percentile(s, 0.50);
+        summary.p90 = percentile(s, 0.90);
+        summary.p99 = percentile(s, 0.99);
+
+        double q1 = percentile(s, 0.25), q3 = percentile(s, 0.75);
+        double fence = 1.5 * (q3 - q1);
+        for (double v : s) {
+            if (v < q1 - fence || v > q3 + fence) summary.outliers++;
+        }
+
+        bootstrap_median_ci(values, resamples, confidence, summary.ci_low, summary.ci_high);
+        return summary;
+    }
+
+    /**
+     * @brief Percentile of sorted values, by linear interpolation
+     *
+     * @param s Values in ascending order
+     * @param q Quantile in [0, 1]
+     * @return double The percentile (0 if s is empty)
+     */
+    static double percentile(const std::vector<double>& s, double q) {
+        if (s.empty()) return 0.0;
+        double pos = q * (s.size() - 1);
+        size_t lo = static_cast<size_t>(pos);
+        size_t hi = std::min(lo + 1, s.size() - 1);
+        return s[lo] + (pos - lo) * (s[hi] - s[lo]);
+    }
+
+    /**
+     * @brief Percentile bootstrap confidence interval of the median
+     *
+     * Uses a fixed seed, so the same timings always give the same interval.
+     *
+     * @param values Timings
+     * @param resamples Number of resamples
+     * @param confidence Confidence level
+     * @param low Output parameter for the lower bound
+     * @param high Output parameter for the upper bound
+     */
+    static void bootstrap_median_ci(const std::vector<double>& values, int resamples, double confidence,
+                                    double& low, double& high) {
+        if (values.size() < 2 || resamples < 1) {
+            low = high = values.empty() ? 0.0 : values[0];
+            return;
+        }
+        std::mt19937_64 rng(BOOTSTRAP_SEED);
+        std::uniform_int_distribution<size_t> pick(0, values.size() - 1);
+        std::vector<double> resample(values.size());
+        std::vector<double> medians;
+        medians.reserve(resamples);
+        for (int r = 0; r < resamples; ++r) {
+            for (double& v : resample) v = values[pick(rng)];
+            medians.push_back(median_of(resample.begin(), resample.end()));
+        }
+        std::sort(medians.begin(), medians.end());
+        double tail = (1.0 - confidence) / 2;
+        low = percentile(medians, tail);
+        high = percentile(medians, 1.0 - tail);
+    }
+
+    /**
+     * @brief Pin the calling thread to one CPU
+     *
+     * Threads the caller starts afterwards inherit the pinning.
+     *
+     * @param cpu CPU number
+     * @return bool False if the CPU does not exist or pinning is not permitted
+     */
+    static bool pin_to_cpu(int cpu) {
+#if defined(__linux__)
+        if (cpu < 0 || cpu >= CPU_SETSIZE) return false;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+        (void)cpu;
+        return false;
+#endif
+    }
+
+private:
+    // Warm-up compares the medians of two windows of this many runs
+    enum { WARMUP_WINDOW = 5 };
+    // The stopping rule is evaluated after at least CHECK_EVERY more runs, with fewer resamples
+    enum { CHECK_EVERY = 10, STOPPING_RESAMPLES = 200 };
+    static const uint64_t BOOTSTRAP_SEED = 0x5eed5eed5eed5eedULL;
+
+    Config config;
+    std::vector<double> times;
+
+    static std::vector<double> sorted(std::vector<double> values) {
+        std::sort(values.begin(), values.end());
+        return values;
+    }
+
+    template <typename It>
+    static double median_of(It first, It last) {
+        std::vector<double> v(first, last);
+        size_t mid = v.size() / 2;
+        std::nth_element(v.begin(), v.begin() + mid, v.end());
+        double upper = v[mid];
+        if (v.size() % 2 == 1) return upper;
+        return (*std::max_element(v.begin(), v.begin() + mid) + upper) / 2.0;
+    }
+};
+
+/**
+ * @brief Writer for the common benchmark result schema
+ *
+ * Every latency benchmark writes the same columns, so analyze_results.py
+ * --type bench (and bench comparison) can read any of them:
+ *
+ *   Benchmark,Algorithm,BitSize,Variant,Runs,WarmupRuns,Outliers,Converged,
+ *   MeanMs,StdDevMs,MinMs,P50Ms,P90Ms,P99Ms,MaxMs,CiLowMs,CiHighMs,
+ *   Cycles,Instructions,IPC,CacheMissRate,BranchMissRate,Extra
+ *
+ * Variant distinguishes configurations of one algorithm and size (search
+ * strategy, dispatch path, thread count); Extra holds benchmark-specific
+ * key=value pairs separated by semicolons.
+ *
+ * The raw timings go to a companion file next to it (foo.csv gets
+ * foo_samples.csv), one row per result with the runs separated by spaces:
+ *
+ *   Benchmark,Algorithm,BitSize,Variant,SamplesMs
+ *
+ * bench_compare.py tests those against a stored baseline.
+ *
+ * Results are either collected and written at the end (write()), or
+ * appended to the files as each one is added (open()), so that an
+ * interrupted run keeps what it finished and can be resumed. add() may be
+ * called from several threads.
+ */
+class BenchResults {
+public:
+    /**
+     * @brief Start a result set
+     *
+     * @param benchmark Value of the Benchmark column
+     */
+    explicit BenchResults(const std::string& benchmark) : benchmark(benchmark), streaming(false) {}
+
+    /**
+     * @brief Get the header line of the schema
+     */
+    static std::string header() {
+        return std::string("Benchmark,Algorithm,BitSize,Variant,Runs,WarmupRuns,Outliers,Converged,"
+                           "MeanMs,StdDevMs,MinMs,P50Ms,P90Ms,P99Ms,MaxMs,CiLowMs,CiHighMs,") +
+               PerfCounters::Sample::csv_header() + ",Extra";
+    }
+    
+    /**
+     * @brief Get the header line of the raw timings file
+     */
+    static std::string samples_header() {
+        return "Benchmark,Algorithm,BitSize,Variant,SamplesMs";
+    }
+    
+    /**
+     * @brief Get the path of the raw timings file for a results file
+     *
+     * @param path Results file
+     * @return std::string path with "_samples" inserted before a .csv extension
+     */
+    static std::string samples_path(const std::string& path) {
+        const std::string ext = ".csv";
+        if (path.size() > ext.size() && path.compare(path.size() - ext.size(), ext.size(), ext) == 0) {
+            return path.substr(0, path.size() - ext.size()) + "_samples" + ext;
+        }
+        return path + "_samples";
+    }
+
+    /**
+     * @brief Add a row
+     *
+     * @param algorithm Algorithm name
+     * @param bits Bit size
+     * @param variant Configuration label (may be empty)
+     * @param summary Timing statistics
+     * @param counters Hardware counters
+     * @param counted_ops Number of operations the counters cover (Cycles and Instructions are per operation)
+     * @param extra Benchmark-specific key=value pairs (may be empty)
+     */
+    void add(const std::string& algorithm, int bits, const std::string& variant,
+             const BenchHarness::Summary& summary, const PerfCounters::Sample& counters,
+             double counted_ops, const std::string& extra = "") {
+        std::ostringstream row;
+        row << key(algorithm, bits, variant) << ","
+            << summary.runs << "," << summary.warmup_runs << "," << summary.outliers << ","
+            << (summary.converged ? 1 : 0) << ","
+            << std::setprecision(6)
+            << summary.mean << "," << summary.stddev << "," << summary.min << ","
+            << summary.p50 << "," << summary.p90 << "," << summary.p99 << "," << summary.max << ","
+            << summary.ci_low << "," << summary.ci_high << ","
+            << counters.csv_row(counted_ops > 0 ? counted_ops : 1.0) << ","
+            << extra;
+        
+        std::ostringstream line;
+        if (!summary.samples.empty()) {
+            line << key(algorithm, bits, variant) << "," << std::setprecision(9);
+            for (size_t i = 0; i < summary.samples.size(); ++i) {
+                line << (i ? " " : "") << summary.samples[i];
+            }
+        }
+        
+        std::lock_guard<std::mutex> lock(mutex);
+        rows.push_back(row.str());
+        if (!summary.samples.empty()) sample_rows.push_back(line.str());
+        finished.insert(key(algorithm, bits, variant));
+        if (streaming) {
+            // The samples go first: a result row marks its samples as complete
+            if (!summary.samples.empty()) sample_out << line.str() << std::endl;
+            out << row.str() << std::endl;
+        }
+    }
+    
+    /**
+     * @brief Append every result to files as it is added
+     *
+     * With resume, results already in the files are kept and reported by
+     * contains(); a line cut off by an interrupted run is dropped, as are
+     * samples whose result row was never written. Rows of add_failed() are
+     * dropped too, so the resumed run measures those cells again. Otherwise (or if the file
+     * does not have this schema) the files are started afresh.
+     *
+     * @param path Results file; the raw timings go to samples_path(path)
+     * @param resume Keep the results of an earlier run
+     * @return bool False if the files could not be written
+     */
+    bool open(const std::string& path, bool resume) {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<std::string> kept_rows, kept_samples;
+        if (resume) {
+            std::vector<std::string> lines = complete_lines(path);
+            if (!lines.empty() && lines[0] == header()) {
+                for (size_t i = 1; i < lines.size(); ++i) {
+                    if (lines[i].compare(0, benchmark.size() + 1, benchmark + ",") != 0) continue;
+                    if (failed_line(lines[i])) continue;
+                    kept_rows.push_back(lines[i]);
+                    finished.insert(line_key(lines[i]));
+                }
+                std::vector<std::string> samples = complete_lines(samples_path(path));
+                for (size_t i = 1; i < samples.size(); ++i) {
+                    if (finished.count(line_key(samples[i]))) kept_samples.push_back(samples[i]);
+                }
+            }
+        }
+        
+        out.open(path, std::ios::trunc);
+        sample_out.open(samples_path(path), std::ios::trunc);
+        if (!out || !sample_out) {
+            std::cerr << "Error: Could not open output file " << path << std::endl;
+            return false;
+        }
+        out << header() << std::endl;
+        for (const auto& line : kept_rows) out << line << std::endl;
+        sample_out << samples_header() << std::endl;
+        for (const auto& line : kept_samples) sample_out << line << std::endl;
+        streaming = true;
+        return static_cast<bool>(out) && static_cast<bool>(sample_out);
+    }
+    
+    /**
+     * @brief Check whether a result is already present (added, or kept by open() with resume)
+     */
+    bool contains(const std::string& algorithm, int bits, const std::string& variant) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return finished.count(key(algorithm, bits, variant)) != 0;
+    }
+
+    /**
+     * @brief Add a row for a measurement that failed
+     */
+    void add_failed(const std::string& algorithm, int bits, const std::string& variant) {
+        add(algorithm, bits, variant, BenchHarness::Summary(), PerfCounters::Sample(), 1, "failed=1");
+    }
+
+    /**
+     * @brief Write the header and all rows to a file, and the raw timings next to it
+     *
+     * @param path Output file
+     * @return bool False if either file could not be written
+     */
+    bool write(const std::string& path) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return write_lines(path, header(), rows) &&
+               write_lines(samples_path(path), samples_header(), sample_rows);
+    }
+
+    /**
+     * @brief Print a summary in the benchmarks' progress format
+     *
+     * @param out Output stream
+     * @param summary Timing statistics
+     */
+    static void print(std::ostream& out, const BenchHarness::Summary& summary) {
+        out << " p50=" << summary.p50 << " ms [" << summary.ci_low << ", " << summary.ci_high << "]"
+            << " p90=" << summary.p90 << " p99=" << summary.p99
+            << " mean=" << summary.mean << " sd=" << summary.stddev
+            << " runs=" << summary.runs << " (+" << summary.warmup_runs << " warm-up)"
+            << " outliers=" << summary.outliers
+            << (summary.converged ? "" : " (CI target not reached)");
+    }
+
+private:
+    std::string benchmark;
+    std::vector<std::string> rows;
+    std::vector<std::string> sample_rows;
+    std::set<std::string> finished;     // Keys of the results present
+    bool streaming;                     // Rows are appended to out and sample_out
+    std::ofstream out, sample_out;
+    mutable std::mutex mutex;
+    
+    std::string key(const std::string& algorithm, int bits, const std::string& variant) const {
+        return benchmark + "," + algorithm + "," + std::to_string(bits) + "," + variant;
+    }
+    
+    // The key of a row: its first four fields
+    static std::string line_key(const std::string& line) {
+        size_t end = 0;
+        for (int field = 0; field < 4 && end != std::string::npos; ++field) {
+            end = line.find(',', end == 0 ? 0 : end + 1);
+        }
+        return line.substr(0, end);
+    }
+    
+    // Whether a row was written by add_failed(): its Extra column, the last, has failed=1
+    static bool failed_line(const std::string& line) {
+        std::string extra = ";" + line.substr(line.rfind(',') + 1) + ";";
+        return extra.find(";failed=1;") != std::string::npos;
+    }
+    
+    // The lines of a file that end in a newline (a run killed mid-write leaves a partial last line)
+    static std::vector<std::string> complete_lines(const std::string& path) {
+        std::vector<std::string> lines;
+        std::ifstream in(path);
+        if (!in) return lines;
+        std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        size_t start = 0, end;
+        while ((end = text.find('\n', start)) != std::string::npos) {
+            lines.push_back(text.substr(start, end - start));
+            start = end + 1;
+        }
+        return lines;
+    }
+    
+    static bool write_lines(const std::string& path, const std::string& first,
+                            const std::vector<std::string>& lines) {
+        std::ofstream out(path);
+        if (!out) {
+            std::cerr << "Error: Could not open output file " << path << std::endl;
+            return false;
+        }
+        out << first << std::endl;
+        for (const auto& line : lines) {
+            out << line << std::endl;
+        }
+        return static_cast<bool>(out);
+    }
+};
+
+#endif // BENCH_HARNESS_H
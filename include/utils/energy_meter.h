@@ -0,0 +1,182 @@
+#ifndef ENERGY_METER_H
+#define ENERGY_METER_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <dirent.h>
+
+/**
+ * @brief Cumulative energy counters of the machine, read from sysfs
+ *
+ * Reads the Linux powercap interface (/sys/class/powercap/intel-rapl:N,
+ * which the kernel also uses for AMD RAPL): one counter per CPU package,
+ * in microjoules, wrapping at max_energy_range_uj. Subzones (core, uncore,
+ * dram) are part of their package and not added again. Without powercap it
+ * falls back to hwmon energy sensors (energyN_input, microjoules), which
+ * some Arm and RISC-V boards provide through their power monitor.
+ *
+ * The counters usually wrap after minutes to hours, so sample() must be
+ * called at least once per wrap period; a long run calls it every second.
+ * Since Linux 5.10 energy_uj is readable by root only, in which case the
+ * meter reports itself unavailable.
+ *
+ * Not thread-safe: one thread samples the meter.
+ */
+class EnergyMeter {
+public:
+    /**
+     * @brief Find the readable energy counters
+     *
+     * @param powercap_root Directory of the powercap zones
+     * @param hwmon_root Directory of the hwmon devices
+     */
+    explicit EnergyMeter(const std::string& powercap_root = "/sys/class/powercap",
+                         const std::string& hwmon_root = "/sys/class/hwmon")
+        : total_uj(0) {
+        find_powercap(powercap_root);
+        if (zones.empty()) find_hwmon(hwmon_root);
+        start();
+    }
+
+    /**
+     * @brief Check whether any energy counter could be read
+     */
+    bool available() const {
+        return !zones.empty();
+    }
+
+    /**
+     * @brief Describe the counters, e.g. "rapl:package-0+package-1"
+     *
+     * @return std::string The description, or "none"
+     */
+    std::string source() const {
+        if (zones.empty()) return "none";
+        std::string out = kind + ":";
+        for (size_t i = 0; i < zones.size(); ++i) {
+            out += (i ? "+" : "") + zones[i].name;
+        }
+        return out;
+    }
+
+    /**
+     * @brief Start measuring from now
+     */
+    void start() {
+        total_uj = 0;
+        for (Zone& zone : zones) {
+            read_counter(zone.path, zone.last);
+        }
+    }
+
+    /**
+     * @brief Read the counters and add what was used since the last sample
+     *
+     * A counter that went backwards wrapped once; its range is added back.
+     */
+    void sample() {
+        for (Zone& zone : zones) {
+            uint64_t now;
+            if (!read_counter(zone.path, now)) continue;
+            if (now >= zone.last) {
+                total_uj += now - zone.last;
+            } else if (zone.range > 0) {
+                total_uj += zone.range - zone.last + now;
+            }
+            zone.last = now;
+        }
+    }
+
+    /**
+     * @brief Get the energy used between start() and the last sample()
+     *
+     * @return double Energy in joules (0 if no counter is available)
+     */
+    double joules() const {
+        return total_uj / 1e6;
+    }
+
+private:
+    struct Zone {
+        std::string name;
+        std::string path;   // Counter file
+        uint64_t range;     // Value at which the counter wraps (0 if unknown)
+        uint64_t last;      // Counter at the last sample
+    };
+
+    std::vector<Zone> zones;
+    std::string kind;
+    uint64_t total_uj;
+
+    static bool read_counter(const std::string& path, uint64_t& value) {
+        std::ifstream in(path);
+        return static_cast<bool>(in >> value);
+    }
+
+    static std::string read_line(const std::string& path) {
+        std::ifstream in(path);
+        std::string line;
+        std::getline(in, line);
+        return line;
+    }
+
+    static std::vector<std::string> list_dir(const std::string& path) {
+        std::vector<std::string> names;
+        DIR* dir = opendir(path.c_str());
+        if (!dir) return names;
+        while (struct dirent* entry = readdir(dir)) {
+            std::string name = entry->d_name;
+            if (name != "." && name != "..") names.push_back(name);
+        }
+        closedir(dir);
+        return names;
+    }
+
+    /**
+     * @brief Add the package zones intel-rapl:N (not the subzones intel-rapl:N:M)
+     */
+    void find_powercap(const std::string& root) {
+        for (const std::string& entry : list_dir(root)) {
+            const std::string prefix = "intel-rapl:";
+            if (entry.compare(0, prefix.size(), prefix) != 0) continue;
+            if (entry.find(':', prefix.size()) != std::string::npos) continue;
+
+            Zone zone;
+            zone.path = root + "/" + entry + "/energy_uj";
+            if (!read_counter(zone.path, zone.last)) continue;
+            if (!read_counter(root + "/" + entry + "/max_energy_range_uj", zone.range)) zone.range = 0;
+            zone.name = read_line(root + "/" + entry + "/name");
+            if (zone.name.empty()) zone.name = entry;
+            zones.push_back(zone);
+        }
+        if (!zones.empty()) kind = "rapl";
+    }
+
+    /**
+     * @brief Add every readable hwmon energy sensor
+     */
+    void find_hwmon(const std::string& root) {
+        for (const std::string& device : list_dir(root)) {
+            std::string dir = root + "/" + device;
+            std::string device_name = read_line(dir + "/name");
+            for (const std::string& file : list_dir(dir)) {
+                if (file.compare(0, 6, "energy") != 0) continue;
+                if (file.size() < 12 || file.compare(file.size() - 6, 6, "_input") != 0) continue;
+
+                Zone zone;
+                zone.path = dir + "/" + file;
+                if (!read_counter(zone.path, zone.last)) continue;
+                zone.range = 0;
+                std::string label = read_line(dir + "/" + file.substr(0, file.size() - 6) + "_label");
+                zone.name = (device_name.empty() ? device : device_name) + "/" +
+                            (label.empty() ? file.substr(0, file.size() - 6) : label);
+                zones.push_back(zone);
+            }
+        }
+        if (!zones.empty()) kind = "hwmon";
+    }
+};
+
+#endif // ENERGY_METER_H
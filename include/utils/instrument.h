@@ -0,0 +1,402 @@
+#ifndef INSTRUMENT_H
+#define INSTRUMENT_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Hot-path counters and cycle timers, compiled in with PRIME_INSTRUMENT
+ *
+ * The primality code marks its interesting events with PRIME_COUNT,
+ * PRIME_COUNT_N and PRIME_TIME. Without PRIME_INSTRUMENT (the default) the
+ * macros expand to nothing and this header costs nothing. Build with
+ * `make INSTRUMENT=1` to turn them on.
+ *
+ * With instrumentation on, every thread counts into its own block, so a
+ * counter update is a plain load and store on a cache line no other thread
+ * writes. collect() sums the blocks of the running threads and of the
+ * threads that have exited. Timers accumulate timestamp-counter ticks (see
+ * ticks()) and the number of timed calls.
+ *
+ * An instrumented binary writes the totals when it exits and whenever it
+ * receives SIGUSR1, to stderr or to the file named by $PRIME_INSTRUMENT_OUT,
+ * as JSON or, with PRIME_INSTRUMENT_FORMAT=csv, as CSV. GMP heap operations
+ * are counted through AllocStats, which is installed for that purpose.
+ */
+namespace Instrument {
+    /**
+     * @brief Event counters
+     */
+    enum Counter {
+        CANDIDATES,         // Numbers produced by a prime search (sieve survivors or random draws)
+        SIEVE_REJECTS,      // Numbers struck out by the search sieve without a test
+        TESTED,             // Numbers that entered the screening pipeline
+        TRIAL_REJECTS,      // Rejected by trial division
+        BASE2_REJECTS,      // Rejected by the base-2 strong round
+        ROUND_REJECTS,      // Rejected by a further Miller-Rabin round
+        LUCAS_REJECTS,      // Rejected by the strong Lucas test
+        ACCEPTED,           // Declared (probably) prime
+        POWM_CALLS,         // Calls to mpz_powm
+        POWM_EXP_BITS,      // Exponent bits passed to mpz_powm (squarings done inside GMP)
+        MOD_SQRS,           // mpz squarings mod n in the strong round's squaring loop
+        MONT_MULS,          // ModContext multiplications and squarings
+        LIMB_MULS,          // Limb products in those (schoolbook count, product plus reduction)
+        NUM_COUNTERS
+    };
+
+    /**
+     * @brief Timed regions
+     */
+    enum Timer {
+        T_IS_PRIME,         // PrimalityTester::is_prime
+        T_SEARCH,           // PrimalityTester::generate_prime
+        T_TRIAL,            // Trial division stage
+        T_BASE2,            // Base-2 strong round
+        T_ROUNDS,           // Remaining Miller-Rabin rounds
+        T_LUCAS,            // Strong Lucas test
+        NUM_TIMERS
+    };
+
+    /**
+     * @brief Get the name of a counter, as used in the output
+     */
+    const char* counter_name(int counter) {
+        static const char* const names[NUM_COUNTERS] = {
+            "candidates", "sieve_rejects", "tested", "trial_rejects", "base2_rejects",
+            "round_rejects", "lucas_rejects", "accepted", "powm_calls", "powm_exp_bits",
+            "mod_sqrs", "mont_muls", "limb_muls"
+        };
+        return names[counter];
+    }
+
+    /**
+     * @brief Get the name of a timer, as used in the output
+     */
+    const char* timer_name(int timer) {
+        static const char* const names[NUM_TIMERS] = {
+            "is_prime", "search", "trial_division", "base2_round", "mr_rounds", "lucas"
+        };
+        return names[timer];
+    }
+
+    /**
+     * @brief Read the timestamp counter
+     *
+     * rdtsc on x86, the virtual counter on AArch64, the time CSR on RISC-V
+     * (rdcycle is not readable from user space on current Linux kernels), and
+     * steady_clock nanoseconds elsewhere. Only differences are meaningful.
+     *
+     * @return uint64_t Current tick count
+     */
+    inline uint64_t ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+        uint32_t lo, hi;
+        __asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+        return (static_cast<uint64_t>(hi) << 32) | lo;
+#elif defined(__aarch64__)
+        uint64_t value;
+        __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(value));
+        return value;
+#elif defined(__riscv) && __riscv_xlen == 64
+        uint64_t value;
+        __asm__ __volatile__("rdtime %0" : "=r"(value));
+        return value;
+#else
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+    }
+
+    /**
+     * @brief Summed counters of all threads
+     */
+    struct Totals {
+        uint64_t counts[NUM_COUNTERS];
+        uint64_t timer_calls[NUM_TIMERS];
+        uint64_t timer_ticks[NUM_TIMERS];
+        unsigned int threads;               // Threads that have counted anything
+
+        Totals() : threads(0) {
+            std::memset(counts, 0, sizeof(counts));
+            std::memset(timer_calls, 0, sizeof(timer_calls));
+            std::memset(timer_ticks, 0, sizeof(timer_ticks));
+        }
+    };
+
+    namespace detail {
+        /**
+         * @brief One thread's counters
+         *
+         * Only the owning thread writes; collect() reads them from any thread,
+         * hence the relaxed atomics.
+         */
+        struct alignas(64) Block {
+            std::atomic<uint64_t> counts[NUM_COUNTERS];
+            std::atomic<uint64_t> timer_calls[NUM_TIMERS];
+            std::atomic<uint64_t> timer_ticks[NUM_TIMERS];
+
+            Block() {
+                for (auto& c : counts) c.store(0, std::memory_order_relaxed);
+                for (auto& c : timer_calls) c.store(0, std::memory_order_relaxed);
+                for (auto& c : timer_ticks) c.store(0, std::memory_order_relaxed);
+            }
+
+            void add_to(Totals& totals) const {
+                for (int i = 0; i < NUM_COUNTERS; ++i) totals.counts[i] += counts[i].load(std::memory_order_relaxed);
+                for (int i = 0; i < NUM_TIMERS; ++i) {
+                    totals.timer_calls[i] += timer_calls[i].load(std::memory_order_relaxed);
+                    totals.timer_ticks[i] += timer_ticks[i].load(std::memory_order_relaxed);
+                }
+                totals.threads++;
+            }
+        };
+
+        /**
+         * @brief Blocks of the running threads and the sum of the exited ones
+         *
+         * Allocated once and never freed, so it outlives every thread-local
+         * block and the exit-time dump.
+         */
+        struct Registry {
+            std::mutex mutex;
+            std::vector<const Block*> live;
+            Totals retired;
+        };
+
+        Registry& registry() {
+            static Registry* instance = new Registry();
+            return *instance;
+        }
+
+        /**
+         * @brief Registers a thread's block on first use and folds it into the
+         *        retired totals when the thread exits
+         */
+        struct ThreadSlot {
+            Block block;
+
+            ThreadSlot() {
+                Registry& r = registry();
+                std::lock_guard<std::mutex> lock(r.mutex);
+                r.live.push_back(&block);
+            }
+
+            ~ThreadSlot() {
+                Registry& r = registry();
+                std::lock_guard<std::mutex> lock(r.mutex);
+                block.add_to(r.retired);
+                for (size_t i = 0; i < r.live.size(); ++i) {
+                    if (r.live[i] == &block) {
+                        r.live.erase(r.live.begin() + i);
+                        break;
+                    }
+                }
+            }
+        };
+
+        inline Block& local() {
+            thread_local ThreadSlot slot;
+            return slot.block;
+        }
+
+        inline void bump(std::atomic<uint64_t>& counter, uint64_t amount) {
+            counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+        }
+    };
+
+    /**
+     * @brief Add to a counter of the calling thread
+     *
+     * @param counter The counter
+     * @param amount Amount to add
+     */
+    inline void add(Counter counter, uint64_t amount = 1) {
+        detail::bump(detail::local().counts[counter], amount);
+    }
+
+    /**
+     * @brief Adds the ticks spent in its scope to a timer of the calling thread
+     */
+    class ScopedTimer {
+    public:
+        explicit ScopedTimer(Timer timer) : timer(timer), start(ticks()) {}
+
+        ~ScopedTimer() {
+            detail::Block& block = detail::local();
+            detail::bump(block.timer_ticks[timer], ticks() - start);
+            detail::bump(block.timer_calls[timer], 1);
+        }
+
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    private:
+        Timer timer;
+        uint64_t start;
+    };
+
+    /**
+     * @brief Sum the counters of all threads, running and exited
+     *
+     * @return Totals The sums
+     */
+    Totals collect() {
+        detail::Registry& r = detail::registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        Totals totals = r.retired;
+        for (const detail::Block* block : r.live) {
+            block->add_to(totals);
+        }
+        return totals;
+    }
+
+    /**
+     * @brief Write totals as one JSON object
+     *
+     * @param out Output stream
+     * @param totals The totals
+     * @param gmp_heap GMP allocs, reallocs and frees, or nullptr if not counted
+     */
+    void write_json(std::ostream& out, const Totals& totals, const uint64_t* gmp_heap) {
+        out << "{\"threads\": " << totals.threads << ", \"counters\": {";
+        for (int i = 0; i < NUM_COUNTERS; ++i) {
+            out << (i ? ", " : "") << "\"" << counter_name(i) << "\": " << totals.counts[i];
+        }
+        out << "}, \"timers\": {";
+        for (int i = 0; i < NUM_TIMERS; ++i) {
+            out << (i ? ", " : "") << "\"" << timer_name(i) << "\": {\"calls\": " << totals.timer_calls[i]
+                << ", \"ticks\": " << totals.timer_ticks[i] << "}";
+        }
+        out << "}";
+        if (gmp_heap != nullptr) {
+            out << ", \"gmp\": {\"allocs\": " << gmp_heap[0] << ", \"reallocs\": " << gmp_heap[1]
+                << ", \"frees\": " << gmp_heap[2] << "}";
+        }
+        out << "}" << std::endl;
+    }
+
+    /**
+     * @brief Write totals as CSV with the columns Section,Name,Count,Ticks
+     *
+     * @param out Output stream
+     * @param totals The totals
+     * @param gmp_heap GMP allocs, reallocs and frees, or nullptr if not counted
+     */
+    void write_csv(std::ostream& out, const Totals& totals, const uint64_t* gmp_heap) {
+        out << "Section,Name,Count,Ticks\n";
+        out << "process,threads," << totals.threads << ",\n";
+        for (int i = 0; i < NUM_COUNTERS; ++i) {
+            out << "counter," << counter_name(i) << "," << totals.counts[i] << ",\n";
+        }
+        for (int i = 0; i < NUM_TIMERS; ++i) {
+            out << "timer," << timer_name(i) << "," << totals.timer_calls[i] << "," << totals.timer_ticks[i] << "\n";
+        }
+        if (gmp_heap != nullptr) {
+            out << "gmp,allocs," << gmp_heap[0] << ",\n"
+                << "gmp,reallocs," << gmp_heap[1] << ",\n"
+                << "gmp,frees," << gmp_heap[2] << ",\n";
+        }
+        out.flush();
+    }
+};
+
+#ifdef PRIME_INSTRUMENT
+
+#include <csignal>
+#include <pthread.h>
+#include <thread>
+#include "alloc_stats.h"
+
+namespace Instrument {
+    /**
+     * @brief Write the current totals to the configured destination
+     *
+     * $PRIME_INSTRUMENT_OUT names a file to append to (stderr if unset);
+     * $PRIME_INSTRUMENT_FORMAT selects json (default) or csv.
+     */
+    void dump() {
+        Totals totals = collect();
+        AllocStats::Counts heap = AllocStats::snapshot();
+        uint64_t gmp_heap[3] = { heap.allocs, heap.reallocs, heap.frees };
+
+        const char* format = std::getenv("PRIME_INSTRUMENT_FORMAT");
+        bool csv = format != nullptr && std::strcmp(format, "csv") == 0;
+        const char* path = std::getenv("PRIME_INSTRUMENT_OUT");
+
+        if (path != nullptr && *path != '\0') {
+            std::ofstream file(path, std::ios::app);
+            if (file) {
+                csv ? write_csv(file, totals, gmp_heap) : write_json(file, totals, gmp_heap);
+                return;
+            }
+        }
+        csv ? write_csv(std::cerr, totals, gmp_heap) : write_json(std::cerr, totals, gmp_heap);
+    }
+
+    namespace detail {
+        /**
+         * @brief Body of the thread that dumps on SIGUSR1
+         */
+        void signal_loop(sigset_t signals) {
+            while (true) {
+                int signal = 0;
+                if (sigwait(&signals, &signal) == 0 && signal == SIGUSR1) {
+                    dump();
+                }
+            }
+        }
+
+        void dump_at_exit() {
+            dump();
+        }
+
+        /**
+         * @brief Installs the hooks during static initialization
+         *
+         * SIGUSR1 is blocked here, before main() starts any thread, so every
+         * thread inherits the mask and the signal is only ever taken by
+         * sigwait in the dump thread, never inside the code being measured.
+         */
+        struct AutoInstall {
+            AutoInstall() {
+                AllocStats::install();
+                std::atexit(dump_at_exit);
+
+                sigset_t signals;
+                sigemptyset(&signals);
+                sigaddset(&signals, SIGUSR1);
+                if (pthread_sigmask(SIG_BLOCK, &signals, nullptr) == 0) {
+                    std::thread(signal_loop, signals).detach();
+                }
+            }
+        };
+
+        AutoInstall auto_install;
+    };
+};
+
+#define PRIME_COUNT(counter) Instrument::add(Instrument::counter)
+#define PRIME_COUNT_N(counter, amount) Instrument::add(Instrument::counter, (amount))
+#define PRIME_TIME_CONCAT2(a, b) a##b
+#define PRIME_TIME_CONCAT(a, b) PRIME_TIME_CONCAT2(a, b)
+#define PRIME_TIME(timer) Instrument::ScopedTimer PRIME_TIME_CONCAT(prime_timer_, __LINE__)(Instrument::timer)
+
+#else
+
+#define PRIME_COUNT(counter) ((void)0)
+#define PRIME_COUNT_N(counter, amount) ((void)0)
+#define PRIME_TIME(timer) ((void)0)
+
+#endif // PRIME_INSTRUMENT
+
+#endif // INSTRUMENT_H
@@ -0,0 +1,175 @@
+#ifndef MEM_PROFILE_H
+#define MEM_PROFILE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <sys/resource.h>
+#include "alloc_stats.h"
+
+/**
+ * @brief Memory footprint of one stretch of work (--mem-profile)
+ *
+ * begin() and end() bracket the work: end() reports GMP heap operations
+ * and bytes per operation, the most bytes GMP held at once, and the peak
+ * resident set size of the process. The GMP figures come from AllocStats,
+ * so MemProfile::install() must run at the start of main(), before any mpz_t
+ * is initialized.
+ *
+ * On Linux begin() resets the kernel's RSS high-water mark (writing 5 to
+ * /proc/self/clear_refs), so the peak RSS belongs to the bracketed work.
+ * Where that is not possible the peak counts from process start, and the
+ * report says so. Both peaks are process-wide: bracket one stretch of work
+ * at a time.
+ */
+class MemProfile {
+public:
+    /**
+     * @brief Result of a bracketed stretch of work
+     */
+    struct Report {
+        double allocs_per_op;     // GMP allocate calls per operation
+        double reallocs_per_op;   // GMP reallocate calls per operation
+        double bytes_per_op;      // Bytes requested from GMP's allocator per operation
+        uint64_t peak_live_bytes; // Most bytes GMP held at once
+        uint64_t peak_rss_bytes;  // Peak resident set size, 0 if unknown
+        bool rss_from_start;      // peak_rss_bytes counts from process start
+
+        Report()
+            : allocs_per_op(0), reallocs_per_op(0), bytes_per_op(0), peak_live_bytes(0),
+              peak_rss_bytes(0), rss_from_start(false) {}
+
+        /**
+         * @brief Format the report as key=value pairs for a CSV Extra column
+         *
+         * @return std::string e.g. "allocs_per_op=0.000;reallocs_per_op=0.000;bytes_per_op=0.0;peak_live_bytes=4096;peak_rss_bytes=3964928"
+         */
+        std::string extra() const {
+            std::ostringstream out;
+            out << std::fixed << std::setprecision(3) << "allocs_per_op=" << allocs_per_op
+                << ";reallocs_per_op=" << reallocs_per_op
+                << std::setprecision(1) << ";bytes_per_op=" << bytes_per_op
+                << ";peak_live_bytes=" << peak_live_bytes
+                << ";peak_rss_bytes=" << peak_rss_bytes;
+            if (rss_from_start) out << ";rss_from_start=1";
+            return out.str();
+        }
+
+        /**
+         * @brief Format the report for progress output
+         *
+         * @return std::string e.g. "allocs/op=0.000 reallocs/op=0.000 bytes/op=0.0 peak_live=4.0KiB peak_rss=3872.0KiB"
+         */
+        std::string summary() const {
+            std::ostringstream out;
+            out << std::fixed << std::setprecision(3) << "allocs/op=" << allocs_per_op
+                << " reallocs/op=" << reallocs_per_op
+                << std::setprecision(1) << " bytes/op=" << bytes_per_op
+                << " peak_live=" << peak_live_bytes / 1024.0 << "KiB"
+                << " peak_rss=" << peak_rss_bytes / 1024.0 << "KiB";
+            return out.str();
+        }
+    };
+
+    /**
+     * @brief Install the GMP allocation hook (call first thing in main)
+     */
+    static void install() {
+        AllocStats::install();
+    }
+
+    /**
+     * @brief Check whether profiling is on
+     *
+     * @return bool True after install()
+     */
+    static bool enabled() {
+        return AllocStats::installed();
+    }
+
+    /**
+     * @brief Construct a profile whose stretch starts now (without resetting the peaks)
+     */
+    MemProfile() : rss_reset(false) {
+        start = AllocStats::snapshot();
+    }
+
+    /**
+     * @brief Start a stretch of work: reset both peaks and take the counters
+     */
+    void begin() {
+        AllocStats::reset_peak();
+        rss_reset = reset_peak_rss();
+        start = AllocStats::snapshot();
+    }
+
+    /**
+     * @brief End the stretch of work started by begin()
+     *
+     * @param ops Number of operations done in between (at least 1 is assumed)
+     * @return Report The footprint per operation and the peaks
+     */
+    Report end(double ops) const {
+        AllocStats::Counts used = AllocStats::since(AllocStats::snapshot(), start);
+        if (ops < 1) ops = 1;
+
+        Report report;
+        report.allocs_per_op = used.allocs / ops;
+        report.reallocs_per_op = used.reallocs / ops;
+        report.bytes_per_op = used.bytes / ops;
+        report.peak_live_bytes = AllocStats::peak_bytes();
+        report.peak_rss_bytes = peak_rss_bytes();
+        report.rss_from_start = !rss_reset;
+        return report;
+    }
+
+    /**
+     * @brief Reset the kernel's peak RSS of this process to its current RSS
+     *
+     * @return bool False if the kernel does not support it (not Linux, or before 4.0)
+     */
+    static bool reset_peak_rss() {
+        FILE* file = std::fopen("/proc/self/clear_refs", "w");
+        if (file == nullptr) return false;
+        bool ok = std::fputs("5", file) >= 0;
+        return std::fclose(file) == 0 && ok;
+    }
+
+    /**
+     * @brief Get the peak resident set size of this process
+     *
+     * Reads VmHWM from /proc/self/status, which reset_peak_rss() lowers, and
+     * falls back to getrusage(), which counts from process start.
+     *
+     * @return uint64_t Peak RSS in bytes, 0 if unknown
+     */
+    static uint64_t peak_rss_bytes() {
+        FILE* file = std::fopen("/proc/self/status", "r");
+        if (file != nullptr) {
+            char line[256];
+            unsigned long long kib = 0;
+            bool found = false;
+            while (!found && std::fgets(line, sizeof(line), file) != nullptr) {
+                found = std::sscanf(line, "VmHWM: %llu kB", &kib) == 1;
+            }
+            std::fclose(file);
+            if (found) return static_cast<uint64_t>(kib) * 1024;
+        }
+
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#if defined(__APPLE__)
+        return static_cast<uint64_t>(usage.ru_maxrss);         // Bytes on macOS
+#else
+        return static_cast<uint64_t>(usage.ru_maxrss) * 1024;  // KiB on Linux
+#endif
+    }
+
+private:
+    AllocStats::Counts start;
+    bool rss_reset;
+};
+
+#endif // MEM_PROFILE_H
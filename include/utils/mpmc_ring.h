@@ -0,0 +1,124 @@
+#ifndef MPMC_RING_H
+#define MPMC_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/**
+ * @brief Bounded lock-free multi-producer multi-consumer queue
+ *
+ * Every cell carries a sequence number that says whether it is ready for the
+ * next push or the next pop at its position, so push and pop each claim a
+ * position with one compare-and-swap and never block. The capacity is
+ * rounded up to a power of two.
+ *
+ * T should be cheap to copy (the prime pool passes slot indices through it).
+ *
+ * Reference: Vyukov, D. Bounded MPMC queue.
+ * https://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+ */
+template <typename T>
+class MpmcRing {
+public:
+    /**
+     * @brief Construct an empty ring
+     *
+     * @param min_capacity Minimum number of elements the ring can hold
+     */
+    explicit MpmcRing(size_t min_capacity) : enqueue_pos(0), dequeue_pos(0) {
+        size_t capacity = 1;
+        while (capacity < min_capacity) {
+            capacity <<= 1;
+        }
+        mask = capacity - 1;
+        cells.reset(new Cell[capacity]);
+        for (size_t i = 0; i < capacity; ++i) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpmcRing(const MpmcRing&) = delete;
+    MpmcRing& operator=(const MpmcRing&) = delete;
+
+    /**
+     * @brief Add an element
+     *
+     * @param value Element to add
+     * @return bool False if the ring is full
+     */
+    bool push(const T& value) {
+        size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+        while (true) {
+            Cell& cell = cells[pos & mask];
+            size_t seq = cell.sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.value = value;
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;  // The cell still holds an element from the previous lap
+            } else {
+                pos = enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * @brief Remove the oldest element
+     *
+     * @param value Output parameter for the element
+     * @return bool False if the ring is empty
+     */
+    bool pop(T& value) {
+        size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+        while (true) {
+            Cell& cell = cells[pos & mask];
+            size_t seq = cell.sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    value = cell.value;
+                    cell.sequence.store(pos + mask + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;  // No element has been pushed to this cell yet
+            } else {
+                pos = dequeue_pos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * @brief Get the number of elements the ring can hold
+     *
+     * @return size_t Capacity (a power of two)
+     */
+    size_t capacity() const {
+        return mask + 1;
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    // Producers and consumers update different counters; keep them on separate cache lines
+    static const size_t CACHE_LINE = 64;
+
+    std::unique_ptr<Cell[]> cells;
+    size_t mask;
+    char pad0[CACHE_LINE];
+    std::atomic<size_t> enqueue_pos;
+    char pad1[CACHE_LINE];
+    std::atomic<size_t> dequeue_pos;
+    char pad2[CACHE_LINE];
+};
+
+#endif // MPMC_RING_H
@@ -23,6 +23,17 @@ namespace MPZUtils {
         gmp_randseed_ui(state, seed);
     }
     
+    /**
+     * @brief Initialize a GMP random state with an explicit seed
+     * 
+     * @param state The GMP random state to initialize
+     * @param seed Seed value
+     */
+    void init_gmp_random(gmp_randstate_t state, unsigned long seed) {
+        gmp_randinit_mt(state);
+        gmp_randseed_ui(state, seed);
+    }
+    
     /**
      * @brief Clear a GMP random state
      * 
@@ -0,0 +1,461 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <csetjmp>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+/**
+ * @brief Serialized timestamp counter reads for timing short code sections
+ *
+ * start() and stop() are fenced so the measured instructions can neither
+ * start before the first read nor finish after the second: lfence + rdtsc and
+ * rdtscp + lfence on x86, isb around the virtual counter on AArch64, fence +
+ * rdcycle (or rdtime, if user-mode cycle reads are not permitted) on
+ * RISC-V, and steady_clock elsewhere. overhead() is the calibrated cost of
+ * an empty start/stop pair, which elapsed() subtracts.
+ */
+namespace CycleTimer {
+    namespace detail {
+#if defined(__riscv) && __riscv_xlen == 64
+        sigjmp_buf probe_jump;
+
+        void probe_handler(int) {
+            siglongjmp(probe_jump, 1);
+        }
+
+        /**
+         * @brief Check once whether rdcycle works in user mode
+         *
+         * Linux 6.6 and later trap it unless perf_user_access is set, so the
+         * first read runs under a temporary SIGILL handler.
+         */
+        bool rdcycle_allowed() {
+            static int allowed = -1;
+            if (allowed < 0) {
+                struct sigaction action, previous;
+                std::memset(&action, 0, sizeof(action));
+                action.sa_handler = probe_handler;
+                sigaction(SIGILL, &action, &previous);
+                if (sigsetjmp(probe_jump, 1) == 0) {
+                    uint64_t value;
+                    __asm__ __volatile__("rdcycle %0" : "=r"(value));
+                    allowed = 1;
+                } else {
+                    allowed = 0;
+                }
+                sigaction(SIGILL, &previous, nullptr);
+            }
+            return allowed == 1;
+        }
+#endif
+    };
+
+    /**
+     * @brief Read the counter at the start of a measured section
+     *
+     * @return uint64_t Counter value
+     */
+    inline uint64_t start() {
+#if defined(__x86_64__) || defined(__i386__)
+        uint32_t lo, hi;
+        __asm__ __volatile__("lfence\n\trdtsc" : "=a"(lo), "=d"(hi) :: "memory");
+        return (static_cast<uint64_t>(hi) << 32) | lo;
+#elif defined(__aarch64__)
+        uint64_t value;
+        __asm__ __volatile__("isb\n\tmrs %0, cntvct_el0" : "=r"(value) :: "memory");
+        return value;
+#elif defined(__riscv) && __riscv_xlen == 64
+        uint64_t value;
+        if (detail::rdcycle_allowed()) {
+            __asm__ __volatile__("fence\n\trdcycle %0" : "=r"(value) :: "memory");
+        } else {
+            __asm__ __volatile__("fence\n\trdtime %0" : "=r"(value) :: "memory");
+        }
+        return value;
+#else
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+    }
+
+    /**
+     * @brief Read the counter at the end of a measured section
+     *
+     * @return uint64_t Counter value
+     */
+    inline uint64_t stop() {
+#if defined(__x86_64__) || defined(__i386__)
+        uint32_t lo, hi, aux;
+        __asm__ __volatile__("rdtscp\n\tlfence" : "=a"(lo), "=d"(hi), "=c"(aux) :: "memory");
+        return (static_cast<uint64_t>(hi) << 32) | lo;
+#elif defined(__aarch64__)
+        uint64_t value;
+        __asm__ __volatile__("isb\n\tmrs %0, cntvct_el0\n\tisb" : "=r"(value) :: "memory");
+        return value;
+#elif defined(__riscv) && __riscv_xlen == 64
+        uint64_t value;
+        if (detail::rdcycle_allowed()) {
+            __asm__ __volatile__("rdcycle %0\n\tfence" : "=r"(value) :: "memory");
+        } else {
+            __asm__ __volatile__("rdtime %0\n\tfence" : "=r"(value) :: "memory");
+        }
+        return value;
+#else
+        return start();
+#endif
+    }
+
+    /**
+     * @brief Get the cost of an empty start/stop pair
+     *
+     * Calibrated on first use as the minimum over many pairs.
+     *
+     * @return uint64_t Overhead in ticks
+     */
+    uint64_t overhead() {
+        static uint64_t cost = [] {
+            uint64_t best = UINT64_MAX;
+            for (int i = 0; i < 1000; ++i) {
+                uint64_t t0 = start();
+                uint64_t t1 = stop();
+                best = std::min(best, t1 - t0);
+            }
+            return best;
+        }();
+        return cost;
+    }
+
+    /**
+     * @brief Get the tick rate of the counter
+     *
+     * Calibrated on first use against steady_clock over about 20 ms.
+     *
+     * @return double Ticks per nanosecond
+     */
+    double ticks_per_ns() {
+        static double rate = [] {
+            auto wall0 = std::chrono::steady_clock::now();
+            uint64_t t0 = start();
+            while (std::chrono::steady_clock::now() - wall0 < std::chrono::milliseconds(20)) {
+            }
+            uint64_t t1 = stop();
+            auto wall1 = std::chrono::steady_clock::now();
+            double ns = std::chrono::duration<double, std::nano>(wall1 - wall0).count();
+            return ns > 0 ? (t1 - t0) / ns : 1.0;
+        }();
+        return rate;
+    }
+
+    /**
+     * @brief Ticks between two reads, with the timer overhead removed
+     *
+     * @param t0 Value from start()
+     * @param t1 Value from stop()
+     * @return uint64_t Elapsed ticks (0 if below the overhead)
+     */
+    inline uint64_t elapsed(uint64_t t0, uint64_t t1) {
+        uint64_t ticks = t1 - t0;
+        uint64_t cost = overhead();
+        return ticks > cost ? ticks - cost : 0;
+    }
+
+    /**
+     * @brief Convert ticks to milliseconds
+     *
+     * @param ticks Elapsed ticks
+     * @return double Milliseconds
+     */
+    inline double to_ms(uint64_t ticks) {
+        return ticks / ticks_per_ns() / 1e6;
+    }
+};
+
+/**
+ * @brief Hardware event counts for a section of code
+ *
+ * On Linux the counters are one perf_event group (cycles, instructions,
+ * cache references and misses, branches and branch misses) counting user
+ * mode of the calling thread, read in a single read() and scaled if the
+ * kernel had to multiplex them. On RISC-V, where the PMU driver is often
+ * missing, cycles and instructions fall back to the rdcycle and rdinstret
+ * counters when user access is enabled.
+ *
+ * Events the machine does not provide (virtual machines often have no PMU
+ * at all) are reported as unavailable, and every derived value as NaN, so
+ * benchmarks can always print the columns.
+ *
+ * Usage: counters.start(); work(); PerfCounters::Sample s = counters.stop();
+ */
+class PerfCounters {
+public:
+    /**
+     * @brief Counted events
+     */
+    enum Event {
+        CYCLES,
+        INSTRUCTIONS,
+        CACHE_REFERENCES,
+        CACHE_MISSES,
+        BRANCHES,
+        BRANCH_MISSES,
+        NUM_EVENTS
+    };
+
+    /**
+     * @brief Event counts of one or more measured sections
+     */
+    struct Sample {
+        uint64_t values[NUM_EVENTS];
+        bool valid[NUM_EVENTS];
+
+        Sample() {
+            std::fill(values, values + NUM_EVENTS, 0);
+            std::fill(valid, valid + NUM_EVENTS, false);
+        }
+
+        /**
+         * @brief Add the counts of another section
+         */
+        Sample& operator+=(const Sample& other) {
+            for (int i = 0; i < NUM_EVENTS; ++i) {
+                values[i] += other.values[i];
+                valid[i] = valid[i] || other.valid[i];
+            }
+            return *this;
+        }
+
+        /**
+         * @brief Get an event count as a double
+         *
+         * @return double The count, or NaN if the event was not counted
+         */
+        double get(Event event) const {
+            return valid[event] ? static_cast<double>(values[event]) : std::nan("");
+        }
+
+        /**
+         * @brief Instructions per cycle
+         */
+        double ipc() const {
+            return ratio(INSTRUCTIONS, CYCLES);
+        }
+
+        /**
+         * @brief Cache misses per cache reference
+         */
+        double cache_miss_rate() const {
+            return ratio(CACHE_MISSES, CACHE_REFERENCES);
+        }
+
+        /**
+         * @brief Branch misses per branch
+         */
+        double branch_miss_rate() const {
+            return ratio(BRANCH_MISSES, BRANCHES);
+        }
+
+        /**
+         * @brief Get the CSV column names matching csv_row()
+         *
+         * @return const char* Comma-separated column names
+         */
+        static const char* csv_header() {
+            return "Cycles,Instructions,IPC,CacheMissRate,BranchMissRate";
+        }
+
+        /**
+         * @brief Format the counts as a CSV row
+         *
+         * @param per Divide the cycle and instruction counts by this many operations
+         * @return std::string Comma-separated values, "NA" where not counted
+         */
+        std::string csv_row(double per = 1.0) const {
+            std::ostringstream row;
+            row << field(get(CYCLES) / per) << "," << field(get(INSTRUCTIONS) / per) << ","
+                << field(ipc()) << "," << field(cache_miss_rate()) << "," << field(branch_miss_rate());
+            return row.str();
+        }
+
+        /**
+         * @brief Format IPC and miss rates for a progress line
+         *
+         * @return std::string e.g. "IPC=2.41 cache-miss=0.8% branch-miss=1.2%"
+         */
+        std::string summary() const {
+            std::ostringstream out;
+            out << "IPC=" << field(ipc())
+                << " cache-miss=" << percent(cache_miss_rate())
+                << " branch-miss=" << percent(branch_miss_rate());
+            return out.str();
+        }
+
+    private:
+        double ratio(Event num, Event den) const {
+            if (!valid[num] || !valid[den] || values[den] == 0) return std::nan("");
+            return static_cast<double>(values[num]) / values[den];
+        }
+
+        static std::string field(double value) {
+            if (std::isnan(value)) return "NA";
+            std::ostringstream out;
+            out << value;
+            return out.str();
+        }
+
+        static std::string percent(double value) {
+            if (std::isnan(value)) return "NA";
+            std::ostringstream out;
+            out.precision(3);
+            out << value * 100 << "%";
+            return out.str();
+        }
+    };
+
+    /**
+     * @brief Open the counters for the calling thread
+     */
+    PerfCounters() : leader(-1), csr_fallback(false) {
+        std::fill(fds, fds + NUM_EVENTS, -1);
+        std::fill(slots, slots + NUM_EVENTS, -1);
+        open_events();
+    }
+
+    ~PerfCounters() {
+        for (int fd : fds) {
+            if (fd >= 0) close(fd);
+        }
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    /**
+     * @brief Check whether any event can be counted
+     */
+    bool available() const {
+        return leader >= 0 || csr_fallback;
+    }
+
+    /**
+     * @brief Check whether one event can be counted
+     */
+    bool available(Event event) const {
+        return fds[event] >= 0 || (csr_fallback && (event == CYCLES || event == INSTRUCTIONS));
+    }
+
+    /**
+     * @brief Reset and start counting
+     */
+    void start() {
+#if defined(__linux__)
+        if (leader >= 0) {
+            ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+            return;
+        }
+#endif
+        if (csr_fallback) {
+            read_csrs(csr_start);
+        }
+    }
+
+    /**
+     * @brief Stop counting and return the counts since start()
+     *
+     * @return Sample The counts; events that are not available are marked invalid
+     */
+    Sample stop() {
+        Sample sample;
+#if defined(__linux__)
+        if (leader >= 0) {
+            ioctl(leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+            // PERF_FORMAT_GROUP | TOTAL_TIME_ENABLED | TOTAL_TIME_RUNNING: nr, enabled, running, values
+            uint64_t buffer[3 + NUM_EVENTS];
+            ssize_t got = read(leader, buffer, sizeof(buffer));
+            if (got >= static_cast<ssize_t>(3 * sizeof(uint64_t)) && buffer[2] > 0) {
+                double scale = static_cast<double>(buffer[1]) / buffer[2];
+                for (int i = 0; i < NUM_EVENTS; ++i) {
+                    if (slots[i] >= 0 && static_cast<uint64_t>(slots[i]) < buffer[0]) {
+                        sample.values[i] = static_cast<uint64_t>(buffer[3 + slots[i]] * scale + 0.5);
+                        sample.valid[i] = true;
+                    }
+                }
+            }
+            return sample;
+        }
+#endif
+        if (csr_fallback) {
+            uint64_t end[2];
+            read_csrs(end);
+            sample.values[CYCLES] = end[0] - csr_start[0];
+            sample.values[INSTRUCTIONS] = end[1] - csr_start[1];
+            sample.valid[CYCLES] = sample.valid[INSTRUCTIONS] = true;
+        }
+        return sample;
+    }
+
+private:
+    int fds[NUM_EVENTS];
+    int slots[NUM_EVENTS];     // Position of each event in the group read
+    int leader;
+    bool csr_fallback;
+    uint64_t csr_start[2];
+
+    void open_events() {
+#if defined(__linux__)
+        static const uint64_t configs[NUM_EVENTS] = {
+            PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_REFERENCES, PERF_COUNT_HW_CACHE_MISSES,
+            PERF_COUNT_HW_BRANCH_INSTRUCTIONS, PERF_COUNT_HW_BRANCH_MISSES
+        };
+        int next_slot = 0;
+        for (int i = 0; i < NUM_EVENTS; ++i) {
+            struct perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = configs[i];
+            attr.disabled = (leader < 0) ? 1 : 0;  // Members follow the leader
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                               PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+            int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0));
+            if (fd < 0) continue;
+            fds[i] = fd;
+            slots[i] = next_slot++;
+            if (leader < 0) leader = fd;
+        }
+#endif
+#if defined(__riscv) && __riscv_xlen == 64
+        if (leader < 0 && CycleTimer::detail::rdcycle_allowed()) {
+            csr_fallback = true;
+        }
+#endif
+    }
+
+    void read_csrs(uint64_t out[2]) {
+#if defined(__riscv) && __riscv_xlen == 64
+        __asm__ __volatile__("rdcycle %0\n\trdinstret %1" : "=r"(out[0]), "=r"(out[1]) :: "memory");
+#else
+        out[0] = out[1] = 0;
+#endif
+    }
+};
+
+#endif // PERF_COUNTERS_H
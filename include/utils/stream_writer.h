@@ -0,0 +1,265 @@
+#ifndef STREAM_WRITER_H
+#define STREAM_WRITER_H
+
+#include <gmp.h>
+#include <cerrno>
+#include <condition_variable>
+#include <cstddef>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+/**
+ * @brief Buffered output of large integers, written by a background thread
+ *
+ * Numbers are formatted straight from their limbs into one of a few large
+ * reusable buffers: hex digits, decimal digits (mpn_get_str into a reused
+ * scratch copy), or the raw limbs. A full buffer is handed to a writer
+ * thread that drains it to the file descriptor while the caller keeps
+ * formatting into the next one, so the producer only waits when every
+ * buffer is queued behind a slow reader. Nothing is allocated per number.
+ *
+ * Not thread-safe: one producer thread per writer.
+ */
+class StreamWriter {
+public:
+    /**
+     * @brief Output format
+     */
+    enum Format {
+        HEX,    // Lower-case hex digits, one number per line
+        DEC,    // Decimal digits, one number per line
+        BIN     // Raw little-endian 64-bit limbs, fixed width per number
+    };
+
+    /**
+     * @brief Construct a writer and start its output thread
+     *
+     * @param fd File descriptor to write to (not closed by the writer)
+     * @param buffer_size Bytes per buffer
+     * @param num_buffers Number of buffers (at least 2 to overlap formatting and output)
+     */
+    explicit StreamWriter(int fd, size_t buffer_size = 1 << 20, size_t num_buffers = 4)
+        : fd(fd), capacity(buffer_size), buffers(num_buffers < 2 ? 2 : num_buffers),
+          current(0), used(0), done(false), failed(false) {
+        for (size_t i = 0; i < buffers.size(); ++i) {
+            buffers[i].resize(capacity);
+            if (i != current) free_buffers.push_back(i);
+        }
+        writer = std::thread(&StreamWriter::output_loop, this);
+    }
+
+    /**
+     * @brief Flush the remaining output and stop the output thread
+     */
+    ~StreamWriter() {
+        finish();
+    }
+
+    StreamWriter(const StreamWriter&) = delete;
+    StreamWriter& operator=(const StreamWriter&) = delete;
+
+    /**
+     * @brief Write a number in the given format
+     *
+     * @param n Non-negative number
+     * @param format Output format
+     * @param width_limbs Limbs per number for BIN (numbers are zero-padded to it)
+     */
+    void write(const mpz_t n, Format format, size_t width_limbs = 0) {
+        switch (format) {
+            case HEX: write_hex(n); break;
+            case DEC: write_dec(n); break;
+            case BIN: write_limbs(n, width_limbs); break;
+        }
+    }
+
+    /**
+     * @brief Write a number as hex digits followed by a newline
+     *
+     * @param n Non-negative number
+     */
+    void write_hex(const mpz_t n) {
+        static const char digits[] = "0123456789abcdef";
+        size_t size = mpz_size(n);
+        if (size == 0) {
+            put("0\n", 2);
+            return;
+        }
+
+        const mp_limb_t* limbs = mpz_limbs_read(n);
+        char* out = reserve(size * (GMP_NUMB_BITS / 4) + 1);
+        char* p = out;
+
+        // Most significant limb without leading zeros, the others in full
+        mp_limb_t top = limbs[size - 1];
+        int shift = GMP_NUMB_BITS - 4;
+        while (shift > 0 && ((top >> shift) & 0xf) == 0) shift -= 4;
+        for (; shift >= 0; shift -= 4) *p++ = digits[(top >> shift) & 0xf];
+        for (size_t i = size - 1; i-- > 0;) {
+            for (int s = GMP_NUMB_BITS - 4; s >= 0; s -= 4) *p++ = digits[(limbs[i] >> s) & 0xf];
+        }
+        *p++ = '\n';
+        used += p - out;
+    }
+
+    /**
+     * @brief Write a number as decimal digits followed by a newline
+     *
+     * @param n Non-negative number
+     */
+    void write_dec(const mpz_t n) {
+        size_t size = mpz_size(n);
+        if (size == 0) {
+            put("0\n", 2);
+            return;
+        }
+
+        // mpn_get_str destroys its input and needs room for the largest size-limb number
+        const mp_limb_t* limbs = mpz_limbs_read(n);
+        scratch.assign(limbs, limbs + size);
+        size_t max_digits = static_cast<size_t>(size * GMP_NUMB_BITS * 0.30103) + 2;
+        unsigned char* out = reinterpret_cast<unsigned char*>(reserve(max_digits + 1));
+        size_t count = mpn_get_str(out, 10, scratch.data(), static_cast<mp_size_t>(size));
+        for (size_t i = 0; i < count; ++i) out[i] += '0';
+        out[count] = '\n';
+        used += count + 1;
+    }
+
+    /**
+     * @brief Write a number as width_limbs raw little-endian 64-bit limbs
+     *
+     * @param n Non-negative number of at most width_limbs limbs
+     * @param width_limbs Limbs per number; missing high limbs are written as zero
+     */
+    void write_limbs(const mpz_t n, size_t width_limbs) {
+        size_t size = mpz_size(n);
+        if (width_limbs < size) width_limbs = size;
+        size_t bytes = width_limbs * sizeof(mp_limb_t);
+        char* out = reserve(bytes);
+        std::memcpy(out, mpz_limbs_read(n), size * sizeof(mp_limb_t));
+        std::memset(out + size * sizeof(mp_limb_t), 0, bytes - size * sizeof(mp_limb_t));
+        used += bytes;
+    }
+
+    /**
+     * @brief Hand the current buffer to the output thread
+     */
+    void flush() {
+        if (used == 0) return;
+        submit();
+    }
+
+    /**
+     * @brief Write out everything and stop the output thread
+     *
+     * @return bool False if a write to the file descriptor failed
+     */
+    bool finish() {
+        if (writer.joinable()) {
+            flush();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                done = true;
+            }
+            ready.notify_one();
+            writer.join();
+        }
+        return !failed;
+    }
+
+private:
+    int fd;
+    size_t capacity;
+    std::vector<std::vector<char>> buffers;
+    size_t current;                      // Buffer being formatted into
+    size_t used;                         // Bytes of current in use
+    std::vector<mp_limb_t> scratch;      // Destroyable copy for mpn_get_str
+
+    std::mutex mutex;
+    std::condition_variable ready;       // Signals the output thread: a buffer is full or done
+    std::condition_variable returned;    // Signals the producer: a buffer was written out
+    std::deque<std::pair<size_t, size_t>> full_buffers;  // (buffer, bytes) waiting for output
+    std::deque<size_t> free_buffers;
+    bool done;
+    bool failed;
+    std::thread writer;
+
+    /**
+     * @brief Get space for bytes more output, switching buffers if needed
+     *
+     * @param bytes Bytes needed
+     * @return char* Where to write them; the caller advances used
+     */
+    char* reserve(size_t bytes) {
+        if (used + bytes > capacity) {
+            flush();
+            if (bytes > capacity) {
+                // A single number larger than a buffer: grow this buffer for it
+                buffers[current].resize(bytes);
+            }
+        }
+        return buffers[current].data() + used;
+    }
+
+    /**
+     * @brief Copy a short literal into the output
+     */
+    void put(const char* text, size_t bytes) {
+        std::memcpy(reserve(bytes), text, bytes);
+        used += bytes;
+    }
+
+    /**
+     * @brief Queue the current buffer and take a free one, waiting if there is none
+     */
+    void submit() {
+        std::unique_lock<std::mutex> lock(mutex);
+        full_buffers.push_back(std::make_pair(current, used));
+        ready.notify_one();
+        returned.wait(lock, [this] { return !free_buffers.empty(); });
+        current = free_buffers.front();
+        free_buffers.pop_front();
+        used = 0;
+    }
+
+    /**
+     * @brief Body of the output thread
+     */
+    void output_loop() {
+        while (true) {
+            std::pair<size_t, size_t> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                ready.wait(lock, [this] { return done || !full_buffers.empty(); });
+                if (full_buffers.empty()) return;  // done, and everything written
+                job = full_buffers.front();
+                full_buffers.pop_front();
+            }
+
+            const char* p = buffers[job.first].data();
+            size_t left = job.second;
+            while (left > 0 && !failed) {
+                ssize_t n = ::write(fd, p, left);
+                if (n < 0) {
+                    if (errno == EINTR) continue;
+                    failed = true;  // Keep draining so the producer never blocks
+                    break;
+                }
+                p += n;
+                left -= static_cast<size_t>(n);
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                free_buffers.push_back(job.first);
+            }
+            returned.notify_one();
+        }
+    }
+};
+
+#endif // STREAM_WRITER_H
@@ -0,0 +1,132 @@
+#ifndef WORK_STEALING_H
+#define WORK_STEALING_H
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief Per-worker task deques with stealing
+ *
+ * Each worker owns one deque. It pushes and pops its own tasks at the back,
+ * so it keeps working on what it touched last, while an idle worker steals
+ * from the front of someone else's deque, taking the oldest task. Every deque
+ * has its own lock, so a worker only contends with a thief that picked the
+ * same deque, never with the whole pool; the tasks here are chunks of
+ * primality work lasting milliseconds, for which a short lock is cheaper than
+ * a lock-free deque.
+ *
+ * size() is an upper-bound hint kept with relaxed atomics, for deciding
+ * whether a sleeping worker should be woken.
+ *
+ * References:
+ * - Blumofe, R. D., & Leiserson, C. E. (1999). Scheduling multithreaded
+ *   computations by work stealing. Journal of the ACM, 46(5), 720-748.
+ */
+template <typename T>
+class WorkStealingDeques {
+public:
+    /**
+     * @brief Construct one empty deque per worker
+     *
+     * @param workers Number of workers
+     */
+    explicit WorkStealingDeques(size_t workers) : total(0) {
+        for (size_t i = 0; i < workers; ++i) {
+            deques.emplace_back(new Deque());
+        }
+    }
+
+    WorkStealingDeques(const WorkStealingDeques&) = delete;
+    WorkStealingDeques& operator=(const WorkStealingDeques&) = delete;
+
+    /**
+     * @brief Add a task to the back of a worker's own deque
+     *
+     * @param worker Index of the owning worker
+     * @param task The task
+     */
+    void push(size_t worker, const T& task) {
+        Deque& deque = *deques[worker];
+        std::lock_guard<std::mutex> lock(deque.mutex);
+        deque.tasks.push_back(task);
+        total.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Take the newest task from a worker's own deque
+     *
+     * @param worker Index of the owning worker
+     * @param task Output parameter for the task
+     * @return bool False if the deque was empty
+     */
+    bool pop(size_t worker, T& task) {
+        Deque& deque = *deques[worker];
+        std::lock_guard<std::mutex> lock(deque.mutex);
+        if (deque.tasks.empty()) return false;
+        task = deque.tasks.back();
+        deque.tasks.pop_back();
+        total.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    /**
+     * @brief Take the oldest task from another worker's deque
+     *
+     * The victims are tried in order, starting after the thief, so thieves
+     * spread over the deques instead of all hitting the first one.
+     *
+     * @param thief Index of the stealing worker
+     * @param task Output parameter for the task
+     * @return bool False if every other deque was empty
+     */
+    bool steal(size_t thief, T& task) {
+        for (size_t i = 1; i < deques.size(); ++i) {
+            Deque& deque = *deques[(thief + i) % deques.size()];
+            std::lock_guard<std::mutex> lock(deque.mutex);
+            if (deque.tasks.empty()) continue;
+            task = deque.tasks.front();
+            deque.tasks.pop_front();
+            total.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * @brief Remove every task from every deque
+     *
+     * @return std::vector<T> The tasks that were left
+     */
+    std::vector<T> drain() {
+        std::vector<T> left;
+        for (auto& deque : deques) {
+            std::lock_guard<std::mutex> lock(deque->mutex);
+            left.insert(left.end(), deque->tasks.begin(), deque->tasks.end());
+            total.fetch_sub(deque->tasks.size(), std::memory_order_relaxed);
+            deque->tasks.clear();
+        }
+        return left;
+    }
+
+    /**
+     * @brief Get the number of queued tasks (a hint while workers run)
+     */
+    size_t size() const {
+        return total.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Deque {
+        std::mutex mutex;
+        std::deque<T> tasks;
+    };
+
+    std::vector<std::unique_ptr<Deque>> deques;
+    std::atomic<size_t> total;
+};
+
+#endif // WORK_STEALING_H
@@ -1,6 +1,12 @@
 #include "../../include/prng/lcg.h"
 #include "../../include/prng/xoshiro.h"
+#include "../../include/prng/random_bits.h"
 #include "../../include/primality/primality_tester.h"
+#include "../../include/primality/prime_search.h"
+#include "../../include/utils/alloc_stats.h"
+#include "../../include/utils/bench_harness.h"
+#include "../../include/utils/energy_meter.h"
+#include "../../include/utils/mem_profile.h"
 #include <iostream>
 #include <string>
 #include <chrono>
@@ -12,6 +18,8 @@
 #include <cstdint>
 #include <csignal>
 #include <memory>
+#include <sstream>
+#include <vector>
 
 /**
  * @brief Program to continuously run algorithms for energy consumption measurement
@@ -19,15 +27,60 @@
  * This program continuously runs the specified algorithm for a given duration,
  * periodically reporting statistics to allow energy consumption measurement.
  * 
- * Usage: continuous_operation <algorithm> <bits> <duration_seconds>
+ * Usage: continuous_operation <algorithm> <bits> <duration_seconds> [--count-allocs] [--mem-profile]
+ *                              [--dispatch=virtual|template] [--threads=N] [--work=N]
  *   algorithm: lcg, xoshiro, miller_rabin, or baillie_psw
  *   bits: number of bits (e.g., 40, 56, 80, ..., 4096)
- *   duration_seconds: how long to run in seconds
+ *   duration_seconds: how long to run in seconds (0 with --work: no time limit)
+ *   --count-allocs: report GMP heap operations per iteration
+ *   --mem-profile: also report GMP bytes allocated per iteration, the most
+ *                  bytes GMP held at once and the peak RSS, on the STAT and
+ *                  final lines and as a MEMORY line of key=value pairs
+ *   --dispatch: call the generator and the test through PRNGInterface and
+ *               PrimalityTester (virtual, the default), or through
+ *               RandomBits and PrimeSearch bound at compile time (template)
+ *   --threads: run N worker threads pinned to cores (0 for one per core).
+ *              Primality workers search for fresh primes instead of
+ *              re-testing one, and the run reports operations per second per
+ *              core and, where RAPL or hwmon energy counters are readable,
+ *              operations per joule
+ *   --work: stop after N operations (numbers drawn or primes found) in total
  */
 
 // Global flag for graceful termination
 std::atomic<bool> g_running(true);
 
+// Whether GMP allocations are being counted (--count-allocs, or --mem-profile)
+bool g_count_allocs = false;
+
+// Whether bytes and peak memory are reported as well (--mem-profile)
+bool g_mem_profile = false;
+
+// Format GMP heap operations per iteration for the STAT lines
+std::string allocs_per_op(const AllocStats::Counts& counts, uint64_t iterations) {
+    if (!g_count_allocs || iterations == 0) {
+        return "";
+    }
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(3)
+        << " | Allocs/op: " << static_cast<double>(counts.allocs) / iterations
+        << " Reallocs/op: " << static_cast<double>(counts.reallocs) / iterations
+        << " Frees/op: " << static_cast<double>(counts.frees) / iterations;
+    if (g_mem_profile) {
+        out << std::setprecision(1) << " Bytes/op: " << static_cast<double>(counts.bytes) / iterations
+            << " PeakLive: " << AllocStats::peak_bytes() / 1024.0 << "KiB"
+            << " PeakRSS: " << MemProfile::peak_rss_bytes() / 1024.0 << "KiB";
+    }
+    return out.str();
+}
+
+// Print the memory profile of a whole run (--mem-profile)
+void report_memory(const MemProfile& memory, uint64_t iterations) {
+    if (g_mem_profile) {
+        std::cout << "MEMORY: " << memory.end(static_cast<double>(iterations)).extra() << std::endl;
+    }
+}
+
 // Signal handler for Ctrl+C
 void signal_handler(int signal) {
     if (signal == SIGINT) {
@@ -35,8 +88,9 @@ void signal_handler(int signal) {
     }
 }
 
-// Function to run a PRNG continuously
-void run_prng(PRNGInterface& prng, int bits, int duration_seconds) {
+// Function to run a PRNG continuously; source is InterfaceBits or RandomBits<Gen>
+template <typename Source>
+void run_prng(Source& source, int bits, int duration_seconds) {
     mpz_t number;
     mpz_init(number);
     
@@ -52,10 +106,14 @@ void run_prng(PRNGInterface& prng, int bits, int duration_seconds) {
     const int stats_interval = 10; // seconds
     auto next_stat = start_time + std::chrono::seconds(stats_interval);
     uint64_t interval_iterations = 0;
+    MemProfile memory;
+    if (g_mem_profile) memory.begin();
+    AllocStats::Counts run_allocs = AllocStats::snapshot();
+    AllocStats::Counts interval_allocs = run_allocs;
     
     while (g_running && std::chrono::steady_clock::now() < end_time) {
         // Generate a random number
-        prng.randbits(number, bits);
+        source(number, bits);
         iterations++;
         interval_iterations++;
         
@@ -78,13 +136,18 @@ void run_prng(PRNGInterface& prng, int bits, int duration_seconds) {
             auto interval = std::chrono::duration_cast<std::chrono::seconds>(now - (next_stat - std::chrono::seconds(stats_interval))).count();
             double interval_rate = static_cast<double>(interval_iterations) / interval;
             
+            AllocStats::Counts allocs_now = AllocStats::snapshot();
+            
             std::cout << std::endl << "STAT: " 
                       << std::chrono::duration_cast<std::chrono::seconds>(now - start_time).count() 
                       << "s - Rate: " << std::setw(12) << static_cast<uint64_t>(interval_rate) 
-                      << " ops/sec" << std::endl;
+                      << " ops/sec"
+                      << allocs_per_op(AllocStats::since(allocs_now, interval_allocs), interval_iterations)
+                      << std::endl;
             
             next_stat = now + std::chrono::seconds(stats_interval);
             interval_iterations = 0;
+            interval_allocs = allocs_now;
         }
     }
     
@@ -93,19 +156,24 @@ void run_prng(PRNGInterface& prng, int bits, int duration_seconds) {
     double rate = static_cast<double>(iterations) / elapsed;
     
     std::cout << std::endl << "Completed " << iterations << " iterations in "
-              << elapsed << " seconds (" << static_cast<uint64_t>(rate) << " ops/sec)" << std::endl;
+              << elapsed << " seconds (" << static_cast<uint64_t>(rate) << " ops/sec"
+              << allocs_per_op(AllocStats::since(AllocStats::snapshot(), run_allocs), iterations)
+              << ")" << std::endl;
+    report_memory(memory, iterations);
     
     mpz_clear(number);
 }
 
-// Function to run a primality test continuously
-void run_primality(PrimalityTester& tester, PrimalityTester::TestType type, int bits, int duration_seconds) {
+// Function to run a primality test continuously; generate(prime, bits) finds the
+// prime to test and test(n) runs one primality test
+template <typename Generate, typename Test>
+void run_primality(Generate generate, Test test, int bits, int duration_seconds) {
     // First, generate a prime number of the specified bit size
     mpz_t prime;
     mpz_init(prime);
     
     std::cout << "Generating a " << bits << "-bit prime for testing..." << std::endl;
-    tester.generate_prime(prime, bits);
+    generate(prime, bits);
     
     uint64_t iterations = 0;
     auto start_time = std::chrono::steady_clock::now();
@@ -119,10 +187,14 @@ void run_primality(PrimalityTester& tester, PrimalityTester::TestType type, int
     const int stats_interval = 10; // seconds
     auto next_stat = start_time + std::chrono::seconds(stats_interval);
     uint64_t interval_iterations = 0;
+    MemProfile memory;
+    if (g_mem_profile) memory.begin();
+    AllocStats::Counts run_allocs = AllocStats::snapshot();
+    AllocStats::Counts interval_allocs = run_allocs;
     
     while (g_running && std::chrono::steady_clock::now() < end_time) {
         // Test the primality of the number
-        tester.is_prime(prime, type);
+        test(prime);
         iterations++;
         interval_iterations++;
         
@@ -145,13 +217,18 @@ void run_primality(PrimalityTester& tester, PrimalityTester::TestType type, int
             auto interval = std::chrono::duration_cast<std::chrono::seconds>(now - (next_stat - std::chrono::seconds(stats_interval))).count();
             double interval_rate = static_cast<double>(interval_iterations) / interval;
             
+            AllocStats::Counts allocs_now = AllocStats::snapshot();
+            
             std::cout << std::endl << "STAT: " 
                       << std::chrono::duration_cast<std::chrono::seconds>(now - start_time).count() 
                       << "s - Rate: " << std::setw(12) << static_cast<uint64_t>(interval_rate) 
-                      << " ops/sec" << std::endl;
+                      << " ops/sec"
+                      << allocs_per_op(AllocStats::since(allocs_now, interval_allocs), interval_iterations)
+                      << std::endl;
             
             next_stat = now + std::chrono::seconds(stats_interval);
             interval_iterations = 0;
+            interval_allocs = allocs_now;
         }
     }
     
@@ -160,20 +237,275 @@ void run_primality(PrimalityTester& tester, PrimalityTester::TestType type, int
     double rate = static_cast<double>(iterations) / elapsed;
     
     std::cout << std::endl << "Completed " << iterations << " iterations in "
-              << elapsed << " seconds (" << static_cast<uint64_t>(rate) << " ops/sec)" << std::endl;
+              << elapsed << " seconds (" << static_cast<uint64_t>(rate) << " ops/sec"
+              << allocs_per_op(AllocStats::since(AllocStats::snapshot(), run_allocs), iterations)
+              << ")" << std::endl;
+    report_memory(memory, iterations);
     
     mpz_clear(prime);
 }
 
+// Operations done by one worker, on its own cache line so that the monitor's
+// reads do not slow the workers down
+struct WorkerCount {
+    std::atomic<uint64_t> ops;
+    char pad[64 - sizeof(std::atomic<uint64_t>)];
+    
+    WorkerCount() : ops(0) {}
+};
+
+// One worker's generator: each operation draws one bits-bit number
+template <typename Gen, typename Source>
+class DrawOp {
+public:
+    DrawOp(uint64_t seed, int bits) : gen(seed), source(gen), bits(bits) {
+        mpz_init(number);
+    }
+    
+    ~DrawOp() {
+        mpz_clear(number);
+    }
+    
+    void operator()() {
+        source(number, bits);
+    }
+    
+private:
+    Gen gen;
+    Source source;
+    int bits;
+    mpz_t number;
+};
+
+// One worker's prime search through PrimalityTester: each operation finds one prime
+class TesterSearchOp {
+public:
+    TesterSearchOp(uint64_t seed, int bits, PrimalityTester::TestType type)
+        : tester(static_cast<unsigned long>(seed)), bits(bits), type(type) {
+        mpz_init(prime);
+    }
+    
+    ~TesterSearchOp() {
+        mpz_clear(prime);
+    }
+    
+    void operator()() {
+        tester.find_prime(prime, bits, type);
+    }
+    
+private:
+    PrimalityTester tester;
+    int bits;
+    PrimalityTester::TestType type;
+    mpz_t prime;
+};
+
+// One worker's prime search through PrimeSearch: each operation finds one prime
+template <typename Test>
+class TemplateSearchOp {
+public:
+    TemplateSearchOp(uint64_t seed, int bits) : gen(seed), search(gen), bits(bits) {
+        mpz_init(prime);
+    }
+    
+    ~TemplateSearchOp() {
+        mpz_clear(prime);
+    }
+    
+    void operator()() {
+        search.find(prime, bits);
+    }
+    
+private:
+    Xoshiro256pp gen;
+    PrimeSearch<Xoshiro256pp, Test> search;
+    int bits;
+    mpz_t prime;
+};
+
+// Format a per-joule figure, or NA without an energy counter
+std::string per_joule(double value, double joules) {
+    if (joules <= 0) {
+        return "NA";
+    }
+    std::ostringstream out;
+    out << std::setprecision(6) << value / joules;
+    return out.str();
+}
+
+// Run threads pinned workers, each doing operations with its own state from
+// make_op(worker), until duration_seconds pass or work operations are done
+// (0 for either means no limit). Workers claim chunk operations at a time from
+// the shared budget. The calling thread reports progress and samples energy.
+template <typename MakeOp>
+void run_workers(MakeOp make_op, const std::string& unit, int bits, unsigned int threads,
+                 int duration_seconds, uint64_t work, uint64_t chunk) {
+    unsigned int cores = std::thread::hardware_concurrency();
+    if (cores == 0) cores = 1;
+    if (threads == 0) threads = cores;
+    
+    std::vector<WorkerCount> counts(threads);
+    std::atomic<uint64_t> claimed(0);
+    std::atomic<unsigned int> pinned(0);
+    std::atomic<unsigned int> finished(0);
+    
+    std::cout << "Running " << threads << " worker(s) with " << bits << " bits";
+    if (duration_seconds > 0) std::cout << " for " << duration_seconds << " seconds";
+    if (work > 0) std::cout << (duration_seconds > 0 ? " or " : " until ") << work << " " << unit;
+    std::cout << std::endl;
+    
+    EnergyMeter meter;
+    std::cout << "Energy source: " << meter.source() << std::endl;
+    
+    // Includes the workers' setup, spread over every operation
+    MemProfile memory;
+    if (g_mem_profile) memory.begin();
+    
+    auto start_time = std::chrono::steady_clock::now();
+    meter.start();
+    
+    std::vector<std::thread> workers;
+    for (unsigned int w = 0; w < threads; w++) {
+        workers.emplace_back([&, w]() {
+            if (BenchHarness::pin_to_cpu(static_cast<int>(w % cores))) pinned++;
+            auto op = make_op(w);
+            WorkerCount& count = counts[w];
+            while (g_running) {
+                uint64_t n = chunk;
+                if (work > 0) {
+                    uint64_t first = claimed.fetch_add(chunk);
+                    if (first >= work) break;
+                    n = std::min(chunk, work - first);
+                }
+                for (uint64_t i = 0; i < n; i++) {
+                    (*op)();
+                }
+                count.ops.store(count.ops.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+            }
+            finished++;
+        });
+    }
+    
+    auto total_ops = [&]() {
+        uint64_t total = 0;
+        for (const WorkerCount& count : counts) total += count.ops.load(std::memory_order_relaxed);
+        return total;
+    };
+    
+    // Set up for statistics
+    const int stats_interval = 10; // seconds
+    auto end_time = start_time + std::chrono::seconds(duration_seconds);
+    auto next_report = start_time + std::chrono::seconds(1);
+    auto next_stat = start_time + std::chrono::seconds(stats_interval);
+    uint64_t stat_ops = 0;
+    double stat_joules = 0;
+    
+    // Poll often, so that the end of a fixed-work run is seen within milliseconds
+    while (g_running && finished < threads) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        auto now = std::chrono::steady_clock::now();
+        if (duration_seconds > 0 && now >= end_time) break;
+        if (now < next_report) continue;
+        next_report += std::chrono::seconds(1);
+        
+        meter.sample();
+        uint64_t ops = total_ops();
+        double elapsed = std::chrono::duration<double>(now - start_time).count();
+        
+        double progress = (work > 0) ? 100.0 * ops / work : 100.0 * elapsed / duration_seconds;
+        std::cout << "Progress: " << std::fixed << std::setprecision(2)
+                  << std::setw(6) << progress << "% | Rate: "
+                  << std::setw(12) << static_cast<uint64_t>(ops / elapsed) << " ops/sec\r" << std::flush;
+        
+        if (now >= next_stat) {
+            double joules = meter.joules();
+            std::cout << std::endl << "STAT: " << static_cast<uint64_t>(elapsed)
+                      << "s - Rate: " << std::setw(12) << static_cast<uint64_t>((ops - stat_ops) / stats_interval)
+                      << " ops/sec | Ops/J: " << per_joule(ops - stat_ops, joules - stat_joules)
+                      << std::endl;
+            next_stat += std::chrono::seconds(stats_interval);
+            stat_ops = ops;
+            stat_joules = joules;
+        }
+    }
+    
+    g_running = false;
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    
+    auto final_time = std::chrono::steady_clock::now();
+    meter.sample();
+    uint64_t ops = total_ops();
+    double seconds = std::chrono::duration<double>(final_time - start_time).count();
+    double joules = meter.joules();
+    double rate = ops / seconds;
+    unsigned int cores_used = std::min(threads, cores);
+    
+    std::cout << std::endl << "Completed " << ops << " " << unit << " in " << std::fixed << std::setprecision(3)
+              << seconds << " seconds with " << threads << " worker(s), " << pinned.load() << " pinned"
+              << std::endl;
+    std::cout << std::defaultfloat << std::setprecision(6)
+              << "RESULT: ops=" << ops
+              << " seconds=" << seconds
+              << " threads=" << threads
+              << " ops_per_sec=" << rate
+              << " cores=" << cores_used
+              << " ops_per_sec_per_core=" << rate / cores_used
+              << " joules=" << (meter.available() ? std::to_string(joules) : "NA")
+              << " watts=" << (meter.available() && seconds > 0 ? std::to_string(joules / seconds) : "NA")
+              << " ops_per_joule=" << per_joule(ops, joules)
+              << " energy_source=" << meter.source()
+              << std::endl;
+    report_memory(memory, ops);
+}
+
 int main(int argc, char* argv[]) {
-    if (argc != 4) {
-        std::cerr << "Usage: " << argv[0] << " <algorithm> <bits> <duration_seconds>" << std::endl;
+    if (argc < 4) {
+        std::cerr << "Usage: " << argv[0] << " <algorithm> <bits> <duration_seconds> [--count-allocs] [--mem-profile]"
+                  << " [--dispatch=virtual|template] [--threads=N] [--work=N]" << std::endl;
         std::cerr << "  algorithm: lcg, xoshiro, miller_rabin, or baillie_psw" << std::endl;
         std::cerr << "  bits: number of bits (e.g., 40, 56, 80, ..., 4096)" << std::endl;
-        std::cerr << "  duration_seconds: how long to run in seconds" << std::endl;
+        std::cerr << "  duration_seconds: how long to run in seconds (0 with --work: no time limit)" << std::endl;
+        std::cerr << "  --count-allocs: report GMP heap operations per iteration" << std::endl;
+        std::cerr << "  --mem-profile: also report bytes per iteration, peak GMP bytes and peak RSS" << std::endl;
+        std::cerr << "  --dispatch: virtual (PRNGInterface, PrimalityTester) or template (RandomBits, PrimeSearch)" << std::endl;
+        std::cerr << "  --threads: N pinned workers on fresh candidates (0 for one per core), reporting ops/sec per core and ops/J" << std::endl;
+        std::cerr << "  --work: stop after N numbers drawn or primes found (implies --threads=1 if --threads is not given)" << std::endl;
         return 1;
     }
     
+    bool template_dispatch = false;
+    bool workers = false;
+    unsigned int threads = 1;
+    uint64_t work = 0;
+    for (int i = 4; i < argc; i++) {
+        if (std::strncmp(argv[i], "--threads=", 10) == 0) {
+            workers = true;
+            threads = static_cast<unsigned int>(std::strtoul(argv[i] + 10, nullptr, 10));
+        } else if (std::strncmp(argv[i], "--work=", 7) == 0) {
+            workers = true;
+            work = std::strtoull(argv[i] + 7, nullptr, 10);
+        } else if (std::strcmp(argv[i], "--count-allocs") == 0) {
+            g_count_allocs = true;
+        } else if (std::strcmp(argv[i], "--mem-profile") == 0) {
+            g_count_allocs = true;
+            g_mem_profile = true;
+        } else if (std::strcmp(argv[i], "--dispatch=virtual") == 0) {
+            template_dispatch = false;
+        } else if (std::strcmp(argv[i], "--dispatch=template") == 0) {
+            template_dispatch = true;
+        } else {
+            std::cerr << "Error: Unknown option: " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+    
+    // Must be installed before the first mpz_t is initialized
+    if (g_count_allocs) {
+        AllocStats::install();
+    }
+    
     // Register signal handler
     std::signal(SIGINT, signal_handler);
     
@@ -194,7 +526,7 @@ int main(int argc, char* argv[]) {
         return 1;
     }
     
-    if (duration_seconds <= 0) {
+    if (duration_seconds < 0 || (duration_seconds == 0 && work == 0)) {
         std::cerr << "Error: Duration must be positive" << std::endl;
         return 1;
     }
@@ -202,17 +534,90 @@ int main(int argc, char* argv[]) {
     // Fixed seed for repeatability
     uint64_t seed = 12345678901234ULL;
     
+    if (workers) {
+        // Every worker gets its own generator; numbers are drawn in chunks so
+        // that claiming work does not dominate, primes are claimed one at a time
+        PrimalityTester::TestType test_type =
+            (algorithm == "miller_rabin") ? PrimalityTester::MILLER_RABIN : PrimalityTester::BAILLIE_PSW;
+        if (algorithm == "lcg" && template_dispatch) {
+            run_workers([&](unsigned int w) { return std::make_unique<DrawOp<LCG, RandomBits<LCG>>>(seed + w, bits); },
+                        "numbers", bits, threads, duration_seconds, work, 1024);
+        } else if (algorithm == "lcg") {
+            run_workers([&](unsigned int w) { return std::make_unique<DrawOp<LCG, InterfaceBits>>(seed + w, bits); },
+                        "numbers", bits, threads, duration_seconds, work, 1024);
+        } else if (algorithm == "xoshiro" && template_dispatch) {
+            run_workers([&](unsigned int w) { return std::make_unique<DrawOp<Xoshiro256pp, RandomBits<Xoshiro256pp>>>(seed + w, bits); },
+                        "numbers", bits, threads, duration_seconds, work, 1024);
+        } else if (algorithm == "xoshiro") {
+            run_workers([&](unsigned int w) { return std::make_unique<DrawOp<Xoshiro256pp, InterfaceBits>>(seed + w, bits); },
+                        "numbers", bits, threads, duration_seconds, work, 1024);
+        } else if (template_dispatch && algorithm == "miller_rabin") {
+            run_workers([&](unsigned int w) { return std::make_unique<TemplateSearchOp<AdaptiveMillerRabinTest<>>>(seed + w, bits); },
+                        "primes", bits, threads, duration_seconds, work, 1);
+        } else if (template_dispatch && algorithm == "baillie_psw") {
+            run_workers([&](unsigned int w) { return std::make_unique<TemplateSearchOp<BailliePSWTest>>(seed + w, bits); },
+                        "primes", bits, threads, duration_seconds, work, 1);
+        } else if (algorithm == "miller_rabin" || algorithm == "baillie_psw") {
+            run_workers([&](unsigned int w) { return std::make_unique<TesterSearchOp>(seed + w, bits, test_type); },
+                        "primes", bits, threads, duration_seconds, work, 1);
+        } else {
+            std::cerr << "Error: Unknown algorithm: " << algorithm << std::endl;
+            std::cerr << "Supported algorithms: lcg, xoshiro, miller_rabin, baillie_psw" << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+    
     if (algorithm == "lcg") {
         LCG lcg(seed);
-        run_prng(lcg, bits, duration_seconds);
+        if (template_dispatch) {
+            RandomBits<LCG> source(lcg);
+            run_prng(source, bits, duration_seconds);
+        } else {
+            InterfaceBits source(lcg);
+            run_prng(source, bits, duration_seconds);
+        }
     } else if (algorithm == "xoshiro") {
         Xoshiro256pp xoshiro(seed);
-        run_prng(xoshiro, bits, duration_seconds);
+        if (template_dispatch) {
+            RandomBits<Xoshiro256pp> source(xoshiro);
+            run_prng(source, bits, duration_seconds);
+        } else {
+            InterfaceBits source(xoshiro);
+            run_prng(source, bits, duration_seconds);
+        }
+    } else if (template_dispatch && algorithm == "miller_rabin") {
+        // The same prime is tested over and over, so on every path its per-n
+        // setup is done once. 40 rounds, as PrimalityTester::is_prime gives
+        // the virtual path; the search workers use AdaptiveMillerRabinTest,
+        // which matches find_prime
+        Xoshiro256pp xoshiro(seed);
+        PrimeSearch<Xoshiro256pp, MillerRabinTest<40>> search(xoshiro);
+        std::unique_ptr<PreparedModulus> prepared;
+        run_primality([&](mpz_t prime, int b) { search.find(prime, b); },
+                      [&](const mpz_t n) {
+                          if (!prepared || !prepared->prepares(n)) prepared.reset(new PreparedModulus(n));
+                          return search.is_prime(*prepared);
+                      }, bits, duration_seconds);
+    } else if (template_dispatch && algorithm == "baillie_psw") {
+        Xoshiro256pp xoshiro(seed);
+        PrimeSearch<Xoshiro256pp, BailliePSWTest> search(xoshiro);
+        std::unique_ptr<PreparedModulus> prepared;
+        run_primality([&](mpz_t prime, int b) { search.find(prime, b); },
+                      [&](const mpz_t n) {
+                          if (!prepared || !prepared->prepares(n)) prepared.reset(new PreparedModulus(n));
+                          return search.is_prime(*prepared);
+                      }, bits, duration_seconds);
     } else if (algorithm == "miller_rabin" || algorithm == "baillie_psw") {
         PrimalityTester tester;
         PrimalityTester::TestType test_type = 
             (algorithm == "miller_rabin") ? PrimalityTester::MILLER_RABIN : PrimalityTester::BAILLIE_PSW;
-        run_primality(tester, test_type, bits, duration_seconds);
+        std::unique_ptr<PreparedModulus> prepared;
+        run_primality([&](mpz_t prime, int b) { tester.find_prime(prime, b, test_type); },
+                      [&](const mpz_t n) {
+                          if (!prepared || !prepared->prepares(n)) prepared.reset(new PreparedModulus(n));
+                          return tester.is_prime(*prepared, test_type);
+                      }, bits, duration_seconds);
     } else {
         std::cerr << "Error: Unknown algorithm: " << algorithm << std::endl;
         std::cerr << "Supported algorithms: lcg, xoshiro, miller_rabin, baillie_psw" << std::endl;
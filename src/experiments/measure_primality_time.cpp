@@ -1,4 +1,6 @@
 #include "../../include/primality/primality_tester.h"
+#include "../../include/primality/prime_cache.h"
+#include "../../include/utils/perf_counters.h"
 #include <iostream>
 #include <string>
 #include <chrono>
@@ -6,7 +8,7 @@
 #include <cstring>
 #include <cstdint>
 #include <memory>
-#include <x86intrin.h> // For _rdtsc()
+#include <vector>
 
 /**
  * @brief Program to measure primality testing algorithm execution time with high precision
@@ -14,26 +16,61 @@
  * This program measures the execution time of testing the primality of numbers
  * using various algorithms at different bit sizes.
  * 
- * Usage: measure_primality_time <algorithm> <bits>
+ * The prime under test is the first entry for the bit size in the prime
+ * cache (PrimeCache::default_path()), so every run measures the same number
+ * and startup does not include a prime search. A size missing from the
+ * cache is generated once and added to it.
+ * 
+ * Usage: measure_primality_time <algorithm> <bits> [--counters]
+ *        measure_primality_time --build-cache [--count=<n>] <bits>...
  *   algorithm: miller_rabin or baillie_psw
  *   bits: number of bits (e.g., 40, 56, 80, ..., 4096)
+ *   --counters: also print a line with the hardware counters of one more call
+ *               (Cycles,Instructions,IPC,CacheMissRate,BranchMissRate; NA if unavailable)
+ *   --build-cache: fill the prime cache with n primes (default 1) of each size and exit
  */
 
-// Function to get high-precision time using rdtsc
-inline uint64_t rdtsc() {
-    return __rdtsc();
-}
-
-// Use std::chrono for systems where rdtsc is not available
-uint64_t high_resolution_time() {
-    return std::chrono::high_resolution_clock::now().time_since_epoch().count();
+// Fill the prime cache for the given sizes (--build-cache)
+int build_cache(int argc, char* argv[]) {
+    std::vector<unsigned int> sizes;
+    size_t count = 1;
+    
+    try {
+        for (int i = 2; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg.substr(0, 8) == "--count=") {
+                count = std::stoul(arg.substr(8));
+            } else {
+                sizes.push_back(std::stoul(arg));
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: Invalid argument to --build-cache" << std::endl;
+        return 1;
+    }
+    
+    PrimalityTester tester;
+    std::string path = PrimeCache::default_path();
+    if (!PrimeCache::ensure(path, sizes, count, tester)) {
+        std::cerr << "Error: Could not write prime cache " << path << std::endl;
+        return 1;
+    }
+    std::cerr << "Prime cache " << path << " holds " << count << " prime(s) for each requested size" << std::endl;
+    return 0;
 }
 
 int main(int argc, char* argv[]) {
-    if (argc != 3) {
-        std::cerr << "Usage: " << argv[0] << " <algorithm> <bits>" << std::endl;
+    if (argc >= 2 && std::strcmp(argv[1], "--build-cache") == 0) {
+        return build_cache(argc, argv);
+    }
+    
+    bool with_counters = (argc == 4 && std::strcmp(argv[3], "--counters") == 0);
+    if (argc != 3 && !with_counters) {
+        std::cerr << "Usage: " << argv[0] << " <algorithm> <bits> [--counters]" << std::endl;
+        std::cerr << "       " << argv[0] << " --build-cache [--count=<n>] <bits>..." << std::endl;
         std::cerr << "  algorithm: miller_rabin or baillie_psw" << std::endl;
         std::cerr << "  bits: number of bits (e.g., 40, 56, 80, ..., 4096)" << std::endl;
+        std::cerr << "  --counters: also print " << PerfCounters::Sample::csv_header() << std::endl;
         return 1;
     }
     
@@ -66,30 +103,50 @@ int main(int argc, char* argv[]) {
         return 1;
     }
     
-    // Generate a prime number of the specified bit size
+    // Take the prime from the cache, adding it on first use
+    std::string cache_path = PrimeCache::default_path();
+    PrimeCache cache;
+    if (!cache.open(cache_path) || cache.count(bits) == 0) {
+        PrimeCache::ensure(cache_path, {static_cast<unsigned int>(bits)}, 1, tester);
+        cache.open(cache_path);
+    }
+    
     mpz_t prime;
     mpz_init(prime);
+    if (!cache.load(prime, bits, 0)) {
+        // Cache not writable (or bits < 2): search as before
+        tester.generate_prime(prime, bits);
+    }
     
-    // Find a prime of the specified bit size
-    tester.generate_prime(prime, bits);
+    // The per-n setup is done once, outside the measurement
+    PreparedModulus prepared(prime);
     
     // Warm-up runs
     for (int i = 0; i < 3; i++) {
-        tester.is_prime(prime, test_type);
+        tester.is_prime(prepared, test_type);
     }
     
-    // Measure time
-    uint64_t start_time = rdtsc();
+    // Measure time with the fenced timestamp counter, minus the timer's own cost
+    uint64_t start_time = CycleTimer::start();
     
     // Call the algorithm
-    tester.is_prime(prime, test_type);
+    tester.is_prime(prepared, test_type);
     
-    uint64_t end_time = rdtsc();
-    uint64_t elapsed_cycles = end_time - start_time;
+    uint64_t end_time = CycleTimer::stop();
+    uint64_t elapsed_cycles = CycleTimer::elapsed(start_time, end_time);
     
     // Output just the raw measurement (to be processed by the calling script)
     std::cout << elapsed_cycles << std::endl;
     
+    // Hardware counters for one more call, on a separate run so the timing above is unaffected
+    if (with_counters) {
+        PerfCounters counters;
+        counters.start();
+        tester.is_prime(prepared, test_type);
+        PerfCounters::Sample sample = counters.stop();
+        std::cout << sample.csv_row() << std::endl;
+    }
+    
     // Clean up
     mpz_clear(prime);
     
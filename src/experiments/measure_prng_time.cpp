@@ -1,5 +1,6 @@
 #include "../../include/prng/lcg.h"
 #include "../../include/prng/xoshiro.h"
+#include "../../include/utils/perf_counters.h"
 #include <iostream>
 #include <string>
 #include <chrono>
@@ -7,7 +8,6 @@
 #include <cstring>
 #include <cstdint>
 #include <memory>
-#include <x86intrin.h> // For _rdtsc()
 
 /**
  * @brief Program to measure PRNG algorithm execution time with high precision
@@ -15,26 +15,20 @@
  * This program measures the execution time of generating random numbers
  * with various PRNG algorithms at different bit sizes.
  * 
- * Usage: measure_prng_time <algorithm> <bits>
+ * Usage: measure_prng_time <algorithm> <bits> [--counters]
  *   algorithm: lcg or xoshiro
  *   bits: number of bits (e.g., 40, 56, 80, ..., 4096)
+ *   --counters: also print a line with the hardware counters of one more call
+ *               (Cycles,Instructions,IPC,CacheMissRate,BranchMissRate; NA if unavailable)
  */
 
-// Function to get high-precision time using rdtsc
-inline uint64_t rdtsc() {
-    return __rdtsc();
-}
-
-// Use std::chrono for systems where rdtsc is not available
-uint64_t high_resolution_time() {
-    return std::chrono::high_resolution_clock::now().time_since_epoch().count();
-}
-
 int main(int argc, char* argv[]) {
-    if (argc != 3) {
-        std::cerr << "Usage: " << argv[0] << " <algorithm> <bits>" << std::endl;
+    bool with_counters = (argc == 4 && std::strcmp(argv[3], "--counters") == 0);
+    if (argc != 3 && !with_counters) {
+        std::cerr << "Usage: " << argv[0] << " <algorithm> <bits> [--counters]" << std::endl;
         std::cerr << "  algorithm: lcg or xoshiro" << std::endl;
         std::cerr << "  bits: number of bits (e.g., 40, 56, 80, ..., 4096)" << std::endl;
+        std::cerr << "  --counters: also print " << PerfCounters::Sample::csv_header() << std::endl;
         return 1;
     }
     
@@ -78,18 +72,27 @@ int main(int argc, char* argv[]) {
         prng->randbits(result, bits);
     }
     
-    // Measure time
-    uint64_t start_time = rdtsc();
+    // Measure time with the fenced timestamp counter, minus the timer's own cost
+    uint64_t start_time = CycleTimer::start();
     
     // Call the algorithm
     prng->randbits(result, bits);
     
-    uint64_t end_time = rdtsc();
-    uint64_t elapsed_cycles = end_time - start_time;
+    uint64_t end_time = CycleTimer::stop();
+    uint64_t elapsed_cycles = CycleTimer::elapsed(start_time, end_time);
     
     // Output just the raw measurement (to be processed by the calling script)
     std::cout << elapsed_cycles << std::endl;
     
+    // Hardware counters for one more call, on a separate run so the timing above is unaffected
+    if (with_counters) {
+        PerfCounters counters;
+        counters.start();
+        prng->randbits(result, bits);
+        PerfCounters::Sample sample = counters.stop();
+        std::cout << sample.csv_row() << std::endl;
+    }
+    
     // Clean up
     mpz_clear(result);
     
@@ -1,13 +1,27 @@
 #include "../include/prng/lcg.h"
 #include "../include/prng/xoshiro.h"
 #include "../include/primality/primality_tester.h"
+#include "../include/primality/parallel_prime_finder.h"
+#include "../include/primality/prime_jobs.h"
+#include "../include/primality/prime_server.h"
+#include "../include/primality/prime_sieve.h"
 #include "../include/utils/mpz_utils.h"
+#include "../include/utils/stream_writer.h"
+#include "../include/prng/random_bits.h"
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <sstream>
+#include <vector>
 #include <iostream>
 #include <chrono>
 #include <string>
 #include <memory>
 #include <stdexcept>
 #include <cstdlib>
+#include <cstdio>
 
 /**
  * @brief Entry point for the prime number generation and testing application
@@ -24,45 +38,232 @@ void print_help() {
     std::cout << "  help                  Display this help message\n";
     std::cout << "  generate <bits>       Generate a random prime number of the specified size\n";
     std::cout << "  test <number>         Test if a number is prime\n";
+    std::cout << "  stream                Write many primes or random numbers to stdout (see --kind)\n";
+    std::cout << "  range <lo> <hi>       Write the primes in [lo, hi] (64-bit bounds) to stdout, one per line\n";
+    std::cout << "  serve                 Answer newline-delimited test/generate requests from stdin, or a Unix\n";
+    std::cout << "                        socket with --socket, keeping the tester and tables warm\n";
     std::cout << "  benchmark             Run all benchmarks\n";
     std::cout << "  benchmark-prng        Run only PRNG benchmarks\n";
     std::cout << "  benchmark-primality   Run only primality testing benchmarks\n\n";
     std::cout << "Options:\n";
-    std::cout << "  --iterations=<n>      Number of iterations for Miller-Rabin test (default: 40)\n";
-    std::cout << "  --algorithm=<alg>     Primality test algorithm: mr (Miller-Rabin) or bpsw (Baillie-PSW) (default: mr)\n";
+    std::cout << "  --iterations=<n>      Fixed number of Miller-Rabin rounds (default: as many as --error-bits needs)\n";
+    std::cout << "  --error-bits=<n>      Accept a composite with probability at most 2^-n (default: 128); generate\n";
+    std::cout << "                        and stream test random candidates, which need far fewer rounds than test\n";
+    std::cout << "  --algorithm=<alg>     Primality test algorithm: mr (Miller-Rabin), bpsw (Baillie-PSW) or auto\n";
+    std::cout << "                        (the cheaper of the two for the error target) (default: mr)\n";
+    std::cout << "  --threads=<n>         Number of threads for generate, stream and range, 0 for all cores (default: 1)\n";
+    std::cout << "  --count-only          range: print only the number of primes\n";
+    std::cout << "  --safe                generate: a safe prime p = 2q + 1 with q prime\n";
+    std::cout << "  --timeout=<ms>        generate: give up after ms milliseconds (one search thread)\n";
+    std::cout << "  --socket=<path>       serve: listen on a Unix socket instead of stdin/stdout\n";
+    std::cout << "  --pool=<bits,...>     serve: keep ready-made primes of these sizes, refilled by --threads threads\n";
+    std::cout << "  --pool-size=<n>       serve: primes kept per pooled size (default: 16)\n";
+    std::cout << "  --kind=<kind>         stream: prime or random (default: random)\n";
+    std::cout << "  --bits=<n>            stream: bit length of every number (default: 1024)\n";
+    std::cout << "  --count=<n>           stream: how many numbers to write (default: 1)\n";
+    std::cout << "  --format=<fmt>        stream: hex or dec (one per line), or bin (raw little-endian\n";
+    std::cout << "                        64-bit limbs, ceil(bits/64) per number) (default: hex)\n";
 }
 
 /**
  * @brief Generate a random prime number
  * 
  * @param bits Number of bits
- * @param iterations Number of iterations for Miller-Rabin
+ * @param algo_type Type of primality test algorithm to use
+ * @param policy Rounds for the candidates
+ * @param threads Number of search threads (0 for all hardware threads)
+ * @param safe True for a safe prime p = 2q + 1 with q prime
  */
-void generate_prime(unsigned int bits, unsigned int iterations) {
-    PrimalityTester tester;
+void generate_prime(unsigned int bits, PrimalityTester::TestType algo_type, const RoundPolicy& policy,
+                    unsigned int threads, bool safe) {
+    ParallelPrimeFinder finder(threads);
+    finder.set_search_policy(policy);
     mpz_t prime;
     mpz_init(prime);
     
     auto start = std::chrono::high_resolution_clock::now();
-    tester.generate_prime(prime, bits);
+    if (safe) {
+        finder.find_safe_prime(prime, bits, algo_type);
+    } else {
+        finder.find_prime(prime, bits, algo_type);
+    }
     auto end = std::chrono::high_resolution_clock::now();
     
     std::chrono::duration<double, std::milli> duration = end - start;
     
-    std::cout << "Found a " << bits << "-bit prime in " << duration.count() << " ms:\n";
+    std::cout << "Found a " << bits << "-bit " << (safe ? "safe " : "") << "prime in " << duration.count() << " ms";
+    if (finder.thread_count() > 1) {
+        std::cout << " using " << finder.thread_count() << " threads";
+    }
+    std::cout << ":\n";
     gmp_printf("%Zd\n", prime);
     
     mpz_clear(prime);
 }
 
+/**
+ * @brief Generate a random prime number, giving up after a timeout
+ * 
+ * The search runs as a PrimeJobs job, which stops before the next candidate
+ * once the deadline has passed.
+ * 
+ * @param bits Number of bits
+ * @param algo_type Type of primality test algorithm to use
+ * @param policy Rounds for the candidates
+ * @param safe True for a safe prime p = 2q + 1 with q prime
+ * @param timeout_ms Timeout in milliseconds
+ * @return bool True if a prime was found in time
+ */
+bool generate_prime_with_timeout(unsigned int bits, PrimalityTester::TestType algo_type,
+                                 const RoundPolicy& policy, bool safe, unsigned int timeout_ms) {
+    PrimeJobs jobs(1);
+    jobs.set_search_policy(policy);
+    PrimeJobs::Options options;
+    options.type = algo_type;
+    options.safe = safe;
+    options.timeout = std::chrono::milliseconds(timeout_ms);
+    
+    auto start = std::chrono::high_resolution_clock::now();
+    PrimeJobs::Handle job = jobs.submit_generate(bits, options);
+    mpz_t prime;
+    mpz_init(prime);
+    bool found = job.get(prime);
+    auto end = std::chrono::high_resolution_clock::now();
+    
+    std::chrono::duration<double, std::milli> duration = end - start;
+    if (found) {
+        std::cout << "Found a " << bits << "-bit " << (safe ? "safe " : "") << "prime in "
+                  << duration.count() << " ms:\n";
+        gmp_printf("%Zd\n", prime);
+    } else {
+        std::cerr << "Error: No " << bits << "-bit " << (safe ? "safe " : "") << "prime found within "
+                  << timeout_ms << " ms (" << job.candidates() << " candidates tried)\n";
+    }
+    
+    mpz_clear(prime);
+    return found;
+}
+
+/**
+ * @brief Write count primes or random numbers to stdout
+ * 
+ * Numbers are generated on this thread and written by the StreamWriter's
+ * output thread, so generation does not wait on a slow reader until all of
+ * the writer's buffers are queued.
+ * 
+ * @param primes True for primes, false for random numbers with exactly bits bits
+ * @param bits Bit length of every number
+ * @param count Number of numbers
+ * @param format Output format
+ * @param algo_type Type of primality test algorithm to use for primes
+ * @param policy Rounds for the prime candidates
+ * @param threads Number of search threads for primes (0 for all hardware threads)
+ */
+void stream_numbers(bool primes, unsigned int bits, uint64_t count, StreamWriter::Format format,
+                    PrimalityTester::TestType algo_type, const RoundPolicy& policy, unsigned int threads) {
+    StreamWriter writer(STDOUT_FILENO);
+    size_t width = (bits + GMP_NUMB_BITS - 1) / GMP_NUMB_BITS;
+    mpz_t number;
+    mpz_init2(number, bits);
+    
+    auto start = std::chrono::high_resolution_clock::now();
+    if (primes) {
+        ParallelPrimeFinder finder(threads);
+        finder.set_search_policy(policy);
+        for (uint64_t i = 0; i < count; i++) {
+            finder.find_prime(number, bits, algo_type);
+            writer.write(number, format, width);
+        }
+    } else {
+        Xoshiro256pp generator;
+        RandomBits<Xoshiro256pp> random(generator);
+        for (uint64_t i = 0; i < count; i++) {
+            random(number, bits);
+            writer.write(number, format, width);
+        }
+    }
+    bool ok = writer.finish();
+    auto end = std::chrono::high_resolution_clock::now();
+    
+    std::chrono::duration<double, std::milli> duration = end - start;
+    if (!ok) {
+        std::cerr << "Error: Writing to stdout failed\n";
+    }
+    std::cerr << "Streamed " << count << " " << (primes ? "primes" : "random numbers") << " of "
+              << bits << " bits in " << duration.count() << " ms\n";
+    
+    mpz_clear(number);
+}
+
+/**
+ * @brief Write or count the primes in an interval
+ * 
+ * The interval is sieved with PrimeSieve; primes are formatted into a large
+ * buffer and written to stdout in increasing order.
+ * 
+ * @param lo_str Lower bound as a string (decimal, or hex with 0x)
+ * @param hi_str Upper bound as a string
+ * @param count_only True to print only the number of primes
+ * @param threads Number of sieving threads (0 for all hardware threads)
+ * @return bool False if the bounds are invalid
+ */
+bool prime_range(const std::string& lo_str, const std::string& hi_str, bool count_only, unsigned int threads) {
+    // std::stoull accepts a sign and would wrap -1 to 2^64 - 1
+    for (const std::string* bound : {&lo_str, &hi_str}) {
+        size_t first = bound->find_first_not_of(" \t\n\v\f\r");
+        if (first != std::string::npos && (*bound)[first] == '-') {
+            std::cerr << "Error: The bounds must not be negative.\n";
+            return false;
+        }
+    }
+    uint64_t lo = std::stoull(lo_str, nullptr, 0);
+    uint64_t hi = std::stoull(hi_str, nullptr, 0);
+    if (lo > hi) {
+        std::cerr << "Error: The lower bound is above the upper bound.\n";
+        return false;
+    }
+    
+    auto start = std::chrono::high_resolution_clock::now();
+    uint64_t count = 0;
+    if (count_only) {
+        count = PrimeSieve::count_primes(lo, hi, threads);
+        std::cout << count << std::endl;
+    } else {
+        std::string buffer;
+        buffer.reserve(1 << 16);
+        char digits[24];
+        PrimeSieve::for_each_prime(lo, hi, [&](uint64_t p) {
+            int length = std::snprintf(digits, sizeof(digits), "%llu\n", static_cast<unsigned long long>(p));
+            buffer.append(digits, length);
+            if (buffer.size() >= (1 << 16) - 32) {
+                std::fwrite(buffer.data(), 1, buffer.size(), stdout);
+                buffer.clear();
+            }
+            count++;
+        }, threads);
+        std::fwrite(buffer.data(), 1, buffer.size(), stdout);
+        std::fflush(stdout);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    
+    std::chrono::duration<double, std::milli> duration = end - start;
+    std::cerr << "Found " << count << " primes in [" << lo << ", " << hi << "] in "
+              << duration.count() << " ms\n";
+    return true;
+}
+
 /**
  * @brief Test if a number is prime
  * 
+ * The number may come from anywhere, so the policy assumes the worst case.
+ * 
  * @param number_str Number to test as a string
  * @param algo_type Type of primality test algorithm to use
- * @param iterations Number of iterations for Miller-Rabin
+ * @param auto_algo Let the policy choose the algorithm instead
+ * @param policy Error target or fixed rounds
  */
-void test_prime(const std::string& number_str, PrimalityTester::TestType algo_type, unsigned int iterations) {
+void test_prime(const std::string& number_str, PrimalityTester::TestType algo_type, bool auto_algo,
+                const RoundPolicy& policy) {
     PrimalityTester tester;
     mpz_t number;
     mpz_init(number);
@@ -73,21 +274,75 @@ void test_prime(const std::string& number_str, PrimalityTester::TestType algo_ty
         return;
     }
     
+    RoundPolicy::Choice choice = policy.choose(mpz_sizeinbase(number, 2));
+    if (auto_algo) {
+        algo_type = choice.bpsw ? PrimalityTester::BAILLIE_PSW : PrimalityTester::MILLER_RABIN;
+    }
+    
     auto start = std::chrono::high_resolution_clock::now();
-    bool is_prime = tester.is_prime(number, algo_type, iterations);
+    bool is_prime = tester.is_prime(number, algo_type, choice.rounds);
     auto end = std::chrono::high_resolution_clock::now();
     
     std::chrono::duration<double, std::milli> duration = end - start;
     
     std::cout << "Number: " << number_str << std::endl;
     std::cout << "Algorithm: " << (algo_type == PrimalityTester::MILLER_RABIN ? "Miller-Rabin" : "Baillie-PSW") << std::endl;
-    std::cout << "Iterations: " << iterations << std::endl;
-    std::cout << "Result: " << (is_prime ? "Probably Prime" : "Composite") << std::endl;
+    if (algo_type == PrimalityTester::MILLER_RABIN) {
+        std::cout << "Iterations: " << choice.rounds << std::endl;
+    }
+    if (PrimalityTester::is_proven(number)) {
+        std::cout << "Result: " << (is_prime ? "Prime" : "Composite") << " (deterministic 64-bit test)" << std::endl;
+    } else {
+        std::cout << "Result: " << (is_prime ? "Probably Prime" : "Composite") << std::endl;
+    }
     std::cout << "Time: " << duration.count() << " ms" << std::endl;
     
     mpz_clear(number);
 }
 
+// Set by SIGINT and SIGTERM to stop serve --socket
+std::atomic<bool> g_stop_serving(false);
+
+void stop_serving(int) {
+    g_stop_serving.store(true);
+}
+
+/**
+ * @brief Answer requests until end of input, or on a Unix socket until interrupted
+ * 
+ * @param socket_path Socket to listen on, or empty for stdin/stdout
+ * @param algo_type Type of primality test algorithm to use
+ * @param auto_algo Let the policies choose the algorithm instead
+ * @param search_policy Rounds for generate requests
+ * @param test_policy Rounds for test requests
+ * @param pool_bits Bit sizes to keep ready-made primes for
+ * @param pool_size Primes kept per pooled size
+ * @param threads Number of pool refill threads (0 for all hardware threads)
+ * @return bool False if the input, the output or the socket failed
+ */
+bool serve(const std::string& socket_path, PrimalityTester::TestType algo_type, bool auto_algo,
+           const RoundPolicy& search_policy, const RoundPolicy& test_policy,
+           const std::vector<unsigned int>& pool_bits, size_t pool_size, unsigned int threads) {
+    PrimeServer server(algo_type, auto_algo, search_policy, test_policy);
+    if (!pool_bits.empty()) {
+        server.pool(pool_bits, pool_size, threads);
+    }
+    std::signal(SIGPIPE, SIG_IGN);
+    
+    if (socket_path.empty()) {
+        return server.serve_fd(STDIN_FILENO, STDOUT_FILENO);
+    }
+    
+    std::signal(SIGINT, stop_serving);
+    std::signal(SIGTERM, stop_serving);
+    std::cerr << "Serving on " << socket_path << std::endl;
+    if (!server.serve_socket(socket_path, g_stop_serving)) {
+        std::cerr << "Error: Could not listen on " << socket_path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
 /**
  * @brief Run the specified benchmarks
  * 
@@ -125,7 +380,20 @@ int main(int argc, char* argv[]) {
     }
     
     // Default parameters
-    unsigned int iterations = 40;
+    unsigned int iterations = 0;  // 0: as many as the error target needs
+    unsigned int error_bits = RoundPolicy::DEFAULT_ERROR_BITS;
+    bool auto_algo = false;
+    bool safe = false;
+    unsigned int timeout_ms = 0;
+    bool count_only = false;
+    unsigned int threads = 1;
+    std::string socket_path;
+    std::vector<unsigned int> pool_bits;
+    size_t pool_size = 16;
+    bool stream_primes = false;
+    unsigned int stream_bits = 1024;
+    uint64_t stream_count = 1;
+    StreamWriter::Format stream_format = StreamWriter::HEX;
     PrimalityTester::TestType algo_type = PrimalityTester::MILLER_RABIN;
     
     // Parse additional options
@@ -134,25 +402,105 @@ int main(int argc, char* argv[]) {
         
         if (arg.substr(0, 13) == "--iterations=") {
             iterations = std::stoi(arg.substr(13));
+        } else if (arg.substr(0, 13) == "--error-bits=") {
+            error_bits = std::stoi(arg.substr(13));
+        } else if (arg.substr(0, 10) == "--threads=") {
+            threads = std::stoi(arg.substr(10));
+        } else if (arg == "--safe") {
+            safe = true;
+        } else if (arg.substr(0, 10) == "--timeout=") {
+            timeout_ms = std::stoi(arg.substr(10));
+        } else if (arg.substr(0, 9) == "--socket=") {
+            socket_path = arg.substr(9);
+        } else if (arg.substr(0, 7) == "--pool=") {
+            std::stringstream sizes(arg.substr(7));
+            std::string size;
+            while (std::getline(sizes, size, ',')) {
+                pool_bits.push_back(std::stoi(size));
+            }
+        } else if (arg.substr(0, 12) == "--pool-size=") {
+            pool_size = std::stoull(arg.substr(12));
+        } else if (arg == "--count-only") {
+            count_only = true;
+        } else if (arg.substr(0, 7) == "--kind=") {
+            std::string kind = arg.substr(7);
+            if (kind == "prime") {
+                stream_primes = true;
+            } else if (kind == "random") {
+                stream_primes = false;
+            } else {
+                std::cerr << "Error: Invalid kind. Use prime or random.\n";
+                return 1;
+            }
+        } else if (arg.substr(0, 7) == "--bits=") {
+            stream_bits = std::stoi(arg.substr(7));
+        } else if (arg.substr(0, 8) == "--count=") {
+            stream_count = std::stoull(arg.substr(8));
+        } else if (arg.substr(0, 9) == "--format=") {
+            std::string format = arg.substr(9);
+            if (format == "hex") {
+                stream_format = StreamWriter::HEX;
+            } else if (format == "dec") {
+                stream_format = StreamWriter::DEC;
+            } else if (format == "bin") {
+                stream_format = StreamWriter::BIN;
+            } else {
+                std::cerr << "Error: Invalid format. Use hex, dec or bin.\n";
+                return 1;
+            }
         } else if (arg.substr(0, 12) == "--algorithm=") {
             std::string algo = arg.substr(12);
             if (algo == "mr") {
                 algo_type = PrimalityTester::MILLER_RABIN;
             } else if (algo == "bpsw") {
                 algo_type = PrimalityTester::BAILLIE_PSW;
+            } else if (algo == "auto") {
+                auto_algo = true;
             } else {
-                std::cerr << "Error: Invalid algorithm. Use mr (Miller-Rabin) or bpsw (Baillie-PSW).\n";
+                std::cerr << "Error: Invalid algorithm. Use mr (Miller-Rabin), bpsw (Baillie-PSW) or auto.\n";
                 return 1;
             }
         }
     }
     
+    // Search candidates are random; a number given to test may not be
+    RoundPolicy search_policy = iterations > 0 ? RoundPolicy::fixed_rounds(iterations)
+                                               : RoundPolicy(error_bits, RoundPolicy::RANDOM_CANDIDATE);
+    RoundPolicy test_policy = iterations > 0 ? RoundPolicy::fixed_rounds(iterations)
+                                             : RoundPolicy(error_bits, RoundPolicy::ADVERSARIAL);
+    
     try {
         if (command == "generate" && argc >= 3) {
             unsigned int bits = std::stoi(argv[2]);
-            generate_prime(bits, iterations);
+            if (auto_algo) {
+                algo_type = search_policy.choose(bits).bpsw ? PrimalityTester::BAILLIE_PSW
+                                                            : PrimalityTester::MILLER_RABIN;
+            }
+            if (timeout_ms > 0) {
+                if (!generate_prime_with_timeout(bits, algo_type, search_policy, safe, timeout_ms)) {
+                    return 1;
+                }
+            } else {
+                generate_prime(bits, algo_type, search_policy, threads, safe);
+            }
+        } else if (command == "range" && argc >= 4) {
+            if (!prime_range(argv[2], argv[3], count_only, threads)) {
+                return 1;
+            }
+        } else if (command == "stream") {
+            if (auto_algo) {
+                algo_type = search_policy.choose(stream_bits).bpsw ? PrimalityTester::BAILLIE_PSW
+                                                                   : PrimalityTester::MILLER_RABIN;
+            }
+            stream_numbers(stream_primes, stream_bits, stream_count, stream_format, algo_type, search_policy,
+                           threads);
         } else if (command == "test" && argc >= 3) {
-            test_prime(argv[2], algo_type, iterations);
+            test_prime(argv[2], algo_type, auto_algo, test_policy);
+        } else if (command == "serve") {
+            if (!serve(socket_path, algo_type, auto_algo, search_policy, test_policy, pool_bits, pool_size,
+                       threads)) {
+                return 1;
+            }
         } else if (command == "benchmark") {
             run_benchmark("all");
         } else if (command == "benchmark-prng") {
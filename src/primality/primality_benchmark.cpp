@@ -1,6 +1,12 @@
 #include "../../include/primality/primality_tester.h"
+#include "../../include/primality/parallel_prime_finder.h"
+#include "../../include/primality/prime_pool.h"
+#include "../../include/primality/prime_jobs.h"
+#include "../../include/primality/prime_cache.h"
 #include "../../include/prng/xoshiro.h"
 #include "../../include/utils/timing.h"
+#include "../../include/utils/bench_harness.h"
+#include "../../include/utils/mem_profile.h"
 #include "../../include/utils/mpz_utils.h"
 #include <iostream>
 #include <iomanip>
@@ -10,8 +16,16 @@
 #include <chrono>
 #include <map>
 #include <algorithm>
-#include <cmath>
-#include <tuple>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <limits>
+#include <cerrno>
+#include <cctype>
+#include <cstdlib>
 
 /**
  * @brief Benchmark primality testing algorithms
@@ -21,12 +35,37 @@ private:
     // Bit sizes to benchmark
     const std::vector<int> bit_sizes = {40, 56, 80, 128, 168, 224, 256, 512, 1024, 2048, 4096};
     
-    // Number of runs for statistical significance
-    const int num_runs = 30;
     
     // Output file for CSV results
     const std::string find_prime_file = "results/find_prime_benchmark.csv";
     const std::string test_prime_file = "results/test_prime_benchmark.csv";
+    const std::string thread_scaling_file = "results/thread_scaling_benchmark.csv";
+    const std::string screening_file = "results/screening_benchmark.csv";
+    const std::string batch_file = "results/batch_benchmark.csv";
+    const std::string pool_file = "results/prime_pool_benchmark.csv";
+    const std::string safe_prime_file = "results/safe_prime_benchmark.csv";
+    const std::string mixed_load_file = "results/mixed_load_benchmark.csv";
+    
+    // Bit sizes for the safe-prime cells of the matrix (3072 only without safety checks)
+    const std::vector<int> safe_bit_sizes = {256, 512, 1024, 2048};
+    const int safe_unsafe_bits = 3072;
+    
+    // Bit sizes for the thread scaling sweep
+    const std::vector<int> scaling_bit_sizes = {256, 512, 1024, 2048};
+    
+    // Bit sizes, batch sizes and candidates per configuration for the batch benchmark
+    const std::vector<int> batch_bit_sizes = {256, 512, 1024, 2048};
+    const std::vector<size_t> batch_sizes = {16, 64, 256};
+    const size_t batch_candidates = 1024;
+    
+    // Bit sizes, shelf capacity and requests per size for the prime pool benchmark
+    const std::vector<unsigned int> pool_bit_sizes = {512, 1024, 2048};
+    const size_t pool_capacity = 8;
+    
+    // Mixed-load benchmark: single-number test jobs and prime searches per bit size, and repetitions
+    const std::vector<std::pair<unsigned int, size_t>> mixed_tests = {{256, 256}};
+    const std::vector<std::pair<unsigned int, size_t>> mixed_workload = {{1024, 8}, {2048, 2}, {4096, 1}};
+    const int mixed_rounds = 3;
     
     // Global GMP random state
     gmp_randstate_t gmp_randstate;
@@ -34,142 +73,295 @@ private:
     // Map to store found primes for testing
     std::map<int, mpz_t> found_primes;
     
+    // Candidate search strategy used by the find-prime benchmark
+    PrimalityTester::SearchMethod search_method = PrimalityTester::SIEVE_SEARCH;
+    
+    // Hardware counters of the benchmark thread
+    PerfCounters counters;
+    
+    // Algorithms compared by the find-prime and test-prime benchmarks
+    const std::vector<std::pair<PrimalityTester::TestType, std::string>> algorithms = {
+        {PrimalityTester::MILLER_RABIN, "Miller-Rabin"},
+        {PrimalityTester::BAILLIE_PSW, "Baillie-PSW"}
+    };
+    
     /**
-     * @brief Calculate standard deviation
+     * @brief One cell of the find-prime/test-prime matrix
+     */
+    struct Cell {
+        PrimalityTester::TestType type;
+        std::string algorithm;
+        int bits;
+    };
+    
+    // Matrix of the find-prime and test-prime benchmarks
+    std::vector<int> matrix_bit_sizes = bit_sizes;
+    bool miller_rabin_only = false;
+    
+    // Matrix runner: worker threads (0 for one per core), this process's shard, resuming and time budgets
+    unsigned int jobs = 1;
+    unsigned int shard_index = 0;
+    unsigned int shard_count = 1;
+    bool resume = false;
+    bool no_safety = false;
+    
+    // Add GMP allocation and peak-memory figures to the matrix rows (--mem-profile)
+    bool mem_profile = false;
+    
+    // Guards found_primes, the screening file and the progress output while cells run in parallel
+    std::mutex matrix_mutex;
+    std::ofstream screening_out;
+    
+    /**
+     * @brief Measurement parameters for the prime searches
      * 
-     * @param values Vector of values
-     * @param mean Mean value
-     * @return double Standard deviation
+     * Search times are heavy-tailed (the distance to the next prime varies a
+     * lot), so the median is only asked for to within 10%. Without safety
+     * checks there is no time budget, only the run limit.
      */
-    double calculate_stddev(const std::vector<double>& values, double mean) {
-        double variance = 0.0;
-        for (double value : values) {
-            variance += (value - mean) * (value - mean);
-        }
-        return std::sqrt(variance / values.size());
+    BenchHarness::Config search_config() const {
+        BenchHarness::Config config;
+        config.min_runs = 10;
+        config.max_runs = 200;
+        config.max_seconds = no_safety ? 1e9 : 30.0;
+        config.target_rel_ci = 0.10;
+        config.warmup_min = 1;
+        config.warmup_max = 5;
+        return config;
     }
     
     /**
-     * @brief Calculate median
+     * @brief Measurement parameters for testing a fixed number
+     */
+    BenchHarness::Config test_config() const {
+        BenchHarness::Config config;
+        config.min_runs = 10;
+        config.max_runs = 1000;
+        config.max_seconds = no_safety ? 1e9 : 3.0;
+        config.target_rel_ci = 0.02;
+        return config;
+    }
+    
+    /**
+     * @brief Measurement parameters for the safe-prime searches
      * 
-     * @param values Vector of values
-     * @return double Median value
+     * A 2048-bit safe prime takes seconds to tens of seconds, so fewer runs
+     * are asked for than for the plain searches.
      */
-    double calculate_median(std::vector<double> values) {
-        std::sort(values.begin(), values.end());
-        if (values.size() % 2 == 0) {
-            return (values[values.size() / 2 - 1] + values[values.size() / 2]) / 2.0;
-        } else {
-            return values[values.size() / 2];
+    BenchHarness::Config safe_config() const {
+        BenchHarness::Config config;
+        config.min_runs = 3;
+        config.max_runs = 50;
+        config.max_seconds = no_safety ? 1e9 : 60.0;
+        config.target_rel_ci = 0.20;
+        config.warmup_min = 1;
+        config.warmup_max = 1;
+        return config;
+    }
+    
+    /**
+     * @brief Time an operation with the harness, counting hardware events on every call
+     * 
+     * @param config Measurement parameters
+     * @param thread_counters Counters of the calling thread
+     * @param op The operation
+     * @param sample Output parameter for the counters, summed over all calls
+     * @param calls Output parameter for the number of calls (warm-up included)
+     * @param memory Output parameter for the memory profile of every call after
+     *        the first (which grows the tester's workspace), or nullptr
+     * @return BenchHarness::Summary Timing statistics
+     */
+    template <typename F>
+    BenchHarness::Summary measure_counted(const BenchHarness::Config& config, PerfCounters& thread_counters,
+                                          F&& op, PerfCounters::Sample& sample, size_t& calls,
+                                          MemProfile::Report* memory = nullptr) {
+        sample = PerfCounters::Sample();
+        calls = 0;
+        BenchHarness harness(config);
+        MemProfile profile;
+        BenchHarness::Summary summary = harness.measure([&]() {
+            if (memory != nullptr && calls == 1) profile.begin();
+            thread_counters.start();
+            uint64_t start = CycleTimer::start();
+            op();
+            uint64_t end = CycleTimer::stop();
+            sample += thread_counters.stop();
+            calls++;
+            return CycleTimer::to_ms(CycleTimer::elapsed(start, end));
+        });
+        if (memory != nullptr) *memory = profile.end(calls > 1 ? calls - 1 : 1);
+        return summary;
+    }
+    
+    /**
+     * @brief Format a memory profile for the progress output, or nothing without --mem-profile
+     */
+    std::string memory_summary(const MemProfile::Report& memory) const {
+        return mem_profile ? ", " + memory.summary() : "";
+    }
+    
+    /**
+     * @brief Get this shard's output file for a results file
+     * 
+     * @param path Results file
+     * @return std::string path, with .shard<i>of<n> before the extension when sharded
+     */
+    std::string shard_path(const std::string& path) const {
+        if (shard_count <= 1) return path;
+        std::string suffix = ".shard" + std::to_string(shard_index) + "of" + std::to_string(shard_count);
+        size_t dot = path.rfind('.');
+        return (dot == std::string::npos) ? path + suffix : path.substr(0, dot) + suffix + path.substr(dot);
+    }
+    
+    /**
+     * @brief Get the cells of the matrix, in the order they are numbered for sharding
+     */
+    std::vector<Cell> matrix_cells() const {
+        std::vector<Cell> cells;
+        for (int bits : matrix_bit_sizes) {
+            for (const auto& algorithm : algorithms) {
+                if (miller_rabin_only && algorithm.first != PrimalityTester::MILLER_RABIN) continue;
+                cells.push_back(Cell{algorithm.first, algorithm.second, bits});
+            }
         }
+        return cells;
     }
     
     /**
-     * @brief Find a prime number of the specified bit size
+     * @brief Get the safe-prime cells of the matrix, numbered after the test-prime cells
      * 
-     * @param tester The PrimalityTester to use
-     * @param type The type of primality test to use
-     * @param bits The bit size of the prime to find
-     * @param result Output parameter for the prime
-     * @return Vector of timing data in milliseconds
+     * A restricted matrix (--only-2048, --include-4096) keeps only its own bit sizes.
      */
-    std::vector<double> find_prime_timed(PrimalityTester& tester, PrimalityTester::TestType type, int bits, mpz_t result) {
-        // Find the prime and time it
-        auto start = std::chrono::high_resolution_clock::now();
-        bool found = tester.find_prime(result, bits, type);
-        auto end = std::chrono::high_resolution_clock::now();
+    std::vector<Cell> safe_cells() const {
+        std::vector<int> sizes = safe_bit_sizes;
+        if (no_safety) sizes.push_back(safe_unsafe_bits);
         
-        if (!found) {
-            std::cerr << "Warning: Could not find a prime of " << bits << " bits" << std::endl;
-            return {};
+        std::vector<Cell> cells;
+        for (int bits : sizes) {
+            if (matrix_bit_sizes != bit_sizes &&
+                std::find(matrix_bit_sizes.begin(), matrix_bit_sizes.end(), bits) == matrix_bit_sizes.end()) {
+                continue;
+            }
+            for (const auto& algorithm : algorithms) {
+                if (miller_rabin_only && algorithm.first != PrimalityTester::MILLER_RABIN) continue;
+                cells.push_back(Cell{algorithm.first, algorithm.second, bits});
+            }
         }
-        
-        std::chrono::duration<double, std::milli> duration = end - start;
-        
-        // Store the first timing result
-        std::vector<double> timings;
-        timings.push_back(duration.count());
-        
-        // Run multiple times for statistical significance for all bit sizes
-        // Always perform full prime finding operations, even for large bit sizes
-        if (bits >= 2048) {
-            std::cout << "  Running 29 more iterations for " << bits 
-                      << "-bit prime (performing complete prime finding for each)..." << std::endl;
+        return cells;
+    }
+    
+    /**
+     * @brief Keep the cells of this shard
+     * 
+     * @param cells All cells of one benchmark
+     * @param offset Number of the first cell (find-prime cells come before test-prime cells)
+     * @return std::vector<Cell> Every cell whose number is shard_index modulo shard_count
+     */
+    std::vector<Cell> shard(const std::vector<Cell>& cells, size_t offset) const {
+        std::vector<Cell> mine;
+        for (size_t i = 0; i < cells.size(); i++) {
+            if ((offset + i) % shard_count == shard_index) mine.push_back(cells[i]);
         }
+        return mine;
+    }
+    
+    /**
+     * @brief Run every cell once, on this thread or on jobs pinned worker threads
+     * 
+     * Each worker takes the next unclaimed cell, so long cells (large bit
+     * sizes) do not hold up the others.
+     * 
+     * @param cells Cells to run
+     * @param run_cell Called as run_cell(cell, counters) with the counters of the running thread
+     */
+    template <typename F>
+    void run_cells(const std::vector<Cell>& cells, F run_cell) {
+        unsigned int cores = std::thread::hardware_concurrency();
+        if (cores == 0) cores = 1;
+        unsigned int workers = resolved_jobs();
+        if (workers > cells.size()) workers = static_cast<unsigned int>(cells.size());
         
-        // For all bit sizes, find 29 more primes
-        for (int i = 1; i < num_runs; i++) {
-            mpz_t temp_result;
-            mpz_init(temp_result);
-            
-            start = std::chrono::high_resolution_clock::now();
-            tester.find_prime(temp_result, bits, type);
-            end = std::chrono::high_resolution_clock::now();
-            
-            duration = end - start;
-            timings.push_back(duration.count());
-            
-            mpz_clear(temp_result);
-            
-            // Print progress indicator every 5 iterations for larger bit sizes
-            if (bits >= 2048 && i % 5 == 0) {
-                std::cout << "    Completed " << i << " of " << (num_runs-1) 
-                        << " additional iterations" << std::endl;
+        if (workers <= 1) {
+            for (const Cell& cell : cells) {
+                run_cell(cell, counters);
             }
+            return;
         }
         
-        return timings;
+        std::atomic<size_t> next(0);
+        std::vector<std::thread> threads;
+        for (unsigned int w = 0; w < workers; w++) {
+            threads.emplace_back([&, w]() {
+                BenchHarness::pin_to_cpu(static_cast<int>(w % cores));
+                PerfCounters thread_counters;
+                for (size_t i = next++; i < cells.size(); i = next++) {
+                    run_cell(cells[i], thread_counters);
+                }
+            });
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
     }
     
     /**
-     * @brief Test a number for primality and time the operation
+     * @brief Check whether cells run concurrently
      * 
-     * @param tester The PrimalityTester to use
-     * @param type The type of primality test to use
-     * @param n The number to test
-     * @return Vector of timing data in milliseconds
-     */
-    std::vector<double> test_primality_timed(PrimalityTester& tester, PrimalityTester::TestType type, const mpz_t n) {
-        std::vector<double> timings;
-        
-        // Multiple runs for statistical significance
-        for (int i = 0; i < num_runs; i++) {
-            auto start = std::chrono::high_resolution_clock::now();
-            tester.is_prime(n, type);
-            auto end = std::chrono::high_resolution_clock::now();
-            
-            std::chrono::duration<double, std::milli> duration = end - start;
-            timings.push_back(duration.count());
-        }
+     * The screening counters are process-wide, so they are only recorded
+     * when one cell runs at a time.
+     */
+    bool parallel_cells() const {
+        return resolved_jobs() > 1;
+    }
+    
+    /**
+     * @brief Get the number of cell workers, with --jobs=0 resolved to the core count
+     */
+    unsigned int resolved_jobs() const {
+        if (jobs != 0) return jobs;
+        unsigned int cores = std::thread::hardware_concurrency();
+        return cores == 0 ? 1 : cores;
+    }
+    
+    /**
+     * @brief Print one line of progress
+     */
+    void progress(const std::string& line) {
+        std::lock_guard<std::mutex> lock(matrix_mutex);
+        std::cout << line << std::endl;
+    }
+    
+    /**
+     * @brief Open the screening counters file, keeping its rows when resuming
+     */
+    void open_screening_file() {
+        const std::string path = shard_path(screening_file);
+        std::ifstream existing(path);
+        bool keep = resume && existing.good() && existing.peek() != std::ifstream::traits_type::eof();
+        existing.close();
         
-        return timings;
+        screening_out.open(path, keep ? std::ios::app : std::ios::trunc);
+        if (!screening_out) {
+            std::cerr << "Error: Could not open output file " << path << std::endl;
+            return;
+        }
+        if (!keep) {
+            screening_out << "Algorithm,BitSize," << Screening::Stats::csv_header() << std::endl;
+        }
     }
     
     /**
-     * @brief Calculate statistics on timing data
+     * @brief Print the screening counters and append them to the screening CSV
      * 
-     * @param timings Vector of timing measurements
-     * @return std::tuple<double, double, double> Mean, median, and standard deviation
+     * @param algorithm Algorithm name for the CSV row
+     * @param bits Bit size for the CSV row
      */
-    std::tuple<double, double, double> calculate_statistics(const std::vector<double>& timings) {
-        if (timings.empty()) {
-            return std::make_tuple(-1.0, -1.0, -1.0);
+    void record_screening(const std::string& algorithm, int bits) {
+        const Screening::Stats& stats = Screening::stats();
+        stats.print(std::cout);
+        if (screening_out) {
+            screening_out << algorithm << "," << bits << "," << stats.csv_row() << std::endl;
         }
-        
-        // Calculate mean
-        double mean = 0.0;
-        for (double time : timings) {
-            mean += time;
-        }
-        mean /= timings.size();
-        
-        // Calculate median
-        double median = calculate_median(timings);
-        
-        // Calculate standard deviation
-        double stddev = calculate_stddev(timings, mean);
-        
-        return std::make_tuple(mean, median, stddev);
     }
     
 public:
@@ -203,101 +395,447 @@ public:
         }
     }
     
+    /**
+     * @brief Select the candidate search strategy for the find-prime benchmark
+     * 
+     * @param method The search strategy
+     */
+    void set_search_method(PrimalityTester::SearchMethod method) {
+        search_method = method;
+    }
+    
+    /**
+     * @brief Restrict the find-prime and test-prime matrix
+     * 
+     * @param sizes Bit sizes to run (each must be one of bit_sizes)
+     * @param mr_only True to run Miller-Rabin only
+     */
+    void set_matrix(const std::vector<int>& sizes, bool mr_only) {
+        matrix_bit_sizes = sizes;
+        miller_rabin_only = mr_only;
+    }
+    
+    /**
+     * @brief Run the matrix cells on parallel worker threads
+     * 
+     * Cells running at the same time share caches and memory bandwidth, so
+     * their timings are for a loaded machine; use 1 for quiet-machine numbers.
+     * 
+     * @param count Worker threads (0 for one per core, 1 to run on this thread)
+     */
+    void set_jobs(unsigned int count) {
+        jobs = count;
+    }
+    
+    /**
+     * @brief Record GMP allocations per call, bytes per call, peak GMP bytes
+     * and peak RSS for every find-prime, test-prime and safe-prime cell
+     * 
+     * The figures go to the Extra column. The peaks are process-wide, so the
+     * cells run one at a time; MemProfile::install() must have been called.
+     * 
+     * @param enabled True to profile
+     */
+    void set_mem_profile(bool enabled) {
+        mem_profile = enabled;
+        if (enabled) jobs = 1;
+    }
+    
+    /**
+     * @brief Run only every count-th cell of the matrix, starting with index
+     * 
+     * The shards of one matrix can run on different machines; each writes
+     * its own files (results/foo.shard<index>of<count>.csv).
+     * 
+     * @param index This shard, below count
+     * @param count Number of shards
+     */
+    void set_shard(unsigned int index, unsigned int count) {
+        shard_index = index;
+        shard_count = count;
+    }
+    
+    /**
+     * @brief Keep the results already in the output files and skip their cells
+     */
+    void set_resume(bool enabled) {
+        resume = enabled;
+    }
+    
+    /**
+     * @brief Drop the per-cell time budgets (a run ends at its run limit or CI target)
+     */
+    void set_no_safety(bool enabled) {
+        no_safety = enabled;
+    }
+    
     /**
      * @brief Benchmark finding prime numbers
+     * 
+     * Every finished cell is appended to the results file straight away.
      */
     void benchmark_find_prime() {
-        std::cout << "Benchmarking prime number generation..." << std::endl;
+        const std::string search_name = (search_method == PrimalityTester::SIEVE_SEARCH) ? "sieve" : "random";
+        std::cout << "Benchmarking prime number generation (" << search_name << " search)..." << std::endl;
         
-        PrimalityTester tester;
-        std::vector<std::string> results;
+        const std::string path = shard_path(find_prime_file);
+        BenchResults results("find_prime");
+        if (!results.open(path, resume)) {
+            return;
+        }
+        if (parallel_cells()) {
+            std::cout << "Cells run in parallel: screening counters are not recorded" << std::endl;
+        } else {
+            open_screening_file();
+        }
         
-        // Add CSV header
-        results.push_back("Algorithm,BitSize,MeanTimeMs,MedianTimeMs,StdDevTimeMs,Prime");
+        run_cells(shard(matrix_cells(), 0), [&](const Cell& cell, PerfCounters& thread_counters) {
+            if (results.contains(cell.algorithm, cell.bits, search_name)) {
+                progress("Skipping " + std::to_string(cell.bits) + "-bit " + cell.algorithm + " (already in " + path + ")");
+                return;
+            }
+            progress("Finding " + std::to_string(cell.bits) + "-bit prime using " + cell.algorithm + "...");
+            if (!parallel_cells()) Screening::stats().reset();
+            
+            PrimalityTester tester;
+            mpz_t prime;
+            mpz_init(prime);
+            
+            PerfCounters::Sample sample;
+            size_t calls = 0;
+            bool found = true;
+            MemProfile::Report memory;
+            BenchHarness::Summary summary = measure_counted(search_config(), thread_counters, [&]() {
+                found = tester.find_prime(prime, cell.bits, cell.type, search_method) && found;
+            }, sample, calls, mem_profile ? &memory : nullptr);
+            
+            std::lock_guard<std::mutex> lock(matrix_mutex);
+            if (!parallel_cells()) record_screening(cell.algorithm, cell.bits);
+            
+            if (!found) {
+                std::cerr << "Warning: Could not find a prime of " << cell.bits << " bits" << std::endl;
+                results.add_failed(cell.algorithm, cell.bits, search_name);
+                mpz_clear(prime);
+                return;
+            }
+            
+            // Keep a prime of every size for the test-prime benchmark, preferring the Miller-Rabin one
+            if (cell.type == PrimalityTester::MILLER_RABIN || mpz_sgn(found_primes[cell.bits]) == 0) {
+                mpz_set(found_primes[cell.bits], prime);
+            }
+            mpz_clear(prime);
+            
+            results.add(cell.algorithm, cell.bits, search_name, summary, sample, calls,
+                        mem_profile ? memory.extra() : "");
+            
+            std::cout << "  " << cell.bits << "-bit " << cell.algorithm << ":";
+            BenchResults::print(std::cout, summary);
+            std::cout << ", " << sample.summary() << memory_summary(memory) << std::endl;
+        });
+        
+        std::cout << "Prime finding benchmark results written to " << path << std::endl;
+        if (screening_out.is_open()) {
+            screening_out.close();
+            std::cout << "Screening counters written to " << shard_path(screening_file) << std::endl;
+        }
+    }
+    
+    /**
+     * @brief Swap the found primes for the ones in the prime cache
+     * 
+     * Every run then tests the same primes. Sizes the cache does not hold
+     * yet are filled from this run's search and added to it.
+     */
+    void use_cached_primes() {
+        const std::string cache_path = PrimeCache::default_path();
+        PrimeCacheBuilder builder;
+        bool added = false;
         
-        // Test both algorithms for finding primes
+        PrimeCache cache;
+        bool cached = cache.open(cache_path);
+        if (cached) {
+            builder.add_all(cache);
+        }
         for (int bits : bit_sizes) {
-            // Benchmark Miller-Rabin
-            std::cout << "Finding " << bits << "-bit prime using Miller-Rabin..." << std::endl;
-            mpz_t mr_prime;
-            mpz_init(mr_prime);
-            std::vector<double> mr_timings = find_prime_timed(tester, PrimalityTester::MILLER_RABIN, bits, mr_prime);
+            if (cached && cache.load(found_primes[bits], bits, 0)) {
+                continue;
+            }
+            if (mpz_sgn(found_primes[bits]) != 0) {
+                builder.add(found_primes[bits]);
+                added = true;
+            }
+        }
+        cache.close();
+        
+        if (added && !builder.write(cache_path)) {
+            std::cerr << "Warning: Could not write prime cache " << cache_path << std::endl;
+        }
+    }
+    
+    /**
+     * @brief Benchmark primality testing time on found primes
+     * 
+     * Sizes without a cached or found prime (e.g. when their search cell ran
+     * in another shard or an earlier run) get one from an untimed search.
+     */
+    void benchmark_test_prime() {
+        std::cout << "Benchmarking primality testing on found primes..." << std::endl;
+        
+        const std::string path = shard_path(test_prime_file);
+        BenchResults results("test_prime");
+        if (!results.open(path, resume)) {
+            return;
+        }
+        
+        use_cached_primes();
+        
+        std::vector<Cell> cells = matrix_cells();
+        run_cells(shard(cells, cells.size()), [&](const Cell& cell, PerfCounters& thread_counters) {
+            if (results.contains(cell.algorithm, cell.bits, "") &&
+                results.contains(cell.algorithm, cell.bits, "prepared")) {
+                progress("Skipping " + std::to_string(cell.bits) + "-bit " + cell.algorithm + " (already in " + path + ")");
+                return;
+            }
+            progress("Testing " + std::to_string(cell.bits) + "-bit prime using " + cell.algorithm + "...");
             
-            if (!mr_timings.empty()) {
-                // Calculate statistics
-                double mean_time, median_time, stddev_time;
-                std::tie(mean_time, median_time, stddev_time) = calculate_statistics(mr_timings);
-                
-                // Store the found prime for later testing
-                mpz_set(found_primes[bits], mr_prime);
-                
-                // Format result
-                std::string prime_str = MPZUtils::to_string(mr_prime);
-                // Truncate very large primes for CSV
-                if (prime_str.length() > 50) {
-                    prime_str = prime_str.substr(0, 24) + "..." + prime_str.substr(prime_str.length() - 24);
+            PrimalityTester tester;
+            mpz_t prime;
+            mpz_init(prime);
+            {
+                std::lock_guard<std::mutex> lock(matrix_mutex);
+                if (mpz_sgn(found_primes[cell.bits]) == 0) {
+                    tester.generate_prime(found_primes[cell.bits], cell.bits);
                 }
+                mpz_set(prime, found_primes[cell.bits]);
+            }
+            
+            // The plain call redoes the per-n setup every time; "prepared" does it once
+            PreparedModulus prepared(prime);
+            for (const std::string variant : {"", "prepared"}) {
+                if (results.contains(cell.algorithm, cell.bits, variant)) continue;
+                PerfCounters::Sample sample;
+                size_t calls = 0;
+                MemProfile::Report memory;
+                BenchHarness::Summary summary = measure_counted(test_config(), thread_counters, [&]() {
+                    if (variant.empty()) {
+                        tester.is_prime(prime, cell.type);
+                    } else {
+                        tester.is_prime(prepared, cell.type);
+                    }
+                }, sample, calls, mem_profile ? &memory : nullptr);
                 
-                std::ostringstream result;
-                result << "Miller-Rabin," << bits << "," 
-                       << std::fixed << std::setprecision(6) << mean_time << ","
-                       << std::fixed << std::setprecision(6) << median_time << ","
-                       << std::fixed << std::setprecision(6) << stddev_time << ","
-                       << prime_str;
-                results.push_back(result.str());
+                std::lock_guard<std::mutex> lock(matrix_mutex);
+                results.add(cell.algorithm, cell.bits, variant, summary, sample, calls,
+                            mem_profile ? memory.extra() : "");
                 
-                std::cout << "  Mean: " << mean_time << " ms, Median: " << median_time 
-                          << " ms, StdDev: " << stddev_time << " ms" << std::endl;
-            } else {
-                results.push_back("Miller-Rabin," + std::to_string(bits) + ",failed,failed,failed,failed");
+                std::cout << "  " << cell.bits << "-bit " << cell.algorithm
+                          << (variant.empty() ? "" : " (" + variant + ")") << ":";
+                BenchResults::print(std::cout, summary);
+                std::cout << ", " << sample.summary() << memory_summary(memory) << std::endl;
             }
+            mpz_clear(prime);
+        });
+        
+        std::cout << "Primality testing benchmark results written to " << path << std::endl;
+    }
+    
+    /**
+     * @brief Benchmark finding safe primes p = 2q + 1
+     * 
+     * The algorithm is the test used for q (see PrimalityTester::generate_safe_prime).
+     */
+    void benchmark_safe_prime() {
+        std::cout << "Benchmarking safe prime generation (combined sieve)..." << std::endl;
+        
+        const std::string path = shard_path(safe_prime_file);
+        BenchResults results("find_safe_prime");
+        if (!results.open(path, resume)) {
+            return;
+        }
+        
+        run_cells(shard(safe_cells(), 2 * matrix_cells().size()), [&](const Cell& cell, PerfCounters& thread_counters) {
+            if (results.contains(cell.algorithm, cell.bits, "combined")) {
+                progress("Skipping " + std::to_string(cell.bits) + "-bit " + cell.algorithm + " (already in " + path + ")");
+                return;
+            }
+            progress("Finding " + std::to_string(cell.bits) + "-bit safe prime using " + cell.algorithm + "...");
+            
+            PrimalityTester tester;
+            mpz_t prime;
+            mpz_init(prime);
             
-            mpz_clear(mr_prime);
+            PerfCounters::Sample sample;
+            size_t calls = 0;
+            MemProfile::Report memory;
+            BenchHarness::Summary summary = measure_counted(safe_config(), thread_counters, [&]() {
+                tester.generate_safe_prime(prime, cell.bits, cell.type);
+            }, sample, calls, mem_profile ? &memory : nullptr);
+            mpz_clear(prime);
             
-            // Benchmark Baillie-PSW
-            std::cout << "Finding " << bits << "-bit prime using Baillie-PSW..." << std::endl;
-            mpz_t bpsw_prime;
-            mpz_init(bpsw_prime);
-            std::vector<double> bpsw_timings = find_prime_timed(tester, PrimalityTester::BAILLIE_PSW, bits, bpsw_prime);
+            std::lock_guard<std::mutex> lock(matrix_mutex);
+            results.add(cell.algorithm, cell.bits, "combined", summary, sample, calls,
+                        mem_profile ? memory.extra() : "");
+            
+            std::cout << "  " << cell.bits << "-bit " << cell.algorithm << ":";
+            BenchResults::print(std::cout, summary);
+            std::cout << ", " << sample.summary() << memory_summary(memory) << std::endl;
+        });
+        
+        std::cout << "Safe prime benchmark results written to " << path << std::endl;
+    }
+    
+    /**
+     * @brief Benchmark parallel prime search over a sweep of thread counts
+     * 
+     * Thread counts double from 1 up to the number of hardware threads (which is
+     * always included). Speedup and per-core efficiency are relative to the
+     * single-thread mean for the same bit size.
+     */
+    void benchmark_thread_scaling() {
+        std::cout << "Benchmarking parallel prime search scaling..." << std::endl;
+        
+        unsigned int max_threads = std::thread::hardware_concurrency();
+        if (max_threads == 0) max_threads = 1;
+        
+        std::vector<unsigned int> thread_counts;
+        for (unsigned int t = 1; t < max_threads; t *= 2) {
+            thread_counts.push_back(t);
+        }
+        thread_counts.push_back(max_threads);
+        
+        BenchHarness::Config config;
+        config.min_runs = 5;
+        config.max_runs = 100;
+        config.max_seconds = 10.0;
+        config.target_rel_ci = 0.10;
+        
+        BenchResults results("thread_scaling");
+        
+        for (int bits : scaling_bit_sizes) {
+            double single_thread_mean = 0.0;
             
-            if (!bpsw_timings.empty()) {
-                // Calculate statistics
-                double mean_time, median_time, stddev_time;
-                std::tie(mean_time, median_time, stddev_time) = calculate_statistics(bpsw_timings);
+            for (unsigned int threads : thread_counts) {
+                std::cout << "Finding " << bits << "-bit primes with " << threads << " thread(s)..." << std::endl;
+                ParallelPrimeFinder finder(threads);
                 
-                // If we don't already have a prime for this bit size, store this one
-                if (mpz_sgn(found_primes[bits]) == 0) {
-                    mpz_set(found_primes[bits], bpsw_prime);
-                }
+                mpz_t prime;
+                mpz_init(prime);
+                
+                // The workers run on other threads, so there are no counters for this one
+                BenchHarness harness(config);
+                BenchHarness::Summary summary = harness.run([&]() {
+                    finder.find_prime(prime, bits, PrimalityTester::MILLER_RABIN, search_method);
+                });
                 
-                // Format result
-                std::string prime_str = MPZUtils::to_string(bpsw_prime);
-                // Truncate very large primes for CSV
-                if (prime_str.length() > 50) {
-                    prime_str = prime_str.substr(0, 24) + "..." + prime_str.substr(prime_str.length() - 24);
+                mpz_clear(prime);
+                
+                if (threads == 1) {
+                    single_thread_mean = summary.mean;
                 }
+                double speedup = (summary.mean > 0.0) ? single_thread_mean / summary.mean : 0.0;
+                double efficiency = speedup / threads;
+                
+                std::ostringstream extra;
+                extra << std::fixed << std::setprecision(3)
+                      << "speedup=" << speedup << ";efficiency=" << efficiency;
+                results.add("Miller-Rabin", bits, "threads=" + std::to_string(threads), summary,
+                            PerfCounters::Sample(), summary.runs, extra.str());
                 
-                std::ostringstream result;
-                result << "Baillie-PSW," << bits << "," 
-                       << std::fixed << std::setprecision(6) << mean_time << ","
-                       << std::fixed << std::setprecision(6) << median_time << ","
-                       << std::fixed << std::setprecision(6) << stddev_time << ","
-                       << prime_str;
-                results.push_back(result.str());
+                BenchResults::print(std::cout, summary);
+                std::cout << ", speedup: " << speedup << "x, efficiency: " << efficiency << std::endl;
+            }
+        }
+        
+        // Write results to file
+        if (results.write(thread_scaling_file)) {
+            std::cout << "Thread scaling benchmark results written to " << thread_scaling_file << std::endl;
+        }
+    }
+    
+    /**
+     * @brief Benchmark batched primality testing against one call per candidate
+     * 
+     * Both paths test the same random odd candidates, which is the workload of
+     * a prime search: most are rejected by trial division or the base-2 round.
+     * The answers of the two paths are compared for every candidate.
+     */
+    void benchmark_batch() {
+        std::cout << "Benchmarking batched primality testing..." << std::endl;
+        
+        PrimalityTester tester;
+        std::vector<std::string> results;
+        
+        // Add CSV header
+        results.push_back("Algorithm,BitSize,BatchSize,SingleCandidatesPerSec,BatchCandidatesPerSec,Speedup");
+        
+        const std::vector<std::pair<PrimalityTester::TestType, std::string>> algorithms = {
+            {PrimalityTester::MILLER_RABIN, "Miller-Rabin"},
+            {PrimalityTester::BAILLIE_PSW, "Baillie-PSW"}
+        };
+        
+        for (int bits : batch_bit_sizes) {
+            std::unique_ptr<mpz_t[]> candidates(new mpz_t[batch_candidates]);
+            for (size_t i = 0; i < batch_candidates; i++) {
+                mpz_init(candidates[i]);
+                MPZUtils::random_odd(candidates[i], bits, gmp_randstate);
+            }
+            
+            std::unique_ptr<bool[]> single(new bool[batch_candidates]);
+            std::unique_ptr<bool[]> batched(new bool[batch_candidates]);
+            
+            for (const auto& algorithm : algorithms) {
+                // One call per candidate
+                auto start = std::chrono::high_resolution_clock::now();
+                for (size_t i = 0; i < batch_candidates; i++) {
+                    single[i] = tester.is_prime(candidates[i], algorithm.first);
+                }
+                auto end = std::chrono::high_resolution_clock::now();
+                std::chrono::duration<double> single_time = end - start;
+                double single_rate = batch_candidates / single_time.count();
                 
-                std::cout << "  Mean: " << mean_time << " ms, Median: " << median_time 
-                          << " ms, StdDev: " << stddev_time << " ms" << std::endl;
-            } else {
-                results.push_back("Baillie-PSW," + std::to_string(bits) + ",failed,failed,failed,failed");
+                for (size_t batch_size : batch_sizes) {
+                    start = std::chrono::high_resolution_clock::now();
+                    for (size_t first = 0; first < batch_candidates; first += batch_size) {
+                        size_t count = std::min(batch_size, batch_candidates - first);
+                        tester.is_prime_batch(&candidates[first], count, &batched[first], algorithm.first);
+                    }
+                    end = std::chrono::high_resolution_clock::now();
+                    std::chrono::duration<double> batch_time = end - start;
+                    double batch_rate = batch_candidates / batch_time.count();
+                    
+                    size_t mismatches = 0;
+                    for (size_t i = 0; i < batch_candidates; i++) {
+                        if (single[i] != batched[i]) mismatches++;
+                    }
+                    if (mismatches > 0) {
+                        std::cerr << "Warning: batch and single results differ for " << mismatches
+                                  << " " << bits << "-bit candidates" << std::endl;
+                    }
+                    
+                    double speedup = batch_rate / single_rate;
+                    
+                    std::ostringstream result;
+                    result << algorithm.second << "," << bits << "," << batch_size << ","
+                           << std::fixed << std::setprecision(2) << single_rate << ","
+                           << std::fixed << std::setprecision(2) << batch_rate << ","
+                           << std::fixed << std::setprecision(3) << speedup;
+                    results.push_back(result.str());
+                    
+                    std::cout << "  " << algorithm.second << " " << bits << " bits, batch " << batch_size
+                              << ": " << single_rate << " -> " << batch_rate
+                              << " candidates/s (" << speedup << "x)" << std::endl;
+                }
             }
             
-            mpz_clear(bpsw_prime);
+            for (size_t i = 0; i < batch_candidates; i++) {
+                mpz_clear(candidates[i]);
+            }
         }
         
         // Write results to file
-        std::ofstream out(find_prime_file);
+        std::ofstream out(batch_file);
         if (!out) {
-            std::cerr << "Error: Could not open output file " << find_prime_file << std::endl;
+            std::cerr << "Error: Could not open output file " << batch_file << std::endl;
             return;
         }
         
@@ -307,68 +845,78 @@ public:
         
         out.close();
         
-        std::cout << "Prime finding benchmark results written to " << find_prime_file << std::endl;
+        std::cout << "Batch benchmark results written to " << batch_file << std::endl;
     }
     
     /**
-     * @brief Benchmark primality testing time on found primes
+     * @brief Benchmark prime pool acquire latency against a direct search
+     * 
+     * For every bit size, times pool_capacity direct generate_prime calls,
+     * then fills a PrimePool with one refill thread and times the same
+     * number of acquires from it.
      */
-    void benchmark_test_prime() {
-        std::cout << "Benchmarking primality testing on found primes..." << std::endl;
+    void benchmark_pool() {
+        std::cout << "Benchmarking the prime pool..." << std::endl;
         
         PrimalityTester tester;
         std::vector<std::string> results;
         
         // Add CSV header
-        results.push_back("Algorithm,BitSize,MeanTimeMs,MedianTimeMs,StdDevTimeMs");
+        results.push_back("BitSize,Requests,DirectMeanMs,DirectMaxMs,PoolMeanUs,PoolMaxUs,Hits,Misses,RefillPrimesPerSec");
         
-        // Test both algorithms on the found primes
-        for (int bits : bit_sizes) {
-            // Skip if we don't have a prime for this bit size
-            if (mpz_sgn(found_primes[bits]) == 0) {
-                std::cout << "Skipping " << bits << " bits (no prime found)" << std::endl;
-                continue;
+        mpz_t prime;
+        mpz_init(prime);
+        
+        for (unsigned int bits : pool_bit_sizes) {
+            // Direct search on the requesting thread
+            std::vector<double> direct_ms;
+            for (size_t i = 0; i < pool_capacity; i++) {
+                direct_ms.push_back(TimingUtils::measure_time_ms([&]() {
+                    tester.generate_prime(prime, bits);
+                }));
             }
             
-            // Benchmark Miller-Rabin
-            std::cout << "Testing " << bits << "-bit prime using Miller-Rabin..." << std::endl;
-            std::vector<double> mr_timings = test_primality_timed(tester, PrimalityTester::MILLER_RABIN, found_primes[bits]);
-            
-            double mr_mean, mr_median, mr_stddev;
-            std::tie(mr_mean, mr_median, mr_stddev) = calculate_statistics(mr_timings);
-            
-            std::ostringstream mr_result;
-            mr_result << "Miller-Rabin," << bits << "," 
-                      << std::fixed << std::setprecision(6) << mr_mean << ","
-                      << std::fixed << std::setprecision(6) << mr_median << ","
-                      << std::fixed << std::setprecision(6) << mr_stddev;
-            results.push_back(mr_result.str());
-            
-            std::cout << "  Mean: " << mr_mean << " ms, Median: " << mr_median 
-                      << " ms, StdDev: " << mr_stddev << " ms" << std::endl;
+            // Acquire from a full pool
+            PrimePool pool({bits}, pool_capacity);
+            while (!pool.full()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
             
-            // Benchmark Baillie-PSW
-            std::cout << "Testing " << bits << "-bit prime using Baillie-PSW..." << std::endl;
-            std::vector<double> bpsw_timings = test_primality_timed(tester, PrimalityTester::BAILLIE_PSW, found_primes[bits]);
+            std::vector<double> pool_us;
+            for (size_t i = 0; i < pool_capacity; i++) {
+                pool_us.push_back(1000.0 * TimingUtils::measure_time_ms([&]() {
+                    pool.acquire(prime, bits);
+                }));
+            }
             
-            double bpsw_mean, bpsw_median, bpsw_stddev;
-            std::tie(bpsw_mean, bpsw_median, bpsw_stddev) = calculate_statistics(bpsw_timings);
+            const PrimePool::Stats& stats = pool.stats();
+            double direct_mean = std::accumulate(direct_ms.begin(), direct_ms.end(), 0.0) / direct_ms.size();
+            double direct_max = *std::max_element(direct_ms.begin(), direct_ms.end());
+            double pool_mean = std::accumulate(pool_us.begin(), pool_us.end(), 0.0) / pool_us.size();
+            double pool_max = *std::max_element(pool_us.begin(), pool_us.end());
+            double refill_rate = stats.refill_ns.load() > 0 ? stats.refills.load() * 1e9 / stats.refill_ns.load() : 0.0;
             
-            std::ostringstream bpsw_result;
-            bpsw_result << "Baillie-PSW," << bits << "," 
-                        << std::fixed << std::setprecision(6) << bpsw_mean << ","
-                        << std::fixed << std::setprecision(6) << bpsw_median << ","
-                        << std::fixed << std::setprecision(6) << bpsw_stddev;
-            results.push_back(bpsw_result.str());
+            std::ostringstream result;
+            result << bits << "," << pool_capacity << ","
+                   << std::fixed << std::setprecision(3) << direct_mean << ","
+                   << std::fixed << std::setprecision(3) << direct_max << ","
+                   << std::fixed << std::setprecision(3) << pool_mean << ","
+                   << std::fixed << std::setprecision(3) << pool_max << ","
+                   << stats.hits.load() << "," << stats.misses.load() << ","
+                   << std::fixed << std::setprecision(3) << refill_rate;
+            results.push_back(result.str());
             
-            std::cout << "  Mean: " << bpsw_mean << " ms, Median: " << bpsw_median 
-                      << " ms, StdDev: " << bpsw_stddev << " ms" << std::endl;
+            std::cout << "  " << bits << " bits: direct mean " << direct_mean << " ms (max " << direct_max
+                      << " ms), pool mean " << pool_mean << " us (max " << pool_max << " us)" << std::endl;
+            stats.print(std::cout);
         }
         
+        mpz_clear(prime);
+        
         // Write results to file
-        std::ofstream out(test_prime_file);
+        std::ofstream out(pool_file);
         if (!out) {
-            std::cerr << "Error: Could not open output file " << test_prime_file << std::endl;
+            std::cerr << "Error: Could not open output file " << pool_file << std::endl;
             return;
         }
         
@@ -378,7 +926,106 @@ public:
         
         out.close();
         
-        std::cout << "Primality testing benchmark results written to " << test_prime_file << std::endl;
+        std::cout << "Prime pool benchmark results written to " << pool_file << std::endl;
+    }
+    
+    /**
+     * @brief Benchmark job latency under a mixed-size load, with and without work stealing
+     * 
+     * Each round submits the test jobs of mixed_tests (one prime each, so
+     * every test runs all its rounds) and the searches of mixed_workload to a
+     * PrimeJobs pool with one worker per hardware thread, all at once and in
+     * a shuffled order (the same for both variants), and records every job's
+     * latency from submission to completion. "static" runs every job on the
+     * worker that took it; "stealing" splits the large searches into chunks
+     * that idle workers steal. The rows report the latency distribution per
+     * job type and bit size, so the tail is in P90Ms, P99Ms and MaxMs; Extra
+     * has the job type and the mean time for the whole load.
+     */
+    void benchmark_mixed_load() {
+        std::cout << "Benchmarking job latency under a mixed-size load..." << std::endl;
+        
+        // A job is (test, bits); the numbers to test are primes found up front
+        typedef std::pair<bool, unsigned int> MixedJob;
+        std::vector<MixedJob> order;
+        size_t num_tests = 0;
+        for (const auto& entry : mixed_tests) {
+            order.insert(order.end(), entry.second, MixedJob(true, entry.first));
+            num_tests += entry.second;
+        }
+        for (const auto& entry : mixed_workload) {
+            order.insert(order.end(), entry.second, MixedJob(false, entry.first));
+        }
+        std::mt19937 shuffle_rng(2024);
+        std::shuffle(order.begin(), order.end(), shuffle_rng);
+        
+        PrimalityTester tester;
+        std::unique_ptr<mpz_t[]> numbers(new mpz_t[num_tests]);
+        size_t next = 0;
+        for (const MixedJob& job : order) {
+            if (!job.first) continue;
+            mpz_init(numbers[next]);
+            tester.generate_prime(numbers[next], job.second);
+            next++;
+        }
+        
+        BenchResults results("mixed_load");
+        
+        for (bool stealing : {false, true}) {
+            const std::string variant = stealing ? "stealing" : "static";
+            std::map<MixedJob, std::vector<double>> latencies;
+            std::mutex latency_mutex;
+            double makespan_ms = 0.0;
+            unsigned int threads = 0;
+            
+            for (int round = 0; round < mixed_rounds; round++) {
+                PrimeJobs jobs;
+                jobs.set_splitting(stealing);
+                threads = jobs.thread_count();
+                
+                std::vector<PrimeJobs::Handle> handles;
+                size_t tested = 0;
+                auto start = std::chrono::steady_clock::now();
+                for (const MixedJob& job : order) {
+                    PrimeJobs::Options options;
+                    options.on_done = [&, job, start](PrimeJobs::Status) {
+                        std::chrono::duration<double, std::milli> latency = std::chrono::steady_clock::now() - start;
+                        std::lock_guard<std::mutex> lock(latency_mutex);
+                        latencies[job].push_back(latency.count());
+                    };
+                    handles.push_back(job.first ? jobs.submit_test(&numbers[tested++], 1, options)
+                                                : jobs.submit_generate(job.second, options));
+                }
+                for (const auto& handle : handles) {
+                    handle.wait();
+                }
+                std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+                makespan_ms += elapsed.count() / mixed_rounds;
+            }
+            
+            std::cout << "  " << variant << " (" << threads << " workers), load finished in "
+                      << makespan_ms << " ms on average" << std::endl;
+            for (const auto& entry : latencies) {
+                BenchHarness::Summary summary = BenchHarness::summarize(entry.second);
+                std::ostringstream extra;
+                extra << std::fixed << std::setprecision(3) << "job=" << (entry.first.first ? "test" : "generate")
+                      << ";threads=" << threads << ";makespan_ms=" << makespan_ms;
+                results.add("Miller-Rabin", entry.first.second, variant, summary, PerfCounters::Sample(),
+                            summary.runs, extra.str());
+                
+                std::cout << "    " << (entry.first.first ? "test " : "generate ") << entry.first.second << " bits:";
+                BenchResults::print(std::cout, summary);
+                std::cout << std::endl;
+            }
+        }
+        
+        for (size_t i = 0; i < num_tests; i++) {
+            mpz_clear(numbers[i]);
+        }
+        
+        if (results.write(mixed_load_file)) {
+            std::cout << "Mixed-load benchmark results written to " << mixed_load_file << std::endl;
+        }
     }
     
     /**
@@ -387,13 +1034,132 @@ public:
     void run() {
         benchmark_find_prime();
         benchmark_test_prime();
+        benchmark_safe_prime();
         
         std::cout << "All benchmarks completed." << std::endl;
     }
 };
 
+/**
+ * @brief Parse a non-negative decimal option value
+ *
+ * @param text The value, without the option name
+ * @param value Output parameter for the parsed value
+ * @return bool False if text is empty, has a sign or other characters, or does not fit
+ */
+bool parse_count(const std::string& text, unsigned int& value) {
+    if (text.empty() || !std::isdigit(static_cast<unsigned char>(text[0]))) return false;
+    errno = 0;
+    char* end = nullptr;
+    unsigned long parsed = std::strtoul(text.c_str(), &end, 10);
+    if (errno != 0 || *end != '\0' || parsed > std::numeric_limits<int>::max()) return false;
+    value = static_cast<unsigned int>(parsed);
+    return true;
+}
+
 int main(int argc, char* argv[]) {
+    // The allocation hook must be in place before the benchmark initializes any mpz_t
+    bool mem_profile = false;
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]) == "--mem-profile") mem_profile = true;
+    }
+    if (mem_profile) {
+        MemProfile::install();
+    }
+    
     PrimalityBenchmark benchmark;
+    bool thread_sweep = false;
+    bool batch = false;
+    bool pool = false;
+    bool mixed = false;
+    int cpu = -1;
+    unsigned int jobs = 1;
+    
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        
+        if (arg.substr(0, 6) == "--cpu=") {
+            unsigned int value = 0;
+            if (!parse_count(arg.substr(6), value)) {
+                std::cerr << "Error: Invalid CPU " << arg.substr(6) << " (use --cpu=<n>, n at least 0)" << std::endl;
+                return 1;
+            }
+            cpu = static_cast<int>(value);
+        } else if (arg.substr(0, 7) == "--jobs=") {
+            if (!parse_count(arg.substr(7), jobs)) {
+                std::cerr << "Error: Invalid job count " << arg.substr(7) << " (use --jobs=<n>, 0 for one per core)" << std::endl;
+                return 1;
+            }
+            benchmark.set_jobs(jobs);
+        } else if (arg.substr(0, 8) == "--shard=") {
+            // --shard=<index>/<count>
+            std::string spec = arg.substr(8);
+            size_t slash = spec.find('/');
+            unsigned int index = 0, count = 0;
+            if (slash == std::string::npos || !parse_count(spec.substr(0, slash), index) ||
+                !parse_count(spec.substr(slash + 1), count) || count == 0 || index >= count) {
+                std::cerr << "Error: Invalid shard " << spec << " (use --shard=<index>/<count>, index below count)" << std::endl;
+                return 1;
+            }
+            benchmark.set_shard(index, count);
+        } else if (arg == "--resume") {
+            benchmark.set_resume(true);
+        } else if (arg == "--no-safety") {
+            benchmark.set_no_safety(true);
+        } else if (arg == "--only-2048") {
+            benchmark.set_matrix({2048}, true);
+        } else if (arg == "--include-4096") {
+            benchmark.set_matrix({2048, 4096}, true);
+        } else if (arg == "--search=random") {
+            benchmark.set_search_method(PrimalityTester::RANDOM_RESTART);
+        } else if (arg == "--search=sieve") {
+            benchmark.set_search_method(PrimalityTester::SIEVE_SEARCH);
+        } else if (arg == "--thread-sweep") {
+            thread_sweep = true;
+        } else if (arg == "--batch") {
+            batch = true;
+        } else if (arg == "--pool") {
+            pool = true;
+        } else if (arg == "--mixed") {
+            mixed = true;
+        }
+    }
+    
+    // After --jobs, which it overrides
+    if (mem_profile) {
+        if (jobs != 1) {
+            std::cerr << "Warning: --mem-profile runs the cells one at a time, --jobs is ignored" << std::endl;
+        }
+        benchmark.set_mem_profile(true);
+    }
+    
+    // Worker threads inherit the affinity, so the thread sweep and the mixed load are never pinned
+    if (cpu >= 0 && (thread_sweep || mixed)) {
+        std::cerr << "Warning: --cpu is ignored with --thread-sweep and --mixed" << std::endl;
+    } else if (cpu >= 0 && !BenchHarness::pin_to_cpu(cpu)) {
+        std::cerr << "Warning: Could not pin to CPU " << cpu << std::endl;
+    }
+    
+    if (thread_sweep) {
+        benchmark.benchmark_thread_scaling();
+        return 0;
+    }
+    
+    if (batch) {
+        benchmark.benchmark_batch();
+        return 0;
+    }
+    
+    if (pool) {
+        benchmark.benchmark_pool();
+        return 0;
+    }
+    
+    if (mixed) {
+        benchmark.benchmark_mixed_load();
+        return 0;
+    }
+    
     benchmark.run();
     return 0;
 } 
\ No newline at end of file
@@ -1,6 +1,9 @@
 #include "../../include/prng/lcg.h"
 #include "../../include/prng/xoshiro.h"
-#include "../../include/utils/timing.h"
+#include "../../include/prng/xoshiro_simd.h"
+#include "../../include/prng/random_bits.h"
+#include "../../include/utils/bench_harness.h"
+#include "../../include/utils/mem_profile.h"
 #include <iostream>
 #include <iomanip>
 #include <vector>
@@ -11,6 +14,7 @@
 #include <algorithm>
 #include <cmath>
 #include <tuple>
+#include <chrono>
 
 /**
  * @brief Benchmark PRNGs for random number generation
@@ -23,120 +27,204 @@ private:
     // Bit sizes to benchmark
     const std::vector<int> bit_sizes = {40, 56, 80, 128, 168, 224, 256, 512, 1024, 2048, 4096};
     
-    // Number of runs to average over
-    const int num_runs = 30;
+    // Measurement parameters: per-call times are sub-microsecond, so many runs are cheap
+    BenchHarness::Config harness_config() const {
+        BenchHarness::Config config;
+        config.min_runs = 30;
+        config.max_runs = 100000;
+        config.max_seconds = 0.5;
+        config.target_rel_ci = 0.02;
+        return config;
+    }
     
     // Output file for CSV results
     const std::string output_file = "results/prng_benchmark.csv";
+    const std::string throughput_file = "results/prng_throughput.csv";
     
-    /**
-     * @brief Calculate standard deviation
-     * 
-     * @param values Vector of values
-     * @param mean Mean value
-     * @return double Standard deviation
-     */
-    double calculate_stddev(const std::vector<double>& values, double mean) {
-        double variance = 0.0;
-        for (double value : values) {
-            variance += (value - mean) * (value - mean);
-        }
-        return std::sqrt(variance / values.size());
-    }
+    // Bytes to generate per throughput measurement
+    const size_t throughput_bytes = size_t(1) << 24;
+    
+    // Calls per hardware counter measurement (one call is too short to read the counters around)
+    const int counter_calls = 1000;
+    
+    // Hardware counters of the benchmark thread
+    PerfCounters counters;
+    
+    // Add GMP allocation and peak-memory figures to the rows (--mem-profile)
+    bool mem_profile = false;
     
     /**
-     * @brief Calculate median
+     * @brief Benchmark a single PRNG
      * 
-     * @param values Vector of values
-     * @return double Median value
+     * @param source Bit source: InterfaceBits for the virtual path, RandomBits<Gen> for the template path
+     * @param name The name of the PRNG for output
+     * @param variant The call path for output ("virtual" or "template")
+     * @param results Result set to add the rows to
      */
-    double calculate_median(std::vector<double> values) {
-        std::sort(values.begin(), values.end());
-        if (values.size() % 2 == 0) {
-            return (values[values.size() / 2 - 1] + values[values.size() / 2]) / 2.0;
-        } else {
-            return values[values.size() / 2];
+    template <typename Source>
+    void benchmark_prng(Source& source, const std::string& name, const std::string& variant,
+                        BenchResults& results) {
+        std::cout << "Benchmarking " << name << " (" << variant << ")..." << std::endl;
+        
+        mpz_t num;
+        mpz_init(num);
+        BenchHarness harness(harness_config());
+        
+        for (int bits : bit_sizes) {
+            // Time single calls until the median is known well enough
+            BenchHarness::Summary summary = harness.run([&]() {
+                source(num, bits);
+            });
+            
+            // Hardware counters (and the memory profile) over a block of calls, reported per call
+            MemProfile memory;
+            if (mem_profile) memory.begin();
+            counters.start();
+            for (int call = 0; call < counter_calls; call++) {
+                source(num, bits);
+            }
+            PerfCounters::Sample sample = counters.stop();
+            MemProfile::Report report = memory.end(counter_calls);
+            
+            results.add(name, bits, variant, summary, sample, counter_calls, mem_profile ? report.extra() : "");
+            
+            std::cout << "  " << bits << " bits:";
+            BenchResults::print(std::cout, summary);
+            std::cout << ", " << sample.summary();
+            if (mem_profile) std::cout << ", " << report.summary();
+            std::cout << std::endl;
         }
+        
+        mpz_clear(num);
     }
     
     /**
-     * @brief Benchmark a single PRNG
+     * @brief Measure the output rate of a PRNG through randbits and through fill
+     * 
+     * Both paths generate throughput_bytes worth of bits-sized numbers: one
+     * randbits call per number, or one fill call per number's worth of words.
      * 
-     * @param prng The PRNG to benchmark
+     * @param source Bit source: InterfaceBits for the virtual path, RandomBits<Gen> for the template path
      * @param name The name of the PRNG for output
+     * @param isa Instruction set of the generator ("scalar" for the plain ones)
      * @param results Vector to store result strings
      */
-    void benchmark_prng(PRNGInterface& prng, const std::string& name, std::vector<std::string>& results) {
-        std::cout << "Benchmarking " << name << "..." << std::endl;
+    template <typename Source>
+    void benchmark_throughput(Source& source, const std::string& name, const std::string& isa,
+                              std::vector<std::string>& results) {
+        std::cout << "Measuring throughput of " << name << " (" << isa << ")..." << std::endl;
         
         mpz_t num;
         mpz_init(num);
         
         for (int bits : bit_sizes) {
-            // Vector to store all time measurements
-            std::vector<double> time_measurements;
+            size_t words = (bits + 63) / 64;
+            size_t count = std::max<size_t>(1, throughput_bytes / (words * 8));
+            std::vector<uint64_t> buffer(words);
             
-            // Run the benchmark multiple times for statistical significance
-            for (int run = 0; run < num_runs; run++) {
-                // Measure time to generate a random number of the specified bit size
-                double run_time = TimingUtils::measure_time_ms([&]() {
-                    prng.randbits(num, bits);
-                });
-                
-                time_measurements.push_back(run_time);
+            auto start = std::chrono::high_resolution_clock::now();
+            for (size_t i = 0; i < count; i++) {
+                source(num, bits);
             }
+            auto end = std::chrono::high_resolution_clock::now();
+            std::chrono::duration<double> randbits_time = end - start;
             
-            // Calculate statistics
-            double mean_time = 0.0;
-            for (double time : time_measurements) {
-                mean_time += time;
+            start = std::chrono::high_resolution_clock::now();
+            for (size_t i = 0; i < count; i++) {
+                source.fill(buffer.data(), words);
             }
-            mean_time /= time_measurements.size();
+            end = std::chrono::high_resolution_clock::now();
+            std::chrono::duration<double> fill_time = end - start;
             
-            double median_time = calculate_median(time_measurements);
-            double stddev_time = calculate_stddev(time_measurements, mean_time);
+            double randbits_rate = count * (bits / 8.0) / randbits_time.count();
+            double fill_rate = count * words * 8.0 / fill_time.count();
             
-            // Format the result string
             std::ostringstream result;
-            result << name << "," << bits << "," 
-                   << std::fixed << std::setprecision(6) << mean_time << ","
-                   << std::fixed << std::setprecision(6) << median_time << ","
-                   << std::fixed << std::setprecision(6) << stddev_time;
+            result << name << "," << isa << "," << bits << ","
+                   << std::fixed << std::setprecision(0) << randbits_rate << ","
+                   << std::fixed << std::setprecision(0) << fill_rate;
             results.push_back(result.str());
             
-            std::cout << "  " << bits << " bits: Mean=" << mean_time 
-                      << " ms, Median=" << median_time 
-                      << " ms, StdDev=" << stddev_time << " ms" << std::endl;
+            std::cout << "  " << bits << " bits: randbits " << randbits_rate / 1e6
+                      << " MB/s, fill " << fill_rate / 1e6 << " MB/s" << std::endl;
         }
         
         mpz_clear(num);
     }
     
+    /**
+     * @brief Benchmark a generator through the virtual interface and through RandomBits
+     * 
+     * The rows carry Variant "virtual" or "template". Each path gets its
+     * own generator with the same seed, so both draw the same numbers.
+     */
+    template <typename Gen>
+    void benchmark_both(const std::string& name, BenchResults& results) {
+        Gen virtual_gen(seed);
+        InterfaceBits virtual_bits(virtual_gen);
+        benchmark_prng(virtual_bits, name, "virtual", results);
+        
+        Gen template_gen(seed);
+        RandomBits<Gen> template_bits(template_gen);
+        benchmark_prng(template_bits, name, "template", results);
+    }
+    
+    /**
+     * @brief Throughput of a generator through the virtual interface and through RandomBits
+     *
+     * @param args Constructor arguments after the seed
+     */
+    template <typename Gen, typename... Args>
+    void throughput_both(const std::string& name, const std::string& isa, std::vector<std::string>& results,
+                         Args... args) {
+        Gen virtual_gen(seed, args...);
+        InterfaceBits virtual_bits(virtual_gen);
+        benchmark_throughput(virtual_bits, name, isa, results);
+        
+        Gen template_gen(seed, args...);
+        RandomBits<Gen> template_bits(template_gen);
+        benchmark_throughput(template_bits, name + " (template)", isa, results);
+    }
+    
 public:
     /**
-     * @brief Run the PRNG benchmarks
+     * @brief Record GMP allocations and bytes per call, peak GMP bytes and
+     * peak RSS in the Extra column of every row
+     * 
+     * MemProfile::install() must have been called.
+     * 
+     * @param enabled True to profile
      */
-    void run() {
+    void set_mem_profile(bool enabled) {
+        mem_profile = enabled;
+    }
+    
+    /**
+     * @brief Run the throughput benchmarks for the scalar and multi-stream generators
+     */
+    void run_throughput() {
         std::vector<std::string> results;
         
         // Add CSV header
-        results.push_back("Algorithm,BitSize,MeanTimeMs,MedianTimeMs,StdDevTimeMs");
+        results.push_back("Algorithm,ISA,BitSize,RandbitsBytesPerSec,FillBytesPerSec");
         
-        // Create and benchmark each PRNG
-        {
-            LCG lcg(seed);
-            benchmark_prng(lcg, "LCG", results);
-        }
+        throughput_both<LCG>("LCG", "scalar", results);
+        throughput_both<Xoshiro256pp>("Xoshiro256++", "scalar", results);
         
-        {
-            Xoshiro256pp xoshiro(seed);
-            benchmark_prng(xoshiro, "Xoshiro256++", results);
+        // Every lane update kernel this host can run, picked at run time
+        const Xoshiro256ppSimd::Isa kernels[] = {
+            Xoshiro256ppSimd::GENERIC, Xoshiro256ppSimd::AVX2, Xoshiro256ppSimd::AVX512, Xoshiro256ppSimd::RVV
+        };
+        for (Xoshiro256ppSimd::Isa kernel : kernels) {
+            if (Xoshiro256ppSimd::supported(kernel)) {
+                throughput_both<Xoshiro256ppSimd>("Xoshiro256++x8", Xoshiro256ppSimd::isa_name(kernel), results, kernel);
+            }
         }
         
         // Write results to file
-        std::ofstream out(output_file);
+        std::ofstream out(throughput_file);
         if (!out) {
-            std::cerr << "Error: Could not open output file " << output_file << std::endl;
+            std::cerr << "Error: Could not open output file " << throughput_file << std::endl;
             return;
         }
         
@@ -146,12 +234,51 @@ public:
         
         out.close();
         
-        std::cout << "Benchmark results written to " << output_file << std::endl;
+        std::cout << "Throughput results written to " << throughput_file << std::endl;
+    }
+    
+    /**
+     * @brief Run the PRNG benchmarks
+     */
+    void run() {
+        BenchResults results("prng");
+        
+        // Create and benchmark each PRNG, through the interface and through RandomBits
+        benchmark_both<LCG>("LCG", results);
+        benchmark_both<Xoshiro256pp>("Xoshiro256++", results);
+        
+        // Write results to file
+        if (results.write(output_file)) {
+            std::cout << "Benchmark results written to " << output_file << std::endl;
+        }
     }
 };
 
-int main() {
+int main(int argc, char* argv[]) {
     PRNGBenchmark benchmark;
+    bool run_throughput = false;
+    
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        
+        if (arg.substr(0, 6) == "--cpu=") {
+            int cpu = std::stoi(arg.substr(6));
+            if (!BenchHarness::pin_to_cpu(cpu)) {
+                std::cerr << "Warning: Could not pin to CPU " << cpu << std::endl;
+            }
+        } else if (arg == "--throughput") {
+            run_throughput = true;
+        } else if (arg == "--mem-profile") {
+            MemProfile::install();  // No mpz_t exists before run()
+            benchmark.set_mem_profile(true);
+        }
+    }
+    
+    if (run_throughput) {
+        benchmark.run_throughput();
+        return 0;
+    }
+    
     benchmark.run();
     return 0;
 } 
\ No newline at end of file